@@ -11,7 +11,9 @@
 #include <sodium.h>
 
 #include <vector>
+#include <algorithm>
 #include <array>
+#include <mutex>
 #include <atomic>
 #include <optional>
 #include <cstddef>
@@ -569,6 +571,13 @@ public:
 	template<typename VectorType>
 	void accumulate_values_parallel(VectorType& vec) const;
 
+	//Serializes every value (as XdrT), in key order, without copying them into a vector first.
+	//get_buffer(total_bytes) is called once, after sizing, and must return a buffer of at least that size;
+	//it is then filled, in parallel, with the xdr encoding of accumulate_values_parallel()'s output
+	//(minus the length prefix).
+	template<typename XdrT, typename GetBufferFn>
+	void serialize_values_parallel(GetBufferFn&& get_buffer) const;
+
 	template<typename MergeFn = OverwriteMergeFn>
 	void merge_in(serial_trie_t& trie) {
 		std::lock_guard lock(mtx);
@@ -1132,6 +1141,75 @@ AccountTrie<ValueType>::accumulate_values_parallel(VectorType& output) const {
 		});
 }
 
+template<typename ValueType>
+template<typename XdrT, typename GetBufferFn>
+void
+AccountTrie<ValueType>::serialize_values_parallel(GetBufferFn&& get_buffer) const {
+
+	std::lock_guard lock(mtx);
+
+	if (size() == 0) {
+		get_buffer(0);
+		return;
+	}
+
+	AccountAccumulateValuesRange<node_t> range(root, allocator);
+
+	struct Segment {
+		uint64_t vector_offset;
+		std::vector<ptr_t> work_list;
+		size_t byte_offset;
+		size_t num_bytes;
+	};
+
+	std::mutex segments_mtx;
+	std::vector<Segment> segments;
+
+	//first pass only sizes each range, so that every range knows where its output starts
+	tbb::parallel_for(
+		range,
+		[&segments_mtx, &segments, this] (const auto& range) {
+			size_t segment_size = 0;
+			auto size_fn = [&segment_size] (const ValueType& value) {
+				segment_size += xdr::xdr_argpack_size(static_cast<const XdrT&>(value));
+			};
+			for (size_t i = 0; i < range.work_list.size(); i++) {
+				allocator.get_object(range.work_list[i]).apply(size_fn, allocator);
+			}
+
+			std::lock_guard lock(segments_mtx);
+			segments.push_back(Segment{range.vector_offset, range.work_list, 0, segment_size});
+		});
+
+	std::sort(segments.begin(), segments.end(),
+		[] (const auto& a, const auto& b) {
+			return a.vector_offset < b.vector_offset;
+		});
+
+	size_t total_bytes = 0;
+	for (auto& segment : segments) {
+		segment.byte_offset = total_bytes;
+		total_bytes += segment.num_bytes;
+	}
+
+	unsigned char* out = get_buffer(total_bytes);
+
+	tbb::parallel_for(
+		tbb::blocked_range<size_t>(0, segments.size()),
+		[&segments, out, this] (const auto& r) {
+			for (size_t idx = r.begin(); idx < r.end(); idx++) {
+				auto& segment = segments[idx];
+				xdr::xdr_put p(out + segment.byte_offset, out + segment.byte_offset + segment.num_bytes);
+				auto serialize_fn = [&p] (const ValueType& value) {
+					p(static_cast<const XdrT&>(value));
+				};
+				for (size_t i = 0; i < segment.work_list.size(); i++) {
+					allocator.get_object(segment.work_list[i]).apply(serialize_fn, allocator);
+				}
+			}
+		});
+}
+
 template<typename ValueType>
 template<typename VectorType>
 void 
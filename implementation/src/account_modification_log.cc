@@ -139,20 +139,8 @@ AccountModificationLog::freeze_and_hash(Hash& hash) {
 	float res = measure_time(timestamp);
 	modification_log.sz_check();
 
-	*persistable_block = modification_log.template accumulate_values_parallel<AccountModificationBlock>();
-
-	float res2 = measure_time(timestamp);
-
-	std::printf("acct log freeze_and_hash time: hash and normalize %lf accumulate block %lf\n", res, res2);
-
-	INTEGRITY_CHECK_F(
-		for (size_t i = 0; i < persistable_block->size(); i ++) {
-			if ((*persistable_block)[i].owner == 0 && i != 0) {
-				std::printf("i %lu owner not set!\n", i);
-				throw std::runtime_error("owner not set during accumulate_values_parallel");
-			}
-		}
-	);
+	//The block is only materialized in persist_block, and only if the caller wants it back.
+	std::printf("acct log freeze_and_hash time: hash and normalize %lf\n", res);
 }
 
 
@@ -233,19 +221,10 @@ AccountModificationLog::persist_block(uint64_t block_number, bool return_block)
 	std::lock_guard lock(mtx);
 	//AccountModificationBlock vec = modification_log.template accumulate_values<AccountModificationBlock> ();
 	std::printf("saving account log for block %lu\n", block_number);
-	if (write_buffer == nullptr) {
-		std::printf("write buffer was null!!!\n");
-		throw std::runtime_error("null write buffer");
-	}
 	//save_xdr_to_file_fast(vec, log_name(block_number).c_str());
 
 	//AccountModificationBlock vec = modification_log.template accumulate_values_parallel<AccountModificationBlock> ();
 
-	if ((persistable_block->size() == 0) && (modification_log.size() > 0)) {
-		std::printf("forming log in persist_block\n");
-		*persistable_block = modification_log.template accumulate_values_parallel<AccountModificationBlock>();
-	}
-
 	auto& block_fd = file_preallocator.wait_for_prealloc();
 	if (!block_fd) {
 		throw std::runtime_error("block wasn't preallocated!!!");
@@ -265,14 +244,35 @@ AccountModificationLog::persist_block(uint64_t block_number, bool return_block)
 
 	BLOCK_INFO("block_fd = %d", block_fd.get());
 
-	BLOCK_INFO("persist_block size: %lu\n", persistable_block->size());
-	if (persistable_block->size() != modification_log.size()) {
-		throw std::runtime_error("must be error in accumulate_values_parallel");
+	if (return_block) {
+		if ((persistable_block->size() == 0) && (modification_log.size() > 0)) {
+			std::printf("forming log in persist_block\n");
+			*persistable_block = modification_log.template accumulate_values_parallel<AccountModificationBlock>();
+		}
+
+		BLOCK_INFO("persist_block size: %lu\n", persistable_block->size());
+		if (persistable_block->size() != modification_log.size()) {
+			throw std::runtime_error("must be error in accumulate_values_parallel");
+		}
+
+		std::lock_guard writer_lock(block_writer_mtx);
+		//waits for the previous block's file, and takes ownership of block_fd
+		block_writer.write_async(*persistable_block, std::move(block_fd));
+	} else {
+		//No one needs the block itself, so serialize straight from the trie, in parallel,
+		//into the writer's aligned buffer.
+		BLOCK_INFO("persist_block size: %lu\n", modification_log.size());
+
+		std::lock_guard writer_lock(block_writer_mtx);
+		//waits for the previous block's file, and takes ownership of block_fd
+		modification_log.template serialize_values_parallel<AccountModificationTxList>(
+			[this, &block_fd] (size_t list_bytes) {
+				return block_writer.begin_in_place(std::move(block_fd), modification_log.size(), list_bytes);
+			});
+		block_writer.submit_in_place();
 	}
-	save_xdr_to_file_fast(*persistable_block, block_fd, write_buffer, BUF_SIZE);
 	//save_account_block_fast(*persistable_block, block_fd, write_buffer, BUF_SIZE);
-	BLOCK_INFO("done saving mod block");
-	block_fd.clear();
+	BLOCK_INFO("done serializing mod block");
 //	num_txs_in_log = 0;
 
 	if (return_block) {
@@ -350,6 +350,8 @@ void
 AccountModificationLog::diff_with_prev_log(uint64_t block_number) {
 	AccountModificationBlock prev;
 
+	wait_for_persisted_block();
+
 	auto filename = tx_block_name(block_number);
 	if (load_xdr_from_file(prev, filename.c_str())) {
 		throw std::runtime_error("couldn't load previous comparison data");
@@ -8,6 +8,7 @@
 #include "xdr/database_commitments.h"
 #include "threadlocal_cache.h"
 #include "file_prealloc_worker.h"
+#include "io_uring_file_writer.h"
 
 #include "xdr/types.h"
 #include "utils.h"
@@ -151,8 +152,12 @@ private:
 	FilePreallocWorker file_preallocator;
 	BackgroundDeleter<int> deleter;
 
-	constexpr static unsigned int BUF_SIZE = 5*1677716;
-	unsigned char* write_buffer = new unsigned char[BUF_SIZE];
+	//Account log files are written asynchronously.  Guarded by block_writer_mtx, not mtx,
+	//so the persistence thread can wait on a write without blocking the next block's log.
+	//Lock order is mtx, then block_writer_mtx.
+	std::mutex block_writer_mtx;
+	IoUringFileWriter block_writer;
+
 	friend class SerialAccountModificationLog;
 
 public:
@@ -166,6 +171,8 @@ public:
 		, mtx()
 		, file_preallocator()
 		, deleter() 
+		, block_writer_mtx()
+		, block_writer()
 		{
 			std::thread([this] () {
 				deleter.run();
@@ -177,7 +184,6 @@ public:
 
 	~AccountModificationLog() {
 		std::lock_guard lock(mtx);
-		delete[] write_buffer;
 		deleter.terminate();
 	}
 
@@ -274,9 +280,15 @@ public:
 		}*/
 	}
 
+	//Returns once the log is serialized; the file is durable only after wait_for_persisted_block().
 	std::unique_ptr<AccountModificationBlock>
 	persist_block(uint64_t block_number, bool return_block);
 
+	void wait_for_persisted_block() {
+		std::lock_guard lock(block_writer_mtx);
+		block_writer.wait();
+	}
+
 	//const std::vector<AccountID>& get_dirty_accounts();
 
 
@@ -315,6 +327,11 @@ public:
 	void log_other_modification(AccountID tx_owner, uint64_t sequence_number, AccountID modified_account);
 	void log_new_self_transaction(const SignedTransaction& tx);
 
+	//for opening more serial logs (i.e. on other threads) into the same main log
+	AccountModificationLog& get_main_log() {
+		return main_log;
+	}
+
 	//void finish();
 
 	//void _finish_nolock();
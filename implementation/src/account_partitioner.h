@@ -0,0 +1,254 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_sort.h>
+
+#include "memory_database.h"
+#include "tx_write_set.h"
+
+namespace edce {
+
+/*
+Output of AccountPartitioner: the units (txs, or per-account tx lists) of a block,
+grouped so that no account written by a unit in one group is written by a unit in another.
+units[partition_starts[p]..partition_starts[p+1]) is partition p.
+Within a group, units keep their order in the block.
+
+The exception is the residue: units that touch an account not yet in the committed db
+(i.e. created in this block).  These can't be placed in the index space of the union-find,
+so they go (in block order) in the last partitions, and may still contend with other partitions.
+*/
+struct AccountPartitionedBlock {
+	std::vector<uint32_t> units;
+	std::vector<size_t> partition_starts = {0};
+
+	size_t num_components = 0;
+	size_t largest_component = 0;
+	size_t num_residue_units = 0;
+
+	size_t num_partitions() const {
+		return partition_starts.size() - 1;
+	}
+};
+
+/*
+Finds the connected components of the graph where units are joined if they write a common account,
+using a lock-free union-find over db indices.  Roots are always linked under the smaller root,
+so every component's representative is its minimum account index,
+and the output does not depend on thread scheduling.
+
+Components are then packed, in order of representative, into partitions of roughly
+num_units / target_num_partitions units.  A component is never split across partitions,
+so a single very hot account yields one large partition.
+Asking for several partitions per thread leaves room for work stealing.
+
+The union-find array is kept across blocks: only the entries written by the last block
+(every entry a union or path halving can change) are reset,
+and the array only grows, when accounts are added to the db.
+So one partitioner should be reused from block to block (see EdceManagementStructures).
+Not threadsafe: one partition() at a time.
+
+TxList must provide size() and for_each_written_account(idx, func).
+*/
+class AccountPartitioner {
+
+	constexpr static uint32_t RESIDUE = UINT32_MAX;
+
+	const MemoryDatabase& db;
+
+	std::unique_ptr<std::atomic<uint32_t>[]> parents;
+	//entries [0, num_accounts) are in use (and all roots, between partition() calls)
+	size_t num_accounts = 0;
+	size_t capacity = 0;
+
+	//db indices written by the current block
+	std::vector<uint32_t> touched_accounts;
+	std::mutex touched_accounts_mtx;
+
+	uint32_t find(uint32_t x) {
+		while (true) {
+			uint32_t p = parents[x].load(std::memory_order_relaxed);
+			if (p == x) {
+				return x;
+			}
+			uint32_t gp = parents[p].load(std::memory_order_relaxed);
+			if (gp != p) {
+				//path halving.  Fine if this fails; gp remains an ancestor of x.
+				parents[x].compare_exchange_weak(p, gp, std::memory_order_relaxed);
+			}
+			x = gp;
+		}
+	}
+
+	void unite(uint32_t a, uint32_t b) {
+		while (true) {
+			a = find(a);
+			b = find(b);
+			if (a == b) {
+				return;
+			}
+			if (a < b) {
+				std::swap(a, b);
+			}
+			uint32_t expected = a;
+			if (parents[a].compare_exchange_strong(expected, b, std::memory_order_relaxed)) {
+				return;
+			}
+		}
+	}
+
+	void init_parents(size_t start, size_t end) {
+		tbb::parallel_for(
+			tbb::blocked_range<size_t>(start, end),
+			[this] (auto r) {
+				for (auto i = r.begin(); i < r.end(); i++) {
+					parents[i].store(i, std::memory_order_relaxed);
+				}
+			});
+	}
+
+	//covers any accounts added to the db since the last block
+	void grow() {
+		size_t new_num_accounts = db.size();
+		if (new_num_accounts >= RESIDUE) {
+			throw std::runtime_error("too many accounts for AccountPartitioner");
+		}
+		if (new_num_accounts <= num_accounts) {
+			return;
+		}
+		if (new_num_accounts > capacity) {
+			//every entry is a root here, so nothing needs copying
+			capacity = std::max(new_num_accounts, 2 * capacity);
+			parents = std::make_unique<std::atomic<uint32_t>[]>(capacity);
+			init_parents(0, new_num_accounts);
+		} else {
+			init_parents(num_accounts, new_num_accounts);
+		}
+		num_accounts = new_num_accounts;
+	}
+
+	//Only entries written this block can have changed: a union only ever links
+	//the root of a tree of written accounts, which is itself a written account.
+	void reset_touched() {
+		tbb::parallel_for(
+			tbb::blocked_range<size_t>(0, touched_accounts.size()),
+			[this] (auto r) {
+				for (auto i = r.begin(); i < r.end(); i++) {
+					uint32_t idx = touched_accounts[i];
+					parents[idx].store(idx, std::memory_order_relaxed);
+				}
+			});
+		touched_accounts.clear();
+	}
+
+public:
+
+	AccountPartitioner(const MemoryDatabase& db) : db(db) {}
+
+	template<typename TxList>
+	void partition(const TxList& txs, size_t target_num_partitions, AccountPartitionedBlock& out);
+};
+
+template<typename TxList>
+void
+AccountPartitioner::partition(const TxList& txs, size_t target_num_partitions, AccountPartitionedBlock& out) {
+	size_t num_units = txs.size();
+	if (num_units >= RESIDUE) {
+		throw std::runtime_error("too many txs for AccountPartitioner");
+	}
+
+	grow();
+
+	std::vector<uint32_t> first_accounts(num_units);
+
+	tbb::parallel_for(
+		tbb::blocked_range<size_t>(0, num_units),
+		[this, &txs, &first_accounts] (auto r) {
+			std::vector<uint32_t> touched;
+			for (auto i = r.begin(); i < r.end(); i++) {
+				uint32_t first = RESIDUE;
+				bool is_residue = false;
+				txs.for_each_written_account(i, [this, &first, &is_residue, &touched] (const AccountID& account) {
+					account_db_idx idx;
+					if (!db.lookup_user_id(account, &idx)) {
+						is_residue = true;
+						return;
+					}
+					touched.push_back(idx);
+					if (first == RESIDUE) {
+						first = idx;
+					} else {
+						unite(first, idx);
+					}
+				});
+				first_accounts[i] = is_residue ? RESIDUE : first;
+			}
+			std::lock_guard lock(touched_accounts_mtx);
+			touched_accounts.insert(touched_accounts.end(), touched.begin(), touched.end());
+		});
+
+	//(component representative, unit), residue last
+	std::vector<uint64_t> keys(num_units);
+
+	tbb::parallel_for(
+		tbb::blocked_range<size_t>(0, num_units),
+		[this, &first_accounts, &keys] (auto r) {
+			for (auto i = r.begin(); i < r.end(); i++) {
+				uint64_t root = (first_accounts[i] == RESIDUE) ? RESIDUE : find(first_accounts[i]);
+				keys[i] = (root << 32) | i;
+			}
+		});
+
+	reset_touched();
+
+	tbb::parallel_sort(keys.begin(), keys.end());
+
+	out.units.resize(num_units);
+	out.partition_starts = {0};
+	out.num_components = 0;
+	out.largest_component = 0;
+	out.num_residue_units = 0;
+
+	size_t target_partition_size = std::max<size_t>(1, num_units / std::max<size_t>(1, target_num_partitions));
+
+	size_t partition_size = 0;
+	size_t component_size = 0;
+	uint64_t prev_root = static_cast<uint64_t>(RESIDUE) + 1;
+
+	for (size_t i = 0; i < num_units; i++) {
+		uint64_t root = keys[i] >> 32;
+		out.units[i] = static_cast<uint32_t>(keys[i]);
+
+		bool new_component = (root != prev_root);
+		if (new_component) {
+			out.num_components += (root != RESIDUE);
+			component_size = 0;
+		}
+		//residue units share no invariant, so can be split anywhere.
+		if (partition_size >= target_partition_size && (new_component || root == RESIDUE)) {
+			out.partition_starts.push_back(i);
+			partition_size = 0;
+		}
+		if (root == RESIDUE) {
+			out.num_residue_units++;
+		} else {
+			component_size++;
+			out.largest_component = std::max(out.largest_component, component_size);
+		}
+		partition_size++;
+		prev_root = root;
+	}
+	if (num_units > 0) {
+		out.partition_starts.push_back(num_units);
+	}
+}
+
+} /* edce */
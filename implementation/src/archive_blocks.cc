@@ -0,0 +1,79 @@
+#include "block_archive.h"
+#include "file_prealloc_worker.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace edce;
+
+static size_t file_size(const std::string& filename) {
+	struct stat st;
+	if (stat(filename.c_str(), &st)) {
+		return 0;
+	}
+	return st.st_size;
+}
+
+int main(int argc, char const *argv[])
+{
+	if (argc != 3 && argc != 4) {
+		std::printf("usage: ./archive_blocks <first_block> <last_block> <delete_originals=0>\n");
+		std::printf("archives every complete segment of %lu blocks in the range\n", BLOCK_ARCHIVE_SEGMENT_BLOCKS);
+		return 1;
+	}
+
+	uint64_t first_block = std::stoull(argv[1]);
+	uint64_t last_block = std::stoull(argv[2]);
+	bool delete_originals = (argc == 4) && std::stoi(argv[3]);
+
+	BlockArchiveWriter writer;
+
+	for (auto segment = block_archive_segment(first_block); segment <= block_archive_segment(last_block); segment++) {
+
+		uint64_t segment_first = std::max<uint64_t>(1, segment * BLOCK_ARCHIVE_SEGMENT_BLOCKS);
+		uint64_t segment_end = (segment + 1) * BLOCK_ARCHIVE_SEGMENT_BLOCKS;
+
+		size_t raw_size = 0;
+		for (auto block = segment_first; block < segment_end; block++) {
+			raw_size += file_size(tx_block_name(block));
+		}
+
+		auto timestamp = init_time_measurement();
+
+		if (!writer.archive_segment(segment)) {
+			std::printf("segment %lu is incomplete, skipping\n", segment);
+			continue;
+		}
+
+		auto duration = measure_time(timestamp);
+		auto archive_size = file_size(block_archive_segment_name(segment));
+
+		std::printf("segment %lu: blocks [%lu, %lu) %lu bytes -> %lu bytes (ratio %lf) in %lf s\n",
+			segment, segment_first, segment_end, raw_size, archive_size, ((double) raw_size) / archive_size, duration);
+
+		//check the archive before removing anything
+		BlockArchiveReader reader(block_archive_segment_name(segment));
+		for (auto block = segment_first; block < segment_end; block++) {
+			AccountModificationBlock original, archived;
+			if (load_xdr_from_file(original, tx_block_name(block).c_str())) {
+				throw std::runtime_error("block file disappeared");
+			}
+			reader.load_block(block, archived);
+			if (xdr::xdr_to_opaque(original) != xdr::xdr_to_opaque(archived)) {
+				throw std::runtime_error("archive mismatch");
+			}
+		}
+
+		if (delete_originals) {
+			for (auto block = segment_first; block < segment_end; block++) {
+				unlink(tx_block_name(block).c_str());
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,207 @@
+#include "benchmark_harness.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace edce {
+
+extern "C" {
+	#include <libfyaml.h>
+
+	//returns false if the key is absent.
+	static bool _parse_case_p50(struct fy_document* fyd, const char* name, double* p50) {
+		std::string query = std::string("/cases/") + name + "/p50 %lf";
+		return fy_document_scanf(fyd, query.c_str(), p50) == 1;
+	}
+}
+
+double
+BenchmarkResult::percentile(double p) const {
+	if (samples.size() == 0) {
+		return 0;
+	}
+	auto sorted = samples;
+	std::sort(sorted.begin(), sorted.end());
+	size_t idx = std::min<size_t>(sorted.size() - 1, p * sorted.size());
+	return sorted[idx];
+}
+
+double
+BenchmarkResult::mean() const {
+	if (samples.size() == 0) {
+		return 0;
+	}
+	double sum = 0;
+	for (auto sample : samples) {
+		sum += sample;
+	}
+	return sum / samples.size();
+}
+
+void
+BenchmarkResult::print() const {
+	std::printf("%-28s n=%lu min=%lf mean=%lf p50=%lf p90=%lf p99=%lf max=%lf\n",
+		name.c_str(), samples.size(), min(), mean(), percentile(0.5), percentile(0.9), percentile(0.99), max());
+}
+
+static bool valid_case_name(const std::string& name) {
+	if (name.size() == 0) {
+		return false;
+	}
+	for (char c : name) {
+		if (!((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_')) {
+			return false;
+		}
+	}
+	return name != "all";
+}
+
+void
+BenchmarkRegistry::add(const std::string& name, const std::string& description, factory_t factory) {
+	if (!valid_case_name(name)) {
+		throw std::runtime_error("invalid benchmark name " + name);
+	}
+	for (auto& entry : entries) {
+		if (entry.name == name) {
+			throw std::runtime_error("duplicate benchmark name " + name);
+		}
+	}
+	entries.push_back(Entry{name, description, factory});
+}
+
+void
+BenchmarkRegistry::print_cases() const {
+	for (auto& entry : entries) {
+		std::printf("%-28s %s\n", entry.name.c_str(), entry.description.c_str());
+	}
+}
+
+std::vector<std::string>
+BenchmarkRegistry::select(const std::string& filter) const {
+	std::vector<std::string> out;
+	for (auto& entry : entries) {
+		if (filter == "all" || entry.name.compare(0, filter.size(), filter) == 0) {
+			out.push_back(entry.name);
+		}
+	}
+	return out;
+}
+
+BenchmarkResult
+BenchmarkRegistry::run(const std::string& name, size_t warmup, size_t reps) const {
+	auto it = std::find_if(entries.begin(), entries.end(), [&name] (const Entry& entry) {return entry.name == name;});
+	if (it == entries.end()) {
+		throw std::runtime_error("unknown benchmark " + name);
+	}
+
+	auto benchmark = it->factory();
+	benchmark->setup();
+
+	BenchmarkTimer timer;
+	BenchmarkResult result;
+	result.name = name;
+
+	for (size_t i = 0; i < warmup + reps; i++) {
+		timer.reset();
+		auto timestamp = init_time_measurement();
+		benchmark->run(timer);
+		double duration = measure_time(timestamp);
+
+		if (timer.was_used()) {
+			duration = timer.get_elapsed();
+		}
+		if (i >= warmup) {
+			result.samples.push_back(duration);
+		}
+	}
+	return result;
+}
+
+void write_benchmark_json(const std::vector<BenchmarkResult>& results, std::FILE* out) {
+	//indented with spaces: yaml (which parses baselines) forbids tabs in indentation
+	std::fprintf(out, "{\n  \"cases\": {");
+	for (size_t i = 0; i < results.size(); i++) {
+		auto& result = results[i];
+		std::fprintf(out,
+			"%s\n    \"%s\": {\"reps\": %lu, \"min\": %.9g, \"mean\": %.9g, \"p50\": %.9g, \"p90\": %.9g, \"p99\": %.9g, \"max\": %.9g}",
+			(i == 0) ? "" : ",",
+			result.name.c_str(),
+			result.samples.size(),
+			result.min(),
+			result.mean(),
+			result.percentile(0.5),
+			result.percentile(0.9),
+			result.percentile(0.99),
+			result.max());
+	}
+	std::fprintf(out, "\n  }\n}\n");
+}
+
+bool write_benchmark_json(const std::vector<BenchmarkResult>& results, const std::string& filename) {
+	std::FILE* f = std::fopen(filename.c_str(), "w");
+	if (f == nullptr) {
+		return false;
+	}
+	write_benchmark_json(results, f);
+	std::fclose(f);
+	return true;
+}
+
+std::optional<double> load_baseline_p50(const std::string& baseline_filename, const std::string& name) {
+	struct fy_document* fyd = fy_document_build_from_file(NULL, baseline_filename.c_str());
+	if (fyd == NULL) {
+		throw std::runtime_error("failed to load benchmark baseline " + baseline_filename);
+	}
+
+	double p50;
+	bool found = _parse_case_p50(fyd, name.c_str(), &p50);
+	fy_document_destroy(fyd);
+
+	if (!found) {
+		return std::nullopt;
+	}
+	return p50;
+}
+
+size_t compare_benchmarks(
+	const std::vector<BenchmarkResult>& results,
+	const std::string& baseline_filename,
+	double threshold,
+	std::vector<BenchmarkComparison>& comparisons_out) {
+
+	struct fy_document* fyd = fy_document_build_from_file(NULL, baseline_filename.c_str());
+	if (fyd == NULL) {
+		throw std::runtime_error("failed to load benchmark baseline " + baseline_filename);
+	}
+
+	size_t num_regressions = 0;
+
+	for (auto& result : results) {
+		BenchmarkComparison comparison;
+		comparison.name = result.name;
+		comparison.current_p50 = result.percentile(0.5);
+
+		double p50;
+		if (_parse_case_p50(fyd, result.name.c_str(), &p50)) {
+			comparison.baseline_p50 = p50;
+		}
+
+		if (!comparison.baseline_p50) {
+			std::printf("%-28s p50=%lf (not in baseline)\n", result.name.c_str(), comparison.current_p50);
+		} else {
+			bool regression = comparison.is_regression(threshold);
+			std::printf("%-28s p50=%lf baseline=%lf ratio=%lf%s\n",
+				result.name.c_str(), comparison.current_p50, *comparison.baseline_p50, comparison.ratio(),
+				regression ? " REGRESSION" : "");
+			if (regression) {
+				num_regressions++;
+			}
+		}
+		comparisons_out.push_back(comparison);
+	}
+
+	fy_document_destroy(fyd);
+	return num_regressions;
+}
+
+} /* edce */
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "utils.h"
+
+namespace edce {
+
+/*
+Shared driver for the microbenchmarks (microbenchmarks.cc).
+
+Each case is registered under a name ([a-z0-9_], so that it doubles as a path in the json output)
+with a factory, so that only the selected cases build their inputs.
+A run does some untimed warmup repetitions, then times each repetition separately,
+and reports min/mean/p50/p90/p99/max.
+
+Results are written as json
+	{"cases": {"<name>": {"reps": n, "min": s, "mean": s, "p50": s, "p90": s, "p99": s, "max": s}, ...}}
+and an earlier such file can serve as a baseline: a case regresses if its p50 exceeds
+the baseline p50 by more than the given fraction.
+*/
+
+class BenchmarkTimer {
+	time_point timestamp;
+	double elapsed = 0;
+	bool running = false;
+	bool used = false;
+
+public:
+
+	void start() {
+		used = true;
+		running = true;
+		timestamp = init_time_measurement();
+	}
+
+	void stop() {
+		if (!running) {
+			throw std::runtime_error("BenchmarkTimer stopped without being started");
+		}
+		elapsed += measure_time(timestamp);
+		running = false;
+	}
+
+	void reset() {
+		elapsed = 0;
+		running = false;
+		used = false;
+	}
+
+	bool was_used() const {
+		return used;
+	}
+
+	double get_elapsed() const {
+		return elapsed;
+	}
+};
+
+class BenchmarkCase {
+public:
+	//Untimed; called once, before the warmup repetitions.
+	virtual void setup() {}
+
+	//One repetition.  Timed in full, unless it calls timer.start() and timer.stop()
+	//(possibly more than once) around the parts to be timed.
+	virtual void run(BenchmarkTimer& timer) = 0;
+
+	virtual ~BenchmarkCase() = default;
+};
+
+struct BenchmarkResult {
+	std::string name;
+	std::vector<double> samples; //seconds, one per repetition
+
+	double percentile(double p) const;
+	double mean() const;
+	double min() const {
+		return percentile(0);
+	}
+	double max() const {
+		return percentile(1.0);
+	}
+
+	void print() const;
+};
+
+class BenchmarkRegistry {
+
+	using factory_t = std::function<std::unique_ptr<BenchmarkCase>()>;
+
+	struct Entry {
+		std::string name;
+		std::string description;
+		factory_t factory;
+	};
+
+	std::vector<Entry> entries;
+
+public:
+
+	//Throws if the name is invalid or already registered.
+	void add(const std::string& name, const std::string& description, factory_t factory);
+
+	void print_cases() const;
+
+	//"all" selects every case; otherwise, the cases whose names start with the filter.
+	std::vector<std::string> select(const std::string& filter) const;
+
+	BenchmarkResult run(const std::string& name, size_t warmup, size_t reps) const;
+};
+
+void write_benchmark_json(const std::vector<BenchmarkResult>& results, std::FILE* out);
+
+//Returns false if the file can't be opened.
+bool write_benchmark_json(const std::vector<BenchmarkResult>& results, const std::string& filename);
+
+//std::nullopt if the case is absent from the baseline.
+std::optional<double> load_baseline_p50(const std::string& baseline_filename, const std::string& name);
+
+struct BenchmarkComparison {
+	std::string name;
+	std::optional<double> baseline_p50;
+	double current_p50;
+
+	//current p50 / baseline p50
+	double ratio() const {
+		return current_p50 / *baseline_p50;
+	}
+
+	bool is_regression(double threshold) const {
+		return baseline_p50 && current_p50 > (*baseline_p50) * (1.0 + threshold);
+	}
+};
+
+//Prints one line per case and returns the number of regressions.
+//Cases missing from the baseline are reported but never count as regressions.
+size_t compare_benchmarks(
+	const std::vector<BenchmarkResult>& results,
+	const std::string& baseline_filename,
+	double threshold,
+	std::vector<BenchmarkComparison>& comparisons_out);
+
+} /* edce */
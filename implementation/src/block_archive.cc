@@ -0,0 +1,459 @@
+#include "block_archive.h"
+
+#include "file_prealloc_worker.h"
+#include "simple_debug.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#if HAVE_LIBZSTD
+#include <zdict.h>
+#endif
+
+#include <tbb/parallel_for.h>
+
+#include <xdrpp/marshal.h>
+
+namespace edce {
+
+std::string block_archive_segment_name(uint64_t segment) {
+	return std::string(ROOT_DB_DIRECTORY) + std::string(TX_BLOCK_DB) + std::string("segment_") + std::to_string(segment) + std::string(".archive");
+}
+
+static void pread_all(int fd, unsigned char* buf, size_t len, size_t offset) {
+	size_t idx = 0;
+	while (idx < len) {
+		auto res = pread(fd, buf + idx, len - idx, offset + idx);
+		if (res < 0) {
+			std::printf("errno was %d %s from fd %d\n", errno, strerror(errno), fd);
+			throw std::runtime_error("block archive read error");
+		}
+		if (res == 0) {
+			throw std::runtime_error("block archive truncated");
+		}
+		idx += res;
+	}
+}
+
+void
+BlockArchiveWriter::train_dictionary(const std::vector<std::vector<unsigned char>>& frames, BlockArchiveSegmentIndex& index) const {
+#if HAVE_LIBZSTD
+	index.compression = ARCHIVE_ZSTD;
+	index.dictionary.clear();
+
+	if (dictionary_size == 0) {
+		return;
+	}
+
+	std::vector<unsigned char> samples;
+	std::vector<size_t> sample_sizes;
+
+	//spread the samples over the whole segment
+	size_t stride = std::max<size_t>(1, frames.size() / MAX_DICTIONARY_SAMPLES);
+	for (size_t i = 0; i < frames.size(); i += stride) {
+		size_t sample_size = std::min(frames[i].size(), MAX_DICTIONARY_SAMPLE_SIZE);
+		samples.insert(samples.end(), frames[i].begin(), frames[i].begin() + sample_size);
+		sample_sizes.push_back(sample_size);
+	}
+
+	index.dictionary.resize(dictionary_size);
+	auto res = ZDICT_trainFromBuffer(index.dictionary.data(), dictionary_size, samples.data(), sample_sizes.data(), sample_sizes.size());
+	if (ZDICT_isError(res)) {
+		//e.g. too few samples.  Compress without a dictionary.
+		BLOCK_INFO("not using an archive dictionary: %s", ZDICT_getErrorName(res));
+		index.dictionary.clear();
+		return;
+	}
+	index.dictionary.resize(res);
+#else
+	index.compression = ARCHIVE_UNCOMPRESSED;
+	index.dictionary.clear();
+#endif
+}
+
+void
+BlockArchiveWriter::write_segment(const std::string& filename, uint64_t first_block, const std::vector<AccountModificationBlock>& blocks) const {
+
+	BlockArchiveSegmentIndex index;
+	index.firstBlock = first_block;
+	index.numBlocks = blocks.size();
+
+	//(block, first entry) of each frame
+	std::vector<std::pair<size_t, size_t>> frame_starts;
+
+	for (size_t block_idx = 0; block_idx < blocks.size(); block_idx++) {
+		auto& block = blocks[block_idx];
+		for (size_t start = 0; start < block.size(); start += frame_entries) {
+			size_t num_entries = std::min(frame_entries, block.size() - start);
+
+			BlockArchiveFrame frame;
+			frame.blockNumber = first_block + block_idx;
+			frame.firstAccount = block[start].owner;
+			frame.lastAccount = block[start + num_entries - 1].owner;
+			frame.numEntries = num_entries;
+
+			index.frames.push_back(frame);
+			frame_starts.emplace_back(block_idx, start);
+		}
+	}
+
+	size_t num_frames = index.frames.size();
+
+	std::vector<std::vector<unsigned char>> frames(num_frames);
+
+	tbb::parallel_for(
+		tbb::blocked_range<size_t>(0, num_frames),
+		[&] (auto r) {
+			for (auto i = r.begin(); i < r.end(); i++) {
+				auto& block = blocks[frame_starts[i].first];
+				size_t start = frame_starts[i].second;
+				size_t end = start + index.frames[i].numEntries;
+
+				size_t frame_size = 0;
+				for (size_t j = start; j < end; j++) {
+					frame_size += xdr::xdr_argpack_size(block[j]);
+				}
+
+				frames[i].resize(frame_size);
+				xdr::xdr_put p(frames[i].data(), frames[i].data() + frame_size);
+				for (size_t j = start; j < end; j++) {
+					p(block[j]);
+				}
+				index.frames[i].uncompressedSize = frame_size;
+			}
+		});
+
+	train_dictionary(frames, index);
+
+	std::vector<std::vector<unsigned char>> compressed_frames;
+
+#if HAVE_LIBZSTD
+	if (index.compression == ARCHIVE_ZSTD) {
+		compressed_frames.resize(num_frames);
+
+		std::unique_ptr<ZSTD_CDict, decltype(&ZSTD_freeCDict)> cdict(
+			ZSTD_createCDict(index.dictionary.data(), index.dictionary.size(), compression_level),
+			&ZSTD_freeCDict);
+		if (!cdict) {
+			throw std::runtime_error("failed to create zstd dictionary");
+		}
+
+		tbb::parallel_for(
+			tbb::blocked_range<size_t>(0, num_frames),
+			[&] (auto r) {
+				std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> cctx(ZSTD_createCCtx(), &ZSTD_freeCCtx);
+				for (auto i = r.begin(); i < r.end(); i++) {
+					auto& compressed = compressed_frames[i];
+					compressed.resize(ZSTD_compressBound(frames[i].size()));
+					auto res = ZSTD_compress_usingCDict(
+						cctx.get(), compressed.data(), compressed.size(), frames[i].data(), frames[i].size(), cdict.get());
+					if (ZSTD_isError(res)) {
+						std::printf("zstd error: %s\n", ZSTD_getErrorName(res));
+						throw std::runtime_error("zstd compression failed");
+					}
+					compressed.resize(res);
+					std::vector<unsigned char>().swap(frames[i]);
+				}
+			});
+	} else
+#endif
+	{
+		compressed_frames = std::move(frames);
+	}
+
+	uint64_t offset = 0;
+	for (size_t i = 0; i < num_frames; i++) {
+		index.frames[i].offset = offset;
+		index.frames[i].compressedSize = compressed_frames[i].size();
+		offset += compressed_frames[i].size();
+	}
+
+	xdr::opaque_vec<> index_bytes = xdr::xdr_to_opaque(index);
+	auto header = xdr::xdr_to_opaque(index_bytes);
+
+	//write to a temporary file, so that a segment file is either complete or absent
+	auto tmp_filename = filename + ".tmp";
+
+	FILE* f = std::fopen(tmp_filename.c_str(), "w");
+	if (f == nullptr) {
+		std::printf("failed to open %s\n", tmp_filename.c_str());
+		throw std::runtime_error("failed to open archive segment");
+	}
+
+	std::fwrite(header.data(), sizeof(header.data()[0]), header.size(), f);
+	for (auto& frame : compressed_frames) {
+		std::fwrite(frame.data(), sizeof(frame.data()[0]), frame.size(), f);
+	}
+	std::fflush(f);
+	fsync(fileno(f));
+	bool write_failed = std::ferror(f);
+	std::fclose(f);
+
+	if (write_failed) {
+		throw std::runtime_error("failed to write archive segment");
+	}
+
+	if (std::rename(tmp_filename.c_str(), filename.c_str())) {
+		throw std::runtime_error("failed to rename archive segment");
+	}
+
+	BLOCK_INFO("archived blocks [%lu, %lu) in %lu frames, %lu bytes compressed",
+		first_block, first_block + blocks.size(), num_frames, header.size() + offset);
+}
+
+bool
+BlockArchiveWriter::archive_segment(uint64_t segment) const {
+	//There is no block 0.
+	uint64_t first_block = std::max<uint64_t>(1, segment * BLOCK_ARCHIVE_SEGMENT_BLOCKS);
+	uint64_t end_block = (segment + 1) * BLOCK_ARCHIVE_SEGMENT_BLOCKS;
+
+	std::vector<AccountModificationBlock> blocks(end_block - first_block);
+
+	std::atomic<bool> missing_block = false;
+
+	tbb::parallel_for(
+		tbb::blocked_range<size_t>(0, blocks.size()),
+		[&] (auto r) {
+			for (auto i = r.begin(); i < r.end(); i++) {
+				auto filename = tx_block_name(first_block + i);
+				if (load_xdr_from_file(blocks[i], filename.c_str())) {
+					missing_block = true;
+				}
+			}
+		});
+
+	if (missing_block) {
+		return false;
+	}
+
+	write_segment(block_archive_segment_name(segment), first_block, blocks);
+	return true;
+}
+
+BlockArchiveReader::BlockArchiveReader(const std::string& filename)
+	: fd(open(filename.c_str(), O_RDONLY))
+	, index()
+	, block_frame_starts() {
+
+	if (!fd) {
+		std::printf("failed to open %s\n", filename.c_str());
+		throw std::runtime_error("failed to open archive segment");
+	}
+
+	unsigned char len_buf[4];
+	pread_all(fd.get(), len_buf, 4, 0);
+
+	uint32_t index_len;
+	xdr::xdr_get len_get(len_buf, len_buf + 4);
+	len_get(index_len);
+
+	xdr::opaque_vec<> index_bytes;
+	index_bytes.resize(index_len);
+	pread_all(fd.get(), index_bytes.data(), index_len, 4);
+
+	xdr::xdr_from_opaque(index_bytes, index);
+
+	//opaque<> is padded to a multiple of 4
+	data_start = 4 + ((index_len + 3) & ~static_cast<size_t>(3));
+
+	block_frame_starts.resize(index.numBlocks + 1);
+	size_t frame_idx = 0;
+	for (size_t i = 0; i < index.numBlocks; i++) {
+		block_frame_starts[i] = frame_idx;
+		while (frame_idx < index.frames.size() && index.frames[frame_idx].blockNumber == index.firstBlock + i) {
+			frame_idx++;
+		}
+	}
+	block_frame_starts[index.numBlocks] = frame_idx;
+	if (frame_idx != index.frames.size()) {
+		throw std::runtime_error("archive segment frames out of order");
+	}
+
+	if (index.compression == ARCHIVE_ZSTD) {
+#if HAVE_LIBZSTD
+		ddict = ZSTD_createDDict(index.dictionary.data(), index.dictionary.size());
+		if (ddict == nullptr) {
+			throw std::runtime_error("failed to load zstd dictionary");
+		}
+#else
+		throw std::runtime_error("archive segment is zstd compressed, but built without libzstd");
+#endif
+	}
+}
+
+BlockArchiveReader::~BlockArchiveReader() {
+#if HAVE_LIBZSTD
+	if (ddict != nullptr) {
+		ZSTD_freeDDict(ddict);
+	}
+#endif
+}
+
+void
+BlockArchiveReader::read_frame(const BlockArchiveFrame& frame, unsigned char* out) const {
+	if (index.compression == ARCHIVE_UNCOMPRESSED) {
+		pread_all(fd.get(), out, frame.uncompressedSize, data_start + frame.offset);
+		return;
+	}
+
+#if HAVE_LIBZSTD
+	std::vector<unsigned char> compressed(frame.compressedSize);
+	pread_all(fd.get(), compressed.data(), frame.compressedSize, data_start + frame.offset);
+
+	std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> dctx(ZSTD_createDCtx(), &ZSTD_freeDCtx);
+
+	auto res = ZSTD_decompress_usingDDict(dctx.get(), out, frame.uncompressedSize, compressed.data(), compressed.size(), ddict);
+	if (ZSTD_isError(res)) {
+		std::printf("zstd error: %s\n", ZSTD_getErrorName(res));
+		throw std::runtime_error("zstd decompression failed");
+	}
+	if (res != frame.uncompressedSize) {
+		throw std::runtime_error("archive frame has wrong size");
+	}
+#endif
+}
+
+void
+BlockArchiveReader::load_block(uint64_t block_number, AccountModificationBlock& out) const {
+	if (!contains(block_number)) {
+		throw std::runtime_error("block not in archive segment");
+	}
+
+	size_t frames_start = block_frame_starts[block_number - index.firstBlock];
+	size_t frames_end = block_frame_starts[block_number - index.firstBlock + 1];
+
+	size_t num_entries = 0;
+	std::vector<size_t> frame_offsets;
+	//after the list length
+	size_t total_size = 4;
+	for (size_t i = frames_start; i < frames_end; i++) {
+		frame_offsets.push_back(total_size);
+		total_size += index.frames[i].uncompressedSize;
+		num_entries += index.frames[i].numEntries;
+	}
+
+	std::vector<unsigned char> serialized(total_size);
+	xdr::xdr_put p(serialized.data(), serialized.data() + 4);
+	p(xdr::size32(num_entries));
+
+	tbb::parallel_for(
+		tbb::blocked_range<size_t>(frames_start, frames_end),
+		[&] (auto r) {
+			for (auto i = r.begin(); i < r.end(); i++) {
+				read_frame(index.frames[i], serialized.data() + frame_offsets[i - frames_start]);
+			}
+		});
+
+	xdr::xdr_from_opaque(serialized, out);
+}
+
+std::optional<AccountModificationTxList>
+BlockArchiveReader::find_account(uint64_t block_number, AccountID account) const {
+	if (!contains(block_number)) {
+		throw std::runtime_error("block not in archive segment");
+	}
+
+	size_t frames_start = block_frame_starts[block_number - index.firstBlock];
+	size_t frames_end = block_frame_starts[block_number - index.firstBlock + 1];
+
+	for (size_t i = frames_start; i < frames_end; i++) {
+		auto& frame = index.frames[i];
+		if (account < frame.firstAccount || account > frame.lastAccount) {
+			continue;
+		}
+
+		std::vector<unsigned char> serialized(frame.uncompressedSize);
+		read_frame(frame, serialized.data());
+
+		xdr::xdr_get g(serialized.data(), serialized.data() + serialized.size());
+		for (size_t j = 0; j < frame.numEntries; j++) {
+			AccountModificationTxList entry;
+			g(entry);
+			if (entry.owner == account) {
+				return entry;
+			}
+		}
+		return std::nullopt;
+	}
+	return std::nullopt;
+}
+
+int
+load_account_modification_block(
+	uint64_t block_number, AccountModificationBlock& out, std::unique_ptr<BlockArchiveReader>& archive) {
+
+	auto filename = tx_block_name(block_number);
+	if (load_xdr_from_file(out, filename.c_str()) == 0) {
+		return 0;
+	}
+
+	if (!archive || !archive->contains(block_number)) {
+		archive = nullptr;
+		auto archive_name = block_archive_segment_name(block_archive_segment(block_number));
+		if (access(archive_name.c_str(), R_OK) != 0) {
+			return -1;
+		}
+		archive = std::make_unique<BlockArchiveReader>(archive_name);
+	}
+
+	archive->load_block(block_number, out);
+	return 0;
+}
+
+void
+ReplayBlockLoader::run() {
+	while (true) {
+		std::unique_lock lock(mtx);
+		if ((!done_flag) && (!exists_work_to_do())) {
+			cv.wait(lock, [this] () {return done_flag || exists_work_to_do();});
+		}
+		if (done_flag) return;
+		load(*next_load_block);
+		next_load_block = std::nullopt;
+		cv.notify_all();
+	}
+}
+
+void
+ReplayBlockLoader::load(uint64_t block_number) {
+	loaded_block_number = block_number;
+	load_error = std::nullopt;
+	loaded_block.clear();
+
+	try {
+		if (load_account_modification_block(block_number, loaded_block, archive)) {
+			load_error = std::string("can't load tx block ") + tx_block_name(block_number);
+		}
+	} catch (std::exception& e) {
+		load_error = e.what();
+	}
+}
+
+void
+ReplayBlockLoader::get(uint64_t block_number, AccountModificationBlock& out) {
+	wait_for_async_task();
+	std::lock_guard lock(mtx);
+
+	if (loaded_block_number == block_number) {
+		loaded_block_number = std::nullopt;
+		if (load_error) {
+			throw std::runtime_error(*load_error);
+		}
+		out = std::move(loaded_block);
+		loaded_block.clear();
+		return;
+	}
+
+	//wasn't prefetched
+	if (load_account_modification_block(block_number, out, archive)) {
+		throw std::runtime_error(std::string("can't load tx block ") + tx_block_name(block_number));
+	}
+}
+
+} /* edce */
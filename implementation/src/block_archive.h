@@ -0,0 +1,182 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "../config.h"
+
+#if HAVE_LIBZSTD
+#include <zstd.h>
+#endif
+
+#include "async_worker.h"
+#include "cleanup.h"
+
+#include "xdr/database_commitments.h"
+#include "xdr/types.h"
+
+namespace edce {
+
+/*
+Archive of account modification blocks (the files named by tx_block_name()).
+
+Blocks are grouped into segments of BLOCK_ARCHIVE_SEGMENT_BLOCKS consecutive blocks,
+one file per segment.  Each block is cut into frames of consecutive accounts
+(blocks are sorted by account), and each frame is compressed independently,
+with a zstd dictionary trained on the segment's own frames.
+
+A segment file is the xdr encoding of its BlockArchiveSegmentIndex, as an opaque<>,
+followed by the compressed frames.  The index records every frame's first and last account,
+so a lookup of one account in one block decompresses only one frame.
+*/
+
+constexpr static uint64_t BLOCK_ARCHIVE_SEGMENT_BLOCKS = 64;
+
+static inline
+uint64_t block_archive_segment(uint64_t block_number) {
+	return block_number / BLOCK_ARCHIVE_SEGMENT_BLOCKS;
+}
+
+std::string block_archive_segment_name(uint64_t segment);
+
+class BlockArchiveWriter {
+
+public:
+	constexpr static size_t DEFAULT_FRAME_ENTRIES = 1024;
+	constexpr static size_t DEFAULT_DICTIONARY_SIZE = 112640;
+	constexpr static int DEFAULT_COMPRESSION_LEVEL = 3;
+
+private:
+
+	//dictionary training only looks at a prefix of (at most) this many frames
+	constexpr static size_t MAX_DICTIONARY_SAMPLES = 1024;
+	constexpr static size_t MAX_DICTIONARY_SAMPLE_SIZE = 16384;
+
+	const size_t frame_entries;
+	const size_t dictionary_size;
+	const int compression_level;
+
+	void train_dictionary(const std::vector<std::vector<unsigned char>>& frames, BlockArchiveSegmentIndex& index) const;
+
+public:
+
+	BlockArchiveWriter(
+		size_t frame_entries = DEFAULT_FRAME_ENTRIES,
+		size_t dictionary_size = DEFAULT_DICTIONARY_SIZE,
+		int compression_level = DEFAULT_COMPRESSION_LEVEL)
+		: frame_entries(frame_entries)
+		, dictionary_size(dictionary_size)
+		, compression_level(compression_level) {}
+
+	//blocks[i] is block first_block + i.  Frames are built and compressed in parallel.
+	void write_segment(const std::string& filename, uint64_t first_block, const std::vector<AccountModificationBlock>& blocks) const;
+
+	//Archives the per-block files of every block in the segment.  Returns false if any is missing.
+	bool archive_segment(uint64_t segment) const;
+};
+
+class BlockArchiveReader {
+
+	unique_fd fd;
+	BlockArchiveSegmentIndex index;
+	size_t data_start = 0;
+
+	//frames of block (first_block + i) are [block_frame_starts[i], block_frame_starts[i+1])
+	std::vector<size_t> block_frame_starts;
+
+#if HAVE_LIBZSTD
+	ZSTD_DDict* ddict = nullptr;
+#endif
+
+	//threadsafe
+	void read_frame(const BlockArchiveFrame& frame, unsigned char* out) const;
+
+public:
+
+	BlockArchiveReader(const std::string& filename);
+
+	BlockArchiveReader(const BlockArchiveReader&) = delete;
+	BlockArchiveReader& operator=(const BlockArchiveReader&) = delete;
+
+	~BlockArchiveReader();
+
+	uint64_t get_first_block() const {
+		return index.firstBlock;
+	}
+
+	uint64_t get_num_blocks() const {
+		return index.numBlocks;
+	}
+
+	bool contains(uint64_t block_number) const {
+		return block_number >= index.firstBlock && block_number - index.firstBlock < index.numBlocks;
+	}
+
+	//Decompresses the block's frames in parallel.
+	void load_block(uint64_t block_number, AccountModificationBlock& out) const;
+
+	std::optional<AccountModificationTxList> find_account(uint64_t block_number, AccountID account) const;
+};
+
+//Loads from the block's own file if it exists, and otherwise from its archive segment.
+//archive caches the last segment opened.  Returns nonzero if neither exists.
+int load_account_modification_block(
+	uint64_t block_number, AccountModificationBlock& out, std::unique_ptr<BlockArchiveReader>& archive);
+
+/*
+Loads the next block to be replayed in the background
+(decompressing its frames in parallel, if archived)
+while the current one is replayed.
+*/
+class ReplayBlockLoader : public AsyncWorker {
+	using AsyncWorker::mtx;
+	using AsyncWorker::cv;
+
+	std::optional<uint64_t> next_load_block;
+
+	std::optional<uint64_t> loaded_block_number;
+	AccountModificationBlock loaded_block;
+	std::optional<std::string> load_error;
+
+	std::unique_ptr<BlockArchiveReader> archive;
+
+	bool exists_work_to_do() override final {
+		return (bool)next_load_block;
+	}
+
+	void load(uint64_t block_number);
+
+public:
+
+	ReplayBlockLoader()
+		: AsyncWorker()
+		, next_load_block(std::nullopt)
+		, loaded_block_number(std::nullopt)
+		, loaded_block()
+		, load_error(std::nullopt)
+		, archive() {
+			start_async_thread([this] {run();});
+		}
+
+	~ReplayBlockLoader() {
+		wait_for_async_task();
+		end_async_thread();
+	}
+
+	void run();
+
+	void prefetch(uint64_t block_number) {
+		wait_for_async_task();
+		std::lock_guard lock(mtx);
+		next_load_block = block_number;
+		cv.notify_all();
+	}
+
+	//Throws if the block can't be loaded.
+	void get(uint64_t block_number, AccountModificationBlock& out);
+};
+
+} /* edce */
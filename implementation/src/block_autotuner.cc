@@ -0,0 +1,138 @@
+#include "block_autotuner.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace edce {
+
+BlockAutotuner::BlockAutotuner(const EdceOptions& options, size_t max_block_size, uint32_t max_demand_workers)
+	: target_latency(options.autotune_target_latency)
+	, window_blocks(options.autotune_window_blocks)
+	, max_block_size(max_block_size)
+	, max_demand_workers(max_demand_workers)
+	, min_persist_batch(options.persist_batch)
+	, chunks_per_block(std::max<size_t>(1, options.target_block_size / std::max<size_t>(1, options.mempool_chunk_size)))
+	, params{
+		std::clamp(options.target_block_size, MIN_BLOCK_SIZE, max_block_size),
+		options.mempool_chunk_size,
+		std::clamp<uint32_t>(options.num_demand_workers, 1, max_demand_workers),
+		options.persist_batch}
+	, window() {
+		if (window_blocks == 0 || target_latency <= 0) {
+			throw std::runtime_error("invalid autotuning window or target latency");
+		}
+		window.reserve(window_blocks);
+	}
+
+bool
+BlockAutotuner::record_block(const BlockPhaseTimings& timings) {
+	window.push_back(timings);
+	if (window.size() < window_blocks) {
+		return false;
+	}
+
+	std::vector<double> latencies;
+	double total_time = 0, total_tatonnement_time = 0, total_persist_wait_time = 0;
+	double total_txs = 0;
+	for (auto& block : window) {
+		latencies.push_back(block.total_time);
+		total_time += block.total_time;
+		total_tatonnement_time += block.tatonnement_time;
+		total_persist_wait_time += block.persist_wait_time;
+		total_txs += block.num_txs;
+	}
+	window.clear();
+
+	auto p90 = latencies.begin() + (latencies.size() - 1) * 9 / 10;
+	std::nth_element(latencies.begin(), p90, latencies.end());
+
+	auto prev_params = params;
+
+	double mean_tatonnement_time = total_tatonnement_time / window_blocks;
+
+	//one knob per window
+	if (worker_step_pending) {
+		judge_demand_worker_step(mean_tatonnement_time);
+	} else {
+		bool workers_held = (worker_hold_windows > 0);
+		if (workers_held) {
+			worker_hold_windows--;
+		}
+
+		if (!tune_block_size(*p90, total_txs / window_blocks)
+			&& !tune_persist_batch(total_time > 0 ? total_persist_wait_time / total_time : 0)
+			&& !workers_held) {
+			tune_demand_workers(mean_tatonnement_time);
+		}
+	}
+
+	return prev_params.target_block_size != params.target_block_size
+		|| prev_params.mempool_chunk_size != params.mempool_chunk_size
+		|| prev_params.num_demand_workers != params.num_demand_workers
+		|| prev_params.persist_batch != params.persist_batch;
+}
+
+bool
+BlockAutotuner::tune_block_size(double latency, double mean_num_txs) {
+	size_t block_size = params.target_block_size;
+	auto prev_params = params;
+
+	if (latency > target_latency) {
+		//latency is roughly linear in block size, but don't overreact to one slow window
+		block_size = static_cast<size_t>(block_size * std::max(0.5, target_latency / latency));
+	} else if (latency < GROWTH_HEADROOM * target_latency && mean_num_txs >= FULL_BLOCK_FRACTION * block_size) {
+		block_size += std::max<size_t>(1, static_cast<size_t>(block_size * GROWTH_STEP));
+	}
+
+	params.target_block_size = std::clamp(block_size, MIN_BLOCK_SIZE, max_block_size);
+	params.mempool_chunk_size = std::max(MIN_CHUNK_SIZE, params.target_block_size / chunks_per_block);
+
+	return prev_params.target_block_size != params.target_block_size
+		|| prev_params.mempool_chunk_size != params.mempool_chunk_size;
+}
+
+void
+BlockAutotuner::judge_demand_worker_step(double mean_tatonnement_time) {
+	worker_step_pending = false;
+	if (mean_tatonnement_time <= tatonnement_time_before_step * (1 - IMPROVEMENT_THRESHOLD)) {
+		failed_worker_steps = 0;
+	} else {
+		params.num_demand_workers -= worker_step_direction;
+		worker_step_direction = -worker_step_direction;
+		failed_worker_steps++;
+		if (failed_worker_steps >= 2) {
+			failed_worker_steps = 0;
+			worker_hold_windows = WORKER_HOLD_WINDOWS;
+		}
+	}
+}
+
+void
+BlockAutotuner::tune_demand_workers(double mean_tatonnement_time) {
+	//nothing to measure if no prices were computed
+	if (mean_tatonnement_time <= 0 || max_demand_workers <= 1) {
+		return;
+	}
+
+	if ((worker_step_direction > 0 && params.num_demand_workers >= max_demand_workers)
+		|| (worker_step_direction < 0 && params.num_demand_workers <= 1)) {
+		worker_step_direction = -worker_step_direction;
+	}
+
+	params.num_demand_workers += worker_step_direction;
+	tatonnement_time_before_step = mean_tatonnement_time;
+	worker_step_pending = true;
+}
+
+bool
+BlockAutotuner::tune_persist_batch(double persist_wait_fraction) {
+	auto prev_persist_batch = params.persist_batch;
+	if (persist_wait_fraction > PERSIST_WAIT_FRACTION) {
+		params.persist_batch = std::max(min_persist_batch, std::min(MAX_PERSIST_BATCH, params.persist_batch * 2));
+	} else if (persist_wait_fraction < PERSIST_WAIT_FRACTION / 4 && params.persist_batch > min_persist_batch) {
+		params.persist_batch--;
+	}
+	return prev_persist_batch != params.persist_batch;
+}
+
+} /* edce */
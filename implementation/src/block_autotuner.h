@@ -0,0 +1,110 @@
+#pragma once
+
+#include "edce_options.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace edce {
+
+/*
+Retunes the block producer's sizing parameters from the timings of recent blocks
+(optional /edce-node/autotune).
+
+After every window of options.autotune_window_blocks blocks, the autotuner adjusts
+ - target_block_size: cut multiplicatively if the window's 90th percentile block latency is over the target,
+   grown additively while latency is well under the target and blocks come out full
+   (when the mempool can't fill a block, a bigger target adds nothing).
+ - mempool_chunk_size: follows the block size, so a full block spans as many chunks
+   (and block building gets as much parallelism) as with the configured sizes.
+ - num_demand_workers: hill climbing on the window's mean Tatonnement time, one worker at a time.
+   A step that does not cut Tatonnement time by IMPROVEMENT_THRESHOLD is undone and the direction reversed;
+   after a failed step in both directions, the worker count is left alone for WORKER_HOLD_WINDOWS windows.
+ - persist_batch: doubled while production spends more than PERSIST_WAIT_FRACTION of its time waiting
+   on the previous async persist, and walked back towards the configured value once it doesn't.
+
+At most one knob changes per window, so each window measures the effect of a single change
+(in particular, a demand worker step is never judged on a window in which the block size also moved).
+A window that follows a demand worker step only judges that step.  Otherwise the block size
+(with the chunk size) goes first, then persist_batch, and the worker count moves only when neither did.
+*/
+
+struct BlockAutotunerParameters {
+	size_t target_block_size;
+	size_t mempool_chunk_size;
+	uint32_t num_demand_workers;
+	size_t persist_batch;
+};
+
+//timings of one produced block, in seconds
+struct BlockPhaseTimings {
+	double total_time = 0;
+	double tatonnement_time = 0;
+	double persist_wait_time = 0;
+	size_t num_txs = 0;
+};
+
+class BlockAutotuner {
+
+public:
+	//EdceNode::produce_block() takes a block of at most this many txs to mean the mempool has run dry
+	//(which ends a producer experiment), so the target never goes this low.
+	constexpr static size_t EXHAUSTED_MEMPOOL_BLOCK_SIZE = 1'000;
+	constexpr static size_t MIN_BLOCK_SIZE = 2 * EXHAUSTED_MEMPOOL_BLOCK_SIZE;
+	constexpr static size_t MIN_CHUNK_SIZE = 100;
+	constexpr static size_t MAX_PERSIST_BATCH = 64;
+
+	//block size only grows while the window's latency is under this fraction of the target
+	constexpr static double GROWTH_HEADROOM = 0.8;
+	//additive increase, as a fraction of the current block size
+	constexpr static double GROWTH_STEP = 0.1;
+	//blocks with at least this fraction of the target size count as full
+	constexpr static double FULL_BLOCK_FRACTION = 0.9;
+
+	constexpr static double IMPROVEMENT_THRESHOLD = 0.05;
+	constexpr static unsigned int WORKER_HOLD_WINDOWS = 10;
+
+	constexpr static double PERSIST_WAIT_FRACTION = 0.02;
+
+private:
+	const double target_latency;
+	const size_t window_blocks;
+	const size_t max_block_size;
+	const uint32_t max_demand_workers;
+	const size_t min_persist_batch;
+	//with the configured sizes, a full block spans this many mempool chunks
+	const size_t chunks_per_block;
+
+	BlockAutotunerParameters params;
+
+	std::vector<BlockPhaseTimings> window;
+
+	int worker_step_direction = 1;
+	bool worker_step_pending = false;
+	double tatonnement_time_before_step = 0;
+	unsigned int failed_worker_steps = 0;
+	unsigned int worker_hold_windows = 0;
+
+	//each returns true if it changed a parameter
+	bool tune_block_size(double latency, double mean_num_txs);
+	bool tune_persist_batch(double persist_wait_fraction);
+	void tune_demand_workers(double mean_tatonnement_time);
+
+	//keeps or undoes the last demand worker step
+	void judge_demand_worker_step(double mean_tatonnement_time);
+
+public:
+
+	//max_demand_workers is the demand oracle's capacity (TatonnementControlParameters::MAX_DEMAND_WORKERS)
+	BlockAutotuner(const EdceOptions& options, size_t max_block_size, uint32_t max_demand_workers);
+
+	//returns true if the parameters changed
+	bool record_block(const BlockPhaseTimings& timings);
+
+	const BlockAutotunerParameters& get_parameters() const {
+		return params;
+	}
+};
+
+} /* edce */
@@ -7,19 +7,19 @@ void BlockBuilderManager::log_tx_buffer_reservation() {
 
 	std::printf("reserving a block of transactions\n");
 
-	while ((reserved_tx_count + TransactionBufferManager::BUF_SIZE > MAX_TRANSACTIONS_PER_BLOCK) || !enabled_flag) {
+	while ((reserved_tx_count + buf_size > MAX_TRANSACTIONS_PER_BLOCK) || !enabled_flag) {
 		reservation_wait_cv.wait(lock);
 	}
 
-	reserved_tx_count += TransactionBufferManager::BUF_SIZE;
+	reserved_tx_count += buf_size;
 }
 void BlockBuilderManager::commit_tx_addition(int num_txs) {
 	std::lock_guard lock(reservation_wait_mtx);
 
-	auto freed_amount = TransactionBufferManager::BUF_SIZE - num_txs;
+	auto freed_amount = buf_size - num_txs;
 	reserved_tx_count -= freed_amount;
 
-	if ((reserved_tx_count + TransactionBufferManager::BUF_SIZE <= MAX_TRANSACTIONS_PER_BLOCK) && enabled_flag) {
+	if ((reserved_tx_count + buf_size <= MAX_TRANSACTIONS_PER_BLOCK) && enabled_flag) {
 		reservation_wait_cv.notify_all();
 	}
 }
@@ -14,15 +14,17 @@ class BlockBuilderManager {
 
 	bool enabled_flag;
 
-	constexpr static int BUF_SIZE = TransactionBufferManager::BUF_SIZE;
+	//size of the buffers that reservations are made for
+	const size_t buf_size;
 
 public:
 
-	BlockBuilderManager() 
+	BlockBuilderManager(size_t buf_size = TransactionBufferManager::DEFAULT_BUF_SIZE) 
 		: reserved_tx_count(0),
 		reservation_wait_mtx(),
 		reservation_wait_cv(),
-		enabled_flag(true) {}
+		enabled_flag(true),
+		buf_size(buf_size) {}
 
 
 	void log_tx_buffer_reservation();
@@ -1,9 +1,13 @@
 #include "block_producer.h"
 #include "serial_transaction_processor.h"
 
+#include <algorithm>
 #include <atomic>
 #include <cstdint>
 #include <mutex>
+#include <optional>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_invoke.h>
 #include <tbb/parallel_reduce.h>
 #include <tbb/global_control.h>
 #include <tbb/task_arena.h>
@@ -36,12 +40,38 @@ bool delete_tx_from_mempool(TransactionProcessingStatus status) {
 		case RECIPIENT_ACCOUNT_NEXIST:
 		case INVALID_PRINT_MONEY_AMOUNT:
 		case INVALID_AMOUNT:
+		case INVALID_SIGNATURE:
 			return true;
 		default:
 			throw std::runtime_error("forgot to add an error code to delete_tx_from_mempool");
 	}
 }
 
+//Results of the per-chunk pass that must wait for the hot account lanes
+//(and for txs that speculation deprioritized) before being handed to the mempool.
+struct DeferredChunkResults {
+	//empty if the chunk was not reached
+	std::vector<std::vector<bool>> bitmaps;
+	//per lane, aligned with the lane's txs
+	std::vector<std::vector<bool>> lane_removals;
+	//per chunk, indices of SPECULATION_DEFER txs, which keep their reserved space until the last pass
+	std::vector<std::vector<uint32_t>> speculative_deferrals;
+
+	DeferredChunkResults(size_t num_chunks, size_t num_lanes)
+		: bitmaps(num_chunks)
+		, lane_removals(num_lanes)
+		, speculative_deferrals(num_chunks) {}
+};
+
+enum class ProductionPass {
+	//over mempool chunks
+	CHUNKS,
+	//over scheduler lanes
+	LANES,
+	//over mempool chunks, only the txs speculation deprioritized
+	SPECULATIVE_DEFERRALS
+};
+
 class BlockProductionReduce {
 	EdceManagementStructures& management_structures;
 	SerialTransactionProcessor<> tx_processor;
@@ -49,71 +79,121 @@ class BlockProductionReduce {
 	//std::mutex mtx;
 	std::atomic<int64_t>& remaining_block_space;
 	std::atomic<uint64_t>& total_block_size;
+	const SpeculativeTxProcessor* speculation;
 
+	//if set, txs the scheduler assigned to a lane are skipped in the per-chunk pass
+	const ConflictAwareScheduler* scheduler;
+	//if set, SPECULATION_DEFER txs are skipped in the per-chunk pass
+	DeferredChunkResults* deferred;
+	const ProductionPass pass;
 
-public:
-	std::unordered_map<TransactionProcessingStatus, uint64_t> status_counts;
-	BlockStateUpdateStatsWrapper stats;
+	//Runs alongside the per-chunk pass, so lanes reserve their own block space.
+	void process_lanes(const tbb::blocked_range<std::size_t> r) {
+		SerialAccountModificationLog serial_account_log(management_structures.account_modification_log);
 
-	std::vector<SerialTransactionProcessor<>> accumulated_processors;
-	
-	void operator() (const tbb::blocked_range<std::size_t> r) {
-		//std::lock_guard lock(mtx);
+		for (size_t lane = r.begin(); lane < r.end(); lane++) {
+			auto& refs = scheduler->get_lane(lane);
+			auto& removals = deferred->lane_removals[lane];
+			removals.assign(refs.size(), false);
 
-	//	std::atomic_thread_fence(std::memory_order_acquire);
-		SerialAccountModificationLog serial_account_log(management_structures.account_modification_log);
+			int64_t lane_sz = refs.size();
 
-		for (size_t i = r.begin(); i < r.end(); i++) {
-			auto& chunk = mempool[i];
-			std::vector<bool> bitmap;
+			int64_t remaining_space = remaining_block_space.fetch_sub(lane_sz, std::memory_order_relaxed);
+			if (remaining_space < lane_sz) {
+				remaining_block_space.fetch_add(lane_sz - std::max<int64_t>(remaining_space, 0), std::memory_order_relaxed);
+				//txs past the reservation stay in the mempool
+				lane_sz = remaining_space;
+				if (lane_sz <= 0) {
+					continue;
+				}
+			}
 
-			int64_t chunk_sz = chunk.size();
+			int64_t elts_added_to_block = 0;
 
-			bitmap.resize(chunk_sz, false);
+			for (int64_t k = 0; k < lane_sz; k++) {
+				auto& ref = refs[k];
+				auto& chunk = mempool[ref.chunk_idx];
 
+				const std::vector<uint8_t>* speculative_decisions = (speculation != nullptr)
+					? speculation->get_decisions(ref.chunk_idx, chunk.size())
+					: nullptr;
 
-			//reserve space for txs in output block
-			int64_t remaining_space = remaining_block_space.fetch_sub(chunk_sz, std::memory_order_relaxed);
-			if (remaining_space < chunk_sz) {
-				remaining_block_space.fetch_add(chunk_sz - remaining_space, std::memory_order_relaxed);
-				//reduce the number of txs that we look at, according to reservation
-				//We'll guarantee that we don't exceed a block limit, but we might ignore a few valid txs.
-				chunk_sz = remaining_space;
-				//chunk_sz += remaining_space;
-				//remaining_block_space.fetch_add(-remaining_space, std::memory_order_relaxed);
-				if (chunk_sz <= 0) {
-					return;
+				if (speculative_decisions != nullptr && (*speculative_decisions)[ref.tx_idx] == SPECULATION_DROP) {
+					removals[k] = true;
+					num_speculative_drops++;
+					continue;
+				}
+				auto status = tx_processor.process_transaction(chunk[ref.tx_idx], stats, serial_account_log);
+				status_counts[status] ++;
+				stats.hot_account_tx_count++;
+				if (status == TransactionProcessingStatus::SUCCESS) {
+					removals[k] = true;
+					elts_added_to_block++;
+				} else if (delete_tx_from_mempool(status)) {
+					removals[k] = true;
 				}
 			}
+			remaining_block_space.fetch_add(lane_sz - elts_added_to_block, std::memory_order_relaxed);
+			total_block_size.fetch_add(elts_added_to_block, std::memory_order_release);
+		}
+	}
+
+	void process_speculative_deferrals(const tbb::blocked_range<std::size_t> r) {
+		SerialAccountModificationLog serial_account_log(management_structures.account_modification_log);
 
+		for (size_t i = r.begin(); i < r.end(); i++) {
+			auto& chunk = mempool[i];
+			auto& bitmap = deferred->bitmaps[i];
 
+			int64_t released_space = 0;
 			int64_t elts_added_to_block = 0;
 
-			for (int64_t j = 0; j < chunk_sz; j++) {
-				auto status = tx_processor.process_transaction(chunk[j], stats, serial_account_log);
+			for (auto tx_idx : deferred->speculative_deferrals[i]) {
+				auto status = tx_processor.process_transaction(chunk[tx_idx], stats, serial_account_log);
 				status_counts[status] ++;
 				if (status == TransactionProcessingStatus::SUCCESS) {
-					bitmap[j] = true;
+					bitmap[tx_idx] = true;
 					elts_added_to_block++;
-				} else if(delete_tx_from_mempool(status)) {
-					bitmap[j] = true;
+				} else {
+					released_space++;
+					if (delete_tx_from_mempool(status)) {
+						bitmap[tx_idx] = true;
+					}
 				}
 			}
-			chunk.set_confirmed_txs(std::move(bitmap));
-
-			//if (remaining_space < BLOCK_LARGE_ENOUGH_THRESHOLD) return;
-
-			auto post_check = remaining_block_space.fetch_add(chunk_sz - elts_added_to_block, std::memory_order_relaxed);
+			remaining_block_space.fetch_add(released_space, std::memory_order_relaxed);
 			total_block_size.fetch_add(elts_added_to_block, std::memory_order_release);
-			if (post_check <= 0) {
-				return;
-			}
 		}
+	}
+
+	void process_chunks(const tbb::blocked_range<std::size_t> r);
 
-	//	std::atomic_thread_fence(std::memory_order_release);
 
+public:
+	std::unordered_map<TransactionProcessingStatus, uint64_t> status_counts;
+	BlockStateUpdateStatsWrapper stats;
+
+	std::vector<SerialTransactionProcessor<>> accumulated_processors;
+
+	uint64_t num_speculative_drops = 0;
+	
+	void operator() (const tbb::blocked_range<std::size_t> r) {
+		auto contention_start = ContentionCounters::local();
+		switch(pass) {
+			case ProductionPass::CHUNKS:
+				process_chunks(r);
+				break;
+			case ProductionPass::LANES:
+				process_lanes(r);
+				break;
+			case ProductionPass::SPECULATIVE_DEFERRALS:
+				process_speculative_deferrals(r);
+				break;
+		}
+		stats.add_contention(ContentionCounters::local() - contention_start);
 	}
 
+
 	BlockProductionReduce(BlockProductionReduce& x, tbb::split)
 		: management_structures(x.management_structures)
 		, tx_processor(management_structures)
@@ -121,6 +201,10 @@ public:
 		//, mtx()
 		, remaining_block_space(x.remaining_block_space)
 		, total_block_size(x.total_block_size)
+		, speculation(x.speculation)
+		, scheduler(x.scheduler)
+		, deferred(x.deferred)
+		, pass(x.pass)
 		, accumulated_processors()
 			{};
 
@@ -140,6 +224,7 @@ public:
 		}
 
 		stats += other.stats;
+		num_speculative_drops += other.num_speculative_drops;
 
 		other.accumulated_processors.clear();	
 	}
@@ -154,25 +239,124 @@ public:
 		EdceManagementStructures& management_structures,
 		Mempool& mempool,
 		std::atomic<int64_t>& remaining_block_space,
-		std::atomic<uint64_t>& total_block_size)
+		std::atomic<uint64_t>& total_block_size,
+		const SpeculativeTxProcessor* speculation,
+		const ConflictAwareScheduler* scheduler = nullptr,
+		DeferredChunkResults* deferred = nullptr,
+		ProductionPass pass = ProductionPass::CHUNKS)
 		: management_structures(management_structures)
 		, tx_processor(management_structures)
 		, mempool(mempool)
 		//, mtx()
 		, remaining_block_space(remaining_block_space)
 		, total_block_size(total_block_size)
+		, speculation(speculation)
+		, scheduler(scheduler)
+		, deferred(deferred)
+		, pass(pass)
 		, accumulated_processors()
 		{}
 };
 
 
+void
+BlockProductionReduce::process_chunks(const tbb::blocked_range<std::size_t> r) {
+	//std::lock_guard lock(mtx);
+
+//	std::atomic_thread_fence(std::memory_order_acquire);
+	SerialAccountModificationLog serial_account_log(management_structures.account_modification_log);
+
+	for (size_t i = r.begin(); i < r.end(); i++) {
+		auto& chunk = mempool[i];
+		std::vector<bool> bitmap;
+
+		bitmap.resize(chunk.size(), false);
+
+		//txs the scheduler assigned to a lane get their block space in the lane pass
+		int64_t chunk_sz = chunk.size() - ((scheduler != nullptr) ? scheduler->get_num_lane_txs(i) : 0);
+
+
+		//reserve space for txs in output block
+		int64_t remaining_space = remaining_block_space.fetch_sub(chunk_sz, std::memory_order_relaxed);
+		if (remaining_space < chunk_sz) {
+			//if another reservation already took the space negative, only return our own reservation
+			remaining_block_space.fetch_add(chunk_sz - std::max<int64_t>(remaining_space, 0), std::memory_order_relaxed);
+			//reduce the number of txs that we look at, according to reservation
+			//We'll guarantee that we don't exceed a block limit, but we might ignore a few valid txs.
+			chunk_sz = remaining_space;
+			//chunk_sz += remaining_space;
+			//remaining_block_space.fetch_add(-remaining_space, std::memory_order_relaxed);
+			if (chunk_sz <= 0) {
+				return;
+			}
+		}
+
+
+		int64_t elts_added_to_block = 0;
+
+		const std::vector<uint8_t>* speculative_decisions = (speculation != nullptr)
+			? speculation->get_decisions(i, chunk.size())
+			: nullptr;
+
+		int64_t num_deferred = 0;
+		int64_t num_considered = 0;
+
+		for (size_t j = 0; j < chunk.size() && num_considered < chunk_sz; j++) {
+			if (scheduler != nullptr && scheduler->get_tx_lane(i, j) != ConflictAwareScheduler::NO_LANE) {
+				//processed by the lane owning its hot account
+				continue;
+			}
+			num_considered++;
+			if (speculative_decisions != nullptr && (*speculative_decisions)[j] == SPECULATION_DROP) {
+				//guaranteed to fail, per speculation during the previous block.
+				bitmap[j] = true;
+				num_speculative_drops++;
+				continue;
+			}
+			if (deferred != nullptr && speculative_decisions != nullptr && (*speculative_decisions)[j] == SPECULATION_DEFER) {
+				//likely to fail for lack of balance; processed last, after any credits from this block
+				deferred->speculative_deferrals[i].push_back(j);
+				num_deferred++;
+				continue;
+			}
+			auto status = tx_processor.process_transaction(chunk[j], stats, serial_account_log);
+			status_counts[status] ++;
+			if (status == TransactionProcessingStatus::SUCCESS) {
+				bitmap[j] = true;
+				elts_added_to_block++;
+			} else if(delete_tx_from_mempool(status)) {
+				bitmap[j] = true;
+			}
+		}
+		if (deferred != nullptr) {
+			deferred->bitmaps[i] = std::move(bitmap);
+		} else {
+			chunk.set_confirmed_txs(std::move(bitmap));
+		}
+
+		//if (remaining_space < BLOCK_LARGE_ENOUGH_THRESHOLD) return;
+
+		auto post_check = remaining_block_space.fetch_add(chunk_sz - elts_added_to_block - num_deferred, std::memory_order_relaxed);
+		total_block_size.fetch_add(elts_added_to_block, std::memory_order_release);
+		if (post_check <= 0) {
+			return;
+		}
+	}
+
+//	std::atomic_thread_fence(std::memory_order_release);
+
+}
+
+
 //returns block size
 uint64_t 
 BlockProducer::build_block(
 	Mempool& mempool,
 	int64_t max_block_size,
 	BlockCreationMeasurements& measurements,
-	BlockStateUpdateStatsWrapper& state_update_stats) {
+	BlockStateUpdateStatsWrapper& state_update_stats,
+	const SpeculativeTxProcessor* speculation,
+	uint32_t* num_speculative_drops_out) {
 
 	if (management_structures.account_modification_log.size() != 0) {
 		throw std::runtime_error("forgot to clear mod log");
@@ -184,26 +368,104 @@ BlockProducer::build_block(
 	std::atomic<uint64_t> total_block_size = 0;
 
 
-	auto producer = BlockProductionReduce(management_structures, mempool, remaining_space, total_block_size);
+	auto timestamp = init_time_measurement();
+
+	const ConflictAwareScheduler* active_scheduler = nullptr;
+	if (conflict_aware_scheduling) {
+		scheduler.schedule(mempool, max_block_size);
+		if (scheduler.has_hot_txs()) {
+			active_scheduler = &scheduler;
+		}
+		BLOCK_INFO("conflict scheduling took %lf, %lu hot txs", measure_time(timestamp), scheduler.get_num_hot_txs());
+	}
+
+	const bool defer_speculative_failures = (speculation != nullptr) && speculation->has_deferrals();
+
+	std::optional<DeferredChunkResults> deferred;
+	if (active_scheduler != nullptr || defer_speculative_failures) {
+		deferred.emplace(mempool.num_chunks(), active_scheduler != nullptr ? active_scheduler->get_num_lanes() : 0);
+	}
+
+	auto producer = BlockProductionReduce(
+		management_structures, mempool, remaining_space, total_block_size, speculation,
+		active_scheduler, deferred ? &(*deferred) : nullptr);
 
 	tbb::blocked_range<size_t> range(0, mempool.num_chunks());
 
 	BLOCK_INFO("starting produce block from mempool");
 
-	auto timestamp = init_time_measurement();
+	if (active_scheduler != nullptr) {
+		//one lane per task, so that each hot account is only ever touched by one thread.
+		//Lanes run alongside the chunks, and not after them on the critical path.
+		auto lane_producer = BlockProductionReduce(
+			management_structures, mempool, remaining_space, total_block_size, speculation,
+			active_scheduler, &(*deferred), ProductionPass::LANES);
+
+		tbb::parallel_invoke(
+			[&range, &producer] () {
+				tbb::parallel_reduce(range, producer);
+			},
+			[&lane_producer, active_scheduler] () {
+				tbb::parallel_reduce(tbb::blocked_range<size_t>(0, active_scheduler->get_num_lanes(), 1), lane_producer);
+			});
+		producer.join(lane_producer);
+
+		for (size_t lane = 0; lane < active_scheduler->get_num_lanes(); lane++) {
+			auto& refs = active_scheduler->get_lane(lane);
+			auto& removals = deferred->lane_removals[lane];
+			for (size_t k = 0; k < removals.size(); k++) {
+				if (removals[k]) {
+					auto& bitmap = deferred->bitmaps[refs[k].chunk_idx];
+					if (bitmap.empty()) {
+						//the per-chunk pass ran out of block space before this chunk
+						bitmap.resize(mempool[refs[k].chunk_idx].size(), false);
+					}
+					bitmap[refs[k].tx_idx] = true;
+				}
+			}
+		}
+	} else {
+		tbb::parallel_reduce(range, producer);
+	}
+
+	if (defer_speculative_failures) {
+		//every other tx has been processed, so any credits they make are in place
+		auto deferral_producer = BlockProductionReduce(
+			management_structures, mempool, remaining_space, total_block_size, speculation,
+			active_scheduler, &(*deferred), ProductionPass::SPECULATIVE_DEFERRALS);
 
-	tbb::parallel_reduce(range, producer);
+		tbb::parallel_reduce(range, deferral_producer);
+		producer.join(deferral_producer);
+	}
+
+	if (deferred) {
+		tbb::parallel_for(
+			tbb::blocked_range<size_t>(0, mempool.num_chunks()),
+			[&mempool, &deferred] (auto r) {
+				for (auto i = r.begin(); i < r.end(); i++) {
+					if (!deferred->bitmaps[i].empty()) {
+						mempool[i].set_confirmed_txs(std::move(deferred->bitmaps[i]));
+					}
+				}
+			});
+	}
 
 	BLOCK_INFO("done produce block from mempool: duration %lf", measure_time(timestamp));
 
 	producer.finish();
 
+	if (num_speculative_drops_out != nullptr) {
+		*num_speculative_drops_out = producer.num_speculative_drops;
+	}
+
 	MEMPOOL_INFO_F(
 		for (auto iter = producer.status_counts.begin(); iter != producer.status_counts.end(); iter++) {
 			std::printf("block_producer.cc:   mempool stats: code %d count %lu\n", iter->first, iter->second);
 		}
 		std::printf("block_producer.cc: new_offers %u cancel_offer %u payment %u new_account %u\n", producer.stats.new_offer_count, producer.stats.cancel_offer_count, producer.stats.payment_count, producer.stats.new_account_count); 
 	);
+	BLOCK_INFO("hot_account_txs %u cas_retries %u mutex_waits %u",
+		producer.stats.hot_account_tx_count, producer.stats.cas_retry_count, producer.stats.mutex_wait_count);
 
 //	std::vector<SerialAccountModificationLog> serial_account_logs;
 
@@ -5,7 +5,9 @@
 #include "xdr/block.h"
 #include "async_worker.h"
 #include "block_update_stats.h"
+#include "conflict_aware_scheduler.h"
 #include "log_merge_worker.h"
+#include "speculative_tx_processor.h"
 
 namespace edce {
 
@@ -13,20 +15,31 @@ class BlockProducer {
 
 	EdceManagementStructures& management_structures;
 	LogMergeWorker worker;
+	ConflictAwareScheduler scheduler;
+
+	//Route txs touching hot accounts to one owning thread per account (see conflict_aware_scheduler.h).
+	const bool conflict_aware_scheduling;
 
 public:
-	BlockProducer(EdceManagementStructures& management_structures)
+	BlockProducer(EdceManagementStructures& management_structures, bool conflict_aware_scheduling)
 		: management_structures(management_structures)
-		, worker(management_structures) {}
+		, worker(management_structures)
+		, scheduler()
+		, conflict_aware_scheduling(conflict_aware_scheduling) {}
 
 	//output block is implicitly held within account_modification_log
 	//returns (somewhat redundantly) total number of txs in block
+	//If given, txs that speculation (during the previous block) found guaranteed to fail
+	//are removed from the mempool without being processed,
+	//and txs it found likely to fail are processed after every other tx.
 	uint64_t
 	build_block(
 		Mempool& mempool,
 		int64_t max_block_size,
 		BlockCreationMeasurements& measurements,
-		BlockStateUpdateStatsWrapper& state_update_stats);
+		BlockStateUpdateStatsWrapper& state_update_stats,
+		const SpeculativeTxProcessor* speculation = nullptr,
+		uint32_t* num_speculative_drops_out = nullptr);
 
 };
 
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "contention_counters.h"
+
 #include "xdr/block.h"
 
 namespace edce {
@@ -13,9 +15,17 @@ struct BlockStateUpdateStatsWrapper : public BlockStateUpdateStats {
 		partial_clear_offer_count += other.partial_clear_offer_count;
 		payment_count += other.payment_count;
 		new_account_count += other.new_account_count;
+		hot_account_tx_count += other.hot_account_tx_count;
+		cas_retry_count += other.cas_retry_count;
+		mutex_wait_count += other.mutex_wait_count;
 		return *this;
 	}
 
+	void add_contention(const ContentionCounters& counters) {
+		cas_retry_count += counters.cas_retries;
+		mutex_wait_count += counters.mutex_waits;
+	}
+
 	BlockStateUpdateStats& get_xdr() {
 		return *this;
 	}
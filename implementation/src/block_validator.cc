@@ -1,5 +1,6 @@
 #include "block_validator.h"
 
+#include "account_partitioner.h"
 #include "simple_debug.h"
 
 #include "database.h"
@@ -11,12 +12,17 @@
 #include <mutex>
 #include <atomic>
 
+#include <tbb/task_arena.h>
+
 #include "utils.h"
 
 namespace edce {
 
 const unsigned int VALIDATION_BATCH_SIZE = 1000;
 
+//for account-partitioned validation, so that work stealing can even out uneven partitions
+const unsigned int PARTITIONS_PER_THREAD = 8;
+
 struct TransactionDataWrapper {
 	const TransactionData& data;
 
@@ -25,6 +31,11 @@ struct TransactionDataWrapper {
 		return tx_validator.validate_transaction(data.transactions[i], stats, serial_account_log);
 	}
 
+	template<typename F>
+	void for_each_written_account(size_t i, F&& func) const {
+		edce::for_each_written_account(data.transactions[i].transaction, func);
+	}
+
 	size_t size() const {
 		return data.transactions.size();
 	}
@@ -38,6 +49,11 @@ struct SignedTransactionListWrapper {
 		return tx_validator.validate_transaction(data[i], stats, serial_account_log);
 	}
 
+	template<typename F>
+	void for_each_written_account(size_t i, F&& func) const {
+		edce::for_each_written_account(data[i].transaction, func);
+	}
+
 	size_t size() const {
 		return data.size();
 	}
@@ -58,11 +74,40 @@ struct AccountModificationBlockWrapper {
 //		return tx_validator.validate_transaction(data.transactions[i]);
 	}
 
+	template<typename F>
+	void for_each_written_account(size_t i, F&& func) const {
+		func(data[i].owner);
+		for (auto& tx : data[i].new_transactions_self) {
+			edce::for_each_written_account(tx.transaction, func);
+		}
+	}
+
 	size_t size() const {
 		return data.size();
 	}
 };
 
+//Presents each partition of an AccountPartitionedBlock as one unit of work.
+template<typename WrappedType>
+struct AccountPartitionedWrapper {
+	const WrappedType& data;
+	const AccountPartitionedBlock& partitions;
+
+	template<typename ValidatorType>
+	bool operator() (ValidatorType& tx_validator, size_t p, BlockStateUpdateStatsWrapper& stats, SerialAccountModificationLog& serial_account_log) const {
+		for (size_t k = partitions.partition_starts[p]; k < partitions.partition_starts[p+1]; k++) {
+			if (!data(tx_validator, partitions.units[k], stats, serial_account_log)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	size_t size() const {
+		return partitions.num_partitions();
+	}
+};
+
 template<typename TxListOp>
 class ParallelValidate {
 	const TxListOp& txs;
@@ -172,7 +217,8 @@ bool validate_transaction_block(
 	const WorkUnitStateCommitmentChecker& clearing_commitment,
 	ThreadsafeValidationStatistics& main_stats,
 	BlockValidationMeasurements& measurements,
-	BlockStateUpdateStatsWrapper& stats) {
+	BlockStateUpdateStatsWrapper& stats,
+	const size_t grain_size = VALIDATION_BATCH_SIZE) {
 
 	auto validator = ParallelValidate(transactions, management_structures, clearing_commitment, main_stats);
 
@@ -186,7 +232,7 @@ bool validate_transaction_block(
 	auto timestamp = init_time_measurement();
 
 	//std::atomic_thread_fence(std::memory_order_release);
-	tbb::parallel_reduce(tbb::blocked_range<std::size_t>(0, transactions.size(), VALIDATION_BATCH_SIZE), validator);
+	tbb::parallel_reduce(tbb::blocked_range<std::size_t>(0, transactions.size(), grain_size), validator);
 	//std::atomic_thread_fence(std::memory_order_acquire);
 	BLOCK_INFO("done validating");
 
@@ -281,17 +327,64 @@ bool validate_transaction_block(
 }
 
 
+//Validates each group of txs that write disjoint sets of accounts on one thread,
+//so that (outside of the residue) no two threads modify the same account's balances.
+//Validity does not depend on tx order (the db is checked only once all txs are applied),
+//so the result is the same as that of the unpartitioned validation.
+template<typename WrappedType>
+bool validate_transaction_block_partitioned(
+	EdceManagementStructures& management_structures,
+	const WrappedType& transactions,
+	const WorkUnitStateCommitmentChecker& clearing_commitment,
+	ThreadsafeValidationStatistics& main_stats,
+	BlockValidationMeasurements& measurements,
+	BlockStateUpdateStatsWrapper& stats) {
+
+	auto timestamp = init_time_measurement();
+
+	AccountPartitionedBlock partitions;
+
+	size_t target_num_partitions = tbb::this_task_arena::max_concurrency() * PARTITIONS_PER_THREAD;
+	management_structures.account_partitioner.partition(transactions, target_num_partitions, partitions);
+
+	measurements.tx_partition_time = measure_time(timestamp);
+
+	BLOCK_INFO("partitioned %lu units into %lu partitions (%lu components, largest %lu, residue %lu) in %lf",
+		transactions.size(), partitions.num_partitions(), partitions.num_components,
+		partitions.largest_component, partitions.num_residue_units, measurements.tx_partition_time);
+
+	AccountPartitionedWrapper<WrappedType> wrapper{transactions, partitions};
+
+	return validate_transaction_block(management_structures, wrapper, clearing_commitment, main_stats, measurements, stats, 1);
+}
+
+template<typename WrappedType>
+bool dispatch_validate_transaction_block(
+	EdceManagementStructures& management_structures,
+	const WrappedType& transactions,
+	const WorkUnitStateCommitmentChecker& clearing_commitment,
+	ThreadsafeValidationStatistics& main_stats,
+	BlockValidationMeasurements& measurements,
+	BlockStateUpdateStatsWrapper& stats,
+	bool partition_by_account) {
+	if (partition_by_account) {
+		return validate_transaction_block_partitioned(management_structures, transactions, clearing_commitment, main_stats, measurements, stats);
+	}
+	return validate_transaction_block(management_structures, transactions, clearing_commitment, main_stats, measurements, stats);
+}
+
 bool validate_transaction_block(
 	EdceManagementStructures& management_structures,
 	const AccountModificationBlock& transactions,
 	const WorkUnitStateCommitmentChecker& clearing_commitment,
 	ThreadsafeValidationStatistics& main_stats,
 	BlockValidationMeasurements& measurements,
-	BlockStateUpdateStatsWrapper& stats) {
+	BlockStateUpdateStatsWrapper& stats,
+	bool partition_by_account) {
 	
 	AccountModificationBlockWrapper wrapper{transactions};
 
-	return validate_transaction_block(management_structures, wrapper, clearing_commitment, main_stats, measurements, stats);
+	return dispatch_validate_transaction_block(management_structures, wrapper, clearing_commitment, main_stats, measurements, stats, partition_by_account);
 }
 
 
@@ -301,11 +394,12 @@ bool validate_transaction_block(
 	const WorkUnitStateCommitmentChecker& clearing_commitment,
 	ThreadsafeValidationStatistics& main_stats,
 	BlockValidationMeasurements& measurements,
-	BlockStateUpdateStatsWrapper& stats) {
+	BlockStateUpdateStatsWrapper& stats,
+	bool partition_by_account) {
 
 	TransactionDataWrapper wrapper{transactions};
 
-	return validate_transaction_block(management_structures, wrapper, clearing_commitment, main_stats, measurements, stats);
+	return dispatch_validate_transaction_block(management_structures, wrapper, clearing_commitment, main_stats, measurements, stats, partition_by_account);
 }
 
 bool validate_transaction_block(
@@ -314,11 +408,12 @@ bool validate_transaction_block(
 	const WorkUnitStateCommitmentChecker& clearing_commitment,
 	ThreadsafeValidationStatistics& main_stats,
 	BlockValidationMeasurements& measurements,
-	BlockStateUpdateStatsWrapper& stats) {
+	BlockStateUpdateStatsWrapper& stats,
+	bool partition_by_account) {
 
 	SignedTransactionListWrapper wrapper{transactions};
 
-	return validate_transaction_block(management_structures, wrapper, clearing_commitment, main_stats, measurements, stats);
+	return dispatch_validate_transaction_block(management_structures, wrapper, clearing_commitment, main_stats, measurements, stats, partition_by_account);
 }
 
 bool validate_transaction_block(
@@ -327,7 +422,8 @@ bool validate_transaction_block(
 	const WorkUnitStateCommitmentChecker& clearing_commitment,
 	ThreadsafeValidationStatistics& main_stats,
 	BlockValidationMeasurements& measurements,
-	BlockStateUpdateStatsWrapper& stats) {
+	BlockStateUpdateStatsWrapper& stats,
+	bool partition_by_account) {
 
 	SignedTransactionList txs;
 
@@ -335,7 +431,7 @@ bool validate_transaction_block(
 
 	SignedTransactionListWrapper wrapper{txs};
 
-	return validate_transaction_block(management_structures, wrapper, clearing_commitment, main_stats, measurements, stats);
+	return dispatch_validate_transaction_block(management_structures, wrapper, clearing_commitment, main_stats, measurements, stats, partition_by_account);
 }
 
 class ParallelTrustedReplay {
@@ -18,13 +18,16 @@
 
 namespace edce {
 
+//If partition_by_account is set, the block's txs are first grouped by the accounts they write
+//(see account_partitioner.h), and each group is validated on one thread.
 bool validate_transaction_block(
 	EdceManagementStructures& management_structures,
 	const AccountModificationBlock& transactions,
 	const WorkUnitStateCommitmentChecker& clearing_commitment,
 	ThreadsafeValidationStatistics& main_stats,
 	BlockValidationMeasurements& measurements,
-	BlockStateUpdateStatsWrapper& state_update_stats);
+	BlockStateUpdateStatsWrapper& state_update_stats,
+	bool partition_by_account = false);
 
 bool validate_transaction_block(
 	EdceManagementStructures& management_structures,
@@ -32,7 +35,8 @@ bool validate_transaction_block(
 	const WorkUnitStateCommitmentChecker& clearing_commitment,
 	ThreadsafeValidationStatistics& main_stats,
 	BlockValidationMeasurements& measurements,
-	BlockStateUpdateStatsWrapper& state_update_stats);
+	BlockStateUpdateStatsWrapper& state_update_stats,
+	bool partition_by_account = false);
 
 bool validate_transaction_block(
 	EdceManagementStructures& management_structures,
@@ -40,7 +44,8 @@ bool validate_transaction_block(
 	const WorkUnitStateCommitmentChecker& clearing_commitment,
 	ThreadsafeValidationStatistics& main_stats,
 	BlockValidationMeasurements& measurements,
-	BlockStateUpdateStatsWrapper& state_update_stats);
+	BlockStateUpdateStatsWrapper& state_update_stats,
+	bool partition_by_account = false);
 
 bool validate_transaction_block(
 	EdceManagementStructures& management_structures,
@@ -48,7 +53,8 @@ bool validate_transaction_block(
 	const WorkUnitStateCommitmentChecker& clearing_commitment,
 	ThreadsafeValidationStatistics& main_stats,
 	BlockValidationMeasurements& measurements,
-	BlockStateUpdateStatsWrapper& state_update_stats);
+	BlockStateUpdateStatsWrapper& state_update_stats,
+	bool partition_by_account = false);
 
 
 
@@ -0,0 +1,100 @@
+#include "xdr/experiments.h"
+#include "edce.h"
+#include "utils.h"
+
+#include "block_archive.h"
+#include "edce_management_structures.h"
+#include "singlenode_init.h"
+
+#include "tbb/global_control.h"
+
+#include <cstdio>
+#include <string>
+
+/*
+Catches a node up from the persisted blocks on disk, either with the batched
+catchup path (edce_catchup_replay) or with the per-round path used at startup
+(edce_replay_trusted_round), and reports blocks per second.
+
+Both modes apply every round to memory on its own; the batched path only groups the
+lmdb writes.  Both modify the lmdbs, so compare them on two copies of the same database.
+*/
+
+using namespace edce;
+
+static double legacy_replay(EdceManagementStructures& management_structures, uint64_t start_round, uint64_t end_round) {
+	auto timestamp = init_time_measurement();
+
+	ReplayBlockLoader block_loader;
+	if (start_round <= end_round) {
+		block_loader.prefetch(start_round);
+	}
+
+	for (auto round = start_round; round <= end_round; round++) {
+		AccountModificationBlock tx_block;
+		block_loader.get(round, tx_block);
+		if (round < end_round) {
+			block_loader.prefetch(round + 1);
+		}
+		edce_replay_trusted_round(management_structures, round, tx_block);
+		management_structures.account_modification_log.detached_clear();
+	}
+	management_structures.db.commit_values();
+
+	return measure_time(timestamp);
+}
+
+int main(int argc, char const *argv[])
+{
+	if (argc != 6 && argc != 7) {
+		std::printf("usage: ./catchup_replay <data_directory> <end_round> <num_threads> <batch_size> <checkpoint_interval> <legacy=0>\n");
+		return -1;
+	}
+
+	std::string experiment_root = std::string(argv[1]) + "/";
+	uint64_t end_round = std::stoull(argv[2]);
+	int num_threads = std::stoi(argv[3]);
+	uint64_t batch_size = std::stoull(argv[4]);
+	uint64_t checkpoint_interval = std::stoull(argv[5]);
+	bool legacy = (argc == 7) && std::stoi(argv[6]);
+
+	ExperimentParameters params;
+	std::string params_filename = experiment_root + "params";
+
+	if (load_xdr_from_file(params, params_filename.c_str())) {
+		throw std::runtime_error("failed to load " + params_filename);
+	}
+
+	tbb::global_control control(
+		tbb::global_control::max_allowed_parallelism, num_threads);
+
+	EdceManagementStructures management_structures(
+		params.num_assets,
+		ApproximationParameters {
+			.tax_rate = (uint8_t)params.tax_rate,
+			.smooth_mult = (uint8_t)params.smooth_mult
+		});
+
+	auto start_round = init_management_structures_from_lmdb(management_structures);
+
+	if (start_round > end_round) {
+		std::printf("already persisted through round %lu\n", start_round - 1);
+		return 0;
+	}
+
+	uint64_t num_blocks = end_round - start_round + 1;
+
+	if (legacy) {
+		std::printf("per-round replay of rounds [%lu, %lu]\n", start_round, end_round);
+		auto duration = legacy_replay(management_structures, start_round, end_round);
+		std::printf("per-round replay: %lu blocks in %lf s (%lf blocks/s)\n", num_blocks, duration, num_blocks / duration);
+		return 0;
+	}
+
+	auto stats = edce_catchup_replay(management_structures, end_round, batch_size, checkpoint_interval);
+
+	std::printf("batches: %lu checkpoints: %lu\n", stats.num_batches, stats.num_checkpoints);
+	std::printf("replay: %lf s checkpoint: %lf s persist: %lf s\n", stats.replay_time, stats.checkpoint_time, stats.persist_time);
+	std::printf("catchup replay: %lu blocks in %lf s (%lf blocks/s)\n", stats.num_blocks, stats.total_time, stats.blocks_per_second());
+	return 0;
+}
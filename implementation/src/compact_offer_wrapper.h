@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <xdrpp/marshal.h>
+
+#include "xdr/types.h"
+#include "price_utils.h"
+
+namespace edce {
+
+/*
+Offer trie leaf that stores only an offer's amount.
+
+The rest of an offer is implicit: minPrice, owner, and offerId are the leaf's key
+(see MerkleWorkUnit::generate_key), and every offer in a work unit has the work unit's category
+(the leaf's value context).  to_offer() rebuilds the full Offer.
+
+Leaves serialize (for hashing and proofs) as the xdr of the rebuilt Offer,
+so trie hashes are the same as those of a trie of XdrTypeWrapper<Offer>.
+*/
+struct CompactOfferWrapper {
+	using value_context_t = OfferCategory;
+
+	uint64_t amount;
+
+	CompactOfferWrapper() : amount(0) {}
+	CompactOfferWrapper(const Offer& offer) : amount(offer.amount) {}
+
+	template<typename prefix_t>
+	Offer to_offer(const prefix_t& key, const OfferCategory& category) const {
+		auto bytes = key.get_bytes_array();
+		Offer offer;
+		offer.category = category;
+		offer.minPrice = PriceUtils::read_price_big_endian(bytes.data());
+		PriceUtils::read_unsigned_big_endian(bytes.data() + PriceUtils::PRICE_BYTES, offer.owner);
+		PriceUtils::read_unsigned_big_endian(bytes.data() + PriceUtils::PRICE_BYTES + sizeof(AccountID), offer.offerId);
+		offer.amount = amount;
+		return offer;
+	}
+
+	template<typename prefix_t>
+	void copy_data(std::vector<uint8_t>& buf, const prefix_t& key, const OfferCategory& category) const {
+		auto serialization = xdr::xdr_to_opaque(to_offer(key, category));
+		buf.insert(buf.end(), serialization.begin(), serialization.end());
+	}
+};
+
+} /* edce */
@@ -0,0 +1,191 @@
+#include "conflict_aware_scheduler.h"
+
+#include <algorithm>
+
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
+#include <tbb/task_arena.h>
+
+#include "simple_debug.h"
+#include "tx_write_set.h"
+
+namespace edce {
+
+struct AccountSampleReduce {
+	Mempool& mempool;
+	const size_t sample_stride;
+
+	std::unordered_map<AccountID, uint32_t> counts;
+	uint64_t num_samples = 0;
+
+	//accounts of the tx being sampled
+	std::vector<AccountID> sample_accounts;
+
+	void operator() (const tbb::blocked_range<size_t> r) {
+		for (auto i = r.begin(); i < r.end(); i++) {
+			auto& chunk = mempool[i];
+			size_t chunk_sz = chunk.size();
+			for (size_t j = 0; j < chunk_sz; j += sample_stride) {
+				//a sample counts each account once, however often the tx writes it (e.g. a self-payment)
+				sample_accounts.clear();
+				for_each_written_account(chunk[j].transaction, [this] (const AccountID& account) {
+					if (std::find(sample_accounts.begin(), sample_accounts.end(), account) == sample_accounts.end()) {
+						sample_accounts.push_back(account);
+						counts[account]++;
+					}
+				});
+				num_samples++;
+			}
+		}
+	}
+
+	AccountSampleReduce(Mempool& mempool, size_t sample_stride)
+		: mempool(mempool)
+		, sample_stride(sample_stride) {}
+
+	AccountSampleReduce(AccountSampleReduce& x, tbb::split)
+		: mempool(x.mempool)
+		, sample_stride(x.sample_stride) {}
+
+	void join(AccountSampleReduce& other) {
+		if (other.counts.size() > counts.size()) {
+			std::swap(counts, other.counts);
+		}
+		for (auto& [account, count] : other.counts) {
+			counts[account] += count;
+		}
+		num_samples += other.num_samples;
+	}
+};
+
+void
+ConflictAwareScheduler::find_hot_accounts(Mempool& mempool, size_t num_chunks, size_t max_lanes) {
+	AccountSampleReduce sampler(mempool, sample_stride);
+	tbb::parallel_reduce(tbb::blocked_range<size_t>(0, num_chunks), sampler);
+
+	uint64_t threshold = std::max<uint64_t>(
+		MIN_HOT_ACCOUNT_SAMPLES,
+		static_cast<uint64_t>(hot_account_share * sampler.num_samples));
+
+	std::vector<std::pair<uint32_t, AccountID>> candidates;
+	for (auto& [account, count] : sampler.counts) {
+		if (count >= threshold) {
+			candidates.emplace_back(count, account);
+		}
+	}
+
+	if (candidates.size() == 0) {
+		return;
+	}
+
+	//heaviest first, ties broken by account id so that lane assignment is deterministic
+	std::sort(candidates.begin(), candidates.end(),
+		[] (const auto& a, const auto& b) {
+			return (a.first > b.first) || (a.first == b.first && a.second < b.second);
+		});
+
+	if (candidates.size() > MAX_HOT_ACCOUNTS) {
+		candidates.resize(MAX_HOT_ACCOUNTS);
+	}
+
+	size_t num_lanes = std::min<size_t>(std::min<size_t>(max_lanes, candidates.size()), NO_LANE);
+	lanes.resize(num_lanes);
+
+	//greedy: each account goes to the least loaded lane
+	std::vector<uint64_t> lane_loads(num_lanes, 0);
+	for (auto& [count, account] : candidates) {
+		auto lightest = std::min_element(lane_loads.begin(), lane_loads.end()) - lane_loads.begin();
+		lane_loads[lightest] += count;
+		hot_account_lanes[account] = lightest;
+	}
+
+	BLOCK_INFO("conflict scheduler: %lu hot accounts over %lu lanes (threshold %lu of %lu samples)",
+		hot_account_lanes.size(), num_lanes, threshold, sampler.num_samples);
+}
+
+uint16_t
+ConflictAwareScheduler::compute_lane(const Transaction& tx) const {
+	uint16_t lane = NO_LANE;
+	for_each_written_account(tx, [this, &lane] (const AccountID& account) {
+		if (lane != NO_LANE) {
+			return;
+		}
+		auto iter = hot_account_lanes.find(account);
+		if (iter != hot_account_lanes.end()) {
+			lane = iter->second;
+		}
+	});
+	return lane;
+}
+
+void
+ConflictAwareScheduler::schedule(Mempool& mempool, size_t max_txs, size_t max_lanes) {
+	clear();
+
+	if (max_lanes == 0) {
+		max_lanes = tbb::this_task_arena::max_concurrency();
+	}
+
+	size_t num_chunks = 0;
+	size_t covered_txs = 0;
+	while (num_chunks < mempool.num_chunks() && covered_txs < max_txs) {
+		covered_txs += mempool[num_chunks].size();
+		num_chunks++;
+	}
+
+	find_hot_accounts(mempool, num_chunks, max_lanes);
+
+	if (hot_account_lanes.size() == 0) {
+		return;
+	}
+
+	tx_lanes.resize(num_chunks);
+	chunk_lane_tx_counts.resize(num_chunks, 0);
+	std::vector<std::vector<std::vector<TxRef>>> chunk_lanes(num_chunks);
+
+	tbb::parallel_for(
+		tbb::blocked_range<size_t>(0, num_chunks),
+		[this, &mempool, &chunk_lanes] (auto r) {
+			for (auto i = r.begin(); i < r.end(); i++) {
+				auto& chunk = mempool[i];
+				size_t chunk_sz = chunk.size();
+				auto& lanes_out = tx_lanes[i];
+				lanes_out.resize(chunk_sz);
+				chunk_lanes[i].resize(lanes.size());
+				for (size_t j = 0; j < chunk_sz; j++) {
+					auto lane = compute_lane(chunk[j].transaction);
+					lanes_out[j] = lane;
+					if (lane != NO_LANE) {
+						chunk_lanes[i][lane].push_back(TxRef{static_cast<uint32_t>(i), static_cast<uint32_t>(j)});
+						chunk_lane_tx_counts[i]++;
+					}
+				}
+			}
+		});
+
+	//concatenate in chunk order, so each lane sees its txs in mempool order
+	tbb::parallel_for(
+		tbb::blocked_range<size_t>(0, lanes.size()),
+		[this, &chunk_lanes] (auto r) {
+			for (auto lane = r.begin(); lane < r.end(); lane++) {
+				for (auto& chunk_lane : chunk_lanes) {
+					lanes[lane].insert(lanes[lane].end(), chunk_lane[lane].begin(), chunk_lane[lane].end());
+				}
+			}
+		});
+
+	for (auto& lane : lanes) {
+		num_hot_txs += lane.size();
+	}
+}
+
+void
+ConflictAwareScheduler::clear() {
+	hot_account_lanes.clear();
+	tx_lanes.clear();
+	chunk_lane_tx_counts.clear();
+	lanes.clear();
+	num_hot_txs = 0;
+}
+
+} /* edce */
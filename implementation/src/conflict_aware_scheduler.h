@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "mempool.h"
+
+#include "xdr/transaction.h"
+#include "xdr/types.h"
+
+namespace edce {
+
+/*
+Routes txs that touch heavily-used ("hot") accounts to a single owning lane per account,
+so that one thread applies all of a hot account's balance updates
+instead of every block production thread contending on its RevertableAsset atomics
+and uncommitted_assets_mtx.
+
+A tx's write set is its source account (sequence number, debits, credits)
+plus the receiver of every payment it makes (see tx_write_set.h).
+
+Hot accounts are found by sampling the write sets of the txs at the front of the mempool
+(the txs that build_block will look at first).  Hot accounts are assigned to lanes
+greedily by sampled load.  A tx is routed to the lane of its source account if
+that is hot, otherwise to the lane of the first hot payment receiver.
+Every other tx is processed by the usual per-chunk parallel pass.
+
+Scheduling changes only which thread processes a tx, and when (lanes run alongside
+the per-chunk pass, each reserving block space for its own txs).  Every update is still applied with the same atomic
+operations, so a tx touching hot accounts in two different lanes is still handled correctly,
+just with some contention.
+*/
+class ConflictAwareScheduler {
+
+public:
+
+	constexpr static uint16_t NO_LANE = UINT16_MAX;
+
+	struct TxRef {
+		uint32_t chunk_idx;
+		uint32_t tx_idx;
+	};
+
+	constexpr static size_t DEFAULT_SAMPLE_STRIDE = 8;
+	//an account is hot if it appears in at least this share of sampled write sets
+	constexpr static double DEFAULT_HOT_ACCOUNT_SHARE = 0.002;
+	constexpr static size_t MIN_HOT_ACCOUNT_SAMPLES = 16;
+	constexpr static size_t MAX_HOT_ACCOUNTS = 1024;
+
+private:
+
+	const size_t sample_stride;
+	const double hot_account_share;
+
+	std::unordered_map<AccountID, uint16_t> hot_account_lanes;
+
+	//indexed by mempool chunk, then by tx.  Only covers the chunks that were scheduled.
+	std::vector<std::vector<uint16_t>> tx_lanes;
+	//per scheduled chunk, number of txs in any lane
+	std::vector<uint32_t> chunk_lane_tx_counts;
+	//per lane, hot txs in mempool order
+	std::vector<std::vector<TxRef>> lanes;
+
+	size_t num_hot_txs = 0;
+
+	void find_hot_accounts(Mempool& mempool, size_t num_chunks, size_t max_lanes);
+
+	uint16_t compute_lane(const Transaction& tx) const;
+
+public:
+
+	ConflictAwareScheduler(
+		size_t sample_stride = DEFAULT_SAMPLE_STRIDE,
+		double hot_account_share = DEFAULT_HOT_ACCOUNT_SHARE)
+		: sample_stride(sample_stride)
+		, hot_account_share(hot_account_share) {}
+
+	//Caller must hold the mempool lock until the schedule is no longer in use.
+	//Considers chunks from the front of the mempool until max_txs txs are covered.
+	//max_lanes = 0 uses the number of tbb worker threads.
+	void schedule(Mempool& mempool, size_t max_txs, size_t max_lanes = 0);
+
+	uint16_t get_tx_lane(size_t chunk_idx, size_t tx_idx) const {
+		if (chunk_idx >= tx_lanes.size()) {
+			return NO_LANE;
+		}
+		return tx_lanes[chunk_idx][tx_idx];
+	}
+
+	size_t get_num_lane_txs(size_t chunk_idx) const {
+		if (chunk_idx >= chunk_lane_tx_counts.size()) {
+			return 0;
+		}
+		return chunk_lane_tx_counts[chunk_idx];
+	}
+
+	bool has_hot_txs() const {
+		return num_hot_txs > 0;
+	}
+
+	size_t get_num_lanes() const {
+		return lanes.size();
+	}
+
+	const std::vector<TxRef>& get_lane(size_t lane) const {
+		return lanes.at(lane);
+	}
+
+	size_t get_num_hot_accounts() const {
+		return hot_account_lanes.size();
+	}
+
+	size_t get_num_hot_txs() const {
+		return num_hot_txs;
+	}
+
+	bool is_hot(AccountID account) const {
+		return hot_account_lanes.find(account) != hot_account_lanes.end();
+	}
+
+	void clear();
+};
+
+} /* edce */
@@ -9,10 +9,10 @@ ConsensusApiServer::ConsensusApiServer(EdceNode& main_node)
 	, req_server(main_node)
 	, control_server(main_node)
 	, ps()
-	, bt_listener(ps, xdr::tcp_listen(BLOCK_FORWARDING_PORT, AF_INET), false, xdr::session_allocator<void>())
-	, ack_listener(ps, xdr::tcp_listen(BLOCK_CONFIRMATION_PORT, AF_INET), false, xdr::session_allocator<void>())
-	, req_listener(ps, xdr::tcp_listen(FORWARDING_REQUEST_PORT, AF_INET), false, xdr::session_allocator<void>())
-	, control_listener(ps, xdr::tcp_listen(SERVER_CONTROL_PORT, AF_INET), false, xdr::session_allocator<void>()) {
+	, bt_listener(ps, tcp_listen_on_node_address(BLOCK_FORWARDING_PORT), false, xdr::session_allocator<void>())
+	, ack_listener(ps, tcp_listen_on_node_address(BLOCK_CONFIRMATION_PORT), false, xdr::session_allocator<void>())
+	, req_listener(ps, tcp_listen_on_node_address(FORWARDING_REQUEST_PORT), false, xdr::session_allocator<void>())
+	, control_listener(ps, tcp_listen_on_node_address(SERVER_CONTROL_PORT), false, xdr::session_allocator<void>()) {
 		bt_listener.register_service(transfer_server);
 		ack_listener.register_service(ack_server);
 		req_listener.register_service(req_server);
@@ -29,13 +29,13 @@ ConsensusApiServer::add_to_pollset(xdr::pollset& ps) {
 
 	BLOCK_INFO("running consensus_api_server");
 
-	bt_listener = xdr::arpc_tcp_listener<> (ps, xdr::tcp_listen(BLOCK_FORWARDING_PORT, AF_INET), false, xdr::session_allocator<void>());
+	bt_listener = xdr::arpc_tcp_listener<> (ps, tcp_listen_on_node_address(BLOCK_FORWARDING_PORT), false, xdr::session_allocator<void>());
 
-	ack_listener = xdr::arpc_tcp_listener<> (ps, xdr::tcp_listen(BLOCK_CONFIRMATION_PORT, AF_INET), false, xdr::session_allocator<void>());
+	ack_listener = xdr::arpc_tcp_listener<> (ps, tcp_listen_on_node_address(BLOCK_CONFIRMATION_PORT), false, xdr::session_allocator<void>());
 
-	req_listener = xdr::srpc_tcp_listener<> (ps, xdr::tcp_listen(FORWARDING_REQUEST_PORT, AF_INET), false, xdr::session_allocator<void>());
+	req_listener = xdr::srpc_tcp_listener<> (ps, tcp_listen_on_node_address(FORWARDING_REQUEST_PORT), false, xdr::session_allocator<void>());
 
-	control_listener = xdr::srpc_tcp_listener<> (ps, xdr::tcp_listen(SERVER_CONTROL_PORT, AF_INET), false, xdr::session_allocator<void>());
+	control_listener = xdr::srpc_tcp_listener<> (ps, tcp_listen_on_node_address(SERVER_CONTROL_PORT), false, xdr::session_allocator<void>());
 	
 	//ps.run();
 	//throw std::runtime_error("pollset.run() should never terminate!");
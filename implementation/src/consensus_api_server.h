@@ -2,6 +2,7 @@
 
 #include "edce_node.h"
 #include "rpc/rpcconfig.h"
+#include "rpc/listen_address.h"
 #include "rpc/consensus_api.h"
 #include "xdr/consensus_api.h"
 
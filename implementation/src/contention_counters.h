@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+
+namespace edce {
+
+/*
+Per-thread counts of contention on account state during tx processing:
+failed compare_exchange attempts on RevertableAsset balances,
+and acquisitions of UserAccount::uncommitted_assets_mtx that had to wait.
+
+Counters are only ever touched by their owning thread, and only on the contended path,
+so the uncontended fast path costs nothing extra.
+Readers take a snapshot before and after a unit of work and report the difference.
+*/
+struct ContentionCounters {
+	uint64_t cas_retries = 0;
+	uint64_t mutex_waits = 0;
+
+	static ContentionCounters& local() {
+		static thread_local ContentionCounters counters;
+		return counters;
+	}
+
+	ContentionCounters operator-(const ContentionCounters& other) const {
+		ContentionCounters out;
+		out.cas_retries = cas_retries - other.cas_retries;
+		out.mutex_waits = mutex_waits - other.mutex_waits;
+		return out;
+	}
+};
+
+static inline void record_cas_retry() {
+	ContentionCounters::local().cas_retries++;
+}
+
+//Acquires mtx, counting the acquisition if the lock was not immediately available.
+static inline std::unique_lock<std::mutex> lock_counting_contention(std::mutex& mtx) {
+	std::unique_lock<std::mutex> lock(mtx, std::try_to_lock);
+	if (!lock.owns_lock()) {
+		ContentionCounters::local().mutex_waits++;
+		lock.lock();
+	}
+	return lock;
+}
+
+} /* edce */
@@ -0,0 +1,253 @@
+#include "convex_price_solver.h"
+
+#include "merkle_work_unit.h"
+#include "price_utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace edce {
+
+//Solves a x = b in place (b holds x on return), for symmetric positive definite a.
+//Returns false if a is not (numerically) positive definite.
+static bool 
+cholesky_solve(std::vector<double>& a, std::vector<double>& b, const size_t n) {
+	for (size_t j = 0; j < n; j++) {
+		double diag = a[j * n + j];
+		for (size_t k = 0; k < j; k++) {
+			diag -= a[j * n + k] * a[j * n + k];
+		}
+		if (!(diag > 0)) {
+			return false;
+		}
+		diag = std::sqrt(diag);
+		a[j * n + j] = diag;
+		for (size_t i = j + 1; i < n; i++) {
+			double val = a[i * n + j];
+			for (size_t k = 0; k < j; k++) {
+				val -= a[i * n + k] * a[j * n + k];
+			}
+			a[i * n + j] = val / diag;
+		}
+	}
+	for (size_t i = 0; i < n; i++) {
+		double val = b[i];
+		for (size_t k = 0; k < i; k++) {
+			val -= a[i * n + k] * b[k];
+		}
+		b[i] = val / a[i * n + i];
+	}
+	for (size_t i = n; i-- > 0;) {
+		double val = b[i];
+		for (size_t k = i + 1; k < n; k++) {
+			val -= a[k * n + i] * b[k];
+		}
+		b[i] = val / a[i * n + i];
+	}
+	return true;
+}
+
+ConvexPriceSolver::ConvexPriceSolver(MerkleWorkUnitManager& work_unit_manager)
+	: work_unit_manager(work_unit_manager)
+	, num_assets(work_unit_manager.get_num_assets())
+	, log_prices(num_assets, 0.0)
+	, residual(num_assets, 0.0)
+	, jacobian(num_assets * num_assets, 0.0)
+	, normal_matrix(num_assets * num_assets, 0.0)
+	, gradient(num_assets, 0.0)
+	, system(num_assets * num_assets, 0.0)
+	, step_direction(num_assets, 0.0)
+	, trial_log_prices(num_assets, 0.0)
+	, trial_residual(num_assets, 0.0)
+	, trial_jacobian(num_assets * num_assets, 0.0) {}
+
+double
+ConvexPriceSolver::evaluate(
+	const std::vector<double>& x, 
+	const uint8_t smooth_mult, 
+	std::vector<double>& residual_out, 
+	std::vector<double>& jacobian_out, 
+	double& traded_value_out) const {
+
+	std::fill(residual_out.begin(), residual_out.end(), 0.0);
+	std::fill(jacobian_out.begin(), jacobian_out.end(), 0.0);
+	traded_value_out = 0;
+
+	const double epsilon = std::exp2(-((double) smooth_mult));
+	const double endow_times_price_radix = std::exp2(PriceUtils::PRICE_RADIX);
+
+	//every offer's min price is a Price, so clamping lookups to this range doesn't change them
+	const double min_rate = PriceUtils::to_double(1);
+	const double max_rate = PriceUtils::to_double(PriceUtils::PRICE_MAX);
+
+	for (const auto& work_unit : work_unit_manager.get_work_units()) {
+		//the first index entry is a placeholder
+		if (work_unit.get_indexed_metadata().size() <= 1) {
+			continue;
+		}
+
+		auto category = work_unit.get_category();
+		const size_t sell = category.sellAsset;
+		const size_t buy = category.buyAsset;
+
+		const double sell_price = std::exp(x[sell]);
+		const double rate = std::exp(x[sell] - x[buy]);
+
+		//same execution bounds as MerkleWorkUnit::get_execution_prices
+		Price upper_bound_price = PriceUtils::from_double(std::clamp(rate, min_rate, max_rate));
+		Price lower_bound_price = upper_bound_price;
+		if (smooth_mult) {
+			lower_bound_price = upper_bound_price - (upper_bound_price >> smooth_mult);
+		}
+
+		auto metadata_full = work_unit.get_metadata(lower_bound_price);
+		auto metadata_partial = work_unit.get_metadata(upper_bound_price);
+
+		double sold = metadata_full.endow;
+		double d_sold_d_rate = 0;
+
+		if (smooth_mult) {
+			double partial_endow = metadata_partial.endow - metadata_full.endow;
+			double partial_endow_times_price 
+				= ((double) (metadata_partial.endow_times_price - metadata_full.endow_times_price)) / endow_times_price_radix;
+
+			sold += std::max(0.0, (partial_endow - partial_endow_times_price / rate) / epsilon);
+			d_sold_d_rate = partial_endow_times_price / (epsilon * rate * rate);
+		}
+
+		const double value = sell_price * sold;
+
+		residual_out[buy] += value;
+		residual_out[sell] -= value;
+		traded_value_out += value;
+
+		// d value / d x_sell = value + g, d value / d x_buy = -g
+		const double g = sell_price * d_sold_d_rate * rate;
+
+		jacobian_out[buy * num_assets + sell] += value + g;
+		jacobian_out[buy * num_assets + buy] -= g;
+		jacobian_out[sell * num_assets + sell] -= value + g;
+		jacobian_out[sell * num_assets + buy] += g;
+	}
+
+	double norm_sq = 0;
+	for (size_t i = 0; i < num_assets; i++) {
+		norm_sq += residual_out[i] * residual_out[i];
+	}
+	return norm_sq;
+}
+
+void
+ConvexPriceSolver::reset(const Price* starting_prices, const uint8_t smooth_mult) {
+	double mean = 0;
+	for (size_t i = 0; i < num_assets; i++) {
+		log_prices[i] = std::log(PriceUtils::to_double(std::max<Price>(starting_prices[i], 1)));
+		mean += log_prices[i];
+	}
+	mean /= num_assets;
+	for (size_t i = 0; i < num_assets; i++) {
+		log_prices[i] = std::clamp(log_prices[i] - mean, -MAX_LOG_PRICE, MAX_LOG_PRICE);
+	}
+
+	damping = INITIAL_DAMPING;
+	residual_norm_sq = evaluate(log_prices, smooth_mult, residual, jacobian, traded_value);
+}
+
+bool
+ConvexPriceSolver::step(const uint8_t smooth_mult) {
+
+	const size_t n = num_assets;
+
+	// normal equations of the linearization: (J^T J) dx = -J^T Z
+	double max_diag = 0;
+	for (size_t i = 0; i < n; i++) {
+		double grad = 0;
+		for (size_t k = 0; k < n; k++) {
+			grad += jacobian[k * n + i] * residual[k];
+		}
+		gradient[i] = -grad;
+
+		for (size_t j = 0; j <= i; j++) {
+			double val = 0;
+			for (size_t k = 0; k < n; k++) {
+				val += jacobian[k * n + i] * jacobian[k * n + j];
+			}
+			normal_matrix[i * n + j] = val;
+			normal_matrix[j * n + i] = val;
+		}
+		max_diag = std::max(max_diag, normal_matrix[i * n + i]);
+	}
+
+	if (max_diag == 0) {
+		//nothing trades anywhere nearby
+		return false;
+	}
+
+	while (damping <= MAX_DAMPING) {
+
+		//Marquardt scaling, plus a rank one term that pins down the (otherwise free) mean log price.
+		for (size_t i = 0; i < n; i++) {
+			for (size_t j = 0; j < n; j++) {
+				system[i * n + j] = normal_matrix[i * n + j] + max_diag / n;
+			}
+			system[i * n + i] += damping * (normal_matrix[i * n + i] + MIN_DAMPING * max_diag);
+			step_direction[i] = gradient[i];
+		}
+
+		if (!cholesky_solve(system, step_direction, n)) {
+			damping *= 10;
+			continue;
+		}
+
+		double mean = 0;
+		double max_abs = 0;
+		for (size_t i = 0; i < n; i++) {
+			mean += step_direction[i];
+		}
+		mean /= n;
+		for (size_t i = 0; i < n; i++) {
+			step_direction[i] -= mean;
+			max_abs = std::max(max_abs, std::abs(step_direction[i]));
+		}
+
+		double scale = (max_abs > MAX_LOG_STEP) ? MAX_LOG_STEP / max_abs : 1.0;
+
+		for (size_t i = 0; i < n; i++) {
+			trial_log_prices[i] = std::clamp(log_prices[i] + scale * step_direction[i], -MAX_LOG_PRICE, MAX_LOG_PRICE);
+		}
+
+		double trial_traded_value = 0;
+		double trial_norm_sq = evaluate(trial_log_prices, smooth_mult, trial_residual, trial_jacobian, trial_traded_value);
+
+		if (trial_norm_sq < residual_norm_sq) {
+			std::swap(log_prices, trial_log_prices);
+			std::swap(residual, trial_residual);
+			std::swap(jacobian, trial_jacobian);
+			residual_norm_sq = trial_norm_sq;
+			traded_value = trial_traded_value;
+
+			damping = std::max(damping / 3, MIN_DAMPING);
+			return true;
+		}
+		damping *= 4;
+	}
+	return false;
+}
+
+void
+ConvexPriceSolver::get_prices(Price* prices_out) const {
+	for (size_t i = 0; i < num_assets; i++) {
+		prices_out[i] = PriceUtils::impose_bounds(PriceUtils::from_double(std::exp(log_prices[i])));
+	}
+}
+
+double
+ConvexPriceSolver::get_relative_residual() const {
+	if (traded_value == 0) {
+		return std::numeric_limits<double>::infinity();
+	}
+	return std::sqrt(residual_norm_sq) / traded_value;
+}
+
+} /* edce */
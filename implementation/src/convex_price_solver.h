@@ -0,0 +1,88 @@
+#pragma once
+
+#include "merkle_work_unit_manager.h"
+#include "xdr/types.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace edce {
+
+/*
+Damped Newton price solver, raced against the Tatonnement threads in TatonnementOracle.
+
+Works in log prices (price_i = exp(x_i)) on the same smoothed demand function
+that Tatonnement uses, evaluated in floating point from each work unit's metadata index.
+A work unit selling A for B at exchange rate r = p_A / p_B sells
+
+	S(r) = E_full + (E_partial - ETP_partial / r) / eps
+
+units of A, where eps = 2^-smooth_mult, E_full is the endowment of offers with
+min price at most r(1-eps), and E_partial and ETP_partial are the endowment
+and endowment times min price of offers with min price in (r(1-eps), r].
+Between offer prices, dS/dr = ETP_partial / (eps r^2).
+
+The residual Z_i is the value of asset i demanded minus the value supplied, 
+and each step is a Levenberg-Marquardt step on |Z|^2.
+Z is homogeneous in the prices, so steps keep the mean log price fixed.
+
+The solver only proposes prices.  The caller checks them with the exact
+(fixed-point) demand calculation.
+*/
+class ConvexPriceSolver {
+
+	constexpr static double INITIAL_DAMPING = 1e-3;
+	constexpr static double MIN_DAMPING = 1e-12;
+	constexpr static double MAX_DAMPING = 1e12;
+
+	//largest change to any one log price in one step
+	constexpr static double MAX_LOG_STEP = 2.0;
+	//keeps log prices within [-MAX_LOG_PRICE, MAX_LOG_PRICE], inside the range of Price
+	constexpr static double MAX_LOG_PRICE = 16.0;
+
+	MerkleWorkUnitManager& work_unit_manager;
+	const size_t num_assets;
+
+	std::vector<double> log_prices;
+	std::vector<double> residual;
+	//row-major, jacobian[i * num_assets + j] = d residual[i] / d log_prices[j]
+	std::vector<double> jacobian;
+	double residual_norm_sq = 0;
+	double traded_value = 0;
+
+	double damping = INITIAL_DAMPING;
+
+	//step workspaces
+	std::vector<double> normal_matrix;
+	std::vector<double> gradient;
+	std::vector<double> system;
+	std::vector<double> step_direction;
+	std::vector<double> trial_log_prices;
+	std::vector<double> trial_residual;
+	std::vector<double> trial_jacobian;
+
+	//returns |residual_out|^2
+	double evaluate(
+		const std::vector<double>& x, 
+		const uint8_t smooth_mult, 
+		std::vector<double>& residual_out, 
+		std::vector<double>& jacobian_out, 
+		double& traded_value_out) const;
+
+public:
+
+	ConvexPriceSolver(MerkleWorkUnitManager& work_unit_manager);
+
+	void reset(const Price* starting_prices, const uint8_t smooth_mult);
+
+	//Returns false once no step (up to MAX_DAMPING) reduces the residual.
+	bool step(const uint8_t smooth_mult);
+
+	void get_prices(Price* prices_out) const;
+
+	//|Z| relative to the total value traded
+	double get_relative_residual() const;
+};
+
+} /* edce */
@@ -0,0 +1,181 @@
+#include "edce_management_structures.h"
+#include "lp_solver.h"
+#include "price_utils.h"
+#include "tatonnement_oracle.h"
+#include "tatonnement_sim_setup.h"
+#include "utils.h"
+
+#include "xdr/experiments.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/*
+Compares price computation with and without the convex solver racing the
+Tatonnement threads, on the aberrant datasets (synthetic_data_generator/aberrant_datasets_gen.cc).
+*/
+
+using namespace edce;
+
+struct RaceResult {
+	double runtime;
+	uint32_t num_rounds;
+	bool convex_solver_won;
+	bool timeout;
+};
+
+static RaceResult run_one(
+	TatonnementOracle& oracle, std::vector<Price> prices, const ApproximationParameters approx_params, uint32_t timeout_ms) {
+
+	std::atomic<bool> timeout_flag = false;
+	std::atomic<bool> cancel_timeout = false;
+	auto timeout_th = oracle.launch_timeout_thread(timeout_ms, timeout_flag, cancel_timeout);
+
+	auto res = oracle.compute_prices_grid_search(prices.data(), approx_params);
+	cancel_timeout = true;
+	timeout_th.join();
+
+	//the losers need to stop before the work units are reloaded
+	oracle.wait_for_all_tatonnement_threads();
+
+	return RaceResult {
+		.runtime = res.runtime,
+		.num_rounds = res.num_rounds,
+		.convex_solver_won = res.convex_solver_won != 0,
+		.timeout = timeout_flag.load()
+	};
+}
+
+static double median(std::vector<double> samples) {
+	if (samples.size() == 0) {
+		return 0;
+	}
+	std::sort(samples.begin(), samples.end());
+	return samples[samples.size() / 2];
+}
+
+static void print_summary(const char* name, const std::vector<RaceResult>& results) {
+	std::vector<double> runtimes;
+	size_t num_timeouts = 0, num_convex_wins = 0;
+	for (auto& res : results) {
+		if (res.timeout) {
+			num_timeouts++;
+			continue;
+		}
+		runtimes.push_back(res.runtime);
+		if (res.convex_solver_won) {
+			num_convex_wins++;
+		}
+	}
+	std::printf("\t%s: median %lf s, max %lf s, timeouts %lu/%lu, convex solver won %lu\n",
+		name, 
+		median(runtimes), 
+		runtimes.size() ? *std::max_element(runtimes.begin(), runtimes.end()) : 0.0,
+		num_timeouts, 
+		results.size(), 
+		num_convex_wins);
+}
+
+static void run_dataset(
+	const std::string& experiment_root, const ExperimentConfig& config, size_t num_txs, uint8_t tax_rate, uint8_t smooth_mult, size_t num_trials) {
+
+	ExperimentParameters params;
+
+	std::string params_filename = experiment_root + "params";
+	if (load_xdr_from_file(params, params_filename.c_str())) {
+		throw std::runtime_error("failed to load params file");
+	}
+
+	ApproximationParameters approx_params {
+		.tax_rate = tax_rate,
+		.smooth_mult = smooth_mult
+	};
+
+	EdceManagementStructures management_structures(params.num_assets, approx_params);
+
+	TatonnementSimSetup setup(management_structures);
+	setup.create_accounts(params.num_accounts);
+	setup.set_all_account_balances(params.num_accounts, params.num_assets, 1'000'000'000'000'000);
+
+	auto& manager = management_structures.work_unit_manager;
+
+	LPSolver lp_solver(manager);
+	TatonnementOracle tatonnement_only(manager, lp_solver, 0, false);
+	TatonnementOracle racing(manager, lp_solver, 0, true);
+
+	std::vector<Price> prices;
+	for (auto p : config.starting_prices) {
+		prices.push_back(p);
+	}
+	if (prices.size() == 0) {
+		prices.resize(params.num_assets, PriceUtils::from_double(1));
+	}
+
+	std::vector<RaceResult> tatonnement_results, racing_results;
+
+	for (size_t i = 0; i < num_trials; i++) {
+		std::string filename = experiment_root + std::to_string(i+1) + ".txs";
+		ExperimentBlock trial;
+		if (load_xdr_from_file(trial, filename.c_str())) {
+			std::printf("filename was %s\n", filename.c_str());
+			throw std::runtime_error("failed to load trial data file");
+		}
+		if (trial.size() < num_txs) {
+			throw std::runtime_error("not enough txs!");
+		}
+
+		manager.clear_();
+		setup.load_synthetic_txs(trial, num_txs);
+
+		tatonnement_results.push_back(run_one(tatonnement_only, prices, approx_params, 5000));
+		racing_results.push_back(run_one(racing, prices, approx_params, 5000));
+
+		std::printf("trial %lu: tatonnement %lf s (%u rounds), race %lf s (%u %s)\n",
+			i + 1,
+			tatonnement_results.back().runtime,
+			tatonnement_results.back().num_rounds,
+			racing_results.back().runtime,
+			racing_results.back().num_rounds,
+			racing_results.back().convex_solver_won ? "newton steps, convex solver" : "rounds, tatonnement");
+	}
+
+	std::printf("%s: %lu txs tax_rate %u smooth_mult %u\n", std::string(config.name).c_str(), num_txs, tax_rate, smooth_mult);
+	print_summary("tatonnement only", tatonnement_results);
+	print_summary("convex race", racing_results);
+}
+
+int main(int argc, char const *argv[])
+{
+	if (argc != 3 && argc != 6) {
+		std::printf("usage: ./convex_race_benchmark <data_directory> <num_txs> <tax_rate=10 smooth_mult=10 num_trials=5>\n");
+		return -1;
+	}
+
+	std::string experiment_root = std::string(argv[1]);
+	size_t num_txs = std::stoull(argv[2]);
+
+	uint8_t tax_rate = 10, smooth_mult = 10;
+	size_t num_trials = 5;
+	if (argc == 6) {
+		tax_rate = std::stoi(argv[3]);
+		smooth_mult = std::stoi(argv[4]);
+		num_trials = std::stoull(argv[5]);
+	}
+
+	ExperimentConfigList list;
+
+	std::string config_list_file = experiment_root + "experiments_list";
+
+	if (load_xdr_from_file(list, config_list_file.c_str())) {
+		throw std::runtime_error("failed to load experiment list");
+	}
+
+	for (auto& experiment_config : list) {
+		std::string data_root = experiment_root + std::string(experiment_config.name) + "/";
+		run_dataset(data_root, experiment_config, num_txs, tax_rate, smooth_mult, num_trials);
+	}
+	return 0;
+}
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "price_utils.h"
+#include "work_unit_metadata.h"
+#include "merkle_work_unit_helpers.h"
+
+#include "xdr/types.h"
+
+namespace edce {
+
+/*
+Precomputed reciprocal of a 64-bit divisor (Moller and Granlund, "Improved division by invariant integers").
+Division by it takes two 64x64 multiplications per quotient word, instead of a call to the generic
+128-bit divide.  Quotients and remainders are exactly those of / and %.
+*/
+class DivisorReciprocal {
+	uint64_t normalized_divisor;
+	uint64_t reciprocal;
+	uint8_t shift;
+
+	//(high:low) / normalized_divisor, for high < normalized_divisor.
+	std::pair<uint64_t, uint64_t> div_2by1(uint64_t high, uint64_t low) const {
+		uint128_t q = ((uint128_t) reciprocal) * high + ((((uint128_t) high) << 64) | low);
+		uint64_t q1 = ((uint64_t) (q >> 64)) + 1;
+		uint64_t q0 = (uint64_t) q;
+		uint64_t r = low - q1 * normalized_divisor;
+		//branchless, since this is taken about half the time
+		uint64_t mask = -((uint64_t) (r > q0));
+		q1 += mask;
+		r += mask & normalized_divisor;
+		if (__builtin_expect(r >= normalized_divisor, 0)) {
+			q1++;
+			r -= normalized_divisor;
+		}
+		return {q1, r};
+	}
+
+public:
+
+	DivisorReciprocal()
+		: DivisorReciprocal(1) {}
+
+	explicit DivisorReciprocal(uint64_t divisor) {
+		if (divisor == 0) {
+			throw std::runtime_error("DivisorReciprocal of 0");
+		}
+		shift = __builtin_clzll(divisor);
+		normalized_divisor = divisor << shift;
+		reciprocal = (uint64_t) (((((uint128_t) ~normalized_divisor) << 64) | UINT64_MAX) / normalized_divisor);
+	}
+
+	uint64_t get_divisor() const {
+		return normalized_divisor >> shift;
+	}
+
+	uint128_t divide(uint128_t value, uint64_t& remainder) const {
+		if (((uint64_t) (value >> 64)) < get_divisor()) {
+			//quotient fits in 64 bits (the common case in demand queries), so one step suffices
+			auto [q, r] = div_2by1(value >> (64 - shift), value << shift);
+			remainder = r >> shift;
+			return q;
+		}
+		uint64_t n2, n1, n0;
+		if (shift == 0) {
+			n2 = 0;
+			n1 = value >> 64;
+			n0 = value;
+		} else {
+			n2 = value >> (128 - shift);
+			n1 = value >> (64 - shift);
+			n0 = value << shift;
+		}
+		auto [q1, r1] = div_2by1(n2, n1);
+		auto [q0, r0] = div_2by1(r1, n0);
+		remainder = r0 >> shift;
+		return (((uint128_t) q1) << 64) | q0;
+	}
+};
+
+/*
+Prices of one demand query, with the reciprocal of every price.
+A Tatonnement round queries every work unit at the same prices, and every price is a divisor
+in the demand computation of 2 * (num_assets - 1) work units, so the reciprocals are computed once per round.
+*/
+class DemandQueryPrices {
+	const Price* prices = nullptr;
+	std::vector<DivisorReciprocal> reciprocals;
+
+public:
+
+	void set(const Price* prices_, size_t num_assets) {
+		prices = prices_;
+		reciprocals.resize(num_assets);
+		for (size_t i = 0; i < num_assets; i++) {
+			reciprocals[i] = DivisorReciprocal(prices[i]);
+		}
+	}
+
+	const Price* get_prices() const {
+		return prices;
+	}
+
+	Price price(size_t asset) const {
+		return prices[asset];
+	}
+
+	const DivisorReciprocal& reciprocal(size_t asset) const {
+		return reciprocals[asset];
+	}
+};
+
+/*
+Demand and supply computation of one work unit, with the price radix and smooth_mult as compile-time constants.
+Gives exactly the same results as MerkleWorkUnit::calculate_demands_and_supplies.
+*/
+template<uint8_t RADIX>
+struct FixedPointDemandKernel {
+
+	static_assert(RADIX < 64, "execution price must fit in a Price");
+
+	//value * a / b, rounded as in PriceUtils::wide_multiply_val_by_a_over_b
+	static uint128_t wide_multiply_val_by_a_over_b(const uint128_t value, const Price a, const DivisorReciprocal& b) {
+		uint64_t remainder;
+		uint128_t quotient = b.divide(value, remainder);
+		uint64_t unused;
+		return quotient * a + b.divide(((uint128_t) remainder) * a, unused);
+	}
+
+	template<uint8_t SMOOTH_MULT>
+	static std::pair<Price, Price> execution_prices(const Price sell_price, const DivisorReciprocal& buy_price) {
+		uint64_t unused;
+		uint128_t ratio = buy_price.divide(((uint128_t) sell_price) << 64, unused);
+		Price upper_bound_price = (ratio >> (64 - RADIX)) & UINT64_MAX;
+		Price lower_bound_price = upper_bound_price;
+		if constexpr (SMOOTH_MULT > 0) {
+			lower_bound_price = upper_bound_price - (upper_bound_price >> SMOOTH_MULT);
+		}
+		return std::make_pair(lower_bound_price, upper_bound_price);
+	}
+
+	//WorkUnitT needs get_metadata(Price) and get_category()
+	template<uint8_t SMOOTH_MULT, typename WorkUnitT>
+	static void calculate_demands_and_supplies(
+		const WorkUnitT& work_unit,
+		const DemandQueryPrices& prices,
+		uint128_t* demands_workspace,
+		uint128_t* supplies_workspace) {
+
+		auto category = work_unit.get_category();
+
+		const Price sell_price = prices.price(category.sellAsset);
+		const Price buy_price = prices.price(category.buyAsset);
+		const auto& sell_reciprocal = prices.reciprocal(category.sellAsset);
+		const auto& buy_reciprocal = prices.reciprocal(category.buyAsset);
+
+		auto [full_exec_p, partial_exec_p] = execution_prices<SMOOTH_MULT>(sell_price, buy_reciprocal);
+
+		EndowAccumulator metadata_partial = work_unit.get_metadata(partial_exec_p);
+		EndowAccumulator metadata_full = metadata_partial;
+		if constexpr (SMOOTH_MULT > 0) {
+			metadata_full = work_unit.get_metadata(full_exec_p);
+		}
+
+		uint64_t full_exec_endow = metadata_full.endow;
+		uint64_t partial_exec_endow = metadata_partial.endow - full_exec_endow; //radix:0
+
+		if (metadata_full.endow_times_price > metadata_partial.endow_times_price) {
+			throw std::runtime_error("This should absolutely never happen, and means indexed_metadata or binary search is broken (or maybe an overflow)");
+		}
+		uint128_t partial_exec_endow_times_price = metadata_partial.endow_times_price - metadata_full.endow_times_price; //radix:RADIX
+
+		uint128_t partial_sell_volume = 0; //radix:RADIX
+		uint128_t partial_buy_volume = 0; //radix:RADIX
+
+		if constexpr (SMOOTH_MULT > 0) {
+			//shifted as a uint64_t, exactly as in MerkleWorkUnit::calculate_demands_and_supplies
+			uint128_t endow_over_epsilon = partial_exec_endow << SMOOTH_MULT; //radix:0
+			uint128_t endow_times_price_over_epsilon = partial_exec_endow_times_price << SMOOTH_MULT; //radix:RADIX
+
+			uint128_t sell_wide_multiply_result = wide_multiply_val_by_a_over_b(endow_times_price_over_epsilon, buy_price, sell_reciprocal);
+			if ((endow_over_epsilon << RADIX) < sell_wide_multiply_result) {
+				throw std::runtime_error("this should not happen unless something has begun to overflow");
+			}
+			partial_sell_volume = (endow_over_epsilon << RADIX) - sell_wide_multiply_result;
+
+			uint128_t buy_wide_multiply_result = wide_multiply_val_by_a_over_b(endow_over_epsilon << RADIX, sell_price, buy_reciprocal);
+			if (buy_wide_multiply_result < endow_times_price_over_epsilon) {
+				throw std::runtime_error("this should not happen unless something has begun to overflow");
+			}
+			partial_buy_volume = buy_wide_multiply_result - endow_times_price_over_epsilon;
+		}
+
+		uint128_t full_sell_volume = partial_sell_volume + (((uint128_t) full_exec_endow) << RADIX);
+		uint128_t full_buy_volume = partial_buy_volume
+			+ wide_multiply_val_by_a_over_b(((uint128_t) full_exec_endow) << RADIX, sell_price, buy_reciprocal);
+
+		demands_workspace[category.buyAsset] += full_buy_volume;
+		supplies_workspace[category.sellAsset] += full_sell_volume;
+	}
+};
+
+/*
+Runtime dispatch from smooth_mult to the kernel specialized for it.
+smooth_mult values of MAX_SPECIALIZED_SMOOTH_MULT or more have no specialization (get() returns nullptr).
+*/
+template<typename WorkUnitT, uint8_t RADIX = PriceUtils::PRICE_RADIX>
+class DemandKernelDispatch {
+
+public:
+	constexpr static uint8_t MAX_SPECIALIZED_SMOOTH_MULT = 32;
+
+	using KernelFn = void (*)(const WorkUnitT&, const DemandQueryPrices&, uint128_t*, uint128_t*);
+
+private:
+	template<size_t... SMOOTH_MULTS>
+	constexpr static std::array<KernelFn, sizeof...(SMOOTH_MULTS)> make_table(std::index_sequence<SMOOTH_MULTS...>) {
+		return {&FixedPointDemandKernel<RADIX>::template calculate_demands_and_supplies<SMOOTH_MULTS, WorkUnitT>...};
+	}
+
+public:
+
+	static KernelFn get(uint8_t smooth_mult) {
+		constexpr static auto table = make_table(std::make_index_sequence<MAX_SPECIALIZED_SMOOTH_MULT>{});
+
+		if (smooth_mult >= MAX_SPECIALIZED_SMOOTH_MULT) {
+			return nullptr;
+		}
+		return table[smooth_mult];
+	}
+};
+
+} /* edce */
@@ -0,0 +1,116 @@
+#include "merkle_work_unit_manager.h"
+#include "simple_synthetic_data_generator.h"
+#include "demand_kernel.h"
+#include "price_utils.h"
+#include "utils.h"
+
+#include <x86intrin.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+Cycles per work unit demand query, through MerkleWorkUnit::calculate_demands_and_supplies
+with raw prices (128-bit divisions) and through the FixedPointDemandKernel
+(per-round reciprocals, compile-time smooth_mult).  Checks that both give the same results.
+*/
+
+using namespace edce;
+
+static double median(std::vector<double> samples) {
+	std::sort(samples.begin(), samples.end());
+	return samples[samples.size() / 2];
+}
+
+int main(int argc, char const *argv[])
+{
+	if (argc > 5) {
+		std::printf("usage: ./demand_kernel_benchmark <num_assets=20> <num_offers=1000000> <smooth_mult=10> <num_trials=2000>\n");
+		return 1;
+	}
+
+	int num_assets = (argc > 1) ? std::stoi(argv[1]) : 20;
+	int num_offers = (argc > 2) ? std::stoi(argv[2]) : 1'000'000;
+	uint8_t smooth_mult = (argc > 3) ? std::stoi(argv[3]) : 10;
+	int num_trials = (argc > 4) ? std::stoi(argv[4]) : 2000;
+
+	std::minstd_rand gen(0);
+	std::uniform_real_distribution<> price_dist(0.01, 1000.0);
+
+	std::vector<Price> underlying_prices;
+	for (int i = 0; i < num_assets; i++) {
+		underlying_prices.push_back(PriceUtils::from_double(price_dist(gen)));
+	}
+
+	SimpleSyntheticDataGenerator data_gen(num_assets);
+	auto offers = data_gen.normal_underlying_prices_sell(num_offers, underlying_prices, 1, 10000, 0.01, 1000);
+
+	MerkleWorkUnitManager manager(num_assets);
+	{
+		ProcessingSerialManager serial(manager);
+		int unused = 0;
+		for (auto& offer : offers) {
+			serial.add_offer(manager.look_up_idx(offer.category), offer, unused, unused);
+		}
+		serial.finish_merge();
+	}
+	manager.commit_for_production(1);
+
+	auto& work_units = manager.get_work_units();
+
+	std::vector<std::vector<Price>> trial_prices;
+	for (int i = 0; i < num_trials; i++) {
+		std::vector<Price> prices;
+		for (int j = 0; j < num_assets; j++) {
+			//near the underlying prices, as in late Tatonnement rounds
+			double noise = std::uniform_real_distribution<>(0.8, 1.2)(gen);
+			prices.push_back(PriceUtils::impose_bounds((uint128_t) (underlying_prices[j] * noise)));
+		}
+		trial_prices.push_back(prices);
+	}
+
+	std::vector<uint128_t> demands(num_assets), supplies(num_assets);
+	std::vector<uint128_t> kernel_demands(num_assets), kernel_supplies(num_assets);
+
+	std::vector<double> generic_cycles, kernel_cycles;
+
+	DemandQueryPrices query_prices;
+
+	for (int trial = 0; trial < num_trials; trial++) {
+		std::fill(demands.begin(), demands.end(), 0);
+		std::fill(supplies.begin(), supplies.end(), 0);
+		std::fill(kernel_demands.begin(), kernel_demands.end(), 0);
+		std::fill(kernel_supplies.begin(), kernel_supplies.end(), 0);
+
+		auto* prices = trial_prices[trial].data();
+
+		uint64_t start = __rdtsc();
+		for (auto& work_unit : work_units) {
+			work_unit.calculate_demands_and_supplies(prices, demands.data(), supplies.data(), smooth_mult);
+		}
+		uint64_t generic_end = __rdtsc();
+
+		//includes computing the reciprocals
+		query_prices.set(prices, num_assets);
+		for (auto& work_unit : work_units) {
+			work_unit.calculate_demands_and_supplies(query_prices, kernel_demands.data(), kernel_supplies.data(), smooth_mult);
+		}
+		uint64_t kernel_end = __rdtsc();
+
+		generic_cycles.push_back(((double) (generic_end - start)) / work_units.size());
+		kernel_cycles.push_back(((double) (kernel_end - generic_end)) / work_units.size());
+
+		if (demands != kernel_demands || supplies != kernel_supplies) {
+			throw std::runtime_error("demand kernel mismatch");
+		}
+	}
+
+	std::printf("num_assets %d num_offers %d smooth_mult %u total nnz %lu\n", num_assets, num_offers, smooth_mult, manager.get_total_nnz());
+	std::printf("cycles per work unit query: generic median %lf, kernel median %lf (speedup %lf)\n",
+		median(generic_cycles), median(kernel_cycles), median(generic_cycles) / median(kernel_cycles));
+	return 0;
+}
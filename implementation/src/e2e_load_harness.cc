@@ -0,0 +1,374 @@
+#include "synthetic_data_generator/synthetic_data_gen.h"
+
+#include "xdr/consensus_api.h"
+#include "xdr/experiments.h"
+#include "xdr/transaction_submission_api.h"
+#include "rpc/rpcconfig.h"
+
+#include "tx_type_utils.h"
+#include "utils.h"
+
+#include <xdrpp/marshal.h>
+#include <xdrpp/srpc.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace edce;
+
+/*
+Closed-loop end-to-end load harness, for a producer and validators running on one host
+(run_local_cluster.sh starts them, each listening on its own loopback address).
+
+Node 0 (the producer) is at 127.0.0.1, validator i at 127.0.0.(i+2).  The harness waits for every node,
+connects the validators to the producer, starts production, and then runs num_clients closed-loop clients.
+
+Each client owns accounts_per_client accounts of the experiment's account list, and keeps
+at most one payment outstanding per account: an account sends its next tx only once the previous one
+is confirmed (in a block acked by a validator, or produced, if there are no validators), or has timed out.
+So the offered load is set by the number of accounts, not by a target rate.
+
+Confirmation is observed by polling the producer's get_submission_status.  A latency sample is
+an upper bound on submission to confirmation, by at most a poll interval (and, if the tx's
+sequence number is seen committed while its block is still in production, one block).
+
+Txs submitted in the first warmup_seconds are not measured.
+Reports latency percentiles and sustained confirmed tx/s, and writes them to <output_dir>/e2e_results.json.
+*/
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr static std::chrono::milliseconds POLL_INTERVAL(5);
+constexpr static std::chrono::seconds TX_TIMEOUT(20);
+//how long clients wait for outstanding txs after the measurement window
+constexpr static std::chrono::seconds DRAIN_TIME(10);
+
+std::string node_address(int idx) {
+	return std::string("127.0.0.") + std::to_string(idx + 1);
+}
+
+void send_control_signal(int idx) {
+	auto fd = xdr::tcp_connect(node_address(idx).c_str(), SERVER_CONTROL_PORT);
+	auto client = xdr::srpc_client<ExperimentControlV1>(fd.get());
+	client.signal_start();
+}
+
+bool node_is_ready(int idx) {
+	try {
+		auto fd = xdr::tcp_connect(node_address(idx).c_str(), SERVER_CONTROL_PORT);
+		auto client = xdr::srpc_client<ExperimentControlV1>(fd.get());
+		auto res = client.is_ready_to_start();
+		return res && (*res == 1);
+	} catch(...) {
+		return false;
+	}
+}
+
+void wait_for_all_nodes_ready(int num_nodes) {
+	for (int i = 0; i < num_nodes; i++) {
+		while (!node_is_ready(i)) {
+			std::printf("waiting for node %d (%s)\n", i, node_address(i).c_str());
+			std::this_thread::sleep_for(std::chrono::seconds(1));
+		}
+		std::printf("node %d online\n", i);
+	}
+}
+
+//waits until the node finishes, then saves its measurements and signals it to shut down
+void finish_node(int idx, const std::string& output_root) {
+	auto fd = xdr::tcp_connect(node_address(idx).c_str(), SERVER_CONTROL_PORT);
+	auto client = xdr::srpc_client<ExperimentControlV1>(fd.get());
+	while (*client.is_running() != 0) {
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+	}
+	auto measurements = client.get_measurements();
+	auto filename = output_root + std::to_string(idx) + "_measurements";
+	if (save_xdr_to_file(*measurements, filename.c_str())) {
+		std::printf("was unable to save file to %s\n", filename.c_str());
+	}
+	client.signal_start();
+}
+
+struct ClientResults {
+	std::vector<double> latencies;
+	uint64_t num_submitted = 0;
+	uint64_t num_confirmed_in_window = 0;
+	uint64_t num_rejected = 0;
+	uint64_t num_timed_out = 0;
+};
+
+class ClosedLoopClient {
+
+	struct AccountState {
+		//sequence number of the next tx.  0 means resync from the committed sequence number.
+		uint64_t next_seq_num = 0;
+		bool outstanding = false;
+		uint64_t seq_num = 0;
+		clock_type::time_point submit_time;
+		//set once the tx's sequence number is committed
+		uint64_t max_block_number = 0;
+	};
+
+	SubmissionStatusQuery accounts;
+	std::vector<AccountState> states;
+	const uint32_t num_assets;
+
+	SyntheticDataGenSigner signer;
+	std::minstd_rand gen;
+
+	SignedTransaction make_payment(size_t sender_idx) {
+		std::uniform_int_distribution<size_t> receiver_dist(0, accounts.size() - 1);
+		std::uniform_int_distribution<AssetID> asset_dist(0, num_assets - 1);
+
+		PaymentOp op;
+		op.receiver = accounts[receiver_dist(gen)];
+		op.asset = asset_dist(gen);
+		op.amount = 1;
+
+		SignedTransaction tx;
+		tx.transaction.metadata.sourceAccount = accounts[sender_idx];
+		tx.transaction.metadata.sequenceNumber = states[sender_idx].next_seq_num;
+		tx.transaction.operations.push_back(TxTypeUtils::make_operation(op));
+		return tx;
+	}
+
+public:
+
+	ClosedLoopClient(const AccountIDList& all_accounts, size_t first, size_t num, uint32_t num_assets, uint32_t seed)
+		: accounts()
+		, states(num)
+		, num_assets(num_assets)
+		, signer()
+		, gen(seed) {
+			accounts.insert(accounts.end(), all_accounts.begin() + first, all_accounts.begin() + first + num);
+			for (auto account : accounts) {
+				signer.add_account(account);
+			}
+		}
+
+	ClientResults run(clock_type::time_point measure_start, clock_type::time_point end);
+};
+
+ClientResults
+ClosedLoopClient::run(clock_type::time_point measure_start, clock_type::time_point end) {
+	ClientResults results;
+
+	auto fd = xdr::tcp_connect(node_address(0).c_str(), TRANSACTION_SUBMISSION_PORT);
+	xdr::srpc_client<SubmitTransactionV1> client{fd.get()};
+
+	auto status = client.get_submission_status(accounts);
+
+	std::vector<size_t> batch_idxs;
+
+	while (true) {
+		auto now = clock_type::now();
+		bool submitting = now < end;
+
+		size_t num_outstanding = 0;
+		for (auto& state : states) {
+			num_outstanding += state.outstanding ? 1 : 0;
+		}
+		if (!submitting && (num_outstanding == 0 || now > end + DRAIN_TIME)) {
+			break;
+		}
+
+		if (submitting) {
+			//same wire format as SignedTransactionList
+			ExperimentBlock batch;
+			batch_idxs.clear();
+			for (size_t i = 0; i < states.size(); i++) {
+				auto& state = states[i];
+				if (state.outstanding) {
+					continue;
+				}
+				if (state.next_seq_num == 0) {
+					state.next_seq_num = status->committed_sequence_numbers.at(i) + MAX_OPS_PER_TX;
+				}
+				batch.push_back(make_payment(i));
+				batch_idxs.push_back(i);
+			}
+
+			if (batch.size() > 0) {
+				signer.sign_block(batch);
+				auto submit_time = clock_type::now();
+				auto res = client.submit_transaction_batch(xdr::xdr_to_opaque(batch));
+				results.num_submitted += batch.size();
+
+				for (size_t j = 0; j < batch_idxs.size(); j++) {
+					auto& state = states[batch_idxs[j]];
+					if (j < res->results.size() && res->results[j] == TransactionProcessingStatus::SUCCESS) {
+						state.outstanding = true;
+						state.seq_num = state.next_seq_num;
+						state.submit_time = submit_time;
+						state.max_block_number = 0;
+					} else {
+						results.num_rejected++;
+						state.next_seq_num = 0;
+					}
+				}
+			}
+		}
+
+		std::this_thread::sleep_for(POLL_INTERVAL);
+
+		status = client.get_submission_status(accounts);
+		now = clock_type::now();
+
+		for (size_t i = 0; i < states.size(); i++) {
+			auto& state = states[i];
+			if (!state.outstanding) {
+				continue;
+			}
+			uint64_t committed = status->committed_sequence_numbers.at(i);
+			if (committed >= state.seq_num && state.max_block_number == 0) {
+				state.max_block_number = status->highest_produced_block + 1;
+			}
+
+			if (state.max_block_number != 0 && status->highest_confirmed_block >= state.max_block_number) {
+				state.outstanding = false;
+				state.next_seq_num = state.seq_num + MAX_OPS_PER_TX;
+				if (state.submit_time >= measure_start) {
+					results.latencies.push_back(std::chrono::duration<double>(now - state.submit_time).count());
+				}
+				if (now >= measure_start && now < end) {
+					results.num_confirmed_in_window++;
+				}
+			} else if (now - state.submit_time > TX_TIMEOUT) {
+				//i.e. the tx failed in its block
+				state.outstanding = false;
+				state.next_seq_num = 0;
+				results.num_timed_out++;
+			}
+		}
+	}
+	return results;
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+	if (sorted.size() == 0) {
+		return 0;
+	}
+	return sorted[std::min<size_t>(sorted.size() - 1, sorted.size() * p)];
+}
+
+int main(int argc, char const *argv[])
+{
+	if (argc != 7 && argc != 8) {
+		std::printf("usage: ./e2e_load_harness <data_directory> <output_directory> <num_validators> <num_clients> <accounts_per_client> <measure_seconds> <optional: warmup_seconds>\n");
+		std::printf("the producer must be run with submission_only_seconds >= warmup_seconds + measure_seconds\n");
+		return -1;
+	}
+
+	std::string experiment_data_root = std::string(argv[1]) + "/";
+	std::string output_root = std::string(argv[2]) + "/";
+	int num_validators = std::stoi(argv[3]);
+	size_t num_clients = std::stoul(argv[4]);
+	size_t accounts_per_client = std::stoul(argv[5]);
+	uint32_t measure_seconds = std::stoul(argv[6]);
+	uint32_t warmup_seconds = (argc == 8) ? std::stoul(argv[7]) : 5;
+
+	ExperimentParameters params;
+	auto params_filename = experiment_data_root + "params";
+	if (load_xdr_from_file(params, params_filename.c_str())) {
+		throw std::runtime_error("failed to load experiment params file");
+	}
+
+	AccountIDList account_list;
+	auto accounts_filename = experiment_data_root + "accounts";
+	if (load_xdr_from_file(account_list, accounts_filename.c_str())) {
+		throw std::runtime_error("failed to load experiment account list");
+	}
+
+	if (num_clients * accounts_per_client > account_list.size()) {
+		std::printf("need %lu accounts, experiment has %lu\n", num_clients * accounts_per_client, account_list.size());
+		return -1;
+	}
+
+	if (mkdir_safe(output_root.c_str())) {
+		std::printf("directory %s already exists, continuing\n", output_root.c_str());
+	}
+
+	std::vector<std::unique_ptr<ClosedLoopClient>> clients;
+	for (size_t i = 0; i < num_clients; i++) {
+		clients.push_back(std::make_unique<ClosedLoopClient>(account_list, i * accounts_per_client, accounts_per_client, params.num_assets, i + 1));
+	}
+
+	wait_for_all_nodes_ready(num_validators + 1);
+
+	for (int i = 1; i <= num_validators; i++) {
+		send_control_signal(i);
+	}
+	//validators connect to the producer asynchronously
+	std::this_thread::sleep_for(std::chrono::seconds(1));
+	send_control_signal(0);
+
+	auto start_time = clock_type::now();
+	auto measure_start = start_time + std::chrono::seconds(warmup_seconds);
+	auto end = measure_start + std::chrono::seconds(measure_seconds);
+
+	std::vector<ClientResults> client_results(num_clients);
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < num_clients; i++) {
+		threads.emplace_back([&clients, &client_results, i, measure_start, end] {
+			client_results[i] = clients[i]->run(measure_start, end);
+		});
+	}
+	for (auto& th : threads) {
+		th.join();
+	}
+
+	ClientResults total;
+	for (auto& res : client_results) {
+		total.latencies.insert(total.latencies.end(), res.latencies.begin(), res.latencies.end());
+		total.num_submitted += res.num_submitted;
+		total.num_confirmed_in_window += res.num_confirmed_in_window;
+		total.num_rejected += res.num_rejected;
+		total.num_timed_out += res.num_timed_out;
+	}
+	std::sort(total.latencies.begin(), total.latencies.end());
+
+	double tps = ((double) total.num_confirmed_in_window) / measure_seconds;
+
+	std::printf("%lu clients x %lu accounts, %d validators, %u s measured\n", num_clients, accounts_per_client, num_validators, measure_seconds);
+	std::printf("submitted %lu txs (%lu rejected, %lu timed out)\n", total.num_submitted, total.num_rejected, total.num_timed_out);
+	std::printf("sustained rate: %lf confirmed txs/s\n", tps);
+	std::printf("confirmation latency (s): p50 %lf p90 %lf p99 %lf p999 %lf max %lf (%lu samples)\n",
+		percentile(total.latencies, 0.5),
+		percentile(total.latencies, 0.9),
+		percentile(total.latencies, 0.99),
+		percentile(total.latencies, 0.999),
+		total.latencies.size() ? total.latencies.back() : 0.0,
+		total.latencies.size());
+
+	auto results_filename = output_root + "e2e_results.json";
+	std::FILE* f = std::fopen(results_filename.c_str(), "w");
+	if (f == nullptr) {
+		std::printf("could not open %s\n", results_filename.c_str());
+	} else {
+		std::fprintf(f, "{\"num_validators\": %d, \"num_clients\": %lu, \"accounts_per_client\": %lu, \"measure_seconds\": %u, \"warmup_seconds\": %u,\n",
+			num_validators, num_clients, accounts_per_client, measure_seconds, warmup_seconds);
+		std::fprintf(f, " \"submitted\": %lu, \"rejected\": %lu, \"timed_out\": %lu, \"confirmed_in_window\": %lu, \"confirmed_tps\": %lf,\n",
+			total.num_submitted, total.num_rejected, total.num_timed_out, total.num_confirmed_in_window, tps);
+		std::fprintf(f, " \"latency_s\": {\"samples\": %lu, \"p50\": %lf, \"p90\": %lf, \"p99\": %lf, \"p999\": %lf, \"max\": %lf}}\n",
+			total.latencies.size(),
+			percentile(total.latencies, 0.5),
+			percentile(total.latencies, 0.9),
+			percentile(total.latencies, 0.99),
+			percentile(total.latencies, 0.999),
+			total.latencies.size() ? total.latencies.back() : 0.0);
+		std::fclose(f);
+	}
+
+	//the producer stops at its own deadline, and then the validators, once its blocks drain
+	for (int i = 0; i <= num_validators; i++) {
+		finish_node(i, output_root);
+	}
+	return 0;
+}
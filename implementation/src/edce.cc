@@ -16,6 +16,13 @@
 
 #include "header_persistence_utils.h"
 
+#include "speculative_tx_processor.h"
+
+#include "block_archive.h"
+
+#include "metrics.h"
+#include "span_tracer.h"
+
 namespace edce {
 
 /*
@@ -59,6 +66,8 @@ void edce_make_state_commitment(
 	BlockProductionHashingMeasurements& measurements,
 	const EdceOptions& options) {
 
+	TraceSpan span("edce_make_state_commitment");
+
 	//auto& db = management_structures.db;
 	//auto& work_unit_manager = management_structures.work_unit_manager;
 
@@ -91,7 +100,22 @@ void edce_make_state_commitment(
 	management_structures.account_modification_log.freeze_and_hash(hashes.modificationLogHash);
 	measurements.account_log_hash_time = measure_time(timestamp);
 
+	metrics_record(MetricsHistogram::STATE_HASHING,
+		measurements.db_state_commitment_time + measurements.work_unit_commitment_time + measurements.account_log_hash_time);
+
 	management_structures.block_header_hash_map.freeze_and_hash(hashes.blockMapHash);
+
+	if (options.multiset_state_commitment) {
+		auto timestamp = init_time_measurement();
+		management_structures.db.produce_multiset_commitment(hashes.dbMultisetHash);
+		management_structures.work_unit_manager.produce_multiset_commitment(hashes.offerMultisetHash);
+		BLOCK_INFO("multiset commitment time: %lf", measure_time(timestamp));
+	} else {
+		//the fields are always in the header (so the header format does not depend on options),
+		//but are left zeroed when the commitment is off.
+		hashes.dbMultisetHash.fill(0);
+		hashes.offerMultisetHash.fill(0);
+	}
 	//th1.join();
 	//th2.join();
 
@@ -303,6 +327,8 @@ bool edce_block_validation_logic(
 	uint64_t current_block_number = prev_block.block.blockNumber + 1;
 	BLOCK_INFO("starting block validation for block %lu", current_block_number);
 
+	TraceSpan span("edce_block_validation_logic", current_block_number);
+
 	if (current_block_number != expected_next_block.block.blockNumber) {
 		BLOCK_INFO("invalid block number");
 		return false;
@@ -370,7 +396,8 @@ bool edce_block_validation_logic(
 		commitment_checker, 
 		validation_stats,
 		stats,
-		state_update_stats); // checks db in valid state.
+		state_update_stats,
+		options.account_partitioned_validation); // checks db in valid state.
 
 	INFO_F(validation_stats.log());
 
@@ -439,6 +466,23 @@ bool edce_block_validation_logic(
 
 	stats.db_tentative_commit_time = measure_time(timestamp);
 	BLOCK_INFO("db tentative_commit_time = %lf", stats.db_tentative_commit_time);
+
+	//The multiset hashes were updated in O(state changes), so a mismatch here
+	//rejects the block before hashing the orderbook and account log tries.
+	if (options.multiset_state_commitment) {
+		management_structures.db.produce_multiset_commitment(comparison_next_block.internalHashes.dbMultisetHash);
+		management_structures.work_unit_manager.produce_multiset_commitment(comparison_next_block.internalHashes.offerMultisetHash);
+
+		if (memcmp(comparison_next_block.internalHashes.dbMultisetHash.data(), expected_next_block.block.internalHashes.dbMultisetHash.data(), 32) != 0) {
+			BLOCK_INFO("discrepancy in dbMultisetHash");
+			return false;
+		}
+		if (memcmp(comparison_next_block.internalHashes.offerMultisetHash.data(), expected_next_block.block.internalHashes.offerMultisetHash.data(), 32) != 0) {
+			BLOCK_INFO("discrepancy in offerMultisetHash");
+			return false;
+		}
+		stats.multiset_check_time = measure_time(timestamp);
+	}
 	//copy expected clearing state, except we overwrite the hashes later.
 	comparison_next_block.internalHashes.clearingDetails = expected_next_block.block.internalHashes.clearingDetails;
 	management_structures.work_unit_manager.freeze_and_hash(comparison_next_block.internalHashes.clearingDetails);
@@ -526,15 +570,19 @@ void edce_block_creation_logic(Price* price_workspace,
 	BlockCreationMeasurements& stats,
 	WorkUnitStateCommitment& work_unit_clearing_details,
 	uint8_t& fee_rate_out,
-	BlockStateUpdateStatsWrapper& state_update_stats) {
+	BlockStateUpdateStatsWrapper& state_update_stats,
+	SpeculationWorker* speculation) {
 
 	uint64_t current_block_number = prev_block_number + 1;
 
+	TraceSpan span("edce_block_creation_logic", current_block_number);
+
 	BLOCK_INFO("starting block creation");
 	management_structures.account_modification_log.prepare_block_fd(current_block_number);
 	//management_structures.account_modification_log.sanity_check();
 
 	auto timestamp = init_time_measurement();
+	TracePhases phases(current_block_number);
 
 	auto& db = management_structures.db;
 	auto& work_unit_manager = management_structures.work_unit_manager;
@@ -547,20 +595,39 @@ void edce_block_creation_logic(Price* price_workspace,
 	work_unit_manager.commit_for_production(current_block_number);
 
 	stats.initial_offer_db_commit_time = measure_time(timestamp);
+	phases.end_phase("initial_db_commit");
 
 	BLOCK_INFO("initial offerdb commit duration: %fs", stats.initial_offer_db_commit_time);
 	BLOCK_INFO("Database size:%lu", db.size());
 
+	//new accounts are now committed, and nothing until clearing modifies balances,
+	//so the next block's txs can be speculated on.
+	if (speculation != nullptr) {
+		speculation->start_speculation_window();
+	}
+
 	std::atomic<bool> tatonnement_timeout = false;
 	std::atomic<bool> cancel_timeout = false;
+	if (tatonnement.trace_recorder) {
+		tatonnement.trace_recorder->begin_block(
+			current_block_number, work_unit_manager, price_workspace, management_structures.approx_params, tatonnement.rolling_averages.formatted_rolling_avgs);
+		//not counted as price computation time
+		measure_time(timestamp);
+		phases.end_phase("price_trace_begin");
+	}
+
 	auto timeout_th = tatonnement.oracle.launch_timeout_thread(2000, tatonnement_timeout, cancel_timeout);
 
 	auto tat_res = tatonnement.oracle.compute_prices_grid_search(price_workspace, management_structures.approx_params, tatonnement.rolling_averages.formatted_rolling_avgs);
 	cancel_timeout = true;
 
 	stats.tatonnement_time = measure_time(timestamp);
+	phases.end_phase("tatonnement");
 	BLOCK_INFO("price computation took %fs", stats.tatonnement_time);
 	stats.tatonnement_rounds = tat_res.num_rounds;
+	stats.convex_solver_won = tat_res.convex_solver_won;
+	metrics_record(MetricsHistogram::TATONNEMENT, stats.tatonnement_time);
+	metrics_add(MetricsCounter::TATONNEMENT_ROUNDS, tat_res.num_rounds);
 
 	BLOCK_INFO("time per tat round:%lf microseconds", 1'000'000.0 * stats.tatonnement_time / tat_res.num_rounds);
 
@@ -570,10 +637,13 @@ void edce_block_creation_logic(Price* price_workspace,
 		price_workspace, management_structures.approx_params, use_lower_bound);
 	
 	stats.lp_time = measure_time(timestamp);
+	phases.end_phase("lp_solve");
 	BLOCK_INFO("lp solving took %fs", stats.lp_time);
+	metrics_record(MetricsHistogram::LP_SOLVE, stats.lp_time);
 
 	if (!use_lower_bound) {
 		BLOCK_INFO("tat timed out!");
+		metrics_add(MetricsCounter::TATONNEMENT_TIMEOUTS);
 	}
 
 	constexpr bool rerun_tatonnement = true;
@@ -609,6 +679,7 @@ void edce_block_creation_logic(Price* price_workspace,
 
 		BLOCK_INFO("long run Tat vol metric: %lf", vol_metric);
 		BLOCK_INFO("done rerunning");
+		phases.end_phase("tatonnement_rerun");
 	}
 
 	//TODO could be removed later.  Good rn as a sanititimeouttheck.
@@ -616,6 +687,7 @@ void edce_block_creation_logic(Price* price_workspace,
 		lp_results, price_workspace, options.num_assets);
 
 	stats.clearing_check_time = measure_time(timestamp);
+	phases.end_phase("clearing_check");
 	BLOCK_INFO("clearing sanity check took %fs", stats.clearing_check_time);
 
 	double vol_metric = WorkUnitManagerUtils::get_weighted_price_asymmetry_metric(
@@ -643,18 +715,27 @@ void edce_block_creation_logic(Price* price_workspace,
 		lp_results, price_workspace, db, management_structures.account_modification_log, work_unit_clearing_details, state_update_stats);
 
 	stats.offer_clearing_time = measure_time(timestamp);
+	phases.end_phase("offer_clearing");
 	BLOCK_INFO("clearing offers took %fs", stats.offer_clearing_time);
+	metrics_record(MetricsHistogram::OFFER_CLEARING, stats.offer_clearing_time);
+
+	//speculation reads account balances, which is not threadsafe with commit_values
+	if (speculation != nullptr) {
+		speculation->end_speculation_window();
+	}
 
 	if (!db.check_valid_state(management_structures.account_modification_log)) {
 		throw std::runtime_error("DB left in invalid state!!!");
 	}
 
 	stats.db_validity_check_time = measure_time(timestamp);
+	phases.end_phase("db_validity_check");
 	BLOCK_INFO("db validity check took %fs", stats.db_validity_check_time);
 
 	db.commit_values(management_structures.account_modification_log);
 
 	stats.final_commit_time = measure_time(timestamp);
+	phases.end_phase("final_commit");
 	BLOCK_INFO("final commit took %fs", stats.final_commit_time);
 	BLOCK_INFO("finished block creation");
 
@@ -671,6 +752,10 @@ void edce_block_creation_logic(Price* price_workspace,
 		//throw std::runtime_error("can't have successful tat run but invalid smooth mult!");
 	}
 
+	if (tatonnement.trace_recorder) {
+		tatonnement.trace_recorder->finish_block(price_workspace, tat_res, stats);
+	}
+
 	tatonnement.oracle.wait_for_all_tatonnement_threads();
 	timeout_th.join();
 }
@@ -761,6 +846,8 @@ edce_persist_critical_round_data(
 	bool get_block,
 	uint64_t log_offset) {
 
+	TraceSpan span("edce_persist_critical_round_data", header.block.blockNumber);
+
 	auto timestamp = init_time_measurement();
 
 	save_header(header);
@@ -789,12 +876,18 @@ void edce_persist_async(
 	BlockDataPersistenceMeasurements& measurements) {
 
 	//auto current_block_number = header.block.blockNumber;
+	TraceSpan span("edce_persist_async", current_block_number);
 	BLOCK_INFO("starting async persistence");
 	auto timestamp = init_time_measurement();
 
+	//the account db must never get ahead of the account log on disk
+	management_structures.account_modification_log.wait_for_persisted_block();
+	BLOCK_INFO("done async account log write");
+
 	management_structures.db.commit_persistence_thunks(current_block_number);
 	BLOCK_INFO("done async db persistence\n");
 	measurements.account_db_checkpoint_finish_time = measure_time(timestamp);
+	metrics_record(MetricsHistogram::ACCOUNT_LMDB_COMMIT, measurements.account_db_checkpoint_finish_time);
 
 /*
 	management_structures.work_unit_manager.persist_lmdb(current_block_number);
@@ -813,6 +906,7 @@ edce_persist_async_phase2(
 	uint64_t current_block_number,
 	BlockDataPersistenceMeasurements& measurements) {
 
+	TraceSpan span("edce_persist_async_phase2", current_block_number);
 	BLOCK_INFO("starting async persistence phase 2");
 	auto timestamp = init_time_measurement();
 //	std::thread th([&management_structures] () {
@@ -831,16 +925,19 @@ edce_persist_async_phase3(
 	uint64_t current_block_number,
 	BlockDataPersistenceMeasurements& measurements) {
 
+	TraceSpan span("edce_persist_async_phase3", current_block_number);
 	BLOCK_INFO("starting async persistence phase 3");
 	auto timestamp = init_time_measurement();
 
 	management_structures.work_unit_manager.persist_lmdb(current_block_number);
 	BLOCK_INFO("done async offer persistence\n");
 	measurements.offer_checkpoint_time = measure_time(timestamp);
+	metrics_record(MetricsHistogram::OFFER_LMDB_COMMIT, measurements.offer_checkpoint_time);
 
 	management_structures.block_header_hash_map.persist_lmdb(current_block_number);
 
 	measurements.block_hash_map_checkpoint_time = measure_time(timestamp);
+	metrics_record(MetricsHistogram::HEADER_LMDB_COMMIT, measurements.block_hash_map_checkpoint_time);
 	BLOCK_INFO("done async total persistence\n");
 }
 
@@ -910,8 +1007,21 @@ uint64_t edce_load_persisted_data(
 
 	std::printf("replaying rounds [%lu, %lu]\n", start_round, end_round);
 
+	//There is no block number 0.
+	ReplayBlockLoader block_loader;
+	if (start_round != 0) {
+		block_loader.prefetch(start_round);
+	}
+
 	for (auto i = start_round; i <= end_round; i++) {
-		edce_replay_trusted_round(management_structures, i);
+		AccountModificationBlock tx_block;
+		if (i != 0) {
+			block_loader.get(i, tx_block);
+		}
+		if (i < end_round) {
+			block_loader.prefetch(i + 1);
+		}
+		edce_replay_trusted_round(management_structures, i, tx_block);
 	}
 	management_structures.db.commit_values();
 	return end_round;
@@ -926,14 +1036,24 @@ void edce_replay_trusted_round(
 		return;
 	}
 
-	auto header = load_header(round_number);
 	AccountModificationBlock tx_block;
-	auto block_filename = tx_block_name(round_number);
-	auto res = load_xdr_from_file(tx_block, block_filename.c_str());
+	std::unique_ptr<BlockArchiveReader> archive;
+	auto res = load_account_modification_block(round_number, tx_block, archive);
 	if (res != 0) {
-		throw std::runtime_error((std::string("can't load tx block ") + block_filename).c_str());
+		throw std::runtime_error((std::string("can't load tx block ") + tx_block_name(round_number)).c_str());
 	}
 
+	edce_replay_trusted_round(management_structures, round_number, tx_block);
+}
+
+//Applies a trusted round to the in-memory structures, without persisting anything.
+static void 
+replay_trusted_round_in_memory(
+	EdceManagementStructures& management_structures,
+	const uint64_t round_number,
+	const AccountModificationBlock& tx_block,
+	const HashedBlock& header) {
+
 	BLOCK_INFO("starting to replay transactions of round %lu", round_number);
 	replay_trusted_block(management_structures, tx_block, header);
 	if (management_structures.db.get_persisted_round_number() < round_number) {
@@ -961,6 +1081,28 @@ void edce_replay_trusted_round(
 	std::printf("creating header loading hash map\n");
 	auto header_hash_map = LoadLMDBHeaderMap(round_number, management_structures.block_header_hash_map);
 	header_hash_map.insert_for_loading(round_number, header.hash);
+}
+
+void edce_replay_trusted_round(
+	EdceManagementStructures& management_structures,
+	const uint64_t round_number,
+	const AccountModificationBlock& tx_block) {
+
+	if (round_number == 0) {
+		//There is no block number 0.
+		return;
+	}
+
+	edce_replay_trusted_round(management_structures, round_number, tx_block, load_header(round_number));
+}
+
+void edce_replay_trusted_round(
+	EdceManagementStructures& management_structures,
+	const uint64_t round_number,
+	const AccountModificationBlock& tx_block,
+	const HashedBlock& header) {
+
+	replay_trusted_round_in_memory(management_structures, round_number, tx_block, header);
 
 	if (management_structures.db.get_persisted_round_number() < round_number) {
 		management_structures.db.persist_lmdb(round_number);
@@ -971,4 +1113,143 @@ void edce_replay_trusted_round(
 	}
 }
 
+//Recomputes the db and offer commitments from scratch and compares them to the header.
+static void 
+check_catchup_checkpoint(
+	EdceManagementStructures& management_structures,
+	const HashedBlock& header) {
+
+	auto round_number = header.block.blockNumber;
+
+	management_structures.db.commit_values();
+
+	Hash db_hash;
+	management_structures.db.produce_state_commitment(db_hash);
+	if (db_hash != header.block.internalHashes.dbHash) {
+		std::printf("db hash mismatch at checkpoint %lu\n", round_number);
+		throw std::runtime_error("catchup replay db hash mismatch");
+	}
+
+	WorkUnitStateCommitment clearing_details;
+	clearing_details.resize(management_structures.work_unit_manager.get_num_work_units());
+	management_structures.work_unit_manager.freeze_and_hash(clearing_details);
+
+	if (clearing_details.size() != header.block.internalHashes.clearingDetails.size()) {
+		throw std::runtime_error("catchup replay work unit count mismatch");
+	}
+	for (size_t i = 0; i < clearing_details.size(); i++) {
+		if (clearing_details[i].rootHash != header.block.internalHashes.clearingDetails[i].rootHash) {
+			std::printf("work unit %lu hash mismatch at checkpoint %lu\n", i, round_number);
+			throw std::runtime_error("catchup replay work unit hash mismatch");
+		}
+	}
+	BLOCK_INFO("checkpoint %lu matches header", round_number);
+}
+
+CatchupReplayStats
+edce_catchup_replay(
+	EdceManagementStructures& management_structures,
+	const uint64_t end_round,
+	const uint64_t batch_size,
+	const uint64_t checkpoint_interval) {
+
+	ReplayBlockLoader block_loader;
+	bool prefetched = false;
+
+	auto block_source = [&block_loader, &prefetched, end_round] (uint64_t round, AccountModificationBlock& tx_block, HashedBlock& header) {
+		if (!prefetched) {
+			block_loader.prefetch(round);
+			prefetched = true;
+		}
+		block_loader.get(round, tx_block);
+		if (round < end_round) {
+			block_loader.prefetch(round + 1);
+		}
+		header = load_header(round);
+	};
+
+	return edce_catchup_replay(management_structures, end_round, batch_size, checkpoint_interval, block_source);
+}
+
+CatchupReplayStats
+edce_catchup_replay(
+	EdceManagementStructures& management_structures,
+	const uint64_t end_round,
+	const uint64_t batch_size,
+	const uint64_t checkpoint_interval,
+	const CatchupBlockSource& block_source) {
+
+	if (batch_size == 0) {
+		throw std::runtime_error("catchup replay batch size must be nonzero");
+	}
+
+	CatchupReplayStats stats;
+
+	auto& db = management_structures.db;
+	auto& work_unit_manager = management_structures.work_unit_manager;
+	auto& block_header_hash_map = management_structures.block_header_hash_map;
+
+	//after edce_load_persisted_data, everything is persisted through at least this round
+	auto start_round = std::min({
+		db.get_persisted_round_number(), 
+		work_unit_manager.get_min_persisted_round_number(), 
+		block_header_hash_map.get_persisted_round_number()}) + 1;
+
+	std::printf("catchup replay of rounds [%lu, %lu] in batches of %lu\n", start_round, end_round, batch_size);
+
+	auto total_timestamp = init_time_measurement();
+	auto timestamp = init_time_measurement();
+
+	for (auto batch_start = start_round; batch_start <= end_round; batch_start += batch_size) {
+		auto batch_end = std::min(end_round, batch_start + batch_size - 1);
+
+		measure_time(timestamp);
+
+		for (auto round = batch_start; round <= batch_end; round++) {
+			AccountModificationBlock tx_block;
+			HashedBlock header;
+			block_source(round, tx_block, header);
+			if (header.block.blockNumber != round) {
+				throw std::runtime_error("catchup replay loaded wrong header");
+			}
+
+			replay_trusted_round_in_memory(management_structures, round, tx_block, header);
+
+			//replayed blocks are already on disk, so don't let the log grow across the whole catchup.
+			management_structures.account_modification_log.detached_clear();
+
+			stats.num_blocks++;
+
+			if (checkpoint_interval != 0 && round % checkpoint_interval == 0) {
+				stats.replay_time += measure_time(timestamp);
+				check_catchup_checkpoint(management_structures, header);
+				stats.checkpoint_time += measure_time(timestamp);
+				stats.num_checkpoints++;
+			}
+		}
+		stats.replay_time += measure_time(timestamp);
+
+		db.commit_values();
+		if (db.get_persisted_round_number() < batch_end) {
+			db.persist_lmdb(batch_end);
+		}
+		//writes every round's thunks in one transaction per work unit
+		work_unit_manager.persist_lmdb_for_loading(batch_end);
+		if (block_header_hash_map.get_persisted_round_number() < batch_end) {
+			block_header_hash_map.persist_lmdb(batch_end);
+		}
+
+		stats.persist_time += measure_time(timestamp);
+		stats.num_batches++;
+
+		BLOCK_INFO("catchup replay persisted through round %lu", batch_end);
+	}
+
+	stats.total_time = measure_time(total_timestamp);
+
+	std::printf("catchup replay: %lu blocks in %lf s (%lf blocks/s), replay %lf checkpoint %lf persist %lf\n",
+		stats.num_blocks, stats.total_time, stats.blocks_per_second(), stats.replay_time, stats.checkpoint_time, stats.persist_time);
+	return stats;
+}
+
 } /* edce */
@@ -11,6 +11,7 @@
 #include "xdr/block.h"
 #include "signature_check.h"
 #include "async_worker.h"
+#include "span_tracer.h"
 
 #include "edce_management_structures.h"
 #include "work_unit_state_commitment.h"
@@ -18,11 +19,14 @@
 
 #include <atomic>
 #include <cstdint>
+#include <functional>
 #include <mutex>
 #include <condition_variable>
 
 namespace edce {
 
+class SpeculationWorker;
+
 /*
 class Edce {
 
@@ -70,9 +74,9 @@ public:
 //		options.smooth_mult,
 //		options.tax_rate,
 //		options.num_assets),
-	tx_buffer_manager(),
-	sig_buffer_manager(),
-	block_builder_manager(),
+	tx_buffer_manager(options.tx_buffer_size),
+	sig_buffer_manager(options.tx_buffer_size),
+	block_builder_manager(options.tx_buffer_size),
 	block_builders(),
 	signature_checkers(),
 	//block_cache(),
@@ -152,7 +156,8 @@ edce_block_creation_logic(
 	BlockCreationMeasurements& stats,
 	WorkUnitStateCommitment& work_unit_clearing_details,
 	uint8_t& fee_rate_out,
-	BlockStateUpdateStatsWrapper& state_update_stats);
+	BlockStateUpdateStatsWrapper& state_update_stats,
+	SpeculationWorker* speculation = nullptr); // if given, runs during tatonnement and clearing
 
 void 
 edce_make_state_commitment(
@@ -216,6 +221,7 @@ struct EdceAsyncPersisterPhase3 : public AsyncWorker {
 
 
 	void run() {
+		span_tracer_set_thread_name("async_persist_phase3");
 		while(true) {
 			std::unique_lock lock(mtx);
 			if ((!done_flag) && (!exists_work_to_do())) {
@@ -414,6 +420,7 @@ struct EdceAsyncPersisterPhase2 : public AsyncWorker {
 	}
 
 	void run() {
+		span_tracer_set_thread_name("async_persist_phase2");
 		while(true) {
 			std::unique_lock lock(mtx);
 			if ((!done_flag) && (!exists_work_to_do())) {
@@ -489,6 +496,7 @@ struct EdceAsyncPersister {
 
 
 	void run() {
+		span_tracer_set_thread_name("async_persist");
 		while (true) {
 			std::unique_lock lock(mtx);
 			if ((!block_number_to_persist) && (!done_flag)) {
@@ -583,9 +591,67 @@ uint64_t
 edce_load_persisted_data(
 	EdceManagementStructures& management_structures);
 
+//loads the round's block from its own file or from its archive segment.
 void 
 edce_replay_trusted_round(
 	EdceManagementStructures& management_structures,
 	const uint64_t round_number);
 
+void
+edce_replay_trusted_round(
+	EdceManagementStructures& management_structures,
+	const uint64_t round_number,
+	const AccountModificationBlock& tx_block);
+
+//Replays and persists one round, with the given header instead of the one on disk.
+void
+edce_replay_trusted_round(
+	EdceManagementStructures& management_structures,
+	const uint64_t round_number,
+	const AccountModificationBlock& tx_block,
+	const HashedBlock& header);
+
+struct CatchupReplayStats {
+	uint64_t num_blocks = 0;
+	uint64_t num_batches = 0;
+	uint64_t num_checkpoints = 0;
+
+	double replay_time = 0;
+	double checkpoint_time = 0;
+	double persist_time = 0;
+	double total_time = 0;
+
+	double blocks_per_second() const {
+		return total_time > 0 ? num_blocks / total_time : 0;
+	}
+};
+
+//Loads the tx block and header of a round, for edce_catchup_replay.
+using CatchupBlockSource = std::function<void(uint64_t round, AccountModificationBlock& tx_block, HashedBlock& header)>;
+
+//Catches a lagging node up to end_round, replaying trusted blocks in batches of batch_size.
+//This batches persistence, not execution: every round is still applied to the in-memory
+//structures on its own and in order (clearing a round depends on the offers left by the
+//previous round), exactly as in the per-round path.  What is saved is the lmdb work:
+//each batch's thunks are written in one transaction per database at the end of the batch,
+//rather than one per round.
+//State commitments are recomputed (and checked against the headers) only for rounds that
+//are multiples of checkpoint_interval (0 = never).  Throws on a mismatch.
+//Expects edce_load_persisted_data to have been run first.
+//Reads blocks from disk, with the next round's block prefetched during each replay.
+CatchupReplayStats
+edce_catchup_replay(
+	EdceManagementStructures& management_structures,
+	const uint64_t end_round,
+	const uint64_t batch_size,
+	const uint64_t checkpoint_interval);
+
+CatchupReplayStats
+edce_catchup_replay(
+	EdceManagementStructures& management_structures,
+	const uint64_t end_round,
+	const uint64_t batch_size,
+	const uint64_t checkpoint_interval,
+	const CatchupBlockSource& block_source);
+
 } /* edce */
@@ -1,14 +1,20 @@
 #pragma once
 
+#include "account_partitioner.h"
 #include "memory_database.h"
 #include "merkle_work_unit_manager.h"
 #include "account_modification_log.h"
 #include "block_header_hash_map.h"
 #include "approximation_parameters.h"
+#include "verified_transaction_cache.h"
 
 #include "tatonnement_oracle.h"
 #include "lp_solver.h"
 #include "normalization_factor_average.h"
+#include "price_trace.h"
+
+#include <memory>
+#include <string>
 
 namespace edce {
 
@@ -20,6 +26,12 @@ struct EdceManagementStructures {
 	BlockHeaderHashMap block_header_hash_map;
 	ApproximationParameters approx_params;
 
+	//filled at mempool admission, consulted when checking block signatures.
+	VerifiedTransactionCache verified_tx_cache;
+
+	//used by partitioned block validation, and kept across blocks (see account_partitioner.h)
+	AccountPartitioner account_partitioner;
+
 	void create_lmdb() {
 		db.create_lmdb();
 		work_unit_manager.create_lmdb();
@@ -38,23 +50,38 @@ struct EdceManagementStructures {
 		block_header_hash_map.open_lmdb();
 	}
 
+	//Call before loading from lmdb, so that the accumulators cover the loaded state.
+	void enable_multiset_state_commitment() {
+		db.enable_multiset_commitment();
+		work_unit_manager.enable_multiset_commitment();
+	}
+
 	EdceManagementStructures(uint16_t num_assets, ApproximationParameters approx_params)
 		: db()
 		, work_unit_manager(num_assets)
 		, account_modification_log()
 		, block_header_hash_map()
-		, approx_params(approx_params) {}
+		, approx_params(approx_params)
+		, verified_tx_cache()
+		, account_partitioner(db) {}
 };
 
 struct TatonnementManagementStructures {
 	LPSolver lp_solver;
 	TatonnementOracle oracle;
 	NormalizationRollingAverage rolling_averages;
+	//nullptr unless price computations are being traced
+	std::unique_ptr<PriceTraceRecorder> trace_recorder;
 
 	TatonnementManagementStructures(EdceManagementStructures& management_structures)
 		: lp_solver(management_structures.work_unit_manager)
 		, oracle(management_structures.work_unit_manager, lp_solver, 0)
-		, rolling_averages(management_structures.work_unit_manager.get_num_assets()) {}
+		, rolling_averages(management_structures.work_unit_manager.get_num_assets())
+		, trace_recorder() {}
+
+	void enable_price_trace(const std::string& filename) {
+		trace_recorder = std::make_unique<PriceTraceRecorder>(filename);
+	}
 };
 
 } /* edce */
\ No newline at end of file
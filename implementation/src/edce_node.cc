@@ -1,4 +1,6 @@
 #include "edce_node.h"
+#include "metrics.h"
+#include "span_tracer.h"
 #include "utils.h"
 #include "simple_debug.h"
 
@@ -27,6 +29,10 @@ EdceNode::produce_block() {
 	HashedBlock new_block;
 
 	std::lock_guard lock2(measurement_mtx);
+
+	SpanTracer::global().set_current_block(prev_block_number + 1);
+	TraceSpan block_span("produce_block", prev_block_number + 1);
+	TracePhases phases(prev_block_number + 1);
 	
 	BLOCK_INFO("Starting production on block %lu", prev_block_number + 1);
 
@@ -41,8 +47,14 @@ EdceNode::produce_block() {
 			.productionResults();
 	
 	auto mempool_push_ts = init_time_measurement();
+	//txs whose source accounts the previous block created
+	auto released_txs = admission_checker.release_held_txs();
+	if (released_txs.size() > 0) {
+		mempool.add_to_mempool_buffer(std::move(released_txs));
+	}
 	mempool.push_mempool_buffer_to_mempool();
 	current_measurements.mempool_push_time = measure_time(mempool_push_ts);
+	metrics_record(MetricsHistogram::MEMPOOL_PUSH, current_measurements.mempool_push_time);
 
 	BlockStateUpdateStatsWrapper state_update_stats;
 	size_t block_size = 0;
@@ -54,7 +66,13 @@ EdceNode::produce_block() {
 		auto timestamp = init_time_measurement();
 		current_measurements.last_block_added_to_mempool = mempool.latest_block_added_to_mempool.load(std::memory_order_relaxed);
 
-		block_size = block_producer.build_block(mempool, TARGET_BLOCK_SIZE, current_measurements.block_creation_measurements, state_update_stats);
+		block_size = block_producer.build_block(
+			mempool, 
+			target_block_size, 
+			current_measurements.block_creation_measurements, 
+			state_update_stats,
+			options.speculative_tx_screening ? &speculation_worker.get_processor() : nullptr,
+			&current_measurements.speculation_measurements.num_speculative_drops_applied);
 
 		current_measurements
 			.block_creation_measurements
@@ -65,6 +83,7 @@ EdceNode::produce_block() {
 			.number_of_transactions = block_size;
 
 		BLOCK_INFO("block build time: %lf", current_measurements.block_creation_measurements.block_building_time);
+		metrics_record(MetricsHistogram::TX_PROCESSING, current_measurements.block_creation_measurements.block_building_time);
 	}
 
 	/*std::thread mempool_cleaning_thread([this, &current_measurements] {
@@ -77,6 +96,7 @@ EdceNode::produce_block() {
 
 
 	current_measurements.total_block_build_time = measure_time_from_basept(start_time);
+	phases.end_phase("build_block");
 
 	uint8_t tax_rate_out = 0;
 
@@ -90,9 +110,18 @@ EdceNode::produce_block() {
 		current_measurements.block_creation_measurements,
 		new_block.block.internalHashes.clearingDetails,
 		tax_rate_out, 
-		state_update_stats);
+		state_update_stats,
+		options.speculative_tx_screening ? &speculation_worker : nullptr);
+
+	if (options.speculative_tx_screening) {
+		speculation_worker.finish_speculation(current_measurements.speculation_measurements);
+		BLOCK_INFO("speculative screening ran for %f of %lf s window", 
+			current_measurements.speculation_measurements.screening_window_fraction,
+			current_measurements.speculation_measurements.speculation_window_time);
+	}
 
 	current_measurements.total_block_creation_time = measure_time_from_basept(start_time);
+	phases.end_phase("block_creation");
 
 	auto timestamp = init_time_measurement();
 
@@ -107,15 +136,18 @@ EdceNode::produce_block() {
 	edce_format_hashed_block(new_block, prev_block, options, prices.data(), tax_rate_out);
 
 	prev_block = new_block;
+	highest_produced_block.store(prev_block.block.blockNumber, std::memory_order_release);
 	
 	current_measurements.format_time = measure_time(timestamp);
 
 	current_measurements.total_block_commitment_time = measure_time_from_basept(start_time);
+	phases.end_phase("state_commitment");
 
 	auto output_tx_block = edce_persist_critical_round_data(management_structures, prev_block, current_measurements.data_persistence_measurements, true);
 	current_measurements.data_persistence_measurements.total_critical_persist_time = measure_time(timestamp);
 
 	current_measurements.total_critical_persist_time = measure_time_from_basept(start_time);
+	phases.end_phase("critical_persist");
 
 	BLOCK_INFO("finished block production, starting to send to other nodes");
 	connection_manager.send_block(prev_block, std::move(output_tx_block));
@@ -124,6 +156,7 @@ EdceNode::produce_block() {
 	BLOCK_INFO("log confirm time: %lf", measure_time(timestamp));
 
 	current_measurements.total_block_send_time = measure_time_from_basept(start_time);
+	phases.end_phase("send_block");
 
 	BLOCK_INFO("done sending to other nodes");
 	if (connection_manager.self_confirmable()) {
@@ -131,9 +164,11 @@ EdceNode::produce_block() {
 	}
 
 	current_measurements.total_self_confirm_time = measure_time_from_basept(start_time);
+	phases.end_phase("self_confirm");
 
 	auto async_ts = init_time_measurement();
-	if (prev_block.block.blockNumber % PERSIST_BATCH == 0) {
+	if (prev_block.block.blockNumber - last_async_persist_block >= persist_batch) {
+		last_async_persist_block = prev_block.block.blockNumber;
 		async_persister.do_async_persist(
 			prev_block.block.blockNumber, 
 			get_persistence_measurements(prev_block.block.blockNumber));
@@ -141,6 +176,7 @@ EdceNode::produce_block() {
 	current_measurements.data_persistence_measurements.async_persist_wait_time = measure_time(async_ts);
 
 	current_measurements.total_block_persist_time = measure_time_from_basept(start_time);
+	phases.end_phase("async_persist_handoff");
 
 	get_state_update_stats(prev_block.block.blockNumber) = state_update_stats.get_xdr();
 
@@ -148,12 +184,28 @@ EdceNode::produce_block() {
 
 	mempool_worker.wait_for_mempool_cleaning_done();
 	current_measurements.mempool_wait_time = measure_time(mempool_wait_ts);
+	phases.end_phase("mempool_cleaning_wait");
 	
 	current_measurements.total_time_from_basept = measure_time_from_basept(start_time);
 
 	current_measurements.total_time = measure_time(start_time);
 
-	return block_size > 1000;
+	metrics_record(MetricsHistogram::BLOCK_PRODUCTION, current_measurements.total_time);
+	metrics_add(MetricsCounter::BLOCKS_PRODUCED);
+	metrics_add(MetricsCounter::TXS_IN_PRODUCED_BLOCKS, block_size);
+
+	if (autotuner) {
+		BlockPhaseTimings timings;
+		timings.total_time = current_measurements.total_time;
+		timings.tatonnement_time = current_measurements.block_creation_measurements.tatonnement_time;
+		timings.persist_wait_time = current_measurements.data_persistence_measurements.async_persist_wait_time;
+		timings.num_txs = block_size;
+		if (autotuner->record_block(timings)) {
+			apply_autotuned_parameters();
+		}
+	}
+
+	return block_size > BlockAutotuner::EXHAUSTED_MEMPOOL_BLOCK_SIZE;
 	//management_structures.db.values_log();
 
 	//return std::make_pair(prev_block, output_tx_block);
@@ -173,6 +225,9 @@ bool EdceNode::validate_block(const HashedBlock& header, std::unique_ptr<TxListT
 
 	std::lock_guard lock2(measurement_mtx);
 
+	SpanTracer::global().set_current_block(prev_block_number + 1);
+	TraceSpan block_span("validate_block", prev_block_number + 1);
+
 	//management_structures.db.log();
 	//management_structures.db.values_log();
 
@@ -201,11 +256,14 @@ bool EdceNode::validate_block(const HashedBlock& header, std::unique_ptr<TxListT
 	current_measurements.validation_logic_time = measure_time(logic_timestamp);
 	
 	auto persistence_start = init_time_measurement();
-	edce_persist_critical_round_data(management_structures, header, current_measurements.data_persistence_measurements, 1000000);
+	edce_persist_critical_round_data(management_structures, header, current_measurements.data_persistence_measurements, false, 1000000);
 	current_measurements.total_persistence_time = measure_time(persistence_start);
 
 	current_measurements.total_time = measure_time(timestamp);
 
+	metrics_record(MetricsHistogram::BLOCK_VALIDATION, current_measurements.total_time);
+	metrics_add(MetricsCounter::BLOCKS_VALIDATED);
+
 	prev_block = header;
 
 	connection_manager.send_block(prev_block, std::move(block));
@@ -215,7 +273,8 @@ bool EdceNode::validate_block(const HashedBlock& header, std::unique_ptr<TxListT
 		self_confirmation(prev_block.block.blockNumber);
 	}
 
-	if (prev_block.block.blockNumber % PERSIST_BATCH == 0) {
+	if (prev_block.block.blockNumber - last_async_persist_block >= persist_batch) {
+		last_async_persist_block = prev_block.block.blockNumber;
 		async_persister.do_async_persist(
 			prev_block.block.blockNumber, 
 			get_persistence_measurements(prev_block.block.blockNumber));
@@ -227,6 +286,19 @@ bool EdceNode::validate_block(const HashedBlock& header, std::unique_ptr<TxListT
 }
 
 
+void EdceNode::apply_autotuned_parameters() {
+	auto& params = autotuner->get_parameters();
+
+	std::fprintf(stderr, "autotuner: block size %lu chunk size %lu demand workers %u persist batch %lu\n",
+		params.target_block_size, params.mempool_chunk_size, params.num_demand_workers, params.persist_batch);
+
+	target_block_size = params.target_block_size;
+	persist_batch = params.persist_batch;
+	mempool.set_target_chunk_size(params.mempool_chunk_size);
+	speculation_worker.set_max_txs(params.target_block_size);
+	tatonnement_structs.oracle.set_num_demand_workers(params.num_demand_workers);
+}
+
 void EdceNode::set_current_measurements_type() {
 	measurement_results.block_results.at(prev_block.block.blockNumber % MEASUREMENT_PERSIST_FREQUENCY).type(state);
 }
@@ -344,10 +416,14 @@ void EdceNode::add_txs_to_mempool(std::vector<SignedTransaction>&& txs, uint64_t
 
 	assert_state(BLOCK_PRODUCER);	
 
-	for(size_t i = 0; i <= txs.size() / mempool.TARGET_CHUNK_SIZE; i ++) {
+	metrics_add(MetricsCounter::MEMPOOL_TXS_ADDED, txs.size());
+
+	const size_t chunk_size = mempool.get_target_chunk_size();
+
+	for(size_t i = 0; i <= txs.size() / chunk_size; i ++) {
 		std::vector<SignedTransaction> chunk;
-		size_t min_idx = i * mempool.TARGET_CHUNK_SIZE;
-		size_t max_idx = std::min(txs.size(), (i + 1) * mempool.TARGET_CHUNK_SIZE);
+		size_t min_idx = i * chunk_size;
+		size_t max_idx = std::min(txs.size(), (i + 1) * chunk_size);
 		chunk.insert(
 			chunk.end(),
 			std::make_move_iterator(txs.begin() + min_idx),
@@ -357,5 +433,67 @@ void EdceNode::add_txs_to_mempool(std::vector<SignedTransaction>&& txs, uint64_t
 	mempool.latest_block_added_to_mempool.store(latest_block_number, std::memory_order_relaxed);
 }
 
+TransactionProcessingStatus 
+EdceNode::submit_transaction(const SignedTransaction& tx) {
+	assert_state(BLOCK_PRODUCER);
+
+	auto timestamp = init_time_measurement();
+	metrics_add(MetricsCounter::RPC_SUBMIT_CALLS);
+	metrics_add(MetricsCounter::RPC_TXS_SUBMITTED);
+
+	std::vector<SignedTransaction> chunk;
+	chunk.push_back(tx);
+
+	TransactionProcessingStatus status;
+	if (admission_checker.filter_transactions(chunk, &status) == 0) {
+		metrics_record(MetricsHistogram::RPC_SUBMIT, measure_time(timestamp));
+		return status;
+	}
+
+	//empty if the tx was held for a later signature check.
+	//single txs make tiny chunks; join_small_chunks() coalesces them after the next block.
+	if (chunk.size() > 0) {
+		mempool.add_to_mempool_buffer(std::move(chunk));
+	}
+
+	metrics_add(MetricsCounter::RPC_TXS_ADMITTED);
+	metrics_record(MetricsHistogram::RPC_SUBMIT, measure_time(timestamp));
+	return status;
+}
+
+TransactionBatchSubmissionResults 
+EdceNode::submit_transaction_batch(const SerializedBlock& serialized_txs) {
+	assert_state(BLOCK_PRODUCER);
+
+	auto timestamp = init_time_measurement();
+
+	TransactionBatchSubmissionResults results;
+	mempool.add_serialized_to_mempool_buffer(serialized_txs, results, &admission_checker);
+
+	metrics_add(MetricsCounter::RPC_SUBMIT_CALLS);
+	metrics_add(MetricsCounter::RPC_TXS_SUBMITTED, results.results.size());
+	metrics_add(MetricsCounter::RPC_TXS_ADMITTED, results.num_accepted);
+	metrics_record(MetricsHistogram::RPC_SUBMIT, measure_time(timestamp));
+	return results;
+}
+
+SubmissionStatus
+EdceNode::get_submission_status(const SubmissionStatusQuery& accounts) {
+	assert_state(BLOCK_PRODUCER);
+
+	SubmissionStatus status;
+	status.highest_produced_block = highest_produced_block.load(std::memory_order_acquire);
+	{
+		std::lock_guard lock(confirmation_mtx);
+		status.highest_confirmed_block = highest_confirmed_block;
+	}
+
+	status.committed_sequence_numbers.reserve(accounts.size());
+	for (auto account : accounts) {
+		auto seq_num = management_structures.db.get_last_committed_seq_num(account);
+		status.committed_sequence_numbers.push_back(seq_num ? *seq_num : 0);
+	}
+	return status;
+}
 
 } /* edce */
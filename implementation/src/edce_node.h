@@ -6,17 +6,21 @@
 #include "mempool.h"
 #include "consensus_connection_manager.h"
 #include "block_producer.h"
+#include "speculative_tx_processor.h"
+#include "block_autotuner.h"
 
+#include <atomic>
 #include <cstdint>
 #include <mutex>
+#include <optional>
 
 #include "xdr/experiments.h"
 #include "xdr/block.h"
+#include "xdr/transaction_submission_api.h"
 
 namespace edce {
 
 class EdceNode {
-	constexpr static size_t PERSIST_BATCH = 5;
 	constexpr static size_t MEASUREMENT_PERSIST_FREQUENCY = 10000;
 	
 	EdceManagementStructures& management_structures;
@@ -31,6 +35,9 @@ class EdceNode {
 
 	uint64_t highest_confirmed_block;
 
+	//prev_block's number, readable without operation_mtx (which is held for all of block production)
+	std::atomic<uint64_t> highest_produced_block;
+
 	EdceAsyncPersister async_persister;
 	
 	ExperimentResultsUnion measurement_results;
@@ -40,17 +47,22 @@ class EdceNode {
 
 	ConnectionManager connection_manager;
 
-	constexpr static bool small = false;
-
 	//block production related objects
-	constexpr static size_t TARGET_BLOCK_SIZE = small ? 60'000 : 600'000;
 
-	constexpr static size_t MEMPOOL_CHUNK_SIZE = small ? 1'000: 10'000;
+	//start out as in options, and are retuned by the autotuner (if options.autotune)
+	size_t target_block_size;
+	size_t persist_batch;
+
+	uint64_t last_async_persist_block;
+
+	std::optional<BlockAutotuner> autotuner;
 
 	TatonnementManagementStructures tatonnement_structs;
 	std::vector<Price> prices;
 	Mempool mempool;
 	MempoolWorker mempool_worker;
+	MempoolAdmissionChecker admission_checker;
+	SpeculationWorker speculation_worker;
 	BlockProducer block_producer;
 
 	//block validation related objects
@@ -66,6 +78,9 @@ class EdceNode {
 
 	void self_confirmation(uint64_t block_number);
 
+	//hands the autotuner's current parameters to the mempool, speculation worker and Tatonnement
+	void apply_autotuned_parameters();
+
 public:
 
 	EdceNode(
@@ -81,17 +96,32 @@ public:
 	, measurement_mtx()
 	, prev_block()
 	, highest_confirmed_block(0)
+	, highest_produced_block(0)
 	, async_persister(management_structures)
 	, measurement_results()
 	, measurement_output_prefix(measurement_output_prefix)
 	, options(options) 
 	, connection_manager()
+	, target_block_size(options.target_block_size)
+	, persist_batch(options.persist_batch)
+	, last_async_persist_block(0)
+	, autotuner()
 	, tatonnement_structs(management_structures)
 	//, solver(management_structures.work_unit_manager)
 	//, oracle(management_structures.work_unit_manager, solver, 0)
-	, mempool(MEMPOOL_CHUNK_SIZE)
+	, mempool(options.mempool_chunk_size)
 	, mempool_worker(mempool)
-	, block_producer(management_structures)
+	, admission_checker(
+		management_structures.db,
+		management_structures.verified_tx_cache,
+		management_structures.work_unit_manager.get_num_assets())
+	, speculation_worker(
+		mempool,
+		mempool_worker,
+		management_structures.db,
+		admission_checker,
+		options.target_block_size)
+	, block_producer(management_structures, options.conflict_aware_scheduling)
 	{
 		measurement_results.block_results.resize(MEASUREMENT_PERSIST_FREQUENCY);
 		measurement_results.params = params;
@@ -101,6 +131,13 @@ public:
 		for (size_t i = 0; i < num_assets; i++) {
 			prices[i] = PriceUtils::from_double(1.0);
 		}
+		if (!options.price_trace_file.empty()) {
+			tatonnement_structs.enable_price_trace(options.price_trace_file);
+		}
+		tatonnement_structs.oracle.set_num_demand_workers(options.num_demand_workers);
+		if (options.autotune && state == BLOCK_PRODUCER) {
+			autotuner.emplace(options, MAX_TRANSACTIONS_PER_BLOCK, TatonnementControlParameters::MAX_DEMAND_WORKERS);
+		}
 	}
 
 	~EdceNode() {
@@ -135,6 +172,15 @@ public:
 	bool validate_block(const HashedBlock& header, const std::unique_ptr<TxListType> block);
 
 	void add_txs_to_mempool(std::vector<SignedTransaction>&& txs, uint64_t latest_block_number);
+
+	//called from transaction submission rpc server.  Txs are run through admission checks
+	//(format, static op params, seqnum, signature), and those that pass land in the mempool buffer,
+	//and so are visible to the next call to push_mempool_buffer_to_mempool().
+	TransactionProcessingStatus submit_transaction(const SignedTransaction& tx);
+	TransactionBatchSubmissionResults submit_transaction_batch(const SerializedBlock& serialized_txs);
+
+	//committed sequence numbers of the given accounts, and the produced/confirmed block numbers
+	SubmissionStatus get_submission_status(const SubmissionStatusQuery& accounts);
 	size_t mempool_size() {
 		assert_state(BLOCK_PRODUCER);
 		return mempool.size();
@@ -32,6 +32,100 @@ extern "C" {
 
 		return count == 6;
 	}
+
+	//optional; returns false if the key is absent.
+	bool _parse_multiset_state_commitment(const char* filename, unsigned int* multiset_state_commitment) {
+		struct fy_document* fyd = fy_document_build_from_file(NULL, filename);
+
+		if (fyd == NULL) {
+			return false;
+		}
+
+		int count = fy_document_scanf(
+			fyd,
+			"/protocol/multiset_state_commitment %u",
+			multiset_state_commitment);
+
+		fy_document_destroy(fyd);
+		return count == 1;
+	}
+
+	//optional; returns false if the key is absent.
+	bool _parse_price_trace_file(const char* filename, char* price_trace_file) {
+		struct fy_document* fyd = fy_document_build_from_file(NULL, filename);
+
+		if (fyd == NULL) {
+			return false;
+		}
+
+		int count = fy_document_scanf(
+			fyd,
+			"/edce-node/price_trace_file %255s",
+			price_trace_file);
+
+		fy_document_destroy(fyd);
+		return count == 1;
+	}
+
+	//all optional; returns the number of keys present.
+	int _parse_metrics_options(const char* filename, char* metrics_snapshot_file, unsigned int* metrics_server, unsigned int* span_trace_blocks,
+		unsigned int* metrics) {
+		struct fy_document* fyd = fy_document_build_from_file(NULL, filename);
+
+		if (fyd == NULL) {
+			return 0;
+		}
+
+		int count = fy_document_scanf(
+			fyd,
+			"/edce-node/metrics_snapshot_file %255s",
+			metrics_snapshot_file);
+
+		count += fy_document_scanf(
+			fyd,
+			"/edce-node/metrics_server %u",
+			metrics_server);
+
+		count += fy_document_scanf(
+			fyd,
+			"/edce-node/span_trace_blocks %u",
+			span_trace_blocks);
+
+		count += fy_document_scanf(
+			fyd,
+			"/edce-node/metrics %u",
+			metrics);
+
+		fy_document_destroy(fyd);
+		return count;
+	}
+
+	//all optional; returns the number of keys present.
+	int _parse_block_production_options(const char* filename,
+		long unsigned int* target_block_size, long unsigned int* mempool_chunk_size, long unsigned int* persist_batch,
+		long unsigned int* tx_buffer_size, unsigned int* num_demand_workers,
+		unsigned int* autotune, double* autotune_target_latency, unsigned int* autotune_window_blocks,
+		unsigned int* speculative_tx_screening, unsigned int* conflict_aware_scheduling) {
+		struct fy_document* fyd = fy_document_build_from_file(NULL, filename);
+
+		if (fyd == NULL) {
+			return 0;
+		}
+
+		int count = fy_document_scanf(fyd, "/edce-node/target_block_size %lu", target_block_size);
+		count += fy_document_scanf(fyd, "/edce-node/mempool_chunk_size %lu", mempool_chunk_size);
+		count += fy_document_scanf(fyd, "/edce-node/persist_batch %lu", persist_batch);
+		count += fy_document_scanf(fyd, "/edce-node/tx_buffer_size %lu", tx_buffer_size);
+		count += fy_document_scanf(fyd, "/edce-node/num_demand_workers %u", num_demand_workers);
+		count += fy_document_scanf(fyd, "/edce-node/autotune %u", autotune);
+		count += fy_document_scanf(fyd, "/edce-node/autotune_target_latency %lf", autotune_target_latency);
+		count += fy_document_scanf(fyd, "/edce-node/autotune_window_blocks %u", autotune_window_blocks);
+		count += fy_document_scanf(fyd, "/edce-node/speculative_tx_screening %u", speculative_tx_screening);
+		count += fy_document_scanf(fyd, "/edce-node/conflict_aware_scheduling %u", conflict_aware_scheduling);
+
+		fy_document_destroy(fyd);
+		return count;
+	}
 }
 
 
@@ -43,11 +137,51 @@ void EdceOptions::parse_options(const char* filename) {
 		throw std::runtime_error("Error parsing options (did you forget the .yaml?)");
 	}
 
+	unsigned int multiset_flag = 0;
+	if (_parse_multiset_state_commitment(filename, &multiset_flag)) {
+		multiset_state_commitment = (multiset_flag != 0);
+	}
+
+	char price_trace_buf[256];
+	if (_parse_price_trace_file(filename, price_trace_buf)) {
+		price_trace_file = price_trace_buf;
+	}
+
+	char metrics_snapshot_buf[256];
+	metrics_snapshot_buf[0] = '\0';
+	unsigned int metrics_server_flag = 0;
+	unsigned int span_trace_blocks_buf = 0;
+	unsigned int metrics_flag = 1;
+	_parse_metrics_options(filename, metrics_snapshot_buf, &metrics_server_flag, &span_trace_blocks_buf, &metrics_flag);
+	metrics_snapshot_file = metrics_snapshot_buf;
+	metrics_server = (metrics_server_flag != 0);
+	metrics = (metrics_flag != 0);
+	span_trace_blocks = span_trace_blocks_buf;
+
+	unsigned int autotune_flag = 0;
+	unsigned int speculative_tx_screening_flag = 0;
+	unsigned int conflict_aware_scheduling_flag = 1;
+	_parse_block_production_options(filename,
+		&target_block_size, &mempool_chunk_size, &persist_batch, &tx_buffer_size, &num_demand_workers,
+		&autotune_flag, &autotune_target_latency, &autotune_window_blocks,
+		&speculative_tx_screening_flag, &conflict_aware_scheduling_flag);
+	autotune = (autotune_flag != 0);
+	speculative_tx_screening = (speculative_tx_screening_flag != 0);
+	conflict_aware_scheduling = (conflict_aware_scheduling_flag != 0);
+
+	if (target_block_size == 0 || mempool_chunk_size == 0 || persist_batch == 0 || tx_buffer_size == 0
+		|| num_demand_workers == 0 || autotune_window_blocks == 0) {
+		throw std::runtime_error("block production sizing options must be nonzero");
+	}
+
 	std::printf("after\n");
 }
 
 void EdceOptions::print_options() {
-	std::printf("tax_rate=%u smooth_mult=%u num_assets=%u\n", tax_rate, smooth_mult, num_assets);
+	std::printf("tax_rate=%u smooth_mult=%u num_assets=%u multiset_state_commitment=%d price_trace_file=%s metrics_snapshot_file=%s metrics_server=%d metrics=%d span_trace_blocks=%u\n",
+		tax_rate, smooth_mult, num_assets, multiset_state_commitment, price_trace_file.c_str(), metrics_snapshot_file.c_str(), metrics_server, metrics, span_trace_blocks);
+	std::printf("target_block_size=%lu mempool_chunk_size=%lu persist_batch=%lu tx_buffer_size=%lu num_demand_workers=%u autotune=%d autotune_target_latency=%lf autotune_window_blocks=%u speculative_tx_screening=%d conflict_aware_scheduling=%d\n",
+		target_block_size, mempool_chunk_size, persist_batch, tx_buffer_size, num_demand_workers, autotune, autotune_target_latency, autotune_window_blocks, speculative_tx_screening, conflict_aware_scheduling);
 }
 
 }
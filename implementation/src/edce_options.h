@@ -1,5 +1,6 @@
 #pragma once
 #include <cstddef>
+#include <string>
 
 namespace edce {
 
@@ -16,6 +17,53 @@ struct EdceOptions {
 
 	size_t persistence_frequency;
 
+	//validate each block by replaying groups of txs that write disjoint accounts (not read from the config file)
+	bool account_partitioned_validation = false;
+
+	//include multiset hashes of the account db and orderbooks in block headers (optional /protocol/multiset_state_commitment)
+	bool multiset_state_commitment = false;
+
+	//if nonempty, append a trace of every produced block's price computation here (optional /edce-node/price_trace_file)
+	std::string price_trace_file;
+
+	//if nonempty, periodically write a snapshot of the metrics registry here (optional /edce-node/metrics_snapshot_file)
+	std::string metrics_snapshot_file;
+
+	//serve metrics snapshots on METRICS_PORT (optional /edce-node/metrics_server)
+	bool metrics_server = false;
+
+	//record metrics at all (optional /edce-node/metrics, on by default)
+	bool metrics = true;
+
+	//if nonzero, enable the span tracer, and dump the spans of the last this many blocks
+	//when the experiment finishes (optional /edce-node/span_trace_blocks)
+	unsigned int span_trace_blocks = 0;
+
+	//block production sizing (optional /edce-node/target_block_size, mempool_chunk_size,
+	//persist_batch, tx_buffer_size and num_demand_workers).
+	//num_demand_workers is capped at TatonnementControlParameters::MAX_DEMAND_WORKERS.
+	size_t target_block_size = 600'000;
+	size_t mempool_chunk_size = 10'000;
+	size_t persist_batch = 5;
+	size_t tx_buffer_size = 10'000;
+	unsigned int num_demand_workers = 5;
+
+	//let the block producer retune the sizing parameters above every autotune_window_blocks blocks,
+	//aiming for the highest throughput whose block latency (in seconds) stays under autotune_target_latency
+	//(optional /edce-node/autotune, autotune_target_latency, autotune_window_blocks)
+	bool autotune = false;
+	double autotune_target_latency = 1.0;
+	unsigned int autotune_window_blocks = 20;
+
+	//screen the next block's txs while Tatonnement and clearing run on the current block,
+	//dropping txs that can no longer succeed and moving likely failures to the end of the block.
+	//Changes the order of txs within a block (optional /edce-node/speculative_tx_screening).
+	bool speculative_tx_screening = false;
+
+	//route txs touching hot accounts to one owning thread per account during block production
+	//(optional /edce-node/conflict_aware_scheduling, on by default).
+	bool conflict_aware_scheduling = true;
+
 	void parse_options(const char* configfile);
 
 	void print_options();
@@ -1,6 +1,10 @@
 #include "edce_node.h"
 #include "edce_management_structures.h"
 #include "consensus_api_server.h"
+#include "transaction_submission_api_server.h"
+#include "metrics.h"
+#include "metrics_api_server.h"
+#include "span_tracer.h"
 
 #include <tbb/global_control.h>
 #include "singlenode_init.h"
@@ -101,7 +105,24 @@ struct MempoolManager {
 	}
 };
 
-void run_experiment(ExperimentParameters params, std::string experiment_data_root, std::string results_output_root, EdceOptions& options, const size_t num_threads) {
+//Produces blocks only from txs submitted over rpc, for submission_seconds, starting once signalled by
+//a controller (e2e_load_harness), and then waits for a second signal to shut down.
+void run_submission_only(EdceNode& node, ConsensusApiServer& consensus_api_server, uint32_t submission_seconds) {
+	consensus_api_server.wait_for_experiment_start();
+
+	auto end_time = std::chrono::steady_clock::now() + std::chrono::seconds(submission_seconds);
+
+	while (std::chrono::steady_clock::now() < end_time) {
+		node.push_mempool_buffer_to_mempool();
+		if (node.mempool_size() == 0) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+		node.produce_block();
+	}
+}
+
+void run_experiment(ExperimentParameters params, std::string experiment_data_root, std::string results_output_root, EdceOptions& options, const size_t num_threads, const uint32_t submission_seconds) {
 
 	EdceManagementStructures management_structures(
 		options.num_assets,
@@ -121,54 +142,78 @@ void run_experiment(ExperimentParameters params, std::string experiment_data_roo
 	tbb::global_control control(
 		tbb::global_control::max_allowed_parallelism, num_threads);
 
+	if (options.multiset_state_commitment) {
+		management_structures.enable_multiset_state_commitment();
+	}
+
 	init_management_structures_from_lmdb(management_structures);
 
-	EdceNode node(management_structures, params, options, results_output_root, NodeType::BLOCK_PRODUCER);
+	if (options.span_trace_blocks > 0) {
+		SpanTracer::global().enable();
+	}
+	MetricsRegistry::global().enable(options.metrics);
 
-	MempoolManager pool_manager(experiment_data_root, node);
+	EdceNode node(management_structures, params, options, results_output_root, NodeType::BLOCK_PRODUCER);
 
 	ConsensusApiServer consensus_api_server(node);
 
-	consensus_api_server.set_experiment_ready_to_start();
+	//txs submitted over rpc (i.e. by tx_gen) land in the mempool alongside the preloaded experiment txs.
+	TransactionSubmissionApiServer tx_submission_server(node);
 
-	bool wait_for_control_server = false;
-		
-	if (wait_for_control_server) {
-		consensus_api_server.wait_for_experiment_start();
+	std::unique_ptr<MetricsApiServer> metrics_api_server;
+	if (options.metrics_server) {
+		metrics_api_server = std::make_unique<MetricsApiServer>(results_output_root);
+	}
+	std::unique_ptr<MetricsSnapshotWriter> metrics_writer;
+	if (!options.metrics_snapshot_file.empty()) {
+		metrics_writer = std::make_unique<MetricsSnapshotWriter>(options.metrics_snapshot_file);
 	}
 
+	consensus_api_server.set_experiment_ready_to_start();
 
-	const int64_t large_TARGET_MEMPOOL_SIZE = 2'000'000;
-	const int64_t small_TARGET_MEMPOOL_SIZE = 200'000;
-	
-	const int64_t TARGET_MEMPOOL_SIZE = large_TARGET_MEMPOOL_SIZE;
+	bool wait_for_control_server = (submission_seconds > 0);
 
-	pool_manager.call_lazy_tx_addition(TARGET_MEMPOOL_SIZE);
-	pool_manager.wait_for_tx_addition();
-	node.push_mempool_buffer_to_mempool();
+	if (submission_seconds > 0) {
+		run_submission_only(node, consensus_api_server, submission_seconds);
+	} else {
+		MempoolManager pool_manager(experiment_data_root, node);
 
-	while (!pool_manager.is_done()) {
+		const int64_t large_TARGET_MEMPOOL_SIZE = 2'000'000;
+		const int64_t small_TARGET_MEMPOOL_SIZE = 200'000;
+		
+		const int64_t TARGET_MEMPOOL_SIZE = large_TARGET_MEMPOOL_SIZE;
 
-		auto mempool_wait = init_time_measurement();
+		pool_manager.call_lazy_tx_addition(TARGET_MEMPOOL_SIZE);
 		pool_manager.wait_for_tx_addition();
+		node.push_mempool_buffer_to_mempool();
 
-		int64_t gap = TARGET_MEMPOOL_SIZE - node.mempool_size();
-		if (gap > 0) {
-			pool_manager.call_lazy_tx_addition(gap);
-		}
-		BLOCK_INFO("mempool lazy tx addition wait time: %lf", measure_time(mempool_wait));
+		while (!pool_manager.is_done()) {
 
-		if (!node.produce_block()) {
-			BLOCK_INFO("ending because mempool filled with garbage");
-			break;
-		}
+			auto mempool_wait = init_time_measurement();
+			pool_manager.wait_for_tx_addition();
 
+			int64_t gap = TARGET_MEMPOOL_SIZE - node.mempool_size();
+			if (gap > 0) {
+				pool_manager.call_lazy_tx_addition(gap);
+			}
+			BLOCK_INFO("mempool lazy tx addition wait time: %lf", measure_time(mempool_wait));
 
-		//auto [header, block] = node.produce_block();
+			if (!node.produce_block()) {
+				BLOCK_INFO("ending because mempool filled with garbage");
+				break;
+			}
+
+
+			//auto [header, block] = node.produce_block();
 
-		//node.log_block_confirmation(header.block.blockNumber);
+			//node.log_block_confirmation(header.block.blockNumber);
+		}
 	}
 	node.write_measurements();
+	if (options.span_trace_blocks > 0) {
+		auto num_spans = SpanTracer::global().write_chrome_trace(results_output_root + "span_trace.json", options.span_trace_blocks);
+		BLOCK_INFO("wrote %lu spans to span_trace.json", num_spans);
+	}
 	BLOCK_INFO("experiment finished!");
 	consensus_api_server.wait_until_block_buffer_empty();
 	consensus_api_server.set_experiment_done();
@@ -187,8 +232,8 @@ void run_experiment(ExperimentParameters params, std::string experiment_data_roo
 
 int main(int argc, char const *argv[])
 {
-	if (argc != 4) {
-		std::printf("usage: ./whatever <data_directory> <results_directory> <num_threads>\n");
+	if (argc != 4 && argc != 5) {
+		std::printf("usage: ./whatever <data_directory> <results_directory> <num_threads> <optional: submission_only_seconds>\n");
 		return -1;
 	}
 
@@ -207,6 +252,8 @@ int main(int argc, char const *argv[])
 
 	int num_threads = std::stoi(argv[3]);
 
+	uint32_t submission_seconds = (argc == 5) ? std::stoul(argv[4]) : 0;
+
 	ExperimentResults results;
 
 	results.params.tax_rate = params.tax_rate;
@@ -221,6 +268,6 @@ int main(int argc, char const *argv[])
 	options.smooth_mult = params.smooth_mult;
 	options.persistence_frequency = params.persistence_frequency;
 
-	run_experiment(params, experiment_data_root, results_output_root, options, num_threads);
+	run_experiment(params, experiment_data_root, results_output_root, options, num_threads, submission_seconds);
 	return 0;
 }
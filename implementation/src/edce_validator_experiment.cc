@@ -1,6 +1,9 @@
 #include "edce_node.h"
 #include "edce_management_structures.h"
 #include "consensus_api_server.h"
+#include "metrics.h"
+#include "metrics_api_server.h"
+#include "span_tracer.h"
 
 #include "tbb/global_control.h"
 #include "singlenode_init.h"
@@ -36,11 +39,29 @@ void run_experiment(
 	tbb::global_control control(
 		tbb::global_control::max_allowed_parallelism, num_threads);
 
+	if (options.multiset_state_commitment) {
+		management_structures.enable_multiset_state_commitment();
+	}
+
 	init_management_structures_from_lmdb(management_structures);
 
+	if (options.span_trace_blocks > 0) {
+		SpanTracer::global().enable();
+	}
+	MetricsRegistry::global().enable(options.metrics);
+
 	EdceNode node(management_structures, params, options, results_output_root, NodeType::BLOCK_VALIDATOR);
 
 	ConsensusApiServer consensus_api_server(node);
+
+	std::unique_ptr<MetricsApiServer> metrics_api_server;
+	if (options.metrics_server) {
+		metrics_api_server = std::make_unique<MetricsApiServer>(results_output_root);
+	}
+	std::unique_ptr<MetricsSnapshotWriter> metrics_writer;
+	if (!options.metrics_snapshot_file.empty()) {
+		metrics_writer = std::make_unique<MetricsSnapshotWriter>(options.metrics_snapshot_file);
+	}
 	
 	consensus_api_server.set_experiment_ready_to_start();
 	consensus_api_server.wait_for_experiment_start();
@@ -59,19 +80,33 @@ void run_experiment(
 	BLOCK_INFO("got shutdown signal from controller, shutting down");
 
 	node.write_measurements();
+	if (options.span_trace_blocks > 0) {
+		auto num_spans = SpanTracer::global().write_chrome_trace(results_output_root + "span_trace.json", options.span_trace_blocks);
+		BLOCK_INFO("wrote %lu spans to span_trace.json", num_spans);
+	}
 	BLOCK_INFO("shutting down");
 	std::this_thread::sleep_for(std::chrono::seconds(5));
 }
 
 int main(int argc, char const *argv[])
 {
-	if (argc != 6) {
-		std::printf("usage: ./whatever <data_directory> <results_directory> <upstream_hostname> <self_hostname> <num_threads>\n");
+	if (argc != 6 && argc != 7) {
+		std::printf("usage: ./whatever <data_directory> <results_directory> <upstream_hostname> <self_hostname> <num_threads> <optional: validation_mode (ranges|partitioned)>\n");
 		return -1;
 	}
 
 	EdceOptions options;
 
+	if (argc == 7) {
+		auto validation_mode = std::string(argv[6]);
+		if (validation_mode == "partitioned") {
+			options.account_partitioned_validation = true;
+		} else if (validation_mode != "ranges") {
+			std::printf("invalid validation mode %s\n", validation_mode.c_str());
+			return -1;
+		}
+	}
+
 	ExperimentParameters params;
 
 	std::string experiment_data_root = std::string(argv[1]) + "/";
@@ -103,6 +138,8 @@ int main(int argc, char const *argv[])
 	options.smooth_mult = params.smooth_mult;
 	options.persistence_frequency = params.persistence_frequency;
 
+	std::printf("validating with %d threads, %s\n", num_threads, options.account_partitioned_validation ? "account-partitioned" : "tx ranges");
+
 	run_experiment(params, experiment_data_root, results_output_root, options, parent_hostname, self_hostname, num_threads);
 	return 0;
 }
@@ -27,7 +27,7 @@ bool EdceValidatorNode::validate_block(HashedBlock& header, AccountModificationB
 	current_measurements.validation_logic_time = measure_time(logic_timestamp);
 	
 	auto persistence_start = init_time_measurement();
-	edce_persist_critical_round_data(management_structures, header, current_measurements.data_persistence_measurements, 1000000);
+	edce_persist_critical_round_data(management_structures, header, current_measurements.data_persistence_measurements, false, 1000000);
 	current_measurements.total_persistence_time = measure_time(persistence_start);
 
 	current_measurements.total_time = measure_time(timestamp);
@@ -1,10 +1,12 @@
 #include "file_prealloc_worker.h"
+#include "span_tracer.h"
 #include "utils.h"
 
 namespace edce {
 
 void 
 FilePreallocWorker::run() {
+	span_tracer_set_thread_name("file_prealloc_worker");
 
 	while (true) {
 		std::unique_lock lock(mtx);
@@ -23,6 +25,7 @@ FilePreallocWorker::run() {
 
 void 
 FilePreallocWorker::prealloc(uint64_t block_number) {
+	TraceSpan span("file_prealloc", block_number);
 	auto filename = tx_block_name(block_number);
 	std::printf("preallocating file for block %lu filename %s\n", block_number, filename.c_str());
 	block_fd = preallocate_file(filename.c_str());
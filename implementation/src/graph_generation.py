@@ -175,6 +175,10 @@ def plot_validation_over_rounds(experiment):
 		attr_func("block_validation_measurements.db_tentative_commit_time"),
 		experiment,
 		"db_tentative_commit_time")
+	plot_measurement_over_rounds(
+		attr_func("block_validation_measurements.multiset_check_time"),
+		experiment,
+		"multiset_check_time")
 	plot_measurement_over_rounds(
 		attr_func("block_validation_measurements.workunit_hash_time"),
 		experiment,
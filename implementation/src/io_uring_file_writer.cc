@@ -0,0 +1,343 @@
+#include "io_uring_file_writer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+
+#include <unistd.h>
+#include <sys/uio.h>
+
+namespace edce {
+
+IoUringFileWriter::IoUringFileWriter(size_t chunk_size, unsigned int num_buffers)
+	: chunk_size(chunk_size)
+	, num_buffers(num_buffers)
+	, buffers()
+	, free_buffers()
+	, submitted_lengths(num_buffers, 0)
+	, submit_times(num_buffers)
+	, fd()
+	, chunk_latencies() {
+
+	if (num_buffers < 2) {
+		//serialization holds one buffer while waiting for another
+		throw std::runtime_error("IoUringFileWriter needs at least 2 buffers");
+	}
+	if (chunk_size % ALIGNMENT != 0 || chunk_size < 4 * BLOCK_ALIGNMENT) {
+		throw std::runtime_error("invalid IoUringFileWriter chunk size");
+	}
+
+	for (unsigned int i = 0; i < num_buffers; i++) {
+		void* buf = nullptr;
+		if (posix_memalign(&buf, ALIGNMENT, chunk_size)) {
+			throw std::runtime_error("failed to allocate IoUringFileWriter buffer");
+		}
+		buffers.push_back(static_cast<unsigned char*>(buf));
+		free_buffers.push_back(i);
+	}
+
+#if HAVE_LIBURING
+	auto res = io_uring_queue_init(num_buffers, &ring, 0);
+	if (res < 0) {
+		std::printf("io_uring_queue_init error %d %s\n", -res, strerror(-res));
+		throw std::runtime_error("failed to init io_uring");
+	}
+
+	std::vector<struct iovec> iovecs(num_buffers);
+	for (unsigned int i = 0; i < num_buffers; i++) {
+		iovecs[i].iov_base = buffers[i];
+		iovecs[i].iov_len = chunk_size;
+	}
+	res = io_uring_register_buffers(&ring, iovecs.data(), num_buffers);
+	if (res < 0) {
+		std::printf("io_uring_register_buffers error %d %s\n", -res, strerror(-res));
+		io_uring_queue_exit(&ring);
+		throw std::runtime_error("failed to register io_uring buffers");
+	}
+#endif
+}
+
+IoUringFileWriter::~IoUringFileWriter() {
+	try {
+		wait();
+	} catch (std::exception& e) {
+		std::printf("error finishing IoUringFileWriter write: %s\n", e.what());
+	}
+#if HAVE_LIBURING
+	io_uring_unregister_buffers(&ring);
+	io_uring_queue_exit(&ring);
+#endif
+	for (auto* buf : buffers) {
+		free(buf);
+	}
+	free(file_buffer);
+}
+
+unsigned int
+IoUringFileWriter::acquire_buffer() {
+	while (free_buffers.empty()) {
+		reap_one();
+	}
+	unsigned int out = free_buffers.back();
+	free_buffers.pop_back();
+	return out;
+}
+
+#if HAVE_LIBURING
+
+void
+IoUringFileWriter::submit_chunk(unsigned int buf_idx, size_t len) {
+	struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+	if (sqe == nullptr) {
+		//queue depth = num_buffers, so there is always a free sqe
+		throw std::runtime_error("io_uring submission queue full");
+	}
+	io_uring_prep_write_fixed(sqe, fd.get(), buffers[buf_idx], len, file_offset, buf_idx);
+	io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(static_cast<uintptr_t>(buf_idx)));
+
+	submitted_lengths[buf_idx] = len;
+	submit_times[buf_idx] = init_time_measurement();
+
+	auto res = io_uring_submit(&ring);
+	if (res < 0) {
+		std::printf("io_uring_submit error %d %s\n", -res, strerror(-res));
+		throw std::runtime_error("io_uring_submit failed");
+	}
+	in_flight++;
+	file_offset += len;
+}
+
+void
+IoUringFileWriter::submit_in_place_chunk(size_t len) {
+	//keep within the queue depth
+	while (in_flight >= num_buffers) {
+		reap_one();
+	}
+
+	struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+	if (sqe == nullptr) {
+		throw std::runtime_error("io_uring submission queue full");
+	}
+	io_uring_prep_write(sqe, fd.get(), file_buffer + file_offset, len, file_offset);
+	uintptr_t tag = num_buffers + in_place_lengths.size();
+	io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(tag));
+
+	in_place_lengths.push_back(len);
+	in_place_submit_times.push_back(init_time_measurement());
+
+	auto res = io_uring_submit(&ring);
+	if (res < 0) {
+		std::printf("io_uring_submit error %d %s\n", -res, strerror(-res));
+		throw std::runtime_error("io_uring_submit failed");
+	}
+	in_flight++;
+	file_offset += len;
+}
+
+void
+IoUringFileWriter::reap_one() {
+	if (in_flight == 0) {
+		throw std::runtime_error("no io_uring writes in flight");
+	}
+	struct io_uring_cqe* cqe;
+	auto res = io_uring_wait_cqe(&ring, &cqe);
+	if (res < 0) {
+		std::printf("io_uring_wait_cqe error %d %s\n", -res, strerror(-res));
+		throw std::runtime_error("io_uring_wait_cqe failed");
+	}
+
+	uintptr_t tag = reinterpret_cast<uintptr_t>(io_uring_cqe_get_data(cqe));
+	int written = cqe->res;
+	io_uring_cqe_seen(&ring, cqe);
+
+	in_flight--;
+
+	size_t expected_len;
+	if (tag < num_buffers) {
+		unsigned int buf_idx = static_cast<unsigned int>(tag);
+		chunk_latencies.push_back(measure_time_from_basept(submit_times[buf_idx]));
+		free_buffers.push_back(buf_idx);
+		expected_len = submitted_lengths[buf_idx];
+	} else {
+		size_t chunk_idx = tag - num_buffers;
+		chunk_latencies.push_back(measure_time_from_basept(in_place_submit_times[chunk_idx]));
+		expected_len = in_place_lengths[chunk_idx];
+	}
+
+	//reported in wait(), once nothing else is in flight
+	if (written < 0) {
+		std::printf("io_uring write errno was %d %s from fd %d\n", -written, strerror(-written), fd.get());
+		write_failed = true;
+	} else if (static_cast<size_t>(written) != expected_len) {
+		//O_DIRECT writes into a preallocated file are not expected to be short
+		std::printf("short io_uring write (%d of %lu bytes)\n", written, expected_len);
+		write_failed = true;
+	}
+}
+
+#else
+
+static void
+pwrite_all(int fd, const unsigned char* data, size_t len, size_t offset) {
+	size_t idx = 0;
+	while (idx < len) {
+		auto written = pwrite(fd, data + idx, len - idx, offset + idx);
+		if (written < 0) {
+			std::printf("errno was %d %s from fd %d\n", errno, strerror(errno), fd);
+			throw std::runtime_error("error returned from pwrite");
+		}
+		idx += written;
+	}
+}
+
+void
+IoUringFileWriter::submit_chunk(unsigned int buf_idx, size_t len) {
+	auto timestamp = init_time_measurement();
+
+	pwrite_all(fd.get(), buffers[buf_idx], len, file_offset);
+
+	chunk_latencies.push_back(measure_time(timestamp));
+	free_buffers.push_back(buf_idx);
+	file_offset += len;
+}
+
+void
+IoUringFileWriter::submit_in_place_chunk(size_t len) {
+	auto timestamp = init_time_measurement();
+
+	pwrite_all(fd.get(), file_buffer + file_offset, len, file_offset);
+
+	chunk_latencies.push_back(measure_time(timestamp));
+	file_offset += len;
+}
+
+void
+IoUringFileWriter::reap_one() {
+	throw std::runtime_error("no io_uring writes in flight");
+}
+
+#endif
+
+void
+IoUringFileWriter::submit_current_chunk() {
+	size_t write_amount = cur_used - (cur_used % BLOCK_ALIGNMENT);
+	size_t remainder = cur_used % BLOCK_ALIGNMENT;
+
+	unsigned int next_idx = acquire_buffer();
+	memcpy(buffers[next_idx], buffers[cur_idx] + write_amount, remainder);
+
+	submit_chunk(cur_idx, write_amount);
+
+	cur_idx = next_idx;
+	cur_used = remainder;
+}
+
+void
+IoUringFileWriter::begin(unique_fd&& new_fd, size_t list_size) {
+	wait();
+
+	fd = std::move(new_fd);
+	file_offset = 0;
+	total_bytes = 0;
+	active = true;
+
+	cur_idx = acquire_buffer();
+
+	xdr::xdr_put header(buffers[cur_idx], buffers[cur_idx] + 4);
+	header(xdr::size32(list_size));
+	cur_used = 4;
+}
+
+void
+IoUringFileWriter::finish() {
+	total_bytes = file_offset + cur_used;
+
+	size_t write_amount = cur_used - (cur_used % BLOCK_ALIGNMENT) + BLOCK_ALIGNMENT;
+	memset(buffers[cur_idx] + cur_used, 0, write_amount - cur_used);
+	submit_chunk(cur_idx, write_amount);
+}
+
+unsigned char*
+IoUringFileWriter::begin_in_place(unique_fd&& new_fd, size_t list_size, size_t list_bytes) {
+	wait();
+
+	size_t padded_size = round_up_to_block(4 + list_bytes);
+	if (padded_size > file_buffer_capacity) {
+		free(file_buffer);
+		file_buffer = nullptr;
+		file_buffer_capacity = 0;
+
+		size_t capacity = ((padded_size + ALIGNMENT - 1) / ALIGNMENT) * ALIGNMENT;
+		void* buf = nullptr;
+		if (posix_memalign(&buf, ALIGNMENT, capacity)) {
+			throw std::runtime_error("failed to allocate IoUringFileWriter file buffer");
+		}
+		file_buffer = static_cast<unsigned char*>(buf);
+		file_buffer_capacity = capacity;
+	}
+
+	fd = std::move(new_fd);
+	file_offset = 0;
+	total_bytes = 4 + list_bytes;
+	active = true;
+	in_place_pending = true;
+
+	xdr::xdr_put header(file_buffer, file_buffer + 4);
+	header(xdr::size32(list_size));
+	return file_buffer + 4;
+}
+
+void
+IoUringFileWriter::submit_in_place() {
+	if (!in_place_pending) {
+		throw std::runtime_error("submit_in_place() without begin_in_place()");
+	}
+	in_place_pending = false;
+
+	size_t padded_size = round_up_to_block(total_bytes);
+	memset(file_buffer + total_bytes, 0, padded_size - total_bytes);
+
+	in_place_lengths.clear();
+	in_place_submit_times.clear();
+
+	while (file_offset < padded_size) {
+		submit_in_place_chunk(std::min(chunk_size, padded_size - file_offset));
+	}
+}
+
+void
+IoUringFileWriter::wait() {
+	if (!active) {
+		return;
+	}
+
+	while (in_flight > 0) {
+		reap_one();
+	}
+	active = false;
+
+	if (in_place_pending) {
+		in_place_pending = false;
+		fd.clear();
+		throw std::runtime_error("in-place write was never submitted");
+	}
+
+	if (write_failed) {
+		write_failed = false;
+		fd.clear();
+		throw std::runtime_error("io_uring write failed");
+	}
+
+	auto res = ftruncate(fd.get(), total_bytes);
+	if (res) {
+		std::printf("errno was %d %s\n", errno, strerror(errno));
+		throw std::runtime_error("invalid ftruncate result");
+	}
+
+	BLOCK_INFO("total written bytes = %lu", total_bytes);
+
+	fsync(fd.get());
+	fd.clear();
+}
+
+} /* edce */
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <xdrpp/marshal.h>
+
+#include "../config.h"
+
+#if HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+#include "cleanup.h"
+#include "simple_debug.h"
+#include "utils.h"
+
+namespace edce {
+
+/*
+Writes an xdr list to an O_DIRECT file, in the same format as save_xdr_to_file_fast(),
+but without waiting for the disk.
+
+The list is serialized into a small pool of aligned buffers, registered with an io_uring.
+Each full buffer is submitted as one write at the next file offset,
+so several chunks are in flight while serialization continues.
+Serialization only blocks when every buffer is in flight.
+
+Lists can also be serialized by the caller (e.g. in parallel, straight from a trie)
+directly into one aligned whole-file buffer owned by the writer (begin_in_place()),
+which is then written out in chunk_size pieces without being copied (submit_in_place()).
+
+write_async() returns once the whole list is serialized (so the caller can then
+modify or free the list), and wait() returns once every chunk is on disk,
+the file is truncated to its true length, and fsynced.
+
+Without liburing, chunks are written synchronously with pwrite,
+so wait() only has to truncate and sync.
+
+Not threadsafe.
+*/
+class IoUringFileWriter {
+
+public:
+	constexpr static size_t DEFAULT_CHUNK_SIZE = 1 << 22;
+	constexpr static unsigned int DEFAULT_NUM_BUFFERS = 8;
+
+private:
+	constexpr static size_t ALIGNMENT = 4096;
+	//O_DIRECT writes must be multiples of this
+	constexpr static size_t BLOCK_ALIGNMENT = 512;
+
+	const size_t chunk_size;
+	const unsigned int num_buffers;
+
+#if HAVE_LIBURING
+	struct io_uring ring;
+#endif
+
+	std::vector<unsigned char*> buffers;
+	std::vector<unsigned int> free_buffers;
+	std::vector<size_t> submitted_lengths;
+	std::vector<time_point> submit_times;
+	unsigned int in_flight = 0;
+
+	unique_fd fd;
+	size_t file_offset = 0;
+	size_t total_bytes = 0;
+	bool active = false;
+	bool write_failed = false;
+
+	std::vector<double> chunk_latencies;
+
+	//whole-file buffer for in-place writes, kept across writes
+	unsigned char* file_buffer = nullptr;
+	size_t file_buffer_capacity = 0;
+	bool in_place_pending = false;
+	//indexed by (user_data - num_buffers)
+	std::vector<size_t> in_place_lengths;
+	std::vector<time_point> in_place_submit_times;
+
+	//buffer being filled, and bytes used in it
+	unsigned int cur_idx = 0;
+	size_t cur_used = 0;
+
+	//leaves room to pad the last write
+	size_t usable_size() const {
+		return chunk_size - BLOCK_ALIGNMENT;
+	}
+
+	static size_t round_up_to_block(size_t len) {
+		return ((len + BLOCK_ALIGNMENT - 1) / BLOCK_ALIGNMENT) * BLOCK_ALIGNMENT;
+	}
+
+	unsigned int acquire_buffer();
+	void submit_chunk(unsigned int buf_idx, size_t len);
+	//writes len bytes of file_buffer, from file_offset
+	void submit_in_place_chunk(size_t len);
+	void reap_one();
+
+	//submits the aligned prefix of the current buffer and carries the remainder into a new one
+	void submit_current_chunk();
+
+	void begin(unique_fd&& fd, size_t list_size);
+	template<typename xdr_type>
+	void append_xdr(const xdr_type& value);
+	void finish();
+
+public:
+
+	IoUringFileWriter(size_t chunk_size = DEFAULT_CHUNK_SIZE, unsigned int num_buffers = DEFAULT_NUM_BUFFERS);
+
+	IoUringFileWriter(const IoUringFileWriter&) = delete;
+	IoUringFileWriter& operator=(const IoUringFileWriter&) = delete;
+
+	~IoUringFileWriter();
+
+	//Waits for any previous write first.  Takes ownership of fd.
+	template<typename xdr_list_type>
+	void write_async(const xdr_list_type& value, unique_fd&& fd);
+
+	//Same output as write_async(), for a list the caller serializes itself.
+	//Waits for any previous write first, takes ownership of fd, and writes the length prefix.
+	//Returns space for the list_bytes bytes of the serialized list (without its length prefix),
+	//which the caller must fill before calling submit_in_place().
+	unsigned char* begin_in_place(unique_fd&& fd, size_t list_size, size_t list_bytes);
+
+	//Starts writing the list set up by begin_in_place().
+	void submit_in_place();
+
+	//Blocks until the last write is durable, then closes its fd.
+	void wait();
+
+	bool busy() const {
+		return active;
+	}
+
+	//Time from submission to completion of each chunk since the last clear.
+	const std::vector<double>& get_chunk_latencies() const {
+		return chunk_latencies;
+	}
+
+	void clear_chunk_latencies() {
+		chunk_latencies.clear();
+	}
+};
+
+template<typename xdr_list_type>
+void
+IoUringFileWriter::write_async(const xdr_list_type& value, unique_fd&& new_fd) {
+	begin(std::move(new_fd), value.size());
+
+	for (size_t list_idx = 0; list_idx < value.size(); list_idx++) {
+		append_xdr(value[list_idx]);
+	}
+
+	finish();
+}
+
+template<typename xdr_type>
+void
+IoUringFileWriter::append_xdr(const xdr_type& value) {
+	size_t next_sz = xdr::xdr_argpack_size(value);
+
+	if (next_sz > usable_size() - BLOCK_ALIGNMENT) {
+		throw std::runtime_error("xdr list element too large for IoUringFileWriter chunk");
+	}
+
+	if (usable_size() - cur_used < next_sz) {
+		submit_current_chunk();
+	}
+
+	unsigned char* buf = buffers[cur_idx];
+	xdr::xdr_put p(buf + cur_used, buf + cur_used + next_sz);
+	p(value);
+	cur_used += next_sz;
+}
+
+} /* edce */
@@ -1,9 +1,11 @@
 #include "log_merge_worker.h"
+#include "span_tracer.h"
 
 namespace edce {
 
 void
 LogMergeWorker::run() {
+	span_tracer_set_thread_name("log_merge_worker");
 	std::unique_lock lock(mtx);
 	while(true) {
 		if ((!done_flag) && (!exists_work_to_do())) {
@@ -12,6 +14,7 @@ LogMergeWorker::run() {
 		if (done_flag) return;
 		if (logs_ready_for_merge) {
 
+			TraceSpan span("merge_in_log_batch");
 			management_structures.account_modification_log.merge_in_log_batch();
 			
 			/*if (logs.size() > 0) {
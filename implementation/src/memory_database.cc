@@ -82,6 +82,11 @@ int64_t MemoryDatabase::lookup_available_balance(
 	return find_account(user_index).lookup_available_balance(asset_type);
 }
 
+int64_t MemoryDatabase::peek_available_balance(
+	account_db_idx user_index, AssetID asset_type) {
+	return find_account(user_index).peek_available_balance(asset_type);
+}
+
 void MemoryDatabase::clear_internal_data_structures() {
 	uncommitted_db.clear();
 	uncommitted_idx_map.clear();
@@ -173,6 +178,8 @@ void MemoryDatabase::commit_new_accounts(uint64_t current_block_number) {
 
 	auto uncommitted_db_size = uncommitted_db.size();
 	database.reserve(database.size() + uncommitted_db_size);
+
+	MultisetHash new_accounts_multiset;
 	for (uint64_t i = 0; i < uncommitted_db_size; i++) {
 		uncommitted_db[i].commit();
 		database.emplace_back(std::move(uncommitted_db[i]));
@@ -182,8 +189,13 @@ void MemoryDatabase::commit_new_accounts(uint64_t current_block_number) {
 		DBStateCommitmentTrie::prefix_t key_buf;
 		MemoryDatabase::write_trie_key(key_buf, owner);
 		//database.back().commit();
-		commitment_trie.insert(key_buf, DBStateCommitmentValueT(database.back().produce_commitment()));
+		auto commitment = database.back().produce_commitment();
+		if (multiset_commitment_enabled) {
+			new_accounts_multiset.insert_xdr(commitment);
+		}
+		commitment_trie.insert(key_buf, DBStateCommitmentValueT(commitment));
 	}
+	account_multiset += new_accounts_multiset;
 	user_id_to_idx_map.insert(uncommitted_idx_map.begin(), uncommitted_idx_map.end());
 
 	account_creation_thunks.push_back(AccountCreationThunk{current_block_number, uncommitted_db_size});
@@ -199,6 +211,7 @@ void MemoryDatabase::rollback_new_accounts(uint64_t current_block_number) {
 
 
 void MemoryDatabase::rollback_new_accounts_(uint64_t current_block_number) {
+	MultisetHash removed_accounts_multiset;
 	for (size_t i = 0; i < account_creation_thunks.size();) {
 		auto& thunk = account_creation_thunks[i];
 		if (thunk.current_block_number > current_block_number) {
@@ -210,7 +223,10 @@ void MemoryDatabase::rollback_new_accounts_(uint64_t current_block_number) {
 				
 				DBStateCommitmentTrie::prefix_t key_buf;
 				MemoryDatabase::write_trie_key(key_buf, owner);
-				commitment_trie.perform_deletion(key_buf);
+				auto deleted = commitment_trie.perform_deletion(key_buf);
+				if (multiset_commitment_enabled && deleted) {
+					removed_accounts_multiset.insert_xdr(static_cast<const AccountCommitment&>(*deleted));
+				}
 			}
 
 			database.erase(database.begin() + (db_size - thunk.num_accounts_created), database.end());
@@ -220,6 +236,7 @@ void MemoryDatabase::rollback_new_accounts_(uint64_t current_block_number) {
 			i++;
 		}
 	}
+	account_multiset -= removed_accounts_multiset;
 	clear_internal_data_structures();
 }
 
@@ -444,6 +461,15 @@ std::optional<PublicKey> MemoryDatabase::get_pk_nolock(AccountID account) const
 	return database[iter->second].get_pk();
 }
 
+std::optional<uint64_t> MemoryDatabase::get_last_committed_seq_num(AccountID account) const {
+	std::shared_lock lock(committed_mtx);
+	auto iter = user_id_to_idx_map.find(account);
+	if (iter == user_id_to_idx_map.end()) {
+		return std::nullopt;
+	}
+	return database[iter->second].get_last_committed_seq_num();
+}
+
 /*
 void
 MemoryDatabase::tentative_produce_state_commitment(Hash& hash, const std::vector<AccountID>& dirty_accounts) {
@@ -571,6 +597,8 @@ template<typename Lambda>
 struct ParallelApplyLambda {
 	MemoryDatabase::DBStateCommitmentTrie& commitment_trie;
 	Lambda& modify_lambda;
+	//if nonnull, updated with every commitment replaced
+	SharedMultisetHash* multiset = nullptr;
 
 	template<typename Applyable>
 	void operator() (const Applyable& work_root) {
@@ -598,7 +626,9 @@ struct ParallelApplyLambda {
 		//	DebugUtils::__array_to_str(commitment_trie_subnode->get_prefix(), __num_prefix_bytes(commitment_trie_subnode -> get_prefix_len())).c_str(), commitment_trie_subnode -> get_prefix_len());
 
 
-		auto apply_lambda = [this, commitment_trie_subnode] (const AccountModificationLog::LogValueT& log_value) {
+		MultisetHash local_multiset;
+
+		auto apply_lambda = [this, commitment_trie_subnode, &local_multiset] (const AccountModificationLog::LogValueT& log_value) {
 
 			//std::printf("apply lambda to: %s %d\n subnode prefix: %s %d\n", 
 			//	DebugUtils::__array_to_str(prefix, __num_prefix_bytes(64)).c_str(), 64,
@@ -606,8 +636,14 @@ struct ParallelApplyLambda {
 
 			AccountID owner = log_value.owner;
 
-			auto modify_lambda_wrapper = [this, owner] (MemoryDatabase::DBStateCommitmentValueT& commitment_value_out) {
+			auto modify_lambda_wrapper = [this, owner, &local_multiset] (MemoryDatabase::DBStateCommitmentValueT& commitment_value_out) {
+				if (multiset) {
+					local_multiset.remove_xdr(static_cast<const AccountCommitment&>(commitment_value_out));
+				}
 				modify_lambda(owner, commitment_value_out);
+				if (multiset) {
+					local_multiset.insert_xdr(static_cast<const AccountCommitment&>(commitment_value_out));
+				}
 			};
 
 			MemoryDatabase::DBStateCommitmentTrie::prefix_t prefix;
@@ -618,6 +654,10 @@ struct ParallelApplyLambda {
 
 		work_root . apply(apply_lambda);
 		commitment_trie.invalidate_hash_to_node_nolocks(commitment_trie_subnode);
+
+		if (multiset) {
+			*multiset += local_multiset;
+		}
 	}
 };
 
@@ -643,7 +683,8 @@ void MemoryDatabase::tentative_produce_state_commitment(Hash& hash, const Accoun
 
 	TentativeValueModifyLambda func{database, user_id_to_idx_map};
 
-	ParallelApplyLambda<TentativeValueModifyLambda> apply_lambda{commitment_trie, func};
+	ParallelApplyLambda<TentativeValueModifyLambda> apply_lambda{
+		commitment_trie, func, multiset_commitment_enabled ? &account_multiset : nullptr};
 
 	std::printf("starting tentative_produce_state_commitment, size =%lu\n", commitment_trie.size());
 
@@ -656,7 +697,8 @@ void MemoryDatabase::set_trie_commitment_to_user_account_commits(const AccountMo
 
 	ProduceValueModifyLambda func{database, user_id_to_idx_map};
 
-	ParallelApplyLambda<ProduceValueModifyLambda> apply_lambda{commitment_trie, func};
+	ParallelApplyLambda<ProduceValueModifyLambda> apply_lambda{
+		commitment_trie, func, multiset_commitment_enabled ? &account_multiset : nullptr};
 
 	std::printf("starting produce_state_commitment, size =%lu\n", commitment_trie.size());
 
@@ -714,23 +756,32 @@ MemoryDatabase::_produce_state_commitment(Hash& hash) {
 
 	const auto block_size = database.size() / 200;
 
+	//every account is rehashed, so the multiset hash is rebuilt from scratch
+	SharedMultisetHash full_multiset;
+
 	//std::atomic_thread_fence(std::memory_order_release);
 	tbb::parallel_for(
 		tbb::blocked_range<std::size_t>(0, database.size(), block_size),
-		[this, &state_modified_count](auto r) {
+		[this, &state_modified_count, &full_multiset](auto r) {
 			//std::atomic_thread_fence(std::memory_order_acquire);
 			int tl_state_modified_count = 0;
 			DBStateCommitmentTrie::prefix_t key_buf;
 			DBStateCommitmentTrie local_trie;
+			MultisetHash local_multiset;
 			for (auto i = r.begin(); i < r.end(); i++) {
 				//if (database[i].modified_since_last_commit_production()) {
 					tl_state_modified_count ++;
 					MemoryDatabase::write_trie_key(key_buf, database.at(i).get_owner());
 					//TODO the problem is here - use a better iterator, not parallel_insert
-					local_trie.insert(key_buf, DBStateCommitmentValueT(database.at(i).produce_commitment()));
+					auto commitment = database.at(i).produce_commitment();
+					if (multiset_commitment_enabled) {
+						local_multiset.insert_xdr(commitment);
+					}
+					local_trie.insert(key_buf, DBStateCommitmentValueT(commitment));
 				//	database[i].mark_unmodified_since_last_commit_production();
 				//}
 			}
+			full_multiset += local_multiset;
 			commitment_trie.merge_in(std::move(local_trie));
 			state_modified_count.fetch_add(tl_state_modified_count, std::memory_order_relaxed);
 			//std::atomic_thread_fence(std::memory_order_release);
@@ -739,6 +790,8 @@ MemoryDatabase::_produce_state_commitment(Hash& hash) {
 
 	BLOCK_INFO("state modified count = %d", state_modified_count.load());
 
+	account_multiset.set(full_multiset.get());
+
 	commitment_trie.freeze_and_hash(hash);
 
 	INFO_F(commitment_trie._log("db commit"));
@@ -17,6 +17,7 @@
 #include "database_types.h"
 #include "merkle_trie.h"
 #include "merkle_trie_utils.h"
+#include "multiset_hash.h"
 #include "xdr/database_commitments.h"
 
 #include "lmdb_wrapper.h"
@@ -41,6 +42,10 @@ struct AccountLMDB : public LMDBInstance {
 		LMDBInstance::open_env(std::string(ROOT_DB_DIRECTORY) + std::string(ACCOUNT_DB));
 	}
 
+	void open_env(const std::string& path) {
+		LMDBInstance::open_env(path);
+	}
+
 	void create_db() {
 		LMDBInstance::create_db(DB_NAME);
 	}
@@ -200,6 +205,11 @@ private:
 
 	DBStateCommitmentTrie commitment_trie;
 
+	//Multiset hash over the values of commitment_trie, maintained only if enabled.
+	//Updated alongside every modification to commitment_trie.
+	bool multiset_commitment_enabled = false;
+	SharedMultisetHash account_multiset;
+
 	AccountLMDB account_lmdb_instance;
 
 	std::vector<DBPersistenceThunk> persistence_thunks;
@@ -310,6 +320,16 @@ public:
 
 	void rollback_produce_state_commitment(const AccountModificationLog& log);
 	void finalize_produce_state_commitment();
+
+	//Must be called before loading accounts from lmdb.
+	void enable_multiset_commitment() {
+		multiset_commitment_enabled = true;
+	}
+
+	//Multiset hash of every account's commitment, as of the last (tentative_)produce_state_commitment.
+	void produce_multiset_commitment(Hash& hash_out) const {
+		account_multiset.digest(hash_out);
+	}
 	
 	//std::optional<dbenv::wtxn> persist_lmdb(uint64_t current_block_number, AccountModificationLog& log, bool lazy_commit = false);
 	//std::optional<dbenv::wtxn> persist_lmdb(uint64_t current_block_number, const std::vector<AccountID>& dirty_accounts, bool lazy_commit = false);
@@ -319,6 +339,10 @@ public:
 	void open_lmdb_env() {
 		account_lmdb_instance.open_env();
 	}
+	//somewhere other than the account lmdb under ROOT_DB_DIRECTORY (i.e. for benchmarks).  path must exist.
+	void open_lmdb_env(const std::string& path) {
+		account_lmdb_instance.open_env(path);
+	}
 	void create_lmdb() {
 		account_lmdb_instance.create_db();
 	}
@@ -351,6 +375,10 @@ public:
 	int64_t lookup_available_balance(
 		account_db_idx user_index, AssetID asset_type);
 
+	//read-only; see UserAccount::peek_available_balance
+	int64_t peek_available_balance(
+		account_db_idx user_index, AssetID asset_type);
+
 	TransactionProcessingStatus reserve_sequence_number(
 		account_db_idx user_index, uint64_t sequence_number);
 
@@ -365,6 +393,9 @@ public:
 	//not threadsafe with commit/rollback
 	std::optional<PublicKey> get_pk_nolock(AccountID account) const;
 
+	//committed state only.  Sequence numbers at or below this are guaranteed to be rejected.
+	std::optional<uint64_t> get_last_committed_seq_num(AccountID account) const;
+
 	void log();
 	void values_log();
 
@@ -1,6 +1,13 @@
 #include "mempool.h"
 
 #include <tbb/parallel_for.h>
+
+#include <algorithm>
+
+#include <xdrpp/marshal.h>
+
+#include "simple_debug.h"
+
 namespace edce {
 
 uint64_t MempoolChunk::remove_confirmed_txs() {
@@ -28,6 +35,107 @@ void Mempool::add_to_mempool_buffer(std::vector<SignedTransaction>&& chunk) {
 	buffered_mempool.push_back(std::move(to_add));
 }
 
+uint32_t 
+Mempool::add_serialized_to_mempool_buffer(
+	const SerializedBlock& serialized_txs,
+	TransactionBatchSubmissionResults& results,
+	MempoolAdmissionChecker* admission_checker) {
+	results.num_accepted = 0;
+	results.results.clear();
+
+	uint32_t num_txs = 0;
+
+	if (serialized_txs.size() < 4) {
+		//not even a length header, so no txs to report on
+		return 0;
+	}
+
+	xdr::xdr_get header(serialized_txs.data(), serialized_txs.data() + 4);
+	header(num_txs);
+
+	//Every declared tx gets a result, even if the batch as a whole is malformed
+	//(up to the most a result list can hold).
+	results.results.assign(
+		std::min<uint32_t>(num_txs, MAX_TRANSACTIONS_PER_BLOCK), TransactionProcessingStatus::INVALID_TX_FORMAT);
+
+	if (serialized_txs.size() % 4 != 0 || num_txs > MAX_TRANSACTIONS_PER_BLOCK) {
+		return 0;
+	}
+
+	xdr::xdr_get g(serialized_txs.data() + 4, serialized_txs.data() + serialized_txs.size());
+
+	std::vector<std::vector<SignedTransaction>> decoded_chunks;
+
+	uint32_t num_decoded = 0;
+	uint32_t num_accepted = 0;
+	bool malformed = false;
+
+	const size_t max_chunk_sz = get_target_chunk_size();
+
+	while (num_decoded < num_txs && !malformed) {
+		size_t chunk_sz = std::min<size_t>(max_chunk_sz, num_txs - num_decoded);
+
+		//txs are unmarshalled in place, into the vector that becomes the chunk's storage.
+		std::vector<SignedTransaction> txs;
+		txs.resize(chunk_sz);
+
+		size_t i = 0;
+		try {
+			for (; i < chunk_sz; i++) {
+				g(txs[i]);
+				results.results[num_decoded + i] = TransactionProcessingStatus::SUCCESS;
+			}
+		} catch (xdr::xdr_runtime_error& e) {
+			MEMPOOL_INFO("malformed tx %lu in submitted batch: %s", num_decoded + i, e.what());
+			txs.resize(i);
+			malformed = true;
+		}
+
+		num_decoded += i;
+		decoded_chunks.emplace_back(std::move(txs));
+	}
+
+	if (!malformed) {
+		try {
+			g.done();
+		} catch (xdr::xdr_runtime_error& e) {
+			//bytes past the last declared tx: the length header can't be trusted, so nothing in the batch is
+			MEMPOOL_INFO("trailing bytes after submitted batch: %s", e.what());
+			results.results.assign(num_txs, TransactionProcessingStatus::INVALID_TX_FORMAT);
+			return 0;
+		}
+	}
+
+	std::vector<MempoolChunk> chunks;
+
+	size_t chunk_start = 0;
+	for (auto& txs : decoded_chunks) {
+		size_t decoded_sz = txs.size();
+
+		if (admission_checker != nullptr) {
+			//includes txs held for a later signature check
+			num_accepted += admission_checker->filter_transactions(txs, results.results.data() + chunk_start);
+		} else {
+			num_accepted += txs.size();
+		}
+		chunk_start += decoded_sz;
+
+		if (txs.size() > 0) {
+			chunks.emplace_back(std::move(txs));
+		}
+	}
+
+	{
+		std::lock_guard lock(buffer_mtx);
+		for (auto& chunk : chunks) {
+			buffered_mempool.emplace_back(std::move(chunk));
+		}
+	}
+
+	results.num_accepted = num_accepted;
+	return num_accepted;
+}
+
 void Mempool::push_mempool_buffer_to_mempool() {
 	std::lock_guard lock (buffer_mtx);
 	std::lock_guard lock2 (mtx);
@@ -42,9 +150,11 @@ void Mempool::push_mempool_buffer_to_mempool() {
 void Mempool::join_small_chunks() {
 	std::lock_guard lock(mtx);
 
+	const size_t chunk_size = get_target_chunk_size();
+
 	//ensures that the average chunk size is at least TARGET/2
 	for (size_t i = 0; i < mempool.size() - 1;) {
-		if (mempool[i].size() + mempool[i+1].size() < TARGET_CHUNK_SIZE) {
+		if (mempool[i].size() + mempool[i+1].size() < chunk_size) {
 			mempool[i].join(std::move(mempool[i+1]));
 			mempool[i+1] = std::move(mempool.back());
 			mempool.pop_back();
@@ -6,7 +6,12 @@
 #include <cstdint>
 
 #include "xdr/transaction.h"
+#include "xdr/block.h"
+#include "xdr/transaction_submission_api.h"
 #include "async_worker.h"
+#include "mempool_admission.h"
+#include "metrics.h"
+#include "span_tracer.h"
 #include "utils.h"
 
 namespace edce {
@@ -66,11 +71,11 @@ class Mempool {
 	mutable std::mutex mtx;
 	std::mutex buffer_mtx;
 
+	//read by the submission rpc threads, so can change while txs are being added
+	std::atomic<size_t> target_chunk_size;
 
 public:
 
-	const size_t TARGET_CHUNK_SIZE;
-
 	std::atomic<uint64_t> latest_block_added_to_mempool = 0;
 
 	Mempool(size_t target_chunk_size)
@@ -79,11 +84,33 @@ public:
 		, mempool_size(0)
 		, mtx()
 		, buffer_mtx()
-       		, TARGET_CHUNK_SIZE(target_chunk_size) {}
+       		, target_chunk_size(target_chunk_size) {}
 
 	//constexpr static size_t TARGET_CHUNK_SIZE = 10000;
 
+	size_t get_target_chunk_size() const {
+		return target_chunk_size.load(std::memory_order_relaxed);
+	}
+
+	//Applies to chunks made after this call.  Existing chunks are resized only by join_small_chunks().
+	void set_target_chunk_size(size_t new_size) {
+		target_chunk_size.store(new_size, std::memory_order_relaxed);
+	}
+
 	void add_to_mempool_buffer(std::vector<SignedTransaction>&& chunk);
+
+	//Decodes a serialized SignedTransactionList directly into chunks of (at most) the target chunk size
+	//and adds them to the mempool buffer.
+	//XDR is not self-delimiting, so decoding stops at the first malformed tx;
+	//it and every tx after it are reported as INVALID_TX_FORMAT.
+	//A batch with a bad length header, or with bytes past its last declared tx, is rejected whole:
+	//every declared tx is reported as INVALID_TX_FORMAT.
+	//If admission_checker is given, each decoded chunk is filtered through it before buffering.
+	//returns number of txs added.
+	uint32_t add_serialized_to_mempool_buffer(
+		const SerializedBlock& serialized_txs,
+		TransactionBatchSubmissionResults& results,
+		MempoolAdmissionChecker* admission_checker = nullptr);
 	void push_mempool_buffer_to_mempool();
 
 	//threadsafe
@@ -126,6 +153,7 @@ class MempoolWorker : public AsyncWorker {
 	}
 
 	void run() {
+		span_tracer_set_thread_name("mempool_worker");
 		std::unique_lock lock(mtx);
 		while(true) {
 			if ((!done_flag) && (!exists_work_to_do())) {
@@ -133,10 +161,12 @@ class MempoolWorker : public AsyncWorker {
 			}
 			if (done_flag) return;
 			if (do_cleaning) {
+				TraceSpan span("mempool_cleaning");
 				auto timestamp = init_time_measurement();
 				mempool.remove_confirmed_txs();
 				mempool.join_small_chunks();
 				*output_measurement = measure_time(timestamp);
+				metrics_record(MetricsHistogram::MEMPOOL_CLEANING, *output_measurement);
 
 				do_cleaning = false;
 			}
@@ -0,0 +1,237 @@
+#include "mempool_admission.h"
+
+#include <iterator>
+
+#include <sodium.h>
+#include <xdrpp/marshal.h>
+
+#include <tbb/parallel_for.h>
+
+#include "price_utils.h"
+#include "simple_debug.h"
+#include "work_unit_manager_utils.h"
+
+namespace edce {
+
+//mirrors check_tx_format_parameters in serial_transaction_processor.cc
+static bool check_admission_tx_format(const Transaction& tx) {
+	return (tx.metadata.sequenceNumber & RESERVED_SEQUENCE_NUM_LOWBITS) == 0;
+}
+
+MempoolAdmissionChecker::MempoolAdmissionChecker(
+	const MemoryDatabase& db,
+	VerifiedTransactionCache& verified_tx_cache,
+	uint16_t num_assets,
+	bool check_sigs)
+	: db(db)
+	, verified_tx_cache(verified_tx_cache)
+	, num_assets(num_assets)
+	, check_sigs(check_sigs) {
+		if (sodium_init() == -1) {
+			throw std::runtime_error("could not init sodium");
+		}
+	}
+
+TransactionProcessingStatus
+MempoolAdmissionChecker::check_operation(const Operation& op) const {
+	switch(op.body.type()) {
+		case CREATE_ACCOUNT:
+			if (op.body.createAccountOp().startingBalance < CREATE_ACCOUNT_MIN_STARTING_BALANCE) {
+				return TransactionProcessingStatus::STARTING_BALANCE_TOO_LOW;
+			}
+			return TransactionProcessingStatus::SUCCESS;
+		case CREATE_SELL_OFFER:
+		{
+			auto& offer_op = op.body.createSellOfferOp();
+			if (!WorkUnitManagerUtils::validate_category(offer_op.category, num_assets)) {
+				return TransactionProcessingStatus::INVALID_OFFER_CATEGORY;
+			}
+			if (!PriceUtils::is_valid_price(offer_op.minPrice)) {
+				return TransactionProcessingStatus::INVALID_PRICE;
+			}
+			if (offer_op.amount == 0) {
+				return TransactionProcessingStatus::INVALID_AMOUNT;
+			}
+			return TransactionProcessingStatus::SUCCESS;
+		}
+		case MONEY_PRINTER:
+			if (op.body.moneyPrinterOp().amount < 0) {
+				return TransactionProcessingStatus::INVALID_PRINT_MONEY_AMOUNT;
+			}
+			return TransactionProcessingStatus::SUCCESS;
+		case CANCEL_SELL_OFFER:
+		case PAYMENT:
+			return TransactionProcessingStatus::SUCCESS;
+	}
+	return TransactionProcessingStatus::INVALID_OPERATION_TYPE;
+}
+
+TransactionProcessingStatus
+MempoolAdmissionChecker::check_static_parameters(const Transaction& tx) const {
+	if (!check_admission_tx_format(tx)) {
+		return TransactionProcessingStatus::INVALID_TX_FORMAT;
+	}
+
+	for (auto& op : tx.operations) {
+		auto status = check_operation(op);
+		if (status != TransactionProcessingStatus::SUCCESS) {
+			return status;
+		}
+	}
+	return TransactionProcessingStatus::SUCCESS;
+}
+
+TransactionProcessingStatus
+MempoolAdmissionChecker::check_transaction(const SignedTransaction& signed_tx) {
+	auto& tx = signed_tx.transaction;
+
+	auto static_status = check_static_parameters(tx);
+	if (static_status != TransactionProcessingStatus::SUCCESS) {
+		return static_status;
+	}
+
+	auto last_committed_seq_num = db.get_last_committed_seq_num(tx.metadata.sourceAccount);
+	if (!last_committed_seq_num) {
+		if (!check_sigs) {
+			//nothing to verify later; the tx processor checks that the account exists.
+			return TransactionProcessingStatus::SUCCESS;
+		}
+		//no pk to check a sig against yet.  filter_transactions() holds these.
+		return TransactionProcessingStatus::SOURCE_ACCOUNT_NEXIST;
+	}
+
+	if (tx.metadata.sequenceNumber <= *last_committed_seq_num) {
+		return TransactionProcessingStatus::SEQ_NUM_TOO_LOW;
+	}
+
+	if (!check_sigs) {
+		return TransactionProcessingStatus::SUCCESS;
+	}
+
+	Hash tx_hash;
+	VerifiedTransactionCache::hash_tx(signed_tx, tx_hash);
+
+	if (verified_tx_cache.contains(tx_hash)) {
+		num_sig_cache_hits.fetch_add(1, std::memory_order_relaxed);
+		return TransactionProcessingStatus::SUCCESS;
+	}
+
+	auto pk = db.get_pk(tx.metadata.sourceAccount);
+	if (!pk) {
+		//accounts are never deleted, so this is unreachable.
+		throw std::runtime_error("account disappeared during admission check");
+	}
+
+	auto buf = xdr::xdr_to_opaque(tx);
+	if (crypto_sign_verify_detached(signed_tx.signature.data(), buf.data(), buf.size(), pk->data()) != 0) {
+		return TransactionProcessingStatus::INVALID_SIGNATURE;
+	}
+
+	verified_tx_cache.insert(tx_hash);
+	return TransactionProcessingStatus::SUCCESS;
+}
+
+size_t
+MempoolAdmissionChecker::filter_transactions(
+	std::vector<SignedTransaction>& txs,
+	TransactionProcessingStatus* statuses_out) {
+
+	tbb::parallel_for(
+		tbb::blocked_range<size_t>(0, txs.size(), 500),
+		[this, &txs, statuses_out] (auto r) {
+			for (auto i = r.begin(); i < r.end(); i++) {
+				statuses_out[i] = check_transaction(txs[i]);
+			}
+		});
+
+	size_t num_kept = 0;
+	size_t num_held = 0;
+	for (size_t i = 0; i < txs.size(); i++) {
+		if (statuses_out[i] == TransactionProcessingStatus::SOURCE_ACCOUNT_NEXIST) {
+			std::lock_guard lock(held_mtx);
+			if (held_txs.size() < MAX_HELD_TXS) {
+				held_txs.push_back(HeldTransaction{std::move(txs[i])});
+				statuses_out[i] = TransactionProcessingStatus::SUCCESS;
+				num_held++;
+				continue;
+			}
+		}
+
+		if (statuses_out[i] == TransactionProcessingStatus::SUCCESS) {
+			if (num_kept != i) {
+				txs[num_kept] = std::move(txs[i]);
+			}
+			num_kept++;
+		} else {
+			MEMPOOL_INFO("rejected tx from account %lu at admission: status %d",
+				txs[i].transaction.metadata.sourceAccount, statuses_out[i]);
+		}
+	}
+
+	num_rejected.fetch_add(txs.size() - num_kept - num_held, std::memory_order_relaxed);
+	num_admitted.fetch_add(num_kept + num_held, std::memory_order_relaxed);
+	num_unverified.fetch_add(num_held, std::memory_order_relaxed);
+
+	txs.resize(num_kept);
+	return num_kept + num_held;
+}
+
+std::vector<SignedTransaction>
+MempoolAdmissionChecker::release_held_txs() {
+	std::vector<HeldTransaction> to_check;
+	{
+		std::lock_guard lock(held_mtx);
+		to_check.swap(held_txs);
+	}
+
+	std::vector<SignedTransaction> released;
+	if (to_check.size() == 0) {
+		return released;
+	}
+
+	std::vector<TransactionProcessingStatus> statuses(to_check.size());
+
+	tbb::parallel_for(
+		tbb::blocked_range<size_t>(0, to_check.size(), 500),
+		[this, &to_check, &statuses] (auto r) {
+			for (auto i = r.begin(); i < r.end(); i++) {
+				statuses[i] = check_transaction(to_check[i].tx);
+			}
+		});
+
+	std::vector<HeldTransaction> still_held;
+	uint64_t num_dropped = 0;
+
+	for (size_t i = 0; i < to_check.size(); i++) {
+		auto& held = to_check[i];
+		switch(statuses[i]) {
+			case TransactionProcessingStatus::SUCCESS:
+				released.push_back(std::move(held.tx));
+				break;
+			case TransactionProcessingStatus::SOURCE_ACCOUNT_NEXIST:
+				held.num_rechecks++;
+				if (held.num_rechecks < MAX_HELD_RECHECKS) {
+					still_held.push_back(std::move(held));
+					break;
+				}
+				[[fallthrough]];
+			default:
+				MEMPOOL_INFO("dropped held tx from account %lu: status %d",
+					held.tx.transaction.metadata.sourceAccount, statuses[i]);
+				num_dropped++;
+		}
+	}
+
+	num_held_dropped.fetch_add(num_dropped, std::memory_order_relaxed);
+
+	if (still_held.size() > 0) {
+		std::lock_guard lock(held_mtx);
+		held_txs.insert(
+			held_txs.end(),
+			std::make_move_iterator(still_held.begin()),
+			std::make_move_iterator(still_held.end()));
+	}
+	return released;
+}
+
+} /* edce */
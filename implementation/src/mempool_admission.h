@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "memory_database.h"
+#include "verified_transaction_cache.h"
+
+#include "xdr/transaction.h"
+
+namespace edce {
+
+/*
+Cheap, stateless (or stale-state-tolerant) checks run on txs as they arrive at the mempool,
+so that obviously bad txs never occupy mempool space or block production time.
+
+Every check here is one that the serial tx processor would also fail, so a tx
+rejected at admission could never have been included in a block.
+The converse is not true; passing admission says nothing about balances, offers, etc.
+
+Signatures are checked here (in parallel), and verified txs are recorded in the
+VerifiedTransactionCache.  The block producer does not check signatures again,
+so no tx reaches the mempool without a signature check.
+
+A tx whose source account is not committed yet has no pk to check against,
+but it can't be rejected either (the account might be created by a tx still in the mempool).
+Such txs are held here, out of the mempool, and rechecked after each block by release_held_txs().
+*/
+class MempoolAdmissionChecker {
+
+	//bounds memory spent on txs from accounts that may never exist.
+	constexpr static size_t MAX_HELD_TXS = 100'000;
+	//a held tx is dropped if its source account still does not exist after this many rechecks.
+	constexpr static uint32_t MAX_HELD_RECHECKS = 10;
+
+	struct HeldTransaction {
+		SignedTransaction tx;
+		uint32_t num_rechecks = 0;
+	};
+
+	const MemoryDatabase& db;
+	VerifiedTransactionCache& verified_tx_cache;
+	const uint16_t num_assets;
+
+	//experiments that replay unsigned synthetic txs can turn this off.
+	const bool check_sigs;
+
+	std::mutex held_mtx;
+	std::vector<HeldTransaction> held_txs;
+
+	TransactionProcessingStatus check_operation(const Operation& op) const;
+
+public:
+
+	std::atomic<uint64_t> num_admitted = 0;
+	std::atomic<uint64_t> num_rejected = 0;
+	std::atomic<uint64_t> num_sig_cache_hits = 0;
+	//source account not yet committed, so held for a later sig check.
+	std::atomic<uint64_t> num_unverified = 0;
+	//held txs that failed their recheck, or whose account never appeared.
+	std::atomic<uint64_t> num_held_dropped = 0;
+
+	MempoolAdmissionChecker(
+		const MemoryDatabase& db,
+		VerifiedTransactionCache& verified_tx_cache,
+		uint16_t num_assets,
+		bool check_sigs = true);
+
+	//format and per-operation parameter checks only.  Does not touch the db.
+	TransactionProcessingStatus check_static_parameters(const Transaction& tx) const;
+
+	//threadsafe.  Reads committed db state only.  A concurrent block commit can only
+	//make the SEQ_NUM_TOO_LOW check more permissive than it could be, never wrong.
+	//Returns SOURCE_ACCOUNT_NEXIST if the source account is not committed (and sigs are checked),
+	//since the signature can't be verified yet.
+	TransactionProcessingStatus check_transaction(const SignedTransaction& tx);
+
+	//Checks all txs in parallel.  Writes one status per tx into statuses_out,
+	//and removes rejected and held txs from txs (preserving order of those that remain).
+	//Held txs are reported as SUCCESS, unless the hold is full.
+	//Returns the number of txs admitted (remaining in txs or held).
+	size_t filter_transactions(
+		std::vector<SignedTransaction>& txs,
+		TransactionProcessingStatus* statuses_out);
+
+	//Rechecks held txs against the committed db.  Returns the ones that now pass every check
+	//(so can go to the mempool), drops those that fail, and keeps holding the rest.
+	//Call once per block, after the previous block's commit.
+	std::vector<SignedTransaction> release_held_txs();
+
+	size_t num_held_txs() {
+		std::lock_guard lock(held_mtx);
+		return held_txs.size();
+	}
+};
+
+} /* edce */
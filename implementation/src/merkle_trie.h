@@ -1,4 +1,5 @@
 #pragma once
+#include <array>
 #include <unordered_map>
 #include <memory>
 #include <mutex>
@@ -105,6 +106,92 @@ public:
 	}
 
 };
+
+/*
+Version word of a trie node, for optimistic concurrent insertion (parallel_insert).
+
+Readers take no locks.  They read a version, read the node, and then check
+that the version is unchanged.  Writers set WRITE_LOCKED, and additionally
+STRUCTURE_LOCKED if they change the node's prefix, children, or value.
+Releasing a structure lock increments the version, invalidating concurrent readers.
+Metadata updates take only WRITE_LOCKED, and don't disturb readers.
+
+Fits in the padding after hash_valid, so nodes are no larger than without it.
+*/
+class OptimisticVersion {
+	std::atomic<uint32_t> version = 0;
+
+	constexpr static uint32_t WRITE_LOCKED = 1;
+	constexpr static uint32_t STRUCTURE_LOCKED = 2;
+	constexpr static uint32_t INCREMENT = 4;
+
+	//lock holders might be descheduled (e.g. with more inserting threads than cores)
+	static void backoff(unsigned int& spins) {
+		if (spins++ < 64) {
+			__builtin_ia32_pause();
+		} else {
+			std::this_thread::yield();
+		}
+	}
+
+public:
+
+	//waits for any structural modification to finish
+	uint32_t read_begin() const {
+		unsigned int spins = 0;
+		while (true) {
+			auto v = version.load(std::memory_order_acquire);
+			if (!(v & STRUCTURE_LOCKED)) {
+				return v & ~WRITE_LOCKED;
+			}
+			backoff(spins);
+		}
+	}
+
+	//true iff the node's structure has not changed since read_begin() returned v
+	bool validate(uint32_t v) const {
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return (version.load(std::memory_order_relaxed) & ~WRITE_LOCKED) == v;
+	}
+
+	//fails if the node's structure changed since read_begin() returned v
+	bool try_lock_structure(uint32_t v) {
+		unsigned int spins = 0;
+		while (true) {
+			uint32_t expect = v;
+			if (version.compare_exchange_weak(
+				expect, v | WRITE_LOCKED | STRUCTURE_LOCKED, std::memory_order_acquire, std::memory_order_relaxed)) {
+				return true;
+			}
+			if ((expect & ~WRITE_LOCKED) != v) {
+				return false;
+			}
+			backoff(spins);
+		}
+	}
+
+	void unlock_structure() {
+		auto v = version.load(std::memory_order_relaxed);
+		version.store((v & ~(WRITE_LOCKED | STRUCTURE_LOCKED)) + INCREMENT, std::memory_order_release);
+	}
+
+	//returns the version as of locking
+	uint32_t lock_metadata() {
+		unsigned int spins = 0;
+		while (true) {
+			auto v = version.load(std::memory_order_relaxed);
+			if (!(v & WRITE_LOCKED) 
+				&& version.compare_exchange_weak(v, v | WRITE_LOCKED, std::memory_order_acquire, std::memory_order_relaxed)) {
+				return v;
+			}
+			backoff(spins);
+		}
+	}
+
+	void unlock_metadata() {
+		version.fetch_and(~WRITE_LOCKED, std::memory_order_release);
+	}
+};
 template<typename TrieT, typename MetadataType>
 struct BatchMergeRange;
 
@@ -121,6 +208,10 @@ class TrieNode {
 public:
 	constexpr static bool HAS_VALUE = !std::is_same<EmptyValue, ValueType>::value;
 	constexpr static bool HAS_METADATA = !std::is_same<EmptyMetadata, MetadataType>::value;
+
+	//see ValueContextTraits.  apply() passes leaves with a value context along with their keys.
+	using value_context_t = typename ValueContextTraits<ValueType>::context_t;
+	constexpr static bool HAS_VALUE_CONTEXT = ValueContextTraits<ValueType>::HAS_CONTEXT;
 	constexpr static bool METADATA_DELETABLE = std::is_base_of<DeletableMixin, MetadataType>::value;
 	constexpr static bool HAS_SIZE = std::is_base_of<SizeMixin, MetadataType>::value;
 	constexpr static bool METADATA_ROLLBACK = std::is_base_of<RollbackMixin, MetadataType>::value;
@@ -129,8 +220,10 @@ public:
 	constexpr static unsigned int BRANCH_BITS_EXPORT = BRANCH_BITS;
 
 	//Metadata locking is slightly odd.
-	//Adding/subtracting MetadataTypes to AtomicMetadataTypes can be interleaved, as in parallel_insert.
+	//Adding/subtracting MetadataTypes to AtomicMetadataTypes can be interleaved.
 	//This is because metadata is constructed to be commutative.
+	//(parallel_insert still serializes a node's metadata updates with its version word,
+	//so that a prefix split copies a consistent value.)
 	//Thus, we allow metadata modification if you own a shared_lock on a node.
 	//However, that means that reads not exclusively locked might be sheared (shorn?)
 
@@ -192,6 +285,9 @@ private:
 
 	std::atomic_bool hash_valid = false;
 
+	//used only by parallel_insert
+	OptimisticVersion version;
+
 	AtomicMetadataType metadata;
 	
 	OptionalLock<USE_LOCKS> locks;
@@ -252,8 +348,9 @@ private:
 	template<typename InsertFn, typename InsertedValueType>
 	const MetadataType _insert(const prefix_t& key, const InsertedValueType& leaf_value);
 
+	//One optimistic attempt, from the root.  Returns false if the attempt must be retried.
 	template<typename InsertFn, typename InsertedValueType>
-	const std::optional<MetadataType> _parallel_insert(const prefix_t& key, const InsertedValueType& leaf_value);
+	bool _parallel_insert(const prefix_t& key, const InsertedValueType& leaf_value);
 
 	Hash& get_hash_ptr() {
 		return hash;
@@ -309,6 +406,7 @@ public:
 		LOG("metadata   %lu %lu", offsetof(TrieNode, metadata), sizeof(metadata));	
 		LOG("hash       %lu %lu", offsetof(TrieNode, hash), sizeof(hash));	
 		LOG("hash_valid %lu %lu", offsetof(TrieNode, hash_valid), sizeof(hash_valid));
+		LOG("version    %lu %lu", offsetof(TrieNode, version), sizeof(version));
 	}
 	struct iterator {
 
@@ -382,6 +480,137 @@ public:
 		}
 	};
 
+	//Same traversal as iterator, but keeps the path from the starting node to the current leaf
+	//in a fixed-size inline stack, so iterating allocates nothing.
+	//Each frame holds a node and those of its children not yet visited.
+	struct stack_iterator {
+
+		using kv_t = std::pair<const prefix_t, std::reference_wrapper<const ValueType>>;
+
+		//every node on a path extends its parent's prefix by at least BRANCH_BITS
+		constexpr static size_t MAX_DEPTH = MAX_KEY_LEN_BITS.len / BRANCH_BITS + 1;
+
+		struct frame {
+			const TrieNode* node;
+			typename children_map_t::const_iterator next;
+		};
+
+		std::array<frame, MAX_DEPTH> stack;
+		//stack[depth-1] is the current leaf, when not at_end()
+		size_t depth = 0;
+
+		stack_iterator(const TrieNode& start) {
+			push(&start, start.children.begin());
+			settle();
+		}
+
+		//starts at the first key >= lo
+		stack_iterator(const TrieNode& start, const prefix_t& lo) {
+			seek(&start, lo);
+			settle();
+		}
+
+		const prefix_t& key() const {
+			return stack[depth-1].node->prefix;
+		}
+
+		const ValueType& value() const {
+			return stack[depth-1].node->children.value();
+		}
+
+		const kv_t operator*() const {
+			if (at_end()) {
+				throw std::runtime_error("deref iter end");
+			}
+			return std::make_pair(key(), std::cref(value()));
+		}
+
+		//returns true if the iterator is now at the end, as in iterator
+		bool operator++() {
+			if (at_end()) {
+				return true;
+			}
+			//pop the current leaf
+			depth--;
+			settle();
+			return at_end();
+		}
+
+		bool at_end() const {
+			return depth == 0;
+		}
+
+	private:
+
+		void push(const TrieNode* node, typename children_map_t::const_iterator next) {
+			if (depth == MAX_DEPTH) {
+				throw std::runtime_error("stack_iterator overflow");
+			}
+			stack[depth] = frame{node, next};
+			depth++;
+		}
+
+		//descends to the leftmost unvisited leaf, popping exhausted nodes
+		void settle() {
+			while (depth > 0) {
+				auto& top = stack[depth-1];
+				if (top.node->prefix_len == MAX_KEY_LEN_BITS) {
+					return;
+				}
+				if (top.next == children_map_t::cend()) {
+					depth--;
+					continue;
+				}
+				const TrieNode* child = (*top.next).second;
+				top.next++;
+				push(child, child->children.begin());
+			}
+		}
+
+		//pushes the path towards lo, leaving in each frame only the children above lo's branch
+		void seek(const TrieNode* node, const prefix_t& lo) {
+			while (true) {
+				if (node->prefix_len == MAX_KEY_LEN_BITS) {
+					if (node->prefix >= lo) {
+						push(node, children_map_t::cend());
+					}
+					return;
+				}
+
+				prefix_t lo_truncated = lo;
+				truncate_prefix(lo_truncated, node->prefix_len, MAX_KEY_LEN_BITS);
+
+				if (node->prefix > lo_truncated) {
+					push(node, node->children.begin());
+					return;
+				}
+				if (node->prefix < lo_truncated) {
+					return;
+				}
+
+				auto bb = node->get_branch_bits(lo);
+				push(node, node->children.lower_bound(bb + 1));
+
+				auto child = node->children.find(bb);
+				if (child == children_map_t::cend()) {
+					return;
+				}
+				node = (*child).second;
+			}
+		}
+	};
+
+	//true if the subtree might contain keys in [lo, hi).  Exact at leaves.
+	bool overlaps_range(const prefix_t& lo, const prefix_t& hi) const {
+		if (prefix_len == MAX_KEY_LEN_BITS) {
+			return prefix >= lo && prefix < hi;
+		}
+		prefix_t lo_truncated = lo, hi_truncated = hi;
+		truncate_prefix(lo_truncated, prefix_len, MAX_KEY_LEN_BITS);
+		truncate_prefix(hi_truncated, prefix_len, MAX_KEY_LEN_BITS);
+		return prefix >= lo_truncated && prefix <= hi_truncated;
+	}
+
 /*
 	trie_ptr_t duplicate_node_only_unsafe() {
 		return std::make_unique<TrieNode>(prefix, prefix_len, metadata);
@@ -528,7 +757,7 @@ public:
 	void parallel_insert(typename std::enable_if<!x, const prefix_t&>::type key);
 
 	template<typename... ApplyToValueBeforeHashFn>
-	void compute_hash();
+	void compute_hash(const value_context_t& context = value_context_t());
 
 	template<bool x = HAS_VALUE>
 	std::optional<ValueType> get_value(typename std::enable_if<x, const prefix_t&>::type query_key);
@@ -598,6 +827,8 @@ public:
 
 	size_t uncached_size() const;
 
+	void accumulate_memory_usage(TrieMemoryUsage& usage) const;
+
 	void accumulate_and_freeze_unhashed_nodes(
 		std::vector<std::reference_wrapper<TrieNode>>& nodes);
 
@@ -608,7 +839,7 @@ public:
 	void accumulate_keys(VectorType& values);
 
 	ProofNode create_proof_node();
-	void create_proof(Proof& proof, prefix_t data);
+	void create_proof(Proof& proof, prefix_t data, const value_context_t& context = value_context_t());
 
 	const MetadataType get_metadata_unsafe() {
 		return metadata.unsafe_load();
@@ -863,6 +1094,15 @@ public:
 	//trie_ptr_t
 	//metadata_split(const typename MetadataPredicate::param_t split_parameter, TypeWrapper<MetadataPredicate> overload);
 
+	template<typename ApplyFn, typename LeafValueType>
+	void apply_to_leaf(ApplyFn& func, LeafValueType& value) const {
+		if constexpr (HAS_VALUE_CONTEXT) {
+			func(prefix, value);
+		} else {
+			func(value);
+		}
+	}
+
 	template<typename ApplyFn>
 	void apply(ApplyFn& func);
 
@@ -875,6 +1115,10 @@ public:
 	template<typename ApplyFn>
 	void apply_lt_key(ApplyFn& func, const prefix_t min_apply_key);
 
+	//calls func(key, value) on every leaf with lo <= key < hi, in key order
+	template<typename ScanFn>
+	void range_scan(ScanFn& func, const prefix_t& lo, const prefix_t& hi) const;
+
 	std::optional<prefix_t> get_lowest_key();
 
 	//trie_ptr_t deep_copy();
@@ -929,6 +1173,8 @@ class _BaseTrie {
 public:
 	using TrieT = TrieNode<KEY_LEN_BYTES, ValueType, MetadataType, USE_LOCKS, BRANCH_BITS>;
 	using prefix_t = typename TrieT::prefix_t;
+	using value_t = ValueType;
+	using value_context_t = typename TrieT::value_context_t;
 	constexpr static PrefixLenBits MAX_KEY_LEN_BITS = TrieT::MAX_KEY_LEN_BITS;
 protected:
 
@@ -981,9 +1227,9 @@ protected:
 	}
 
 	template<bool use_locks_template = USE_LOCKS, typename... ApplyFn>
-	void _freeze_and_hash(typename std::enable_if<use_locks_template, Hash&>::type buf);
+	void _freeze_and_hash(typename std::enable_if<use_locks_template, Hash&>::type buf, const value_context_t& context = value_context_t());
 	template<bool use_locks_template = USE_LOCKS, typename... ApplyFn>
-	void _freeze_and_hash(typename std::enable_if<!use_locks_template, Hash&>::type buf);
+	void _freeze_and_hash(typename std::enable_if<!use_locks_template, Hash&>::type buf, const value_context_t& context = value_context_t());
 
 	void get_root_hash(Hash& out);
 
@@ -994,9 +1240,9 @@ public:
 	}
 
 	struct iterator {
-		typename TrieT::iterator iter;
+		typename TrieT::stack_iterator iter;
 		
-		using kv_t = typename TrieT::iterator::kv_t;
+		using kv_t = typename TrieT::stack_iterator::kv_t;
 
 		const kv_t operator*() { return *iter;}
 
@@ -1068,6 +1314,16 @@ public:
 		}
 		return 0;
 	}
+
+	//Walks the whole trie.
+	TrieMemoryUsage memory_usage() const {
+		std::shared_lock lock(*hash_modify_mtx);
+		TrieMemoryUsage usage;
+		if (root) {
+			root -> accumulate_memory_usage(usage);
+		}
+		return usage;
+	}
 	void _log(std::string padding) {
 		if (get_hash_valid()) {
 			Hash buf;
@@ -1187,14 +1443,33 @@ public:
 	void
 	parallel_batch_value_modify(ValueModifyFn& fn) const;
 
-	//template<typename ApplyFn>
-	//void
-	//parallel_apply_threadlocal_acc(ApplyFn& fn) const;
+	//Each range of the iteration applies its own functor, obtained from fn.new_threadlocal(),
+	//and passes it to fn.finish_local() once the range is done.
+	template<typename ApplyFn>
+	void
+	parallel_apply_threadlocal_acc(ApplyFn& fn) const;
 
 	template<typename ApplyFn>
 	void
 	parallel_apply(ApplyFn& fn) const;
 
+	//Calls fn(key, value) on every key in [lo, hi), in key order.
+	template<typename ScanFn>
+	void range_scan(ScanFn& fn, const prefix_t& lo, const prefix_t& hi) const {
+		std::shared_lock lock(*hash_modify_mtx);
+		if (!root) {
+			throw std::runtime_error("root is null!!!");
+		}
+		root -> range_scan(fn, lo, hi);
+	}
+
+	//Splits [lo, hi) into disjoint key ranges by subtree, and scans them in parallel.
+	//fn is called concurrently, but in key order within each range.
+	//Requires size metadata, as parallel_apply.
+	template<typename ScanFn>
+	void
+	parallel_range_scan(ScanFn& fn, const prefix_t& lo, const prefix_t& hi) const;
+
 	template<typename ApplyFn>
 	void apply_geq_key(ApplyFn& func, const prefix_t min_apply_key) {
 		std::shared_lock lock(*hash_modify_mtx);
@@ -1336,10 +1611,10 @@ public:
 	FrozenMerkleTrie(trie_ptr_t&& root_ptr) : BaseT(std::move(root_ptr)) {}
 	FrozenMerkleTrie() : BaseT() {}
 
-	Proof generate_proof(prefix_t data) {
+	Proof generate_proof(prefix_t data, const typename BaseT::value_context_t& context = typename BaseT::value_context_t()) {
 		Proof output;
 		
-		BaseT::root -> create_proof(output, data);
+		BaseT::root -> create_proof(output, data, context);
 
 		auto bytes = data.get_bytes_array();
 
@@ -1350,7 +1625,7 @@ public:
 		return output;
 	}
 
-	void get_hash(Hash& buffer);
+	void get_hash(Hash& buffer, const typename BaseT::value_context_t& context = typename BaseT::value_context_t());
 };
 
 template<
@@ -1458,6 +1733,8 @@ public:
 		BaseT::root->template insert<x, InsertFn>(data);
 	}
 
+	//Threadsafe with respect to other parallel_inserts (but no other modifications).
+	//Works without node locks (USE_LOCKS = false) too.
 	template<typename InsertFn = OverwriteInsertFn, bool x = HAS_VALUE>
 	void parallel_insert(typename std::enable_if<!x, const prefix_t>::type data) {
 		std::shared_lock  lock(*BaseT::hash_modify_mtx);
@@ -1534,9 +1811,10 @@ public:
 		BaseT::root->template parallel_merge_in<MergeFn>(std::move(other.root));
 	}
 
+	//context is passed to leaf values that have one (see ValueContextTraits)
 	template<typename... ApplyFn>
-	void freeze_and_hash(Hash& buf) {
-		BaseT::template _freeze_and_hash<USE_LOCKS, ApplyFn...>(buf);
+	void freeze_and_hash(Hash& buf, const typename BaseT::value_context_t& context = typename BaseT::value_context_t()) {
+		BaseT::template _freeze_and_hash<USE_LOCKS, ApplyFn...>(buf, context);
 	}
 
 	FrozenT destructive_freeze() {
@@ -1845,7 +2123,8 @@ void TrieNode<TEMPLATE_PARAMS>::_log(std::string padding) const {
 		std::vector<unsigned char> buf;
 		auto value = children.value();
 		//value.serialize();
-		value.copy_data(buf);
+		//values with a context are logged as if with a default context
+		ValueContextTraits<ValueType>::copy_data(value, buf, prefix, value_context_t());
 		auto str = __wrapper::__array_to_str(buf.data(), buf.size());
 		LOG("%svalue serialization is %s", padding.c_str(), str.c_str());
 		buf.clear();
@@ -1910,6 +2189,23 @@ size_t TrieNode<TEMPLATE_PARAMS>::uncached_size() const {
 	return sz;
 }
 
+TEMPLATE_SIGNATURE
+void TrieNode<TEMPLATE_PARAMS>::accumulate_memory_usage(TrieMemoryUsage& usage) const {
+	usage.num_nodes++;
+	usage.bytes += sizeof(TrieNode);
+	if (prefix_len == MAX_KEY_LEN_BITS) {
+		usage.num_leaves++;
+		return;
+	}
+	if (children.uses_heap_map()) {
+		usage.num_heap_children_maps++;
+		usage.bytes += children_map_t::HEAP_MAP_BYTES;
+	}
+	for (auto iter = children.begin(); iter != children.end(); iter++) {
+		(*iter).second->accumulate_memory_usage(usage);
+	}
+}
+
 //return metadata of all subnodes <= query_prefix (up to query_len)
 // query for 0x1234 with len 16 (bits) matches 0x1234FFFFF but not 0x1235
 TEMPLATE_SIGNATURE
@@ -2019,7 +2315,12 @@ hash of root node
 */
 
 template <typename ValueType, typename prefix_t>
-static void compute_hash_value_node(Hash& hash_buf, const prefix_t prefix, const PrefixLenBits prefix_len, ValueType& value) {
+static void compute_hash_value_node(
+	Hash& hash_buf, 
+	const prefix_t prefix, 
+	const PrefixLenBits prefix_len, 
+	ValueType& value, 
+	const typename ValueContextTraits<ValueType>::context_t& context) {
 	//try {
 	//	value.serialize();
 	//} catch(...) {
@@ -2039,7 +2340,7 @@ static void compute_hash_value_node(Hash& hash_buf, const prefix_t prefix, const
 
 		write_node_header(digest_bytes, prefix, prefix_len);
 
-		value.copy_data(digest_bytes);
+		ValueContextTraits<ValueType>::copy_data(value, digest_bytes, prefix, context);
 		
 		SHA256(digest_bytes.data(), digest_bytes.size(), hash_buf.data());
 		//delete[] digest_bytes;
@@ -2050,10 +2351,10 @@ static void compute_hash_value_node(Hash& hash_buf, const prefix_t prefix, const
 	}
 }
 
-template<typename Map, unsigned int BRANCH_BITS, bool IGNORE_DELETED_SUBNODES, typename prefix_t, typename... ApplyToValueBeforeHashFn>
+template<typename Map, unsigned int BRANCH_BITS, bool IGNORE_DELETED_SUBNODES, typename prefix_t, typename context_t, typename... ApplyToValueBeforeHashFn>
 static 
 typename std::enable_if<!IGNORE_DELETED_SUBNODES, void>::type 
-compute_hash_branch_node(Hash& hash_buf, const prefix_t prefix, const PrefixLenBits prefix_len, const Map& children) {
+compute_hash_branch_node(Hash& hash_buf, const prefix_t prefix, const PrefixLenBits prefix_len, const Map& children, const context_t& context) {
 	
 	//int num_header_bytes = get_header_bytes(prefix_len);
 
@@ -2063,7 +2364,7 @@ compute_hash_branch_node(Hash& hash_buf, const prefix_t prefix, const PrefixLenB
 		if (!(*iter).second) {
 			throw std::runtime_error("can't recurse hash down null ptr");
 		}
-		(*iter).second->template compute_hash<ApplyToValueBeforeHashFn...>();
+		(*iter).second->template compute_hash<ApplyToValueBeforeHashFn...>(context);
 
 	}
 	uint8_t num_children = children.size();
@@ -2109,10 +2410,10 @@ compute_hash_branch_node(Hash& hash_buf, const prefix_t prefix, const PrefixLenB
 	}
 }
 
-template<typename Map, unsigned int BRANCH_BITS, bool IGNORE_DELETED_SUBNODES, typename prefix_t, typename... ApplyToValueBeforeHashFn>
+template<typename Map, unsigned int BRANCH_BITS, bool IGNORE_DELETED_SUBNODES, typename prefix_t, typename context_t, typename... ApplyToValueBeforeHashFn>
 static 
 typename std::enable_if<IGNORE_DELETED_SUBNODES, void>::type 
-compute_hash_branch_node(Hash& hash_buf, const prefix_t prefix, const PrefixLenBits prefix_len, const Map& children) {
+compute_hash_branch_node(Hash& hash_buf, const prefix_t prefix, const PrefixLenBits prefix_len, const Map& children, const context_t& context) {
 	
 	//int num_header_bytes = get_header_bytes(prefix_len);
 
@@ -2126,7 +2427,7 @@ compute_hash_branch_node(Hash& hash_buf, const prefix_t prefix, const PrefixLenB
 			if (!(*iter).second) {
 				throw std::runtime_error("can't recurse hash down null ptr");
 			}
-			(*iter).second->template compute_hash<ApplyToValueBeforeHashFn...>();
+			(*iter).second->template compute_hash<ApplyToValueBeforeHashFn...>(context);
 		}
 		if (child_meta.size < child_meta.num_deleted_subnodes) {
 			std::printf("child_meta size: %lu child num_deleted_subnodes: %d\n", child_meta.size, child_meta.num_deleted_subnodes);
@@ -2190,7 +2491,7 @@ compute_hash_branch_node(Hash& hash_buf, const prefix_t prefix, const PrefixLenB
 
 TEMPLATE_SIGNATURE
 template<typename... ApplyToValueBeforeHashFn>
-void TrieNode<TEMPLATE_PARAMS>::compute_hash() {
+void TrieNode<TEMPLATE_PARAMS>::compute_hash(const value_context_t& context) {
 
 	//[[maybe_unused]]
 	//auto lock = locks.template lock<TrieNode::exclusive_lock_t>();
@@ -2211,9 +2512,9 @@ void TrieNode<TEMPLATE_PARAMS>::compute_hash() {
 		auto& value = children.value();
 
 		(ApplyToValueBeforeHashFn::apply_to_value(value),...);
-		compute_hash_value_node(hash, prefix, prefix_len, value);
+		compute_hash_value_node(hash, prefix, prefix_len, value, context);
 	} else {
-		compute_hash_branch_node<children_map_t, BRANCH_BITS, METADATA_DELETABLE, prefix_t, ApplyToValueBeforeHashFn...>(hash, prefix, prefix_len, children);
+		compute_hash_branch_node<children_map_t, BRANCH_BITS, METADATA_DELETABLE, prefix_t, value_context_t, ApplyToValueBeforeHashFn...>(hash, prefix, prefix_len, children, context);
 	}
 
 	validate_hash();
@@ -2273,7 +2574,7 @@ void TrieNode<TEMPLATE_PARAMS>::accumulate_and_freeze_unhashed_nodes(
 
 
 TEMPLATE_SIGNATURE
-void FrozenMerkleTrie<TEMPLATE_PARAMS>::get_hash(Hash& buffer) {
+void FrozenMerkleTrie<TEMPLATE_PARAMS>::get_hash(Hash& buffer, const typename BaseT::value_context_t& context) {
 	std::lock_guard lock(*BaseT::hash_modify_mtx);
 	if (BaseT::get_hash_valid()) {
 		buffer = BaseT::root_hash;
@@ -2281,7 +2582,7 @@ void FrozenMerkleTrie<TEMPLATE_PARAMS>::get_hash(Hash& buffer) {
 	}
 
 	//root->reset_hash_flags();
-	BaseT::root->compute_hash();
+	BaseT::root->compute_hash(context);
 	BaseT::get_root_hash(BaseT::root_hash);
 	buffer = BaseT::root_hash;
 	//if (buffer != nullptr) {
@@ -2292,7 +2593,7 @@ void FrozenMerkleTrie<TEMPLATE_PARAMS>::get_hash(Hash& buffer) {
 
 TEMPLATE_SIGNATURE
 template <bool use_locks_template, typename ...ApplyFn>
-void _BaseTrie<TEMPLATE_PARAMS>::_freeze_and_hash(typename std::enable_if<!use_locks_template, Hash&>::type buffer) {
+void _BaseTrie<TEMPLATE_PARAMS>::_freeze_and_hash(typename std::enable_if<!use_locks_template, Hash&>::type buffer, const value_context_t& context) {
 	static_assert(use_locks_template == USE_LOCKS, "no funny business");
 	std::lock_guard lock(*hash_modify_mtx);
 
@@ -2305,7 +2606,7 @@ void _BaseTrie<TEMPLATE_PARAMS>::_freeze_and_hash(typename std::enable_if<!use_l
 		throw std::runtime_error("root should not be nullptr in _freeze_and_hash");	
 	}
 
-	root -> compute_hash();
+	root -> compute_hash(context);
 
 	get_root_hash(root_hash);
 	//if (buffer != nullptr) {
@@ -2744,7 +3045,7 @@ TrieNode<TEMPLATE_PARAMS>::invalidate_hash_to_node_nolocks(TrieNode* target) {
 TEMPLATE_SIGNATURE
 template <bool use_locks_template, typename ...ApplyFn>
 void 
-_BaseTrie<TEMPLATE_PARAMS>::_freeze_and_hash(typename std::enable_if<use_locks_template, Hash&>::type buffer) {
+_BaseTrie<TEMPLATE_PARAMS>::_freeze_and_hash(typename std::enable_if<use_locks_template, Hash&>::type buffer, const value_context_t& context) {
 
 	static_assert(use_locks_template == USE_LOCKS, "no funny business");
 	std::lock_guard lock(*hash_modify_mtx);
@@ -2761,9 +3062,9 @@ _BaseTrie<TEMPLATE_PARAMS>::_freeze_and_hash(typename std::enable_if<use_locks_t
 	//No fences needed if other locations have acquires to sync
 	tbb::parallel_for(
 		HashRange<TrieT>(root),
-		[] (const auto& r) {
+		[&context] (const auto& r) {
 			for (size_t idx = 0; idx < r.num_nodes(); idx++) {
-				r[idx] -> template compute_hash<ApplyFn...>();
+				r[idx] -> template compute_hash<ApplyFn...>(context);
 			}
 		});
 
@@ -2791,7 +3092,7 @@ _BaseTrie<TEMPLATE_PARAMS>::_freeze_and_hash(typename std::enable_if<use_locks_t
 			node.get().compute_hash();
 		});*/
 
-	root -> template compute_hash<ApplyFn...>();
+	root -> template compute_hash<ApplyFn...>(context);
 
 	get_root_hash(root_hash);
 	//if (buffer != nullptr) {	
@@ -2835,13 +3136,13 @@ ProofNode TrieNode<TEMPLATE_PARAMS>::create_proof_node() {
 }
 
 TEMPLATE_SIGNATURE
-void TrieNode<TEMPLATE_PARAMS>::create_proof(Proof& proof, prefix_t data) {
+void TrieNode<TEMPLATE_PARAMS>::create_proof(Proof& proof, prefix_t data, const value_context_t& context) {
 
 	proof.nodes.push_back(create_proof_node());
 
 	if (prefix_len == MAX_KEY_LEN_BITS) {
 		proof.membership_flag = 1;
-		children.value().copy_data(proof.value_bytes);
+		ValueContextTraits<ValueType>::copy_data(children.value(), proof.value_bytes, prefix, context);
 		return;
 	}
 	
@@ -2849,7 +3150,7 @@ void TrieNode<TEMPLATE_PARAMS>::create_proof(Proof& proof, prefix_t data) {
 	auto iter = children.find(branch_bits);
 
 	if (iter != children.end()) {
-		(*iter).second->create_proof(proof, data);
+		(*iter).second->create_proof(proof, data, context);
 	}
 
 }
@@ -2881,10 +3182,7 @@ template<bool x, typename InsertFn, typename InsertedValueType>
 void TrieNode<TEMPLATE_PARAMS>::parallel_insert(
 	typename std::enable_if<x, const prefix_t&>::type data, const InsertedValueType& leaf_value) {
 	static_assert(x == HAS_VALUE, "no funny games");
-	auto res = _parallel_insert<InsertFn, InsertedValueType>(data, leaf_value);
-	if (!res) {
-		_insert<InsertFn, InsertedValueType>(data, leaf_value);
-	}
+	while (!_parallel_insert<InsertFn, InsertedValueType>(data, leaf_value)) {}
 }
 
 TEMPLATE_SIGNATURE
@@ -2901,74 +3199,128 @@ void TrieNode<TEMPLATE_PARAMS>::parallel_insert(
 
 	TRIE_INFO("current size:%d", size());
 
-	auto res = _parallel_insert<InsertFn, EmptyValue>(data, EmptyValue{});
-	if (!res) {
-		_insert<InsertFn, EmptyValue>(data, EmptyValue{});
-	}
+	while (!_parallel_insert<InsertFn, EmptyValue>(data, EmptyValue{})) {}
 }
 
 
+/*
+Optimistic lock coupling.  The descent takes no locks; each node is read between
+read_begin() and validate() of its version, and any conflict restarts from the root.
+Only the node that changes (a leaf that is overwritten, a node that gains a leaf,
+or a node whose prefix is split) is structure-locked, and serial _insert()
+modifies just that node.
+
+Ancestors' metadata is then updated bottom-up, each under its own (metadata) write lock.
+Since we passed an ancestor, a split might have moved its contents to a new node
+between it and the next node of our path; such a node copied the ancestor's metadata
+before we got to it, so it needs the delta too.  Splits only insert such nodes below
+a locked node, so they are found by walking down from the ancestor, coupling locks.
+
+Concurrent with other parallel_inserts only.  Nodes are never freed during insertion,
+so a stale child pointer (read before a failed validation) is never dangling.
+*/
 TEMPLATE_SIGNATURE
 template<typename InsertFn, typename InsertedValueType>
-const std::optional<MetadataType>
+bool
 TrieNode<TEMPLATE_PARAMS>::_parallel_insert(const prefix_t& data, const InsertedValueType& leaf_value) {
-	
-	static_assert(USE_LOCKS, "can't parallelize insertion without locks");
 
-	throw std::runtime_error("I took the locks off of _insert to speed performance there!  parallel_insert requires those locks.");
+	constexpr static size_t MAX_DEPTH = MAX_KEY_LEN_BITS.len / BRANCH_BITS + 1;
 
-	auto volatile lock = locks.template lock<TrieNode::shared_lock_t>();
-	//std::shared_lock lock(*mtx);
+	struct path_entry {
+		TrieNode* node;
+		uint32_t version;
+	};
 
-	invalidate_hash();
+	std::array<path_entry, MAX_DEPTH> path;
+	size_t depth = 0;
 
+	TrieNode* node = this;
+	uint32_t node_version = node->version.read_begin();
 
-	//if (is_frozen) {
-	//	throw std::runtime_error("can't modify frozen trie node");
-	//}
+	while (true) {
+		auto prefix_match_len = node->get_prefix_match_len(data);
+		bool is_empty = node->prefix_len.len == 0 && node->children.empty();
 
-	auto prefix_match_len = get_prefix_match_len(data);
+		if (is_empty || prefix_match_len < node->prefix_len || node->prefix_len == MAX_KEY_LEN_BITS) {
+			break;
+		}
 
-	if (prefix_len.len == 0 && children.empty()) {
-		return std::nullopt;
-		//lock.unlock();
-		//return _insert<InsertFn, InsertedValueType>(data, leaf_value);
-	} else if (prefix_match_len >= prefix_len) {
-		if (prefix_len == MAX_KEY_LEN_BITS) {
-			return std::nullopt;
-			//lock.unlock();
-			//return _insert<InsertFn, InsertedValueType>(data, leaf_value);
+		auto branch_bits = node->get_branch_bits(data);
+		TrieNode* child = node->children.optimistic_find(
+			branch_bits, 
+			[node, node_version] () {return node->version.validate(node_version);});
+
+		if (!node->version.validate(node_version)) {
+			return false;
+		}
+		if (child == nullptr) {
+			break;
 		}
 
-		auto branch_bits = get_branch_bits(data);
-		auto iter = children.find(branch_bits);
-		if (iter != children.end()) {
-			TRIE_INFO("parallel insert found previous child");
-			auto& child = (*iter).second;
-		//	if (child->is_frozen) {
-		//		lock.unlock();
-		//		return _insert<InsertFn, InsertedValueType>(data, leaf_value);
-		//	}
-			if (HAS_METADATA) {
-				auto res_metadata_delta = child->template _parallel_insert<InsertFn, InsertedValueType>(data, leaf_value);
-				if (res_metadata_delta) {
-					update_metadata(branch_bits, *res_metadata_delta);
-					return *res_metadata_delta;
+		auto child_version = child->version.read_begin();
+		if (!node->version.validate(node_version)) {
+			return false;
+		}
+		if (depth == MAX_DEPTH) {
+			throw std::runtime_error("parallel_insert path too long");
+		}
+		path[depth++] = {node, node_version};
+		node = child;
+		node_version = child_version;
+	}
+
+	if (!node->version.try_lock_structure(node_version)) {
+		return false;
+	}
+
+	// only modifies node, as nothing changed since validation
+	auto metadata_delta = node->template _insert<InsertFn, InsertedValueType>(data, leaf_value);
+
+	node->version.unlock_structure();
+
+	TrieNode* path_child = node;
+
+	for (size_t i = depth; i-- > 0;) {
+		TrieNode* ancestor = path[i].node;
+
+		if (!HAS_METADATA) {
+			ancestor->invalidate_hash();
+			continue;
+		}
+
+		auto locked_version = ancestor->version.lock_metadata();
+		ancestor->invalidate_hash();
+		ancestor->update_metadata(ancestor->get_branch_bits(data), metadata_delta);
+
+		if (locked_version != path[i].version) {
+			TrieNode* cur = ancestor;
+			while (true) {
+				auto iter = cur->children.find(cur->get_branch_bits(data));
+				if (iter == cur->children.end()) {
+					throw std::runtime_error("lost parallel_insert path (concurrent deletion?)");
 				}
-				auto serial_metadata_res = child -> template _insert<InsertFn, InsertedValueType>(data, leaf_value);
-				update_metadata(branch_bits, serial_metadata_res);
-				return serial_metadata_res;
-			} else {
-				auto res = child->template _parallel_insert<InsertFn, InsertedValueType>(data, leaf_value);
-				if (res) {
-					return MetadataType{};
-				} else {
-					return child-> template _insert<InsertFn, InsertedValueType>(data, leaf_value);
+				TrieNode* next = (*iter).second;
+				if (next == path_child) {
+					break;
+				}
+				next->version.lock_metadata();
+				next->invalidate_hash();
+				next->update_metadata(next->get_branch_bits(data), metadata_delta);
+				if (cur != ancestor) {
+					cur->version.unlock_metadata();
 				}
+				cur = next;
+			}
+			if (cur != ancestor) {
+				cur->version.unlock_metadata();
 			}
 		}
+
+		ancestor->version.unlock_metadata();
+		path_child = ancestor;
 	}
-	return std::nullopt;
+
+	return true;
 }
 
 //TEMPLATE_SIGNATURE
@@ -4173,56 +4525,42 @@ TrieNode<TEMPLATE_PARAMS>::endow_split(
 	invalidate_hash();
 
 	children_map_t new_node_children;
+	MetadataType split_metadata{};
 
-	for(unsigned char branch_bits = 0; branch_bits <= MAX_BRANCH_VALUE; branch_bits ++) {
-
+	//Visits only the children present, in branch order.
+	//Fully consumed children are moved whole; at most one child is recursed into.
+	//(iterators survive the extraction of their own branch)
+	for (auto iter = children.begin(); iter != children.end() && acc_endow < endow_threshold; iter++) {
+		uint8_t branch_bits = (*iter).first;
+		TrieNode* child = (*iter).second;
 
-		auto iter = children.find(branch_bits);
-		if (iter != children.end()) {
-			auto fully_consumed_subtree = acc_endow + (*iter).second->metadata.endow;
+		auto fully_consumed_subtree = acc_endow + child->metadata.endow;
 
-			if (fully_consumed_subtree <= endow_threshold) {
-				//fully consume subnode
-
-				update_metadata((*iter).first, -((*iter).second->metadata.unsafe_load())); // safe bc exclusive lock on *this, which owns the children
-				auto new_child = children.extract((*iter).first);
-				new_node_children.emplace((*iter).first, std::move(new_child));//std::move((*iter).second));
-				//children.erase(iter);
-
-			} else {
-
-				if (!(*iter).second) {
-					throw std::runtime_error("invalid iter in endow_split!");
-				}
-				auto split_obj = (*iter).second->endow_split(endow_threshold - acc_endow);
-				if (split_obj) {
-					update_metadata((*iter).first, -(split_obj->metadata.unsafe_load()));
-					new_node_children.emplace((*iter).first, std::move(split_obj));
-				}
-
-				if ((*iter).second -> single_child()) {
-					auto single_child = (*iter).second -> get_single_child();
-					children.emplace((*iter).first, std::move(single_child));
-					//children[(*iter).first] = std::move(single_child);
-					//children.emplace(iter->first, std::move(single_child));
-					if (!children.at((*iter).first)) {
-						throw std::runtime_error("what the fuck children map");
-					}
-				}
+		if (fully_consumed_subtree <= endow_threshold) {
+			//fully consume subnode
+			split_metadata += child->metadata.unsafe_load(); // safe bc exclusive lock on *this, which owns the children
+			new_node_children.emplace(branch_bits, children.extract(branch_bits));
+		} else {
+			auto split_obj = child->endow_split(endow_threshold - acc_endow);
+			if (split_obj) {
+				split_metadata += split_obj->metadata.unsafe_load();
+				new_node_children.emplace(branch_bits, std::move(split_obj));
 			}
-			acc_endow = fully_consumed_subtree;
-		}
 
-		if (acc_endow >= endow_threshold) {
-			break;
+			if (child -> single_child()) {
+				children.emplace(branch_bits, child -> get_single_child());
+			}
 		}
+		acc_endow = fully_consumed_subtree;
 	}
+
+	metadata -= split_metadata;
+
 	if (new_node_children.size()) {
 
 		auto output = duplicate_node_with_new_children(std::move(new_node_children));
-		output->compute_partial_metadata_unsafe(); // ok because output is threadlocal right now
+		output->metadata += split_metadata; // ok because output is threadlocal right now
 		TRIE_INFO("current metadata:%s", output->metadata.to_string().c_str());
-		//TRIE_INFO("returning exceeds %d split", split_idx);
 		TRIE_INFO_F(output->_log("returned value:"));
 
 		return output;
@@ -4595,12 +4933,32 @@ _BaseTrie<TEMPLATE_PARAMS>::parallel_apply(ApplyFn& fn) const {
 //	std::atomic_thread_fence(std::memory_order_acquire);
 }
 
-/*
+TEMPLATE_SIGNATURE
+template<typename ScanFn>
+void
+_BaseTrie<TEMPLATE_PARAMS>::parallel_range_scan(ScanFn& fn, const prefix_t& lo, const prefix_t& hi) const {
+	std::shared_lock lock(*hash_modify_mtx);
+
+	RangeScanRange<TrieT> range(root, lo, hi);
+
+	if (range.empty()) {
+		return;
+	}
+
+	tbb::parallel_for(
+		range,
+		[&fn, &lo, &hi] (const auto& r) {
+			for (size_t i = 0; i < r.work_list.size(); i++) {
+				r.work_list[i]->range_scan(fn, lo, hi);
+			}
+		});
+}
+
 TEMPLATE_SIGNATURE
 template<typename ApplyFn>
 void
 _BaseTrie<TEMPLATE_PARAMS>::parallel_apply_threadlocal_acc(ApplyFn& fn) const {
-	std::lock_guard lock(*hash_modify_mtx);
+	std::shared_lock lock(*hash_modify_mtx);
 
 	ApplyRange<TrieT> range(root);
 
@@ -4608,12 +4966,12 @@ _BaseTrie<TEMPLATE_PARAMS>::parallel_apply_threadlocal_acc(ApplyFn& fn) const {
 		range,
 		[&fn] (const auto& r) {
 			auto threadlocal = fn.new_threadlocal();
-			for (unsigned int i = 0; i < r.work_list.size(); i++) {
-				threadlocal(r.work_list[i]);
+			for (size_t i = 0; i < r.work_list.size(); i++) {
+				r.work_list[i]->apply(threadlocal);
 			}
-			fn.finish_local(std::move(threadlocal));
+			fn.finish_local(threadlocal);
 		});
-}*/
+}
 
 TEMPLATE_SIGNATURE
 template<typename ValueModifyFn>
@@ -4734,7 +5092,7 @@ TrieNode<TEMPLATE_PARAMS>::apply(ApplyFn& func) {
 			_log("failed node: ");
 			throw std::runtime_error("invalid size in apply");
 		}
-		func(children.value());
+		apply_to_leaf(func, children.value());
 		return;
 	}
 
@@ -4816,7 +5174,7 @@ NoOpTask
 TrieNode<TEMPLATE_PARAMS>::coroutine_apply(ApplyFn& func, CoroutineThrottler& throttler) {
 
 	if (prefix_len == MAX_KEY_LEN_BITS) {
-		func(children.value());
+		apply_to_leaf(func, children.value());
 		co_return;
 	}
 	for (auto iter = children.begin(); iter != children.end(); iter++) {
@@ -4848,7 +5206,7 @@ TrieNode<TEMPLATE_PARAMS>::apply(ApplyFn& func) const {
 			_log("failed node: ");
 			throw std::runtime_error("invalid size in apply");
 		}*/
-		func(children.value());
+		apply_to_leaf(func, children.value());
 		return;
 	}
 
@@ -4946,7 +5304,7 @@ void TrieNode<TEMPLATE_PARAMS>::apply_lt_key(ApplyFn& func, const prefix_t thres
 	if (prefix_len == MAX_KEY_LEN_BITS) {
 		if (prefix < threshold_key) {
 //		if (memcmp(prefix.data(), threshold_key.data(), KEY_LEN_BYTES) < 0) {
-			func(children.value());
+			apply_to_leaf(func, children.value());
 			if (children.size() != 0) {
 				throw std::runtime_error("what the fuck");
 			}
@@ -5003,6 +5361,17 @@ void TrieNode<TEMPLATE_PARAMS>::apply_lt_key(ApplyFn& func, const prefix_t thres
 	}
 }
 
+TEMPLATE_SIGNATURE
+template<typename ScanFn>
+void TrieNode<TEMPLATE_PARAMS>::range_scan(ScanFn& func, const prefix_t& lo, const prefix_t& hi) const {
+	for (stack_iterator iter(*this, lo); !iter.at_end(); ++iter) {
+		if (iter.key() >= hi) {
+			return;
+		}
+		func(iter.key(), iter.value());
+	}
+}
+
 TEMPLATE_SIGNATURE
 template<bool x>
 typename std::enable_if<x, MetadataType>::type
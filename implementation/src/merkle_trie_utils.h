@@ -488,6 +488,11 @@ public:
 		return SimpleBitVector{out};
 	}
 
+	//number of set bits below bb
+	unsigned int rank(uint8_t bb) const {
+		return __builtin_popcount(bv & ((((uint16_t)1) << bb) - 1));
+	}
+
 	bool empty() const {
 		return bv == 0;
 	}
@@ -515,14 +520,34 @@ struct kv_pair_t {
 	ptr_t& second;
 };
 
+/*
+Children of a trie node (keyed by branch bits), or the value of a leaf.
+
+Most nodes have only a few children.  Up to INLINE_CHILDREN child pointers are stored inline,
+in the space of the leaf value, packed in order of branch bits.  A node with more children
+moves them to a heap array of NUM_CHILDREN pointers, indexed directly by branch bits.
+Either way, a child's slot is only stable until the next emplace/extract/erase of another branch.
+*/
 template<typename trie_ptr_t, unsigned int BRANCH_BITS, typename ValueType>
 class FixedChildrenMap {
 	constexpr static unsigned int NUM_CHILDREN = 1<<BRANCH_BITS;
 
 	//using ptr_map_t = std::array<trie_ptr_t, NUM_CHILDREN>;
 	using underlying_ptr_t = trie_ptr_t::pointer;
+
+public:
+	//as many pointers as fit in a leaf value, but at least 4
+	constexpr static unsigned int INLINE_CHILDREN 
+		= std::max<size_t>(4, sizeof(ValueType) / sizeof(underlying_ptr_t));
+
+	constexpr static size_t HEAP_MAP_BYTES = sizeof(underlying_ptr_t) * NUM_CHILDREN;
+
+private:
+	static_assert(INLINE_CHILDREN < NUM_CHILDREN, "inline children map would be bigger than a heap map");
+
 	union {
-		underlying_ptr_t map[NUM_CHILDREN];
+		underlying_ptr_t inline_map[INLINE_CHILDREN];
+		underlying_ptr_t* heap_map;
 		ValueType value_;
 	};
 
@@ -531,6 +556,69 @@ class FixedChildrenMap {
 	bv_t bv;
 	bool call_value_dtor;
 
+	bool is_inline() const {
+		return bv.size() <= INLINE_CHILDREN;
+	}
+
+	//bb must be in bv
+	underlying_ptr_t& slot(uint8_t bb) {
+		if (is_inline()) {
+			return inline_map[bv.rank(bb)];
+		}
+		return heap_map[bb];
+	}
+
+	const underlying_ptr_t& slot(uint8_t bb) const {
+		if (is_inline()) {
+			return inline_map[bv.rank(bb)];
+		}
+		return heap_map[bb];
+	}
+
+	//bb must not be in bv
+	void add_child(uint8_t bb, underlying_ptr_t ptr) {
+		auto sz = bv.size();
+		if (sz < INLINE_CHILDREN) {
+			auto pos = bv.rank(bb);
+			for (auto i = sz; i > pos; i--) {
+				inline_map[i] = inline_map[i-1];
+			}
+			inline_map[pos] = ptr;
+		} else if (sz == INLINE_CHILDREN) {
+			auto* new_map = new underlying_ptr_t[NUM_CHILDREN]();
+			auto remaining = bv;
+			for (unsigned int i = 0; i < sz; i++) {
+				new_map[remaining.pop()] = inline_map[i];
+			}
+			new_map[bb] = ptr;
+			heap_map = new_map;
+		} else {
+			heap_map[bb] = ptr;
+		}
+		bv.add(bb);
+	}
+
+	//bb must be in bv.  Does not delete the child.
+	void remove_child(uint8_t bb) {
+		auto sz = bv.size();
+		if (sz <= INLINE_CHILDREN) {
+			for (auto i = bv.rank(bb); i + 1 < sz; i++) {
+				inline_map[i] = inline_map[i+1];
+			}
+		} else if (sz == INLINE_CHILDREN + 1) {
+			auto* old_map = heap_map;
+			auto remaining = bv;
+			remaining.erase(bb);
+			for (unsigned int i = 0; i < INLINE_CHILDREN; i++) {
+				inline_map[i] = old_map[remaining.pop()];
+			}
+			delete[] old_map;
+		} else {
+			heap_map[bb] = nullptr;
+		}
+		bv.erase(bb);
+	}
+
 	void clear_open_links() {
 		if (!bv.empty()) {
 			TRIE_INFO("clearing links from bv %x", bv.get());
@@ -539,6 +627,9 @@ class FixedChildrenMap {
 				//(*iter).second.reset();
 				delete (*iter).second;
 			}
+			if (!is_inline()) {
+				delete[] heap_map;
+			}
 		}
 	}
 
@@ -550,10 +641,16 @@ class FixedChildrenMap {
 		//}
 	}
 
+	//caller sets bv = other.bv and clears other.bv
 	void steal_ptr_map(FixedChildrenMap& other) {
-		for (size_t i = 0; i < NUM_CHILDREN; i++) {
-			map[i] = other.map[i];//std::move(other.map[i]);
-			other.map[i] = nullptr;
+		if (other.is_inline()) {
+			for (size_t i = 0; i < INLINE_CHILDREN; i++) {
+				inline_map[i] = other.inline_map[i];
+				other.inline_map[i] = nullptr;
+			}
+		} else {
+			heap_map = other.heap_map;
+			other.heap_map = nullptr;
 		}
 	}
 
@@ -574,6 +671,10 @@ public:
 		return bv.get();
 	}
 
+	bool uses_heap_map() const {
+		return !is_inline();
+	}
+
 	const ValueType& value() const {
 		if (bv.empty()) {
 			return value_;
@@ -668,14 +769,17 @@ public:
 		if (idx >= NUM_CHILDREN) {
 			throw std::runtime_error("out of bounds!");
 		}
-		if (!map[idx]) {
+		if (!bv.contains(idx)) {
 			throw std::runtime_error("attempt to dereference null ptr");
 		}
-		return map[idx];
+		return slot(idx);
 	}
 
 	underlying_ptr_t operator[](uint8_t idx) {
-		return map[idx];
+		if (!bv.contains(idx)) {
+			return nullptr;
+		}
+		return slot(idx);
 	}
 
 	~FixedChildrenMap() {
@@ -693,12 +797,14 @@ public:
 		SimpleBitVector<BRANCH_BITS> bv;
 
 		using ptr_t = typename std::conditional<is_const, const underlying_ptr_t, underlying_ptr_t>::type;
+		using map_t = typename std::conditional<is_const, const FixedChildrenMap, FixedChildrenMap>::type;
 
-		ptr_t* map;
+		//slots are looked up on deref, so iterators survive changes to other branches
+		map_t* map;
 
 		kv_pair_t<ptr_t> operator*() {
 			uint8_t branch = bv.lowest();
-			return {branch, map[branch]};
+			return {branch, map->slot(branch)};
 		}
 
 		template<bool other_const>
@@ -717,22 +823,21 @@ public:
 
 	void emplace(uint8_t branch_bits, trie_ptr_t&& ptr) {
 		if (bv.contains(branch_bits)) {
-			delete map[branch_bits];
-//			map[branch_bits].reset();
-		}// else {
-		//	map[branch_bits].release();
-		//}
-		map[branch_bits] = ptr.release();//std::move(ptr);
-		bv.add(branch_bits);
+			auto& child = slot(branch_bits);
+			delete child;
+			child = ptr.release();
+		} else {
+			add_child(branch_bits, ptr.release());
+		}
 	}
 
 	trie_ptr_t extract(uint8_t branch_bits) {
-		auto* out = map[branch_bits];
 		if (!bv.contains(branch_bits)) {
 			std::printf("bad extraction of bb %u! bv was %x\n", branch_bits, bv.get());
 			throw std::runtime_error("can't extract invalid node!");
 		}
-		bv.erase(branch_bits);
+		auto* out = slot(branch_bits);
+		remove_child(branch_bits);
 
 		std::unique_ptr<typename trie_ptr_t::element_type> out_ptr(out);
 		//out_ptr.reset(out);
@@ -744,8 +849,8 @@ public:
 		auto bb = (*loc).first;
 		//map[bb].reset();
 		if (bv.contains(bb)) {
-			delete map[bb];
-			bv.erase(bb);
+			delete slot(bb);
+			remove_child(bb);
 			loc++;
 		} else {
 			throw std::runtime_error("cannot erase nonexistent iter!");
@@ -756,24 +861,24 @@ public:
 
 	void erase(uint8_t loc) {
 		if (bv.contains(loc)) {
-			delete map[loc];
+			delete slot(loc);
 		} else {
 			throw std::runtime_error("cannot erase nonexistent loc!");
 		}
-		bv.erase(loc);
+		remove_child(loc);
 		//map[loc].reset();
 	}
 
 	iterator begin() {
 		if (!bv.empty()) {
-			return iterator{bv, map};
+			return iterator{bv, this};
 		}
 		return end();
 	}
 
 	const_iterator begin() const {
 		if (!bv.empty()) {
-			return const_iterator{bv, map};
+			return const_iterator{bv, this};
 		}
 		return cend();
 	}
@@ -788,18 +893,46 @@ public:
 
 	iterator find(uint8_t bb) {
 		if (bv.contains(bb)) {
-			return iterator{bv.drop_lt(bb), map};
+			return iterator{bv.drop_lt(bb), this};
 		}
 		return end();
 	}
 
 	const_iterator find(uint8_t bb) const {
 		if (bv.contains(bb)) {
-			return const_iterator{bv.drop_lt(bb), map};
+			return const_iterator{bv.drop_lt(bb), this};
 		}
 		return cend();
 	}
 
+	//first child with branch bits >= bb, or cend()
+	const_iterator lower_bound(uint8_t bb) const {
+		if (bb >= NUM_CHILDREN) {
+			return cend();
+		}
+		return const_iterator{bv.drop_lt(bb), this};
+	}
+
+	//For readers racing with a writer (TrieNode::_parallel_insert).
+	//The result is meaningful only if validate() (which checks that no writer has touched the map
+	//since the reader began) is true after this returns.
+	//validate() is called before dereferencing the heap map pointer, which might be stale.
+	template<typename ValidateFn>
+	underlying_ptr_t optimistic_find(uint8_t bb, const ValidateFn& validate) const {
+		bv_t cur_bv = bv;
+		if (!cur_bv.contains(bb)) {
+			return nullptr;
+		}
+		if (cur_bv.size() <= INLINE_CHILDREN) {
+			return inline_map[cur_bv.rank(bb)];
+		}
+		auto* cur_heap_map = heap_map;
+		if (!validate()) {
+			return nullptr;
+		}
+		return cur_heap_map[bb];
+	}
+
 	bool empty() const {
 		return bv.empty();
 	}
@@ -1491,6 +1624,37 @@ struct XdrTypeWrapper : public xdr_type {
 	}*/
 };
 
+struct EmptyValueContext {};
+
+/*
+Leaf values that leave part of their serialization implicit (e.g. in the leaf's key)
+declare a value_context_t, for whatever else they need to serialize themselves.
+Hashing and proofs then serialize such values with copy_data(buf, key, context),
+where the trie's owner supplies the context.  Other values ignore the context.
+*/
+template<typename ValueType>
+struct ValueContextTraits {
+	using context_t = EmptyValueContext;
+	constexpr static bool HAS_CONTEXT = false;
+
+	template<typename prefix_t>
+	static void copy_data(const ValueType& value, std::vector<uint8_t>& buf, const prefix_t&, const context_t&) {
+		value.copy_data(buf);
+	}
+};
+
+template<typename ValueType>
+requires requires { typename ValueType::value_context_t; }
+struct ValueContextTraits<ValueType> {
+	using context_t = typename ValueType::value_context_t;
+	constexpr static bool HAS_CONTEXT = true;
+
+	template<typename prefix_t>
+	static void copy_data(const ValueType& value, std::vector<uint8_t>& buf, const prefix_t& key, const context_t& context) {
+		value.copy_data(buf, key, context);
+	}
+};
+
 template<typename TrieT>
 class HashRange {
 	
@@ -1549,6 +1713,26 @@ public:
 };
 
 
+//Heap memory held by a trie (nodes and spilled children maps), for reporting.
+struct TrieMemoryUsage {
+	size_t num_nodes = 0;
+	size_t num_leaves = 0;
+	size_t num_heap_children_maps = 0;
+	size_t bytes = 0;
+
+	TrieMemoryUsage& operator+=(const TrieMemoryUsage& other) {
+		num_nodes += other.num_nodes;
+		num_leaves += other.num_leaves;
+		num_heap_children_maps += other.num_heap_children_maps;
+		bytes += other.bytes;
+		return *this;
+	}
+
+	double bytes_per_leaf() const {
+		return num_leaves == 0 ? 0 : ((double) bytes) / num_leaves;
+	}
+};
+
 //Main difference with hash range is accounting for subnodes marked deleted.
 //No nodes in work_list overlap, even after splitting
 template<typename TrieT, unsigned int GRAIN_SIZE = 1000>
@@ -1610,6 +1794,75 @@ struct ApplyRange {
 	}
 };
 
+//Like ApplyRange, but drops subtrees that cannot contain keys in [lo, hi).
+//Each entry of work_list covers a contiguous range of keys.
+template<typename TrieT, unsigned int GRAIN_SIZE = 1000>
+struct RangeScanRange {
+	using prefix_t = typename TrieT::prefix_t;
+
+	std::vector<TrieT*> work_list;
+
+	uint64_t work_size;
+
+	const prefix_t lo, hi;
+
+	bool empty() const {
+		return work_size == 0;
+	}
+
+	bool is_divisible() const {
+		return work_size > GRAIN_SIZE;
+	}
+
+	RangeScanRange(const std::unique_ptr<TrieT>& work_root, const prefix_t& lo, const prefix_t& hi)
+		: work_list()
+		, work_size(0)
+		, lo(lo)
+		, hi(hi) {
+			if (work_root -> overlaps_range(lo, hi)) {
+				work_list.push_back(work_root.get());
+				work_size = work_root -> size();
+			}
+		}
+
+	RangeScanRange(RangeScanRange& other, tbb::split)
+		: work_list()
+		, work_size(0)
+		, lo(other.lo)
+		, hi(other.hi) {
+
+			while (work_size < other.work_size) {
+				if (other.work_list.size() == 0) {
+					break;
+				}
+				if (other.work_list.size() == 1) {
+					auto* node = other.work_list.at(0);
+					if (node == nullptr) {
+						throw std::runtime_error("found nullptr in RangeScanRange!");
+					}
+					if (node -> is_leaf()) {
+						break;
+					}
+					other.work_list.clear();
+					other.work_size = 0;
+					for (auto* child : node -> children_list_ordered()) {
+						if (child -> overlaps_range(lo, hi)) {
+							other.work_list.push_back(child);
+							other.work_size += child -> size();
+						}
+					}
+				} else {
+					work_list.push_back(other.work_list.at(0));
+					other.work_list.erase(other.work_list.begin());
+
+					auto sz = work_list.back()->size();
+					work_size += sz;
+					other.work_size -= sz;
+				}
+			}
+	}
+};
+
 template<typename TrieT, unsigned int GRAIN_SIZE = 1000>
 struct ClearRollbackRange {
 	std::vector<TrieT*> work_list;
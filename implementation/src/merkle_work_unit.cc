@@ -34,12 +34,17 @@ Then we do external validity checks.  Check hashes, clearing, supply activations
 If those pass, we call finalize_validation.  If fails, we call rollback_validation.
 */
 void MerkleWorkUnit::tentative_commit_for_validation(uint64_t current_block_number) {
+	if (multiset_commitment_enabled) {
+		update_offer_multiset();
+		pre_block_offer_multiset = offer_multiset;
+	}
 	{
 		std::lock_guard lock(*lmdb_instance.mtx);
 		auto& thunk = lmdb_instance.add_new_thunk(current_block_number);
-		thunk.uncommitted_offers_vec = uncommitted_offers.accumulate_values<std::vector<Offer>>();
+		thunk.uncommitted_offers_vec = accumulate_offers(uncommitted_offers);
 		auto& accumulate_deleted_keys = thunk.deleted_keys;
 		committed_offers.perform_marked_deletions(accumulate_deleted_keys);
+		multiset_thunk_block = current_block_number;
 	}
 	committed_offers.merge_in(std::move(uncommitted_offers));
 	uncommitted_offers.clear();
@@ -48,7 +53,7 @@ void MerkleWorkUnit::tentative_commit_for_validation(uint64_t current_block_numb
 void MerkleWorkUnit::undo_thunk(WorkUnitLMDBCommitmentThunk<MerkleTrieT>& thunk) {
 	std::printf("starting thunk undo\n");
 	for (auto& kv : thunk.deleted_keys.deleted_keys) {
-		committed_offers.insert(kv.first, OfferWrapper(kv.second));
+		committed_offers.insert(kv.first, kv.second);
 	}
 
 	std::printf("done inserting deleted keys\n");
@@ -68,7 +73,7 @@ void MerkleWorkUnit::undo_thunk(WorkUnitLMDBCommitmentThunk<MerkleTrieT>& thunk)
 	if (thunk.get_exists_partial_exec()) {
 		auto bytes_array = thunk.partial_exec_key.get_bytes_array();
 		std::printf("key:%s\n", DebugUtils::__array_to_str(bytes_array.data(), bytes_array.size()).c_str());
-		committed_offers.insert(thunk.partial_exec_key, OfferWrapper(thunk.preexecute_partial_exec_offer));
+		committed_offers.insert(thunk.partial_exec_key, TrieValueT(thunk.preexecute_partial_exec_offer));
 	}
 	std::printf("done thunk undo\n");
 }
@@ -90,6 +95,8 @@ void MerkleWorkUnit::tentative_commit_for_validation(uint64_t current_block_numb
 void MerkleWorkUnit::finalize_validation() {
 	committed_offers.clear_rollback();  //TODO on a higher powered machine, maybe parallelize?
 
+	update_offer_multiset();
+
 	if (uncommitted_offers.size() != 0) {
 		throw std::runtime_error("shouldn't have uncommitted_offers nonempty when calling finalize");
 	}
@@ -121,6 +128,11 @@ void MerkleWorkUnit::rollback_validation() {//const SingleWorkUnitStateCommitmen
 
 	undo_thunk(thunk);
 
+	//the top thunk is about to be popped, after which thunks.back() is the previous block's thunk,
+	//which pre_block_offer_multiset already includes
+	offer_multiset = pre_block_offer_multiset;
+	multiset_thunk_block = std::nullopt;
+
 
 
 	//undoing partial execution
@@ -163,7 +175,7 @@ void MerkleWorkUnit::commit_for_production(uint64_t current_block_number) {
 		std::lock_guard lock(*lmdb_instance.mtx);
 		auto& thunk = lmdb_instance.get_top_thunk();
 		try {
-			thunk.uncommitted_offers_vec = uncommitted_offers.accumulate_values<std::vector<Offer>>();
+			thunk.uncommitted_offers_vec = accumulate_offers(uncommitted_offers);
 		} catch(...) {
 			std::printf("error in uncommitted_offers.accumulate_values!\n");
 			uncommitted_offers._log("offers ");
@@ -201,6 +213,104 @@ void MerkleWorkUnit::commit_for_production(uint64_t current_block_number) {
 	//std::printf("done commit%lu\n", std::this_thread::get_id());
 }*/
 
+std::vector<Offer> MerkleWorkUnit::accumulate_offers(const MerkleTrieT& offers) const {
+	std::vector<Offer> out;
+	out.reserve(offers.size());
+	auto accumulate = [this, &out] (const MerkleTrieT::prefix_t& key, const TrieValueT& leaf) {
+		out.push_back(to_offer(key, leaf));
+	};
+	offers.apply(accumulate);
+	return out;
+}
+
+namespace {
+
+struct OfferMultisetAccumulator {
+	SharedMultisetHash& out;
+	const OfferCategory category;
+
+	struct Local {
+		MultisetHash hash;
+		const OfferCategory category;
+
+		void operator() (const MerkleWorkUnit::MerkleTrieT::prefix_t& key, const MerkleWorkUnit::TrieValueT& leaf) {
+			hash.insert_xdr(leaf.to_offer(key, category));
+		}
+	};
+
+	Local new_threadlocal() {
+		return Local{MultisetHash(), category};
+	}
+
+	void finish_local(Local& local) {
+		out += local.hash;
+	}
+};
+
+MultisetHash hash_offers(const MerkleWorkUnit::MerkleTrieT& offers, const OfferCategory& category) {
+	if (offers.size() == 0) {
+		return MultisetHash();
+	}
+	SharedMultisetHash out;
+	OfferMultisetAccumulator func{out, category};
+	//callers may hold the lmdb mutex
+	tbb::this_task_arena::isolate([&func, &offers]() {
+		offers.parallel_apply_threadlocal_acc(func);
+	});
+	return out.get();
+}
+
+} /* anonymous namespace */
+
+void MerkleWorkUnit::recompute_offer_multiset() {
+	offer_multiset = hash_offers(committed_offers, category);
+	pre_block_offer_multiset = offer_multiset;
+	//committed_offers already reflects every thunk
+	multiset_thunk_block = std::nullopt;
+}
+
+/*
+The top thunk records exactly what the current block changed:
+new offers, cancelled offers, fully cleared offers, and the partially executed offer.
+Recomputing from pre_block_offer_multiset (instead of adding in place) makes this idempotent.
+Only the thunk made for the current block (multiset_thunk_block) is read; after a rollback,
+the top thunk belongs to an earlier block, whose changes are already in pre_block_offer_multiset.
+*/
+void MerkleWorkUnit::update_offer_multiset() {
+	if (!multiset_commitment_enabled) {
+		return;
+	}
+
+	std::lock_guard lock(*lmdb_instance.mtx);
+	auto& thunks = lmdb_instance.get_thunks_ref();
+	if (thunks.size() == 0 || !multiset_thunk_block || thunks.back().current_block_number != *multiset_thunk_block) {
+		//nothing changed since offer_multiset was last set exactly
+		return;
+	}
+	auto& thunk = thunks.back();
+
+	MultisetHash delta;
+	for (auto& offer : thunk.uncommitted_offers_vec) {
+		delta.insert_xdr(offer);
+	}
+	for (auto& kv : thunk.deleted_keys.deleted_keys) {
+		delta.remove_xdr(to_offer(kv.first, kv.second));
+	}
+	delta -= hash_offers(thunk.cleared_offers, category);
+
+	if (thunk.get_exists_partial_exec()) {
+		Offer offer = thunk.preexecute_partial_exec_offer;
+		delta.remove_xdr(offer);
+		offer.amount -= thunk.partial_exec_amount;
+		if (offer.amount > 0) {
+			delta.insert_xdr(offer);
+		}
+	}
+
+	offer_multiset = pre_block_offer_multiset;
+	offer_multiset += delta;
+}
+
 void MerkleWorkUnit::generate_metadata_index() {
 	indexed_metadata = committed_offers.metadata_traversal<EndowAccumulator, Price, FuncWrapper>(PriceUtils::PRICE_BIT_LEN);
 }
@@ -694,6 +804,20 @@ void MerkleWorkUnit::calculate_demands_and_supplies_from_metadata(
 	supplies_workspace[category.sellAsset] += full_sell_volume;
 }
 
+void MerkleWorkUnit::calculate_demands_and_supplies(
+	const DemandQueryPrices& prices,
+	uint128_t* demands_workspace,
+	uint128_t* supplies_workspace,
+	const uint8_t smooth_mult) {
+
+	auto kernel = DemandKernelDispatch<MerkleWorkUnit>::get(smooth_mult);
+	if (kernel == nullptr) {
+		calculate_demands_and_supplies(prices.get_prices(), demands_workspace, supplies_workspace, smooth_mult);
+		return;
+	}
+	kernel(*this, prices, demands_workspace, supplies_workspace);
+}
+
 void MerkleWorkUnit::calculate_demands_and_supplies(
 	const Price* prices, 
 	uint128_t* demands_workspace, 
@@ -865,6 +989,39 @@ void MerkleWorkUnit::calculate_demands_and_supplies(
 	//	category.sellAsset, category.buyAsset, PriceUtils::amount_to_double(full_buy_volume), PriceUtils::amount_to_double(full_sell_volume));
 }
 
+/*
+Small work units clear serially; the clearing phase already runs work units in parallel.
+A very popular trading pair, though, can clear more offers than every other work unit combined,
+leaving every other thread idle.  Those are split into ranges of the trie,
+each cleared with its own serial log and with owner accounts prefetched by coroutines
+(cleared offers' owners are scattered across the account db, so a serial loop mostly waits on cache misses).
+*/
+void MerkleWorkUnit::clear_offers(
+	const MerkleTrieT& cleared_offers,
+	Price sellPrice,
+	Price buyPrice,
+	uint8_t tax_rate,
+	MemoryDatabase& db,
+	SerialAccountModificationLog& serial_account_log) {
+
+	if (cleared_offers.size() < PARALLEL_CLEARING_MIN_OFFERS) {
+		CompleteClearingFunc func(category, sellPrice, buyPrice, tax_rate, db, serial_account_log);
+		cleared_offers.apply(func);
+		return;
+	}
+
+	ParallelCompleteClearingFunc func(category, sellPrice, buyPrice, tax_rate, db, serial_account_log.get_main_log());
+
+	//isolated so this thread doesn't pick up another work unit's clearing while holding the trie lock
+	tbb::this_task_arena::isolate([&func, &cleared_offers]() {
+		cleared_offers.parallel_apply_threadlocal_acc(func);
+	});
+
+	if (func.failed()) {
+		throw std::runtime_error("failed to clear offer");
+	}
+}
+
 bool MerkleWorkUnit::tentative_clear_offers_for_validation(
 	MemoryDatabase& db,
 	SerialAccountModificationLog& serial_account_log,
@@ -890,7 +1047,7 @@ bool MerkleWorkUnit::tentative_clear_offers_for_validation(
 	Price sellPrice = clearing_commitment_log.prices[category.sellAsset];
 	Price buyPrice = clearing_commitment_log.prices[category.buyAsset];
 
-	CompleteClearingFunc func(sellPrice, buyPrice, clearing_commitment_log.tax_rate, db, serial_account_log);
+	uint8_t tax_rate = clearing_commitment_log.tax_rate;
 
 	unsigned char zero_buf[MerkleWorkUnit::WORKUNIT_KEY_LEN];
 	memset(zero_buf, 0, MerkleWorkUnit::WORKUNIT_KEY_LEN);
@@ -917,7 +1074,7 @@ bool MerkleWorkUnit::tentative_clear_offers_for_validation(
 
 		validation_statistics.activated_supply += FractionalAsset::from_integral(committed_offers.get_root_metadata().endow);
 		try {
-			committed_offers.apply(func);
+			clear_offers(committed_offers, sellPrice, buyPrice, tax_rate, db, serial_account_log);
 		} catch (...) {
 			std::printf("failed apply WHEN NO PARTIAL EXEC OFFER in category sell %u buy %u with endow_below_partial_exec_key %ld\n", category.sellAsset, category.buyAsset, endow_below_partial_exec_key);
 			std::printf("committed offers sz was %lu\n", committed_offers.size());
@@ -943,7 +1100,7 @@ bool MerkleWorkUnit::tentative_clear_offers_for_validation(
 	}
 
 
-	auto partial_exec_offer = *partial_exec_offer_opt;
+	Offer partial_exec_offer = to_offer(partialExecThresholdKey, *partial_exec_offer_opt);
 
 	serial_account_log.log_self_modification(partial_exec_offer.owner, partial_exec_offer.offerId);
 
@@ -957,7 +1114,7 @@ bool MerkleWorkUnit::tentative_clear_offers_for_validation(
 
 	if (!db.lookup_user_id(partial_exec_offer.owner, &db_idx)) {
 		std::printf("couldn't lookup user\n");
-		committed_offers.insert(local_clearing_log.partialExecThresholdKey, partial_exec_offer);
+		committed_offers.insert(local_clearing_log.partialExecThresholdKey, TrieValueT(partial_exec_offer));
 		return false;
 	}
 
@@ -976,7 +1133,7 @@ bool MerkleWorkUnit::tentative_clear_offers_for_validation(
 
 	if ((uint64_t)partial_exec_sell_amount > partial_exec_offer.amount) {
 		std::printf("sell amount too high: partial_exec_sell_amount %ld partial_exec_offer.amount %ld\n", partial_exec_sell_amount, partial_exec_offer.amount);
-		committed_offers.insert(local_clearing_log.partialExecThresholdKey, partial_exec_offer);
+		committed_offers.insert(local_clearing_log.partialExecThresholdKey, TrieValueT(partial_exec_offer));
 		return false;
 	}
 
@@ -1007,7 +1164,7 @@ bool MerkleWorkUnit::tentative_clear_offers_for_validation(
 			throw;
 		}
 		try {
-			thunk.cleared_offers.apply(func);
+			clear_offers(thunk.cleared_offers, sellPrice, buyPrice, tax_rate, db, serial_account_log);
 		} catch (...) {
 			std::printf("failed apply in category sell %u buy %u with endow_below_partial_exec_key %ld\n", category.sellAsset, category.buyAsset, endow_below_partial_exec_key);
 			std::printf("cleared offers sz was %lu\n", thunk.cleared_offers.size());
@@ -1027,29 +1184,20 @@ bool MerkleWorkUnit::tentative_clear_offers_for_validation(
 
 	if (partial_exec_offer.amount != 0) {
 		//added if statement 4/22/2021
-		committed_offers.insert(local_clearing_log.partialExecThresholdKey, partial_exec_offer);
+		committed_offers.insert(local_clearing_log.partialExecThresholdKey, TrieValueT(partial_exec_offer));
 		state_update_stats.partial_clear_offer_count ++;
 	}
 	return true;
 }
 
-void MerkleWorkUnit::process_clear_offers(
-	const WorkUnitClearingParams& params, 
-	const Price* prices, 
-	const uint8_t& tax_rate, 
-	MemoryDatabase& db,
-	SerialAccountModificationLog& serial_account_log,
-	SingleWorkUnitStateCommitment& clearing_commitment_log,
-	BlockStateUpdateStatsWrapper& state_update_stats) {
-	
+MerkleWorkUnit::MerkleTrieT 
+MerkleWorkUnit::split_fully_cleared_offers(const WorkUnitClearingParams& params) {
 
 	auto clear_amount = params.supply_activated.floor();
 	if (clear_amount > INT64_MAX) {
 		throw std::runtime_error("trying to clear more than there should exist");
 	}
 
-	PriceUtils::write_unsigned_big_endian(clearing_commitment_log.fractionalSupplyActivated, params.supply_activated.value);
-
 	INTEGRITY_CHECK_F(
 		if (!committed_offers.metadata_integrity_check()) {
 			throw std::runtime_error("metadata corrupted in committed offers");
@@ -1081,18 +1229,26 @@ void MerkleWorkUnit::process_clear_offers(
 		}
 	);
 
+	return fully_cleared_trie;
+}
+
+void MerkleWorkUnit::process_clear_offers(
+	const WorkUnitClearingParams& params, 
+	const Price* prices, 
+	const uint8_t& tax_rate, 
+	MemoryDatabase& db,
+	SerialAccountModificationLog& serial_account_log,
+	SingleWorkUnitStateCommitment& clearing_commitment_log,
+	BlockStateUpdateStatsWrapper& state_update_stats,
+	MerkleTrieT&& fully_cleared_trie) {
+
+	PriceUtils::write_unsigned_big_endian(clearing_commitment_log.fractionalSupplyActivated, params.supply_activated.value);
+
 	Price sellPrice = prices[category.sellAsset];
 	Price buyPrice = prices[category.buyAsset];
 
-	CompleteClearingFunc func(sellPrice, buyPrice, tax_rate, db, serial_account_log);
-
-/*	tbb::this_task_arena::isolate([&func, &fully_cleared_trie]() {
-		fully_cleared_trie.parallel_apply(func);
-	});
-*/
-	//todo see if coroutines still don't make sense
 	try {
-		fully_cleared_trie.apply(func);
+		clear_offers(fully_cleared_trie, sellPrice, buyPrice, tax_rate, db, serial_account_log);
 	} catch (...) {
 		fully_cleared_trie._log("fully cleared trie: ");
 
@@ -1150,7 +1306,7 @@ void MerkleWorkUnit::process_clear_offers(
 		throw std::runtime_error("couldn't find partial exec offer!!!");
 	}
 
-	auto partial_exec_offer = *try_delete;
+	Offer partial_exec_offer = to_offer(*partial_exec_key, *try_delete);
 
 	//std::printf("done last committed offers delete\n");
 
@@ -1203,7 +1359,7 @@ void MerkleWorkUnit::process_clear_offers(
 	if (partial_exec_offer.amount > 0) {
 		//std::printf("starting last committed offers insert\n");
 		//committed_offers._log("committed offers ");
-		committed_offers.insert(*partial_exec_key, partial_exec_offer);
+		committed_offers.insert(*partial_exec_key, TrieValueT(partial_exec_offer));
 		//std::printf("ending last committed offers insert\n");
 		state_update_stats.partial_clear_offer_count++;
 	} else if (partial_exec_offer.amount < 0) {
@@ -1285,6 +1441,9 @@ void MerkleWorkUnit::rollback_thunks(uint64_t current_block_number) {
 			i++;
 		}
 	}
+	if (multiset_commitment_enabled) {
+		recompute_offer_multiset();
+	}
 }
 
 void WorkUnitLMDB::clear_thunks(uint64_t current_block_number) {
@@ -1692,6 +1851,10 @@ void MerkleWorkUnit::load_lmdb_contents_to_memory() {
 	}
 
 	generate_metadata_index();
+
+	if (multiset_commitment_enabled) {
+		recompute_offer_multiset();
+	}
 }
 
 }
@@ -19,6 +19,7 @@
 #include "account_modification_log.h"
 
 #include "work_unit_metadata.h"
+#include "compact_offer_wrapper.h"
 #include "xdr/block.h"
 #include "offer_clearing_logic.h"
 #include "work_unit_state_commitment.h"
@@ -27,9 +28,13 @@
 
 #include "merkle_work_unit_thunk.h"
 #include "merkle_work_unit_helpers.h"
+#include "demand_kernel.h"
+#include "multiset_hash.h"
 
 #include "demand_calc_coroutine.h"
 #include "block_update_stats.h"
+#include "coroutine_throttler.h"
+#include "user_account.h"
 
 namespace edce {
 
@@ -63,16 +68,17 @@ struct EndowmentPredicate {
 
 template<typename Database>
 class CompleteClearingFunc {
+	const OfferCategory category;
 	const Price sellPrice;
 	const Price buyPrice;
 	const uint8_t tax_rate;
 	Database& db;
 	SerialAccountModificationLog& serial_account_log;
 public:
-	CompleteClearingFunc(Price sellPrice, Price buyPrice, uint8_t tax_rate, Database& db, SerialAccountModificationLog& serial_account_log) 
-	: sellPrice(sellPrice), buyPrice(buyPrice), tax_rate(tax_rate), db(db), serial_account_log(serial_account_log) {}
+	CompleteClearingFunc(OfferCategory category, Price sellPrice, Price buyPrice, uint8_t tax_rate, Database& db, SerialAccountModificationLog& serial_account_log) 
+	: category(category), sellPrice(sellPrice), buyPrice(buyPrice), tax_rate(tax_rate), db(db), serial_account_log(serial_account_log) {}
 
-	void operator() (const Offer& offer) {
+	account_db_idx lookup_owner(const Offer& offer) {
 
 		if (PriceUtils::a_over_b_lt_c(sellPrice, buyPrice, offer.minPrice)) {
 			std::printf("%f %f\n", PriceUtils::to_double(sellPrice)/PriceUtils::to_double(buyPrice), PriceUtils::to_double(offer.minPrice));
@@ -87,6 +93,10 @@ public:
 		if (!result) {
 			throw std::runtime_error("Offer in manager from nonexistent account");
 		}
+		return idx;
+	}
+
+	void clear(const Offer& offer, account_db_idx idx) {
 
 		//int64_t sell_amount = -offer.amount;
 		//int64_t buy_amount;// = PriceUtils::wide_multiply_val_by_a_over_b(
@@ -101,12 +111,130 @@ public:
 
 		serial_account_log.log_self_modification(offer.owner, offer.offerId);
 	}
+
+	void operator() (const Offer& offer) {
+		clear(offer, lookup_owner(offer));
+	}
+
+	template<typename prefix_t>
+	void operator() (const prefix_t& key, const CompactOfferWrapper& leaf) {
+		(*this)(leaf.to_offer(key, category));
+	}
+};
+
+//Looks up the offer's owner, then suspends while the owner's account is prefetched.
+//Exceptions can't leave a RootTask, so failures are reported through error.
+template<typename Database>
+auto spawn_clear_offer(
+	const Offer& offer,
+	CompleteClearingFunc<Database>& func,
+	Database& db,
+	CoroutineThrottler& throttler,
+	std::atomic<bool>& error) -> RootTask {
+
+	account_db_idx idx;
+	UserAccount* account = nullptr;
+	try {
+		idx = func.lookup_owner(offer);
+		account = &db.find_account(idx);
+	} catch (...) {
+		error.store(true, std::memory_order_relaxed);
+		co_return;
+	}
+
+	co_await PrefetchAwaiter{account, throttler.scheduler};
+
+	try {
+		func.clear(offer, idx);
+	} catch (...) {
+		error.store(true, std::memory_order_relaxed);
+	}
+}
+
+/*
+Clears every offer of a (large) fully cleared subtrie, in parallel.
+Used when one work unit (i.e. a very popular trading pair) clears so many offers
+that clearing it serially would dominate the clearing phase.
+
+Each range of the subtrie gets its own SerialAccountModificationLog
+(all of which are merged by the usual merge_in_log_batch),
+and interleaves several offers at a time with coroutines,
+so that owner accounts are prefetched instead of waited on.
+*/
+template<typename Database>
+class ParallelCompleteClearingFunc {
+	const OfferCategory category;
+	const Price sellPrice;
+	const Price buyPrice;
+	const uint8_t tax_rate;
+	Database& db;
+	AccountModificationLog& main_log;
+
+	std::atomic<bool> error = false;
+
+	constexpr static uint8_t PREFETCH_QUEUE_SIZE = 8;
+
+public:
+
+	class LocalFunc {
+		const OfferCategory category;
+		SerialAccountModificationLog serial_account_log;
+		CompleteClearingFunc<Database> func;
+		Database& db;
+		CoroutineThrottler throttler;
+		std::atomic<bool>& error;
+
+	public:
+
+		LocalFunc(ParallelCompleteClearingFunc& parent)
+			: category(parent.category)
+			, serial_account_log(parent.main_log)
+			, func(parent.category, parent.sellPrice, parent.buyPrice, parent.tax_rate, parent.db, serial_account_log)
+			, db(parent.db)
+			, throttler(PREFETCH_QUEUE_SIZE)
+			, error(parent.error) {}
+
+		LocalFunc(const LocalFunc&) = delete;
+
+		void operator() (const Offer& offer) {
+			if (throttler.full()) {
+				//runs queued clearings until one finishes
+				throttler.scheduler.pop_front().resume();
+			}
+			throttler.spawn(spawn_clear_offer(offer, func, db, throttler, error));
+		}
+
+		template<typename prefix_t>
+		void operator() (const prefix_t& key, const CompactOfferWrapper& leaf) {
+			(*this)(leaf.to_offer(key, category));
+		}
+
+		void finish() {
+			throttler.join();
+		}
+	};
+
+	ParallelCompleteClearingFunc(OfferCategory category, Price sellPrice, Price buyPrice, uint8_t tax_rate, Database& db, AccountModificationLog& main_log)
+		: category(category), sellPrice(sellPrice), buyPrice(buyPrice), tax_rate(tax_rate), db(db), main_log(main_log) {}
+
+	LocalFunc new_threadlocal() {
+		return LocalFunc(*this);
+	}
+
+	void finish_local(LocalFunc& local) {
+		local.finish();
+	}
+
+	bool failed() const {
+		return error.load(std::memory_order_relaxed);
+	}
 };
 
 
 using OfferWrapper = XdrTypeWrapper<Offer>;
 constexpr static int _WORKUNIT_KEY_LEN = PriceUtils::PRICE_BYTES + sizeof(AccountID) + sizeof(uint64_t);
-using WorkUnit_TrieValueT = OfferWrapper;
+//leaves store only offer amounts; the rest of an offer is its key and the work unit's category
+using WorkUnit_TrieValueT = CompactOfferWrapper;
 using WorkUnit_TrieMetadataT = CombinedMetadata<DeletableMixin, SizeMixin, RollbackMixin, WorkUnitMetadata>;
 
 using WorkUnit_MerkleTrieT = MerkleTrie<_WORKUNIT_KEY_LEN, WorkUnit_TrieValueT, WorkUnit_TrieMetadataT, false>; // no locks on individual trie nodes
@@ -201,15 +329,29 @@ private:
 		}
 	};
 
+public:
 	using IndexType = IndexedMetadata
 					<
 						EndowAccumulator,
 						Price,
 						FuncWrapper
 					>;
+private:
 
 	std::vector<IndexType> indexed_metadata;
 
+	//Multiset hash over committed_offers, maintained only if enabled.
+	bool multiset_commitment_enabled = false;
+	MultisetHash offer_multiset;
+	//offer_multiset as of the start of the current block (i.e. before the top thunk)
+	MultisetHash pre_block_offer_multiset;
+	//block number of the thunk whose changes offer_multiset adds to pre_block_offer_multiset.
+	//nullopt if offer_multiset already accounts for every thunk (after a rollback or a recompute).
+	std::optional<uint64_t> multiset_thunk_block;
+
+	void recompute_offer_multiset();
+	void update_offer_multiset();
+
 	uint64_t get_persisted_round_number() const {
 		return lmdb_instance.get_persisted_round_number();
 	}
@@ -219,6 +361,17 @@ private:
 
 	void generate_metadata_index();
 
+	//Work units clearing at least this many offers clear them in parallel.
+	constexpr static size_t PARALLEL_CLEARING_MIN_OFFERS = 10000;
+
+	void clear_offers(
+		const MerkleTrieT& cleared_offers,
+		Price sellPrice,
+		Price buyPrice,
+		uint8_t tax_rate,
+		MemoryDatabase& db,
+		SerialAccountModificationLog& serial_account_log);
+
 //	void change_approximation_parameters_(uint8_t smooth_mult_, uint8_t tax_rate_) {
 //		smooth_mult = smooth_mult_;
 //		tax_rate = tax_rate_;
@@ -235,12 +388,33 @@ private:
 		//uncommitted_additional_offers.emplace_back(std::move(offers));
 	}
 
+	//Threadsafe with respect to other add_offer_concurrent calls (only).
+	//Transaction processing still inserts into threadlocal tries, merged with add_offers,
+	//because it has to be able to unwind an offer.
+	void add_offer_concurrent(const MerkleTrieT::prefix_t& key, const Offer& offer) {
+		uncommitted_offers.parallel_insert(key, TrieValueT(offer));
+	}
+
+	Offer to_offer(const MerkleTrieT::prefix_t& key, const TrieValueT& leaf) const {
+		return leaf.to_offer(key, category);
+	}
+
+	std::optional<Offer> to_offer(const MerkleTrieT::prefix_t& key, const std::optional<TrieValueT>& leaf) const {
+		if (!leaf) {
+			return std::nullopt;
+		}
+		return to_offer(key, *leaf);
+	}
+
+	//every offer in offers, in key order
+	std::vector<Offer> accumulate_offers(const MerkleTrieT& offers) const;
+
 	std::optional<Offer> mark_for_deletion(const MerkleTrieT::prefix_t key) {
-		return committed_offers.mark_for_deletion(key);
+		return to_offer(key, committed_offers.mark_for_deletion(key));
 	}
 
 	std::optional<Offer> unmark_for_deletion(const MerkleTrieT::prefix_t key) {
-		return committed_offers.unmark_for_deletion(key);
+		return to_offer(key, committed_offers.unmark_for_deletion(key));
 	}
 
 	friend class MerkleWorkUnitManager;
@@ -281,6 +455,9 @@ public:
 		committed_offers.clear();
 		indexed_metadata.clear();
 		lmdb_instance.clear_();
+		offer_multiset.clear();
+		pre_block_offer_multiset.clear();
+		multiset_thunk_block = std::nullopt;
 	}
 
 	void log() {
@@ -288,6 +465,12 @@ public:
 	}
 
 
+	//Splits off the offers that params fully clear (in one descent of committed_offers,
+	//moving whole subtrees).  MerkleWorkUnitManager splits every work unit
+	//in one parallel pass before clearing any of them.
+	MerkleTrieT split_fully_cleared_offers(const WorkUnitClearingParams& params);
+
+	//fully_cleared_trie is the output of split_fully_cleared_offers(params)
 	void process_clear_offers(
 		const WorkUnitClearingParams& params, 
 		const Price* prices, 
@@ -295,7 +478,8 @@ public:
 		MemoryDatabase& db,
 		SerialAccountModificationLog& serial_account_log,
 		SingleWorkUnitStateCommitment& clearing_commitment_log,
-		BlockStateUpdateStatsWrapper& state_update_stats);
+		BlockStateUpdateStatsWrapper& state_update_stats,
+		MerkleTrieT&& fully_cleared_trie);
 	
 	//make the inserted things marked with some kind of metadata, which is deletable
 	bool tentative_clear_offers_for_validation(
@@ -321,7 +505,19 @@ public:
 	}
 
 	void freeze_and_hash(Hash& hash_buf) {
-		committed_offers.freeze_and_hash(hash_buf);
+		committed_offers.freeze_and_hash(hash_buf, category);
+	}
+
+	void enable_multiset_commitment() {
+		multiset_commitment_enabled = true;
+		recompute_offer_multiset();
+	}
+
+	//Brings offer_multiset up to date with the current block's clearing.
+	//Only the top thunk is read, so this is O(offers changed in this block).
+	const MultisetHash& get_offer_multiset() {
+		update_offer_multiset();
+		return offer_multiset;
 	}
 
 	std::pair<Price, Price> get_execution_prices(const Price* prices, const uint8_t smooth_mult) const;
@@ -336,6 +532,13 @@ public:
 		uint128_t* supplies_workspace,
 		const uint8_t smooth_mult);
 
+	//Same results as above, through the FixedPointDemandKernel specialized for smooth_mult.
+	void calculate_demands_and_supplies(
+		const DemandQueryPrices& prices,
+		uint128_t* demands_workspace,
+		uint128_t* supplies_workspace,
+		const uint8_t smooth_mult);
+
 	void calculate_demands_and_supplies_from_metadata(
 		const Price* prices, 
 		uint128_t* demands_workspace,
@@ -349,6 +552,10 @@ public:
 
 	size_t num_open_offers() const;
 
+	TrieMemoryUsage offer_memory_usage() const {
+		return committed_offers.memory_usage();
+	}
+
 	std::pair<uint64_t, uint64_t> get_supply_bounds(const Price* prices, const uint8_t smooth_mult) const;
 	std::pair<uint64_t, uint64_t> get_supply_bounds(Price sell_price, Price buy_price, const uint8_t smooth_mult) const;
 
@@ -360,6 +567,12 @@ public:
 		return indexed_metadata.size() - 1; // first entry of index is 0, so ignore
 	}
 
+	//Demand queries and the LP read only the index, so a recorded index (see price_trace.h)
+	//is enough to rerun price computation.  Leaves the offer tries untouched.
+	void set_indexed_metadata_for_replay(std::vector<IndexType>&& index) {
+		indexed_metadata = std::move(index);
+	}
+
 	OfferCategory get_category() const {
 		return category;
 	}
@@ -140,6 +140,27 @@ void MerkleWorkUnitManager::generate_metadata_indices() {
 	generic_map<&MerkleWorkUnit::generate_metadata_index>();
 }
 
+void MerkleWorkUnitManager::enable_multiset_commitment() {
+	generic_map<&MerkleWorkUnit::enable_multiset_commitment>();
+}
+
+void MerkleWorkUnitManager::produce_multiset_commitment(Hash& hash_out) {
+	std::lock_guard lock(mtx);
+
+	SharedMultisetHash out;
+
+	tbb::parallel_for(
+		tbb::blocked_range<std::size_t>(0, work_units.size()),
+		[&out, this] (auto r) {
+			MultisetHash local;
+			for (auto i = r.begin(); i < r.end(); i++) {
+				local += work_units[i].get_offer_multiset();
+			}
+			out += local;
+		});
+	out.digest(hash_out);
+}
+
 size_t MerkleWorkUnitManager::num_open_offers() const {
 	std::lock_guard lock(mtx);
 
@@ -157,11 +178,31 @@ size_t MerkleWorkUnitManager::num_open_offers() const {
 
 }
 
+TrieMemoryUsage MerkleWorkUnitManager::offer_memory_usage() const {
+	std::lock_guard lock(mtx);
+
+	std::vector<TrieMemoryUsage> usages(work_units.size());
+	tbb::parallel_for(
+		tbb::blocked_range<std::size_t>(0, work_units.size()),
+		[this, &usages] (auto r) {
+			for (unsigned int i = r.begin(); i < r.end(); i++) {
+				usages[i] = work_units[i].offer_memory_usage();
+			}
+		});
+
+	TrieMemoryUsage out;
+	for (auto& usage : usages) {
+		out += usage;
+	}
+	return out;
+}
+
 struct ClearOffersForProductionData {
 	const ClearingParams& params;
 	Price* prices;
 	MemoryDatabase& db;
 	WorkUnitStateCommitment& clearing_details_out;
+	std::vector<MerkleWorkUnit::MerkleTrieT>& fully_cleared_tries;
 
 	void operator() (
 		const tbb::blocked_range<std::size_t>& r, 
@@ -170,7 +211,9 @@ struct ClearOffersForProductionData {
 		BlockStateUpdateStatsWrapper& state_update_stats) {
 		
 		for (auto i = r.begin(); i < r.end(); i++) {
-			work_units.at(i).process_clear_offers(params.work_unit_params.at(i), prices, params.tax_rate, db, local_log, clearing_details_out.at(i), state_update_stats);
+			work_units.at(i).process_clear_offers(
+				params.work_unit_params.at(i), prices, params.tax_rate, db, local_log, clearing_details_out.at(i), state_update_stats,
+				std::move(fully_cleared_tries.at(i)));
 		}
 	}
 };
@@ -360,7 +403,19 @@ void MerkleWorkUnitManager::clear_offers_for_production(
 			}
 		});*/
 	
-	ClearOffersForProductionData data{params, prices, db, clearing_details_out};
+	//Splits are cheap (one descent per work unit), so they get their own pass, 
+	//with no batching, ahead of the (much less even) clearing work.
+	std::vector<MerkleWorkUnit::MerkleTrieT> fully_cleared_tries(num_work_units);
+
+	tbb::parallel_for(
+		tbb::blocked_range<std::size_t>(0, num_work_units),
+		[this, &params, &fully_cleared_tries] (auto r) {
+			for (auto i = r.begin(); i < r.end(); i++) {
+				fully_cleared_tries[i] = work_units[i].split_fully_cleared_offers(params.work_unit_params.at(i));
+			}
+		});
+
+	ClearOffersForProductionData data{params, prices, db, clearing_details_out, fully_cleared_tries};
 
 
 	ClearOffersReduce<ClearOffersForProductionData> reduction(account_log, work_units, data);
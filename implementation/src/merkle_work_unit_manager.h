@@ -78,6 +78,13 @@ public:
 		work_units[idx].add_offers(std::move(trie));
 	}
 
+	//Threadsafe with respect to other add_offer_concurrent calls (only).
+	void add_offer_concurrent(int idx, const Offer& offer) {
+		prefix_t key;
+		MerkleWorkUnit::generate_key(offer, key);
+		work_units[idx].add_offer_concurrent(key, offer);
+	}
+
 	std::optional<Offer> mark_for_deletion(int idx, const prefix_t& key) {
 		return work_units[idx].mark_for_deletion(key);
 	}
@@ -237,8 +244,17 @@ public:
 		});
 	}
 
+	//Must be called before loading offers from lmdb.
+	void enable_multiset_commitment();
+
+	//Multiset hash of every open offer, across all work units.
+	void produce_multiset_commitment(Hash& hash_out);
+
 	uint8_t get_max_feasible_smooth_mult(const ClearingParams& clearing_params, Price* prices);
 	size_t num_open_offers() const;
+
+	//Walks every offer trie, so not for use on the block production path.
+	TrieMemoryUsage offer_memory_usage() const;
 };
 
 class LoadLMDBManagerView {
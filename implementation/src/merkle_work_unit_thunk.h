@@ -4,14 +4,16 @@
 
 namespace edce {
 
-template<typename prefix_t>
+//Offer trie leaves store only what the key doesn't (see CompactOfferWrapper),
+//so deleted offers are kept as (key, leaf) pairs.
+template<typename prefix_t, typename ValueT>
 struct AccumulateDeletedKeys {
 
-	std::vector<std::pair<prefix_t, Offer>> deleted_keys;
+	std::vector<std::pair<prefix_t, ValueT>> deleted_keys;
 
 	AccumulateDeletedKeys() : deleted_keys() {}
 
-	void operator() (const prefix_t& key, const Offer& offer) {
+	void operator() (const prefix_t& key, const ValueT& offer) {
 		deleted_keys.push_back(std::make_pair(key, offer));
 	}
 };
@@ -33,9 +35,9 @@ struct WorkUnitLMDBCommitmentThunk {
 
 	MerkleTrieT cleared_offers; // used only for the rollback
 
-	AccumulateDeletedKeys<prefix_t> deleted_keys;
+	AccumulateDeletedKeys<prefix_t, typename MerkleTrieT::value_t> deleted_keys;
 
-	bool exists_partial_exec;
+	bool exists_partial_exec = false;
 
 	uint64_t current_block_number;
 
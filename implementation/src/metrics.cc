@@ -0,0 +1,230 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+namespace edce {
+
+const char* metrics_counter_name(MetricsCounter counter) {
+	switch(counter) {
+		case MetricsCounter::BLOCKS_PRODUCED:
+			return "blocks_produced";
+		case MetricsCounter::BLOCKS_VALIDATED:
+			return "blocks_validated";
+		case MetricsCounter::TXS_IN_PRODUCED_BLOCKS:
+			return "txs_in_produced_blocks";
+		case MetricsCounter::TATONNEMENT_ROUNDS:
+			return "tatonnement_rounds";
+		case MetricsCounter::TATONNEMENT_TIMEOUTS:
+			return "tatonnement_timeouts";
+		case MetricsCounter::MEMPOOL_TXS_ADDED:
+			return "mempool_txs_added";
+		case MetricsCounter::RPC_SUBMIT_CALLS:
+			return "rpc_submit_calls";
+		case MetricsCounter::RPC_TXS_SUBMITTED:
+			return "rpc_txs_submitted";
+		case MetricsCounter::RPC_TXS_ADMITTED:
+			return "rpc_txs_admitted";
+		default:
+			throw std::runtime_error("invalid metrics counter");
+	}
+}
+
+const char* metrics_histogram_name(MetricsHistogram histogram) {
+	switch(histogram) {
+		case MetricsHistogram::BLOCK_PRODUCTION:
+			return "block_production";
+		case MetricsHistogram::BLOCK_VALIDATION:
+			return "block_validation";
+		case MetricsHistogram::TX_PROCESSING:
+			return "tx_processing";
+		case MetricsHistogram::TATONNEMENT:
+			return "tatonnement";
+		case MetricsHistogram::LP_SOLVE:
+			return "lp_solve";
+		case MetricsHistogram::OFFER_CLEARING:
+			return "offer_clearing";
+		case MetricsHistogram::STATE_HASHING:
+			return "state_hashing";
+		case MetricsHistogram::ACCOUNT_LMDB_COMMIT:
+			return "account_lmdb_commit";
+		case MetricsHistogram::OFFER_LMDB_COMMIT:
+			return "offer_lmdb_commit";
+		case MetricsHistogram::HEADER_LMDB_COMMIT:
+			return "header_lmdb_commit";
+		case MetricsHistogram::MEMPOOL_PUSH:
+			return "mempool_push";
+		case MetricsHistogram::MEMPOOL_CLEANING:
+			return "mempool_cleaning";
+		case MetricsHistogram::RPC_SUBMIT:
+			return "rpc_submit";
+		default:
+			throw std::runtime_error("invalid metrics histogram");
+	}
+}
+
+MetricsRegistry::Shard::Shard() {
+	for (auto& counter : counters) {
+		counter.store(0, std::memory_order_relaxed);
+	}
+	for (auto& hist : histograms) {
+		for (auto& bucket : hist.buckets) {
+			bucket.store(0, std::memory_order_relaxed);
+		}
+		hist.sum_ns.store(0, std::memory_order_relaxed);
+		hist.max_ns.store(0, std::memory_order_relaxed);
+	}
+	in_use.store(true, std::memory_order_relaxed);
+}
+
+MetricsRegistry::Shard*
+MetricsRegistry::acquire_shard() {
+	std::lock_guard lock(shards_mtx);
+	for (auto& shard : shards) {
+		//acquire pairs with the release when the previous owner exits, so its last records are visible to us
+		if (!shard->in_use.load(std::memory_order_acquire)) {
+			shard->in_use.store(true, std::memory_order_relaxed);
+			return shard.get();
+		}
+	}
+	shards.push_back(std::make_unique<Shard>());
+	return shards.back().get();
+}
+
+//first value v such that at least p of the count is <= v, as a bucket upper bound
+static uint64_t
+bucket_percentile(const std::array<uint64_t, LatencyBuckets::NUM_BUCKETS>& buckets, uint64_t count, uint64_t max_ns, double p) {
+	if (count == 0) {
+		return 0;
+	}
+	uint64_t target = std::max<uint64_t>(1, p * count);
+	uint64_t acc = 0;
+	for (size_t i = 0; i < LatencyBuckets::NUM_BUCKETS; i++) {
+		acc += buckets[i];
+		if (acc >= target) {
+			return std::min(LatencyBuckets::upper_bound(i), max_ns);
+		}
+	}
+	//not reached: count is the sum of the buckets
+	return max_ns;
+}
+
+MetricsSnapshot
+MetricsRegistry::snapshot() const {
+	MetricsSnapshot out;
+	out.uptime_ns = measure_time_from_basept(start_time) * 1'000'000'000.0;
+
+	std::lock_guard lock(shards_mtx);
+
+	for (size_t c = 0; c < NUM_METRICS_COUNTERS; c++) {
+		MetricsCounterValue value;
+		value.name = metrics_counter_name(static_cast<MetricsCounter>(c));
+		value.value = 0;
+		for (auto& shard : shards) {
+			value.value += shard->counters[c].load(std::memory_order_relaxed);
+		}
+		out.counters.push_back(value);
+	}
+
+	std::array<uint64_t, LatencyBuckets::NUM_BUCKETS> buckets;
+
+	for (size_t h = 0; h < NUM_METRICS_HISTOGRAMS; h++) {
+		MetricsHistogramSummary summary;
+		summary.name = metrics_histogram_name(static_cast<MetricsHistogram>(h));
+		summary.count = 0;
+		summary.sum_ns = 0;
+		summary.max_ns = 0;
+		buckets.fill(0);
+
+		for (auto& shard : shards) {
+			auto& hist = shard->histograms[h];
+			for (size_t i = 0; i < LatencyBuckets::NUM_BUCKETS; i++) {
+				buckets[i] += hist.buckets[i].load(std::memory_order_relaxed);
+			}
+			summary.sum_ns += hist.sum_ns.load(std::memory_order_relaxed);
+			summary.max_ns = std::max(summary.max_ns, hist.max_ns.load(std::memory_order_relaxed));
+		}
+		for (auto count : buckets) {
+			summary.count += count;
+		}
+
+		summary.p50_ns = bucket_percentile(buckets, summary.count, summary.max_ns, 0.5);
+		summary.p90_ns = bucket_percentile(buckets, summary.count, summary.max_ns, 0.9);
+		summary.p99_ns = bucket_percentile(buckets, summary.count, summary.max_ns, 0.99);
+		summary.p999_ns = bucket_percentile(buckets, summary.count, summary.max_ns, 0.999);
+		out.histograms.push_back(summary);
+	}
+	return out;
+}
+
+void write_metrics_snapshot_json(const MetricsSnapshot& snapshot, std::FILE* out) {
+	std::fprintf(out, "{\n  \"uptime_ns\": %lu,\n  \"counters\": {", snapshot.uptime_ns);
+	for (size_t i = 0; i < snapshot.counters.size(); i++) {
+		auto& counter = snapshot.counters[i];
+		std::fprintf(out, "%s\n    \"%s\": %lu", (i == 0) ? "" : ",", counter.name.c_str(), counter.value);
+	}
+	std::fprintf(out, "\n  },\n  \"histograms\": {");
+	for (size_t i = 0; i < snapshot.histograms.size(); i++) {
+		auto& hist = snapshot.histograms[i];
+		std::fprintf(out,
+			"%s\n    \"%s\": {\"count\": %lu, \"sum_ns\": %lu, \"p50_ns\": %lu, \"p90_ns\": %lu, \"p99_ns\": %lu, \"p999_ns\": %lu, \"max_ns\": %lu}",
+			(i == 0) ? "" : ",",
+			hist.name.c_str(),
+			hist.count,
+			hist.sum_ns,
+			hist.p50_ns,
+			hist.p90_ns,
+			hist.p99_ns,
+			hist.p999_ns,
+			hist.max_ns);
+	}
+	std::fprintf(out, "\n  }\n}\n");
+}
+
+void write_metrics_snapshot_file(const MetricsSnapshot& snapshot, const std::string& filename) {
+	std::string tmp_filename = filename + ".tmp";
+	std::FILE* f = std::fopen(tmp_filename.c_str(), "w");
+	if (f == nullptr) {
+		std::printf("errno was %d %s\n", errno, strerror(errno));
+		throw std::runtime_error("could not open metrics snapshot file " + tmp_filename);
+	}
+	write_metrics_snapshot_json(snapshot, f);
+	std::fclose(f);
+
+	if (std::rename(tmp_filename.c_str(), filename.c_str())) {
+		std::printf("errno was %d %s\n", errno, strerror(errno));
+		throw std::runtime_error("could not rename metrics snapshot file");
+	}
+}
+
+void
+MetricsSnapshotWriter::run() {
+	while (true) {
+		std::unique_lock lock(mtx);
+		cv.wait_for(lock, interval, [this] {return done_flag;});
+
+		try {
+			write_metrics_snapshot_file(MetricsRegistry::global().snapshot(), filename);
+		} catch (std::exception& e) {
+			//metrics are best effort; keep trying
+			std::printf("failed to write metrics snapshot: %s\n", e.what());
+		}
+		if (done_flag) {
+			return;
+		}
+	}
+}
+
+MetricsSnapshotWriter::~MetricsSnapshotWriter() {
+	{
+		std::lock_guard lock(mtx);
+		done_flag = true;
+		cv.notify_all();
+	}
+	writer_thread.join();
+}
+
+} /* edce */
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utils.h"
+
+#include "xdr/metrics_api.h"
+
+namespace edce {
+
+/*
+Process-wide metrics: counters and latency histograms for the hot phases of block production
+and validation, mempool admission and rpc.
+
+Every thread writes to its own shard (taken on first use, and handed to a later thread
+once the owner exits), so recording is a relaxed load and store on memory no other thread writes:
+no locks, no atomic read-modify-writes, no shared cache lines.
+Readers sum the shards.  A snapshot taken concurrently with recording may miss in-flight records.
+
+Metrics are recorded per phase (i.e. a few dozen records per block), not per transaction.
+
+Snapshots are served by MetricsApiServer (METRICS_PORT) and written periodically
+by MetricsSnapshotWriter (optional /edce-node/metrics_snapshot_file).
+Recording can be switched off (optional /edce-node/metrics), to measure its overhead.
+*/
+
+enum class MetricsCounter : uint32_t {
+	BLOCKS_PRODUCED = 0,
+	BLOCKS_VALIDATED,
+	TXS_IN_PRODUCED_BLOCKS,
+	TATONNEMENT_ROUNDS,
+	TATONNEMENT_TIMEOUTS,
+	MEMPOOL_TXS_ADDED,
+	RPC_SUBMIT_CALLS,
+	RPC_TXS_SUBMITTED,
+	RPC_TXS_ADMITTED,
+	NUM_COUNTERS
+};
+
+enum class MetricsHistogram : uint32_t {
+	BLOCK_PRODUCTION = 0,
+	BLOCK_VALIDATION,
+	TX_PROCESSING,
+	TATONNEMENT,
+	LP_SOLVE,
+	OFFER_CLEARING,
+	STATE_HASHING,
+	ACCOUNT_LMDB_COMMIT,
+	OFFER_LMDB_COMMIT,
+	HEADER_LMDB_COMMIT,
+	MEMPOOL_PUSH,
+	MEMPOOL_CLEANING,
+	RPC_SUBMIT,
+	NUM_HISTOGRAMS
+};
+
+constexpr static size_t NUM_METRICS_COUNTERS = static_cast<size_t>(MetricsCounter::NUM_COUNTERS);
+constexpr static size_t NUM_METRICS_HISTOGRAMS = static_cast<size_t>(MetricsHistogram::NUM_HISTOGRAMS);
+
+const char* metrics_counter_name(MetricsCounter counter);
+const char* metrics_histogram_name(MetricsHistogram histogram);
+
+/*
+Log-linear (HDR-style) buckets over nanoseconds.
+Values below 2^SUB_BUCKET_BITS get their own bucket; above that, each power of two
+is split into 2^SUB_BUCKET_BITS equal buckets, so a bucket's width is at most
+1/2^SUB_BUCKET_BITS of its values.  Values of 2^MAX_EXPONENT ns (about 18 minutes) or more
+share the last bucket.
+*/
+struct LatencyBuckets {
+	constexpr static unsigned int SUB_BUCKET_BITS = 4;
+	constexpr static uint64_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+	constexpr static unsigned int MAX_EXPONENT = 40;
+	constexpr static size_t NUM_BUCKETS = (MAX_EXPONENT - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+	static size_t bucket(uint64_t value_ns) {
+		if (value_ns < SUB_BUCKETS) {
+			return value_ns;
+		}
+		unsigned int exponent = 63 - __builtin_clzll(value_ns);
+		if (exponent >= MAX_EXPONENT) {
+			return NUM_BUCKETS - 1;
+		}
+		return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + ((value_ns >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+	}
+
+	static uint64_t lower_bound(size_t bucket_idx) {
+		if (bucket_idx < SUB_BUCKETS) {
+			return bucket_idx;
+		}
+		unsigned int exponent = bucket_idx / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+		return (SUB_BUCKETS + bucket_idx % SUB_BUCKETS) << (exponent - SUB_BUCKET_BITS);
+	}
+
+	//largest value in the bucket
+	static uint64_t upper_bound(size_t bucket_idx) {
+		if (bucket_idx + 1 == NUM_BUCKETS) {
+			return UINT64_MAX;
+		}
+		return lower_bound(bucket_idx + 1) - 1;
+	}
+};
+
+class MetricsRegistry {
+
+	struct alignas(64) Shard {
+		std::array<std::atomic<uint64_t>, NUM_METRICS_COUNTERS> counters;
+
+		struct Histogram {
+			std::array<std::atomic<uint64_t>, LatencyBuckets::NUM_BUCKETS> buckets;
+			std::atomic<uint64_t> sum_ns;
+			std::atomic<uint64_t> max_ns;
+		};
+		std::array<Histogram, NUM_METRICS_HISTOGRAMS> histograms;
+
+		std::atomic<bool> in_use;
+
+		Shard();
+	};
+
+	//only the owning thread writes, so there is no need for fetch_add
+	static void single_writer_add(std::atomic<uint64_t>& value, uint64_t amount) {
+		value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+	}
+
+	struct ShardHandle {
+		Shard* shard;
+		ShardHandle(MetricsRegistry& registry) : shard(registry.acquire_shard()) {}
+		~ShardHandle() {
+			shard->in_use.store(false, std::memory_order_release);
+		}
+	};
+
+	mutable std::mutex shards_mtx;
+	std::vector<std::unique_ptr<Shard>> shards;
+
+	const time_point start_time;
+
+	std::atomic<bool> enabled;
+
+	Shard* acquire_shard();
+
+	Shard& local_shard() {
+		static thread_local ShardHandle handle(*this);
+		return *handle.shard;
+	}
+
+	MetricsRegistry() : shards_mtx(), shards(), start_time(init_time_measurement()), enabled(true) {}
+
+public:
+
+	static MetricsRegistry& global() {
+		static MetricsRegistry registry;
+		return registry;
+	}
+
+	bool is_enabled() const {
+		return enabled.load(std::memory_order_relaxed);
+	}
+
+	void enable(bool enable_metrics = true) {
+		enabled.store(enable_metrics, std::memory_order_relaxed);
+	}
+
+	void add(MetricsCounter counter, uint64_t amount) {
+		if (!is_enabled()) {
+			return;
+		}
+		single_writer_add(local_shard().counters[static_cast<size_t>(counter)], amount);
+	}
+
+	void record(MetricsHistogram histogram, uint64_t value_ns) {
+		if (!is_enabled()) {
+			return;
+		}
+		auto& hist = local_shard().histograms[static_cast<size_t>(histogram)];
+		single_writer_add(hist.buckets[LatencyBuckets::bucket(value_ns)], 1);
+		single_writer_add(hist.sum_ns, value_ns);
+		if (value_ns > hist.max_ns.load(std::memory_order_relaxed)) {
+			hist.max_ns.store(value_ns, std::memory_order_relaxed);
+		}
+	}
+
+	MetricsSnapshot snapshot() const;
+};
+
+static inline void metrics_add(MetricsCounter counter, uint64_t amount = 1) {
+	MetricsRegistry::global().add(counter, amount);
+}
+
+//seconds, as returned by measure_time()
+static inline void metrics_record(MetricsHistogram histogram, double seconds) {
+	MetricsRegistry::global().record(histogram, (seconds > 0) ? static_cast<uint64_t>(seconds * 1'000'000'000.0) : 0);
+}
+
+void write_metrics_snapshot_json(const MetricsSnapshot& snapshot, std::FILE* out);
+
+//Writes to a temporary file and renames it over filename, so readers never see a partial snapshot.
+void write_metrics_snapshot_file(const MetricsSnapshot& snapshot, const std::string& filename);
+
+//Writes a snapshot every interval (and once more on destruction).
+class MetricsSnapshotWriter {
+	const std::string filename;
+	const std::chrono::milliseconds interval;
+
+	std::mutex mtx;
+	std::condition_variable cv;
+	bool done_flag = false;
+
+	std::thread writer_thread;
+
+	void run();
+
+public:
+
+	constexpr static uint32_t DEFAULT_INTERVAL_MS = 1000;
+
+	MetricsSnapshotWriter(const std::string& filename, uint32_t interval_ms = DEFAULT_INTERVAL_MS)
+		: filename(filename)
+		, interval(interval_ms)
+		, mtx()
+		, cv()
+		, writer_thread() {
+			writer_thread = std::thread([this] {run();});
+		}
+
+	~MetricsSnapshotWriter();
+};
+
+} /* edce */
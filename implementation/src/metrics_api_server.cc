@@ -0,0 +1,17 @@
+#include "metrics_api_server.h"
+
+#include <thread>
+
+namespace edce {
+
+MetricsApiServer::MetricsApiServer(const std::string& results_dir)
+	: metrics_server(results_dir)
+	, ps()
+	, metrics_listener(ps, tcp_listen_on_node_address(METRICS_PORT), false, xdr::session_allocator<void>()) {
+		metrics_listener.register_service(metrics_server);
+
+		std::thread th([this] {ps.run();});
+		th.detach();
+	}
+
+} /* edce */
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "rpc/rpcconfig.h"
+#include "rpc/listen_address.h"
+#include "rpc/metrics_api.h"
+#include "xdr/metrics_api.h"
+
+#include <xdrpp/srpc.h>
+#include <xdrpp/pollset.h>
+
+namespace edce {
+
+//Serves MetricsRegistry::global() snapshots (and SpanTracer dumps, into results_dir) on METRICS_PORT.
+class MetricsApiServer {
+
+	using Metrics = MetricsV1_server;
+
+	Metrics metrics_server;
+
+	xdr::pollset ps;
+
+	xdr::srpc_tcp_listener<> metrics_listener;
+
+public:
+
+	MetricsApiServer(const std::string& results_dir);
+};
+
+} /* edce */
@@ -0,0 +1,593 @@
+#include "benchmark_harness.h"
+
+#include "crypto_utils.h"
+#include "demand_kernel.h"
+#include "edce_management_structures.h"
+#include "io_uring_file_writer.h"
+#include "merkle_trie.h"
+#include "merkle_work_unit_manager.h"
+#include "metrics.h"
+#include "price_utils.h"
+#include "serial_transaction_processor.h"
+#include "simple_synthetic_data_generator.h"
+#include "tatonnement_sim_setup.h"
+#include "tx_type_utils.h"
+#include "utils.h"
+
+#include "xdr/experiments.h"
+#include "xdr/types.h"
+
+#include <sodium.h>
+#include <tbb/parallel_for.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+/*
+The microbenchmark suite.  Replaces ad-hoc timing loops
+(performance_test_merkle_trie, demand_kernel_benchmark, sig_benchmark, xdr_write_speedtest, ...)
+for tracking performance across changes: every case runs under the same warmup/repetition
+logic and reports the same statistics (see benchmark_harness.h).
+
+Typical use:
+	./microbenchmarks run all 10 2 baseline.json
+	(make changes)
+	./microbenchmarks compare baseline.json all
+*/
+
+using namespace edce;
+
+constexpr static uint16_t NUM_ASSETS = 20;
+
+using TrieValueT = XdrTypeWrapper<Offer>;
+using BenchmarkTrieT = MerkleTrie<8, TrieValueT, CombinedMetadata<SizeMixin>>;
+
+static void make_trie_key(BenchmarkTrieT::prefix_t& key, uint64_t i) {
+	//multiplying by an odd constant is a bijection, and spreads consecutive indices over the key space
+	PriceUtils::write_unsigned_big_endian(key, i * 0x9E3779B97F4A7C15);
+}
+
+class TrieInsertBenchmark : public BenchmarkCase {
+	constexpr static uint64_t NUM_KEYS = 1'000'000;
+public:
+	void run(BenchmarkTimer& timer) override {
+		BenchmarkTrieT trie;
+		BenchmarkTrieT::prefix_t key;
+		TrieValueT value;
+
+		timer.start();
+		for (uint64_t i = 0; i < NUM_KEYS; i++) {
+			make_trie_key(key, i);
+			trie.insert(key, value);
+		}
+		timer.stop();
+
+		if (trie.size() != NUM_KEYS) {
+			throw std::runtime_error("trie_insert size mismatch");
+		}
+	}
+};
+
+class TrieMergeBenchmark : public BenchmarkCase {
+	constexpr static uint64_t NUM_KEYS = 1'000'000;
+	constexpr static uint64_t NUM_TRIES = 16;
+public:
+	//merges tries with interleaved keys, as when merging per-thread tries of new offers
+	void run(BenchmarkTimer& timer) override {
+		std::vector<BenchmarkTrieT> tries(NUM_TRIES);
+		BenchmarkTrieT::prefix_t key;
+		TrieValueT value;
+		for (uint64_t i = 0; i < NUM_KEYS; i++) {
+			make_trie_key(key, i);
+			tries[i % NUM_TRIES].insert(key, value);
+		}
+
+		BenchmarkTrieT merged;
+		timer.start();
+		for (auto& trie : tries) {
+			merged.merge_in(std::move(trie));
+		}
+		timer.stop();
+
+		if (merged.size() != NUM_KEYS) {
+			throw std::runtime_error("trie_merge size mismatch");
+		}
+	}
+};
+
+class TrieHashBenchmark : public BenchmarkCase {
+	constexpr static uint64_t NUM_KEYS = 1'000'000;
+public:
+	void run(BenchmarkTimer& timer) override {
+		BenchmarkTrieT trie;
+		BenchmarkTrieT::prefix_t key;
+		TrieValueT value;
+		for (uint64_t i = 0; i < NUM_KEYS; i++) {
+			make_trie_key(key, i);
+			trie.insert(key, value);
+		}
+
+		Hash hash;
+		timer.start();
+		trie.freeze_and_hash(hash);
+		timer.stop();
+	}
+};
+
+//One demand query over every work unit, as in a round of Tatonnement.
+class DemandQueryBenchmark : public BenchmarkCase {
+	constexpr static size_t NUM_OFFERS = 500'000;
+	constexpr static size_t NUM_PRICE_SETS = 64;
+	constexpr static uint8_t SMOOTH_MULT = 10;
+
+	const bool use_kernel;
+
+	MerkleWorkUnitManager manager;
+	std::vector<std::vector<Price>> price_sets;
+	size_t next_price_set = 0;
+
+	DemandQueryPrices query_prices;
+	std::vector<uint128_t> demands, supplies;
+
+public:
+
+	DemandQueryBenchmark(bool use_kernel)
+		: use_kernel(use_kernel)
+		, manager(NUM_ASSETS)
+		, demands(NUM_ASSETS)
+		, supplies(NUM_ASSETS) {}
+
+	void setup() override {
+		std::minstd_rand gen(0);
+		std::uniform_real_distribution<> price_dist(0.01, 1000.0);
+
+		std::vector<Price> underlying_prices;
+		for (size_t i = 0; i < NUM_ASSETS; i++) {
+			underlying_prices.push_back(PriceUtils::from_double(price_dist(gen)));
+		}
+
+		SimpleSyntheticDataGenerator data_gen(NUM_ASSETS);
+		auto offers = data_gen.normal_underlying_prices_sell(NUM_OFFERS, underlying_prices, 1, 10000, 0.01, 1000);
+		{
+			ProcessingSerialManager serial(manager);
+			int unused = 0;
+			for (auto& offer : offers) {
+				serial.add_offer(manager.look_up_idx(offer.category), offer, unused, unused);
+			}
+			serial.finish_merge();
+		}
+		manager.commit_for_production(1);
+
+		for (size_t i = 0; i < NUM_PRICE_SETS; i++) {
+			std::vector<Price> prices;
+			for (size_t j = 0; j < NUM_ASSETS; j++) {
+				//near the underlying prices, as in late Tatonnement rounds
+				double noise = std::uniform_real_distribution<>(0.8, 1.2)(gen);
+				prices.push_back(PriceUtils::impose_bounds((uint128_t) (underlying_prices[j] * noise)));
+			}
+			price_sets.push_back(prices);
+		}
+	}
+
+	void run(BenchmarkTimer& timer) override {
+		std::fill(demands.begin(), demands.end(), 0);
+		std::fill(supplies.begin(), supplies.end(), 0);
+
+		auto* prices = price_sets[next_price_set].data();
+		next_price_set = (next_price_set + 1) % NUM_PRICE_SETS;
+
+		timer.start();
+		if (use_kernel) {
+			query_prices.set(prices, NUM_ASSETS);
+			for (auto& work_unit : manager.get_work_units()) {
+				work_unit.calculate_demands_and_supplies(query_prices, demands.data(), supplies.data(), SMOOTH_MULT);
+			}
+		} else {
+			for (auto& work_unit : manager.get_work_units()) {
+				work_unit.calculate_demands_and_supplies(prices, demands.data(), supplies.data(), SMOOTH_MULT);
+			}
+		}
+		timer.stop();
+	}
+};
+
+static SignedTransaction make_offer_tx(AccountID account, uint64_t sequence_number, std::minstd_rand& gen) {
+	std::uniform_int_distribution<> asset_dist(0, NUM_ASSETS - 1);
+	std::uniform_int_distribution<> amount_dist(1, 100);
+	std::uniform_real_distribution<> price_dist(0.5, 2.0);
+
+	AssetID sell_asset = asset_dist(gen);
+	AssetID buy_asset = sell_asset;
+	while (buy_asset == sell_asset) {
+		buy_asset = asset_dist(gen);
+	}
+
+	CreateSellOfferOp op;
+	op.category = TxTypeUtils::make_category(sell_asset, buy_asset, OfferType::SELL);
+	op.amount = amount_dist(gen);
+	op.minPrice = PriceUtils::from_double(price_dist(gen));
+
+	SignedTransaction tx;
+	tx.transaction.metadata.sourceAccount = account;
+	tx.transaction.metadata.sequenceNumber = sequence_number;
+	tx.transaction.operations.push_back(TxTypeUtils::make_operation(op));
+	return tx;
+}
+
+//txs cycle through the accounts, so each account's sequence numbers increase.
+static ExperimentBlock make_offer_txs(size_t num_txs, size_t num_accounts) {
+	std::minstd_rand gen(0);
+	ExperimentBlock txs;
+	for (size_t i = 0; i < num_txs; i++) {
+		txs.push_back(make_offer_tx(i % num_accounts, (i / num_accounts + 1) << 8, gen));
+	}
+	return txs;
+}
+
+//Processes a block of new offers in parallel, as the block producer's tx processing threads do.
+class TxProcessingBenchmark : public BenchmarkCase {
+	constexpr static size_t NUM_ACCOUNTS = 10'000;
+	constexpr static size_t NUM_TXS = 200'000;
+
+	ExperimentBlock txs;
+
+public:
+
+	void setup() override {
+		txs = make_offer_txs(NUM_TXS, NUM_ACCOUNTS);
+	}
+
+	void run(BenchmarkTimer& timer) override {
+		EdceManagementStructures management_structures(
+			NUM_ASSETS,
+			ApproximationParameters {
+				.tax_rate = 10,
+				.smooth_mult = 10
+			});
+		TatonnementSimSetup sim_setup(management_structures);
+		sim_setup.create_accounts(NUM_ACCOUNTS);
+		sim_setup.set_all_account_balances(NUM_ACCOUNTS, NUM_ASSETS, 1'000'000'000);
+
+		std::atomic<size_t> num_failed = 0;
+
+		timer.start();
+		tbb::parallel_for(
+			tbb::blocked_range<size_t>(0, txs.size(), 10'000),
+			[this, &management_structures, &num_failed] (auto r) {
+				SerialAccountModificationLog serial_log(management_structures.account_modification_log);
+				SerialTransactionProcessor tx_processor(management_structures);
+				BlockStateUpdateStatsWrapper stats;
+				for (auto i = r.begin(); i < r.end(); i++) {
+					if (tx_processor.process_transaction(txs[i], stats, serial_log) != TransactionProcessingStatus::SUCCESS) {
+						num_failed.fetch_add(1, std::memory_order_relaxed);
+					}
+				}
+				tx_processor.finish();
+			});
+		management_structures.account_modification_log.merge_in_log_batch();
+		timer.stop();
+
+		if (num_failed > 0) {
+			throw std::runtime_error("tx_processing: " + std::to_string(num_failed.load()) + " txs failed");
+		}
+	}
+};
+
+//Checks every signature of a block, as a validator does.
+class SignatureCheckBenchmark : public BenchmarkCase {
+	constexpr static size_t NUM_ACCOUNTS = 1'000;
+	constexpr static size_t NUM_TXS = 20'000;
+
+	EdceManagementStructures management_structures;
+	SerializedBlock serialized_block;
+
+public:
+
+	SignatureCheckBenchmark()
+		: management_structures(
+			NUM_ASSETS,
+			ApproximationParameters {
+				.tax_rate = 10,
+				.smooth_mult = 10
+			}) {}
+
+	void setup() override {
+		DeterministicKeyGenerator key_gen;
+		std::vector<DeterministicKeyGenerator::SecretKey> sks;
+		for (size_t i = 0; i < NUM_ACCOUNTS; i++) {
+			auto [sk, pk] = key_gen.deterministic_key_gen(i);
+			management_structures.db.add_account_to_db(i, pk);
+			sks.push_back(sk);
+		}
+		management_structures.db.commit(0);
+
+		auto txs = make_offer_txs(NUM_TXS, NUM_ACCOUNTS);
+		tbb::parallel_for(
+			tbb::blocked_range<size_t>(0, txs.size()),
+			[&txs, &sks] (auto r) {
+				for (auto i = r.begin(); i < r.end(); i++) {
+					auto& tx = txs[i];
+					auto msg = xdr::xdr_to_opaque(tx.transaction);
+					crypto_sign_detached(tx.signature.data(), nullptr, msg.data(), msg.size(), sks[tx.transaction.metadata.sourceAccount].data());
+				}
+			});
+
+		SignedTransactionList tx_list;
+		tx_list.insert(tx_list.end(), txs.begin(), txs.end());
+		serialized_block = xdr::xdr_to_opaque(tx_list);
+	}
+
+	void run(BenchmarkTimer& timer) override {
+		BlockSignatureChecker checker(management_structures);
+
+		timer.start();
+		bool res = checker.check_all_sigs(serialized_block);
+		timer.stop();
+
+		if (!res) {
+			throw std::runtime_error("signature check failed");
+		}
+	}
+};
+
+/*
+Persists one block's account modifications to an account lmdb
+(through the persistence thunks, as in edce_persist_async).
+The lmdb lives in a temporary directory (in the working directory, so on the same kind of disk
+as the real databases), created in setup() and removed afterwards.
+*/
+class LmdbPersistenceBenchmark : public BenchmarkCase {
+	constexpr static size_t NUM_ACCOUNTS = 100'000;
+	constexpr static size_t NUM_MODIFIED = 20'000;
+
+	MemoryDatabase db;
+	AccountModificationLog log;
+	uint64_t block_number = 0;
+
+	std::string lmdb_dir;
+
+public:
+
+	void setup() override {
+		char dir_template[] = "microbenchmark_lmdb_XXXXXX";
+		if (mkdtemp(dir_template) == nullptr) {
+			throw std::runtime_error("lmdb_persist: failed to create temporary directory");
+		}
+		lmdb_dir = std::string(dir_template) + "/";
+
+		db.open_lmdb_env(lmdb_dir);
+		db.create_lmdb();
+
+		PublicKey pk;
+		pk.fill(0);
+		for (size_t i = 0; i < NUM_ACCOUNTS; i++) {
+			db.add_account_to_db(i, pk);
+		}
+		db.commit(0);
+
+		block_number = db.get_persisted_round_number();
+	}
+
+	void run(BenchmarkTimer& timer) override {
+		block_number++;
+		{
+			SerialAccountModificationLog serial_log(log);
+			for (size_t i = 0; i < NUM_MODIFIED; i++) {
+				AccountID account = (block_number * NUM_MODIFIED + i) % NUM_ACCOUNTS;
+				account_db_idx idx;
+				if (!db.lookup_user_id(account, &idx)) {
+					throw std::runtime_error("lmdb_persist: missing account");
+				}
+				db.transfer_available(idx, i % NUM_ASSETS, 1);
+				serial_log.log_self_modification(account, block_number << 8);
+			}
+		}
+		log.merge_in_log_batch();
+		db.commit_values(log);
+		db.add_persistence_thunk(block_number, log);
+		log.detached_clear();
+
+		timer.start();
+		db.commit_persistence_thunks(block_number);
+		timer.stop();
+	}
+
+	~LmdbPersistenceBenchmark() {
+		if (lmdb_dir.empty()) {
+			return;
+		}
+		//the env is still open, but unlinking is fine
+		unlink((lmdb_dir + "data.mdb").c_str());
+		unlink((lmdb_dir + "lock.mdb").c_str());
+		rmdir(lmdb_dir.c_str());
+	}
+};
+
+class XdrIoBenchmark : public BenchmarkCase {
+public:
+	enum class Mode {WRITE_FAST, WRITE_URING, READ};
+
+private:
+	constexpr static size_t NUM_TXS = 500'000;
+	constexpr static unsigned int BUF_SIZE = 5*1677716;
+
+	const Mode mode;
+	const std::string filename;
+
+	ExperimentBlock txs;
+	size_t file_size = 0;
+	std::vector<unsigned char> write_buffer;
+	IoUringFileWriter writer;
+
+public:
+
+	XdrIoBenchmark(Mode mode)
+		: mode(mode)
+		, filename("microbenchmark_xdr_io.dat")
+		, txs()
+		, write_buffer(BUF_SIZE)
+		, writer() {}
+
+	void setup() override {
+		txs = make_offer_txs(NUM_TXS, NUM_TXS);
+		file_size = xdr::xdr_argpack_size(txs);
+
+		if (mode == Mode::READ) {
+			auto fd = preallocate_file(filename.c_str(), file_size);
+			save_xdr_to_file_fast(txs, fd, write_buffer.data(), BUF_SIZE);
+		}
+	}
+
+	void run(BenchmarkTimer& timer) override {
+		switch(mode) {
+			case Mode::WRITE_FAST:
+			{
+				auto fd = preallocate_file(filename.c_str(), file_size);
+				timer.start();
+				save_xdr_to_file_fast(txs, fd, write_buffer.data(), BUF_SIZE);
+				timer.stop();
+				break;
+			}
+			case Mode::WRITE_URING:
+			{
+				auto fd = preallocate_file(filename.c_str(), file_size);
+				timer.start();
+				writer.write_async(txs, std::move(fd));
+				writer.wait();
+				timer.stop();
+				break;
+			}
+			case Mode::READ:
+			{
+				ExperimentBlock reloaded;
+				timer.start();
+				if (load_xdr_from_file(reloaded, filename.c_str())) {
+					throw std::runtime_error("xdr_read: could not load file");
+				}
+				timer.stop();
+				if (reloaded.size() != txs.size()) {
+					throw std::runtime_error("xdr_read: size mismatch");
+				}
+				break;
+			}
+		}
+	}
+
+	~XdrIoBenchmark() {
+		unlink(filename.c_str());
+	}
+};
+
+//Cost of the per-phase metrics hooks; a block makes a few dozen such calls.
+class MetricsRecordBenchmark : public BenchmarkCase {
+	constexpr static uint64_t NUM_RECORDS = 1'000'000;
+public:
+	void run(BenchmarkTimer& timer) override {
+		for (uint64_t i = 0; i < NUM_RECORDS; i++) {
+			metrics_add(MetricsCounter::TATONNEMENT_ROUNDS);
+			metrics_record(MetricsHistogram::TATONNEMENT, (i % 1000) * 1e-6);
+		}
+	}
+};
+
+static void register_benchmarks(BenchmarkRegistry& registry) {
+	registry.add("trie_insert", "serial insertion of 1M keys into an offer trie",
+		[] () {return std::make_unique<TrieInsertBenchmark>();});
+	registry.add("trie_merge", "merging 16 tries of interleaved keys (1M total)",
+		[] () {return std::make_unique<TrieMergeBenchmark>();});
+	registry.add("trie_hash", "freeze_and_hash of a 1M key trie",
+		[] () {return std::make_unique<TrieHashBenchmark>();});
+	registry.add("demand_query", "one demand query over all work units (500k offers, raw prices)",
+		[] () {return std::make_unique<DemandQueryBenchmark>(false);});
+	registry.add("demand_query_kernel", "one demand query over all work units (500k offers, FixedPointDemandKernel)",
+		[] () {return std::make_unique<DemandQueryBenchmark>(true);});
+	registry.add("tx_processing", "parallel processing of 200k new offers",
+		[] () {return std::make_unique<TxProcessingBenchmark>();});
+	registry.add("signature_check", "checking a block of 20k signatures",
+		[] () {return std::make_unique<SignatureCheckBenchmark>();});
+	registry.add("lmdb_persist", "persisting 20k modified accounts to an account lmdb (in a temporary directory)",
+		[] () {return std::make_unique<LmdbPersistenceBenchmark>();});
+	registry.add("xdr_write_fast", "save_xdr_to_file_fast of 500k txs",
+		[] () {return std::make_unique<XdrIoBenchmark>(XdrIoBenchmark::Mode::WRITE_FAST);});
+	registry.add("xdr_write_uring", "IoUringFileWriter write of 500k txs",
+		[] () {return std::make_unique<XdrIoBenchmark>(XdrIoBenchmark::Mode::WRITE_URING);});
+	registry.add("xdr_read", "load_xdr_from_file of 500k txs",
+		[] () {return std::make_unique<XdrIoBenchmark>(XdrIoBenchmark::Mode::READ);});
+	registry.add("metrics_record", "1M metrics counter increments and histogram records",
+		[] () {return std::make_unique<MetricsRecordBenchmark>();});
+}
+
+static void print_usage() {
+	std::printf("usage: ./microbenchmarks list\n");
+	std::printf("       ./microbenchmarks run <case prefix|all> <reps=10> <warmup=2> <json_out=none>\n");
+	std::printf("       ./microbenchmarks compare <baseline json> <case prefix|all> <reps=10> <warmup=2> <threshold=0.1>\n");
+	std::printf("compare exits with 1 if any case's p50 exceeds its baseline p50 by more than threshold\n");
+}
+
+int main(int argc, char const *argv[])
+{
+	BenchmarkRegistry registry;
+	register_benchmarks(registry);
+
+	if (argc < 2) {
+		print_usage();
+		return 1;
+	}
+
+	std::string mode = argv[1];
+
+	if (mode == "list") {
+		registry.print_cases();
+		return 0;
+	}
+
+	bool compare = (mode == "compare");
+	if ((mode != "run" && !compare) || (compare && argc < 3)) {
+		print_usage();
+		return 1;
+	}
+
+	int arg_offset = compare ? 3 : 2;
+	std::string filter = (argc > arg_offset) ? argv[arg_offset] : "all";
+	size_t reps = (argc > arg_offset + 1) ? std::stoul(argv[arg_offset + 1]) : 10;
+	size_t warmup = (argc > arg_offset + 2) ? std::stoul(argv[arg_offset + 2]) : 2;
+
+	auto names = registry.select(filter);
+	if (names.size() == 0) {
+		std::printf("no benchmarks match %s\n", filter.c_str());
+		return 1;
+	}
+	if (reps == 0) {
+		std::printf("need at least one rep\n");
+		return 1;
+	}
+
+	std::vector<BenchmarkResult> results;
+	for (auto& name : names) {
+		results.push_back(registry.run(name, warmup, reps));
+		results.back().print();
+	}
+
+	if (!compare) {
+		if (argc > arg_offset + 3) {
+			if (!write_benchmark_json(results, argv[arg_offset + 3])) {
+				throw std::runtime_error(std::string("could not write ") + argv[arg_offset + 3]);
+			}
+		}
+		return 0;
+	}
+
+	double threshold = (argc > arg_offset + 3) ? std::stod(argv[arg_offset + 3]) : 0.1;
+
+	std::vector<BenchmarkComparison> comparisons;
+	auto num_regressions = compare_benchmarks(results, argv[2], threshold, comparisons);
+
+	std::printf("%lu of %lu cases regressed by more than %lf\n", num_regressions, results.size(), threshold);
+	return (num_regressions > 0) ? 1 : 0;
+}
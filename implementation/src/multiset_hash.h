@@ -0,0 +1,159 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+
+#include <sodium.h>
+#include <xdrpp/marshal.h>
+
+#include "xdr/types.h"
+
+namespace edce {
+
+/*
+Additive (lattice-style) multiset hash, with the LtHash16 parameters
+(Bellare-Micciancio; Lewi et al.): each element is hashed, then expanded into
+1024 16-bit lanes, and the hash of a multiset is the lane-wise sum (mod 2^16)
+of its elements' expansions.
+
+Because the hash is a sum, it can be updated in O(1) per insertion or deletion,
+and accumulators built on different threads (in any order) combine with +=.
+Finding a collision requires solving a short-vector problem in a lattice of this dimension;
+the security estimate for LtHash depends on these parameters, so do not shrink them.
+
+digest() compresses the lanes to a 32 byte Hash for inclusion in block headers.
+*/
+class MultisetHash {
+
+public:
+	constexpr static size_t NUM_LANES = 1024;
+	using lane_t = uint16_t;
+
+private:
+
+	std::array<lane_t, NUM_LANES> lanes;
+
+	using expansion_t = std::array<lane_t, NUM_LANES>;
+
+	static void expand(const unsigned char* data, size_t len, expansion_t& out) {
+		static_assert(crypto_stream_chacha20_KEYBYTES == crypto_generichash_BYTES, "seed is used as a stream key");
+		static_assert(sizeof(expansion_t) == NUM_LANES * sizeof(lane_t), "no padding");
+
+		unsigned char seed[crypto_generichash_BYTES];
+		crypto_generichash(seed, sizeof(seed), data, len, nullptr, 0);
+
+		//each seed is used once, so a zero nonce is fine.
+		unsigned char nonce[crypto_stream_chacha20_NONCEBYTES];
+		memset(nonce, 0, sizeof(nonce));
+		crypto_stream_chacha20(reinterpret_cast<unsigned char*>(out.data()), sizeof(expansion_t), nonce, seed);
+	}
+
+public:
+
+	MultisetHash() {
+		clear();
+	}
+
+	void clear() {
+		lanes.fill(0);
+	}
+
+	void insert(const unsigned char* data, size_t len) {
+		expansion_t expansion;
+		expand(data, len, expansion);
+		for (size_t i = 0; i < NUM_LANES; i++) {
+			lanes[i] += expansion[i];
+		}
+	}
+
+	void remove(const unsigned char* data, size_t len) {
+		expansion_t expansion;
+		expand(data, len, expansion);
+		for (size_t i = 0; i < NUM_LANES; i++) {
+			lanes[i] -= expansion[i];
+		}
+	}
+
+	template<typename xdr_type>
+	void insert_xdr(const xdr_type& value) {
+		auto buf = xdr::xdr_to_msg(value);
+		insert(reinterpret_cast<const unsigned char*>(buf->data()), buf->size());
+	}
+
+	template<typename xdr_type>
+	void remove_xdr(const xdr_type& value) {
+		auto buf = xdr::xdr_to_msg(value);
+		remove(reinterpret_cast<const unsigned char*>(buf->data()), buf->size());
+	}
+
+	MultisetHash& operator+=(const MultisetHash& other) {
+		for (size_t i = 0; i < NUM_LANES; i++) {
+			lanes[i] += other.lanes[i];
+		}
+		return *this;
+	}
+
+	MultisetHash& operator-=(const MultisetHash& other) {
+		for (size_t i = 0; i < NUM_LANES; i++) {
+			lanes[i] -= other.lanes[i];
+		}
+		return *this;
+	}
+
+	bool operator==(const MultisetHash& other) const {
+		return lanes == other.lanes;
+	}
+
+	bool operator!=(const MultisetHash& other) const {
+		return lanes != other.lanes;
+	}
+
+	//Lanes are hashed in little endian order, regardless of host byte order.
+	void digest(Hash& out) const {
+		unsigned char buf[NUM_LANES * sizeof(lane_t)];
+		for (size_t i = 0; i < NUM_LANES; i++) {
+			for (size_t j = 0; j < sizeof(lane_t); j++) {
+				buf[i * sizeof(lane_t) + j] = static_cast<unsigned char>(lanes[i] >> (8 * j));
+			}
+		}
+		crypto_generichash(out.data(), out.size(), buf, sizeof(buf), nullptr, 0);
+	}
+};
+
+/*
+A MultisetHash that many threads add their (thread-local) accumulators into.
+*/
+class SharedMultisetHash {
+	MultisetHash value;
+	mutable std::mutex mtx;
+
+public:
+
+	void operator+=(const MultisetHash& local) {
+		std::lock_guard lock(mtx);
+		value += local;
+	}
+
+	void operator-=(const MultisetHash& local) {
+		std::lock_guard lock(mtx);
+		value -= local;
+	}
+
+	MultisetHash get() const {
+		std::lock_guard lock(mtx);
+		return value;
+	}
+
+	void set(const MultisetHash& new_value) {
+		std::lock_guard lock(mtx);
+		value = new_value;
+	}
+
+	void digest(Hash& out) const {
+		get().digest(out);
+	}
+};
+
+} /* edce */
@@ -4,6 +4,10 @@
 #include "merkle_work_unit.h"
 #include "merkle_work_unit_helpers.h"
 #include "demand_calc_coroutine.h"
+#include "span_tracer.h"
+
+#include <algorithm>
+#include <utility>
 
 using uint128_t = __uint128_t;
 
@@ -84,7 +88,7 @@ class DemandOracleWorker : public AsyncWorker {
 	std::atomic<bool> round_done_flag = false;
 
 
-	Price* query_prices;
+	const DemandQueryPrices* query_prices;
 	std::vector<MerkleWorkUnit>* query_work_units;
 	uint8_t query_smooth_mult;
 
@@ -104,15 +108,15 @@ class DemandOracleWorker : public AsyncWorker {
 				return false;
 			}
 			bool sleep = sleep_flag.load(std::memory_order_relaxed);
-			if (sleep) {
-				sleep_flag.store(false, std::memory_order_relaxed);
+			//exchange, since activate_worker can take back the request
+			if (sleep && sleep_flag.exchange(false, std::memory_order_relaxed)) {
 				return true;
 			}
 			__builtin_ia32_pause();
 		}
 	}
 	void get_supply_demand(
-		Price* active_prices,
+		const DemandQueryPrices& active_prices,
 		uint128_t* supplies, 
 		uint128_t* demands, 
 		std::vector<MerkleWorkUnit>& work_units,
@@ -125,6 +129,7 @@ class DemandOracleWorker : public AsyncWorker {
 
 
 	void run() {
+		span_tracer_set_thread_name("demand_oracle_worker");
 		std::unique_lock lock(mtx);
 
 		while(true) {
@@ -137,13 +142,16 @@ class DemandOracleWorker : public AsyncWorker {
 				round_start = false;
 				
 				while(!spinlock()) {
-					for (size_t i = 0; i < num_assets; i++) {
-						supplies[i] = 0;
-						demands[i] = 0;
+					{
+						TraceSpan span("demand_query");
+						for (size_t i = 0; i < num_assets; i++) {
+							supplies[i] = 0;
+							demands[i] = 0;
+						}
+
+						//coro_oracle.
+							get_supply_demand(*query_prices, supplies, demands, *query_work_units, query_smooth_mult);
 					}
-
-					//coro_oracle.
-						get_supply_demand(query_prices, supplies, demands, *query_work_units, query_smooth_mult);
 					signal_round_compute_done();
 				}
 				
@@ -168,6 +176,13 @@ public:
 		start_async_thread([this] {run();});
 	}
 
+	//Only between rounds.  signal_round_start publishes the new range to the worker.
+	void set_range(size_t starting_work_unit_, size_t ending_work_unit_) {
+		starting_work_unit = starting_work_unit_;
+		ending_work_unit = ending_work_unit_;
+		coro_oracle.init(starting_work_unit, ending_work_unit);
+	}
+
 	~DemandOracleWorker() {
 		wait_for_async_task();
 		end_async_thread();
@@ -192,7 +207,7 @@ public:
 		}
 	}
 
-	void signal_round_start(Price* prices, std::vector<MerkleWorkUnit>* work_units, uint8_t smooth_mult) {
+	void signal_round_start(const DemandQueryPrices* prices, std::vector<MerkleWorkUnit>* work_units, uint8_t smooth_mult) {
 		query_prices = prices;
 		query_work_units = work_units;
 		query_smooth_mult = smooth_mult;
@@ -201,6 +216,10 @@ public:
 	}
 
 	void activate_worker() {
+		if (sleep_flag.exchange(false, std::memory_order_relaxed)) {
+			//deactivated, but still spinning
+			return;
+		}
 		std::lock_guard lock(mtx);
 		round_start = true;
 		cv.notify_one();
@@ -211,6 +230,11 @@ public:
 };
 
 
+/*
+NUM_WORKERS threads are allocated up front, but only the first num_active_workers
+of them take part in queries (the rest sleep).  The work units are split evenly
+between the active workers and the calling thread.
+*/
 template<unsigned int NUM_WORKERS>
 class ParallelDemandOracle {
 
@@ -223,26 +247,71 @@ class ParallelDemandOracle {
 
 	DemandOracleWorker workers[NUM_WORKERS];
 
+	size_t num_active_workers = NUM_WORKERS;
+	bool oracle_active = false;
+
 	CoroutineDemandOracle coro_oracle;
 
+	//prices of the current query, and their reciprocals
+	DemandQueryPrices query_prices;
+
+	std::pair<size_t, size_t> worker_range(size_t worker_idx, size_t num_shares) const {
+		return std::make_pair(
+			(num_work_units * (worker_idx+1)) / num_shares,
+			(num_work_units * (worker_idx+2)) / num_shares);
+	}
+
 public:
-	ParallelDemandOracle(size_t num_work_units, size_t num_assets)
+	ParallelDemandOracle(size_t num_work_units, size_t num_assets, size_t num_active_workers_ = NUM_WORKERS)
 		: num_work_units(num_work_units)
 		, num_assets(num_assets)
+		, num_active_workers(std::min<size_t>(num_active_workers_, NUM_WORKERS))
 	{
 
-		size_t num_shares = NUM_WORKERS + 1;
+		size_t num_shares = num_active_workers + 1;
 		main_thread_end_idx = num_work_units / (num_shares);
 
 		for (size_t i = 0; i < NUM_WORKERS; i++) {
-			size_t start_idx = (num_work_units * (i+1)) / num_shares;
-			size_t end_idx = (num_work_units * (i+2)) / num_shares;
+			auto [start_idx, end_idx] = worker_range(i, num_shares);
+			if (i >= num_active_workers) {
+				start_idx = end_idx = num_work_units;
+			}
 		//	std::printf("worker %d: start %lu end %lu total %lu\n", i, start_idx, end_idx, num_work_units);
 			workers[i].init(num_assets, start_idx, end_idx);
 		}
 		coro_oracle.init(main_thread_start_idx, main_thread_end_idx);
 	}
 
+	size_t get_num_active_workers() const {
+		return num_active_workers;
+	}
+
+	//Only between queries or rounds, from the thread that calls get_supply_demand.
+	void set_num_active_workers(size_t new_num_active) {
+		new_num_active = std::min<size_t>(new_num_active, NUM_WORKERS);
+		if (new_num_active == num_active_workers) {
+			return;
+		}
+
+		size_t num_shares = new_num_active + 1;
+		main_thread_end_idx = num_work_units / num_shares;
+		coro_oracle.init(main_thread_start_idx, main_thread_end_idx);
+
+		for (size_t i = 0; i < new_num_active; i++) {
+			auto [start_idx, end_idx] = worker_range(i, num_shares);
+			workers[i].set_range(start_idx, end_idx);
+			if (oracle_active && i >= num_active_workers) {
+				workers[i].activate_worker();
+			}
+		}
+		for (size_t i = new_num_active; i < num_active_workers; i++) {
+			if (oracle_active) {
+				workers[i].deactivate_worker();
+			}
+		}
+		num_active_workers = new_num_active;
+	}
+
 	void get_supply_demand(
 		Price* active_prices,
 		uint128_t* supplies, 
@@ -250,30 +319,33 @@ public:
 		std::vector<MerkleWorkUnit>& work_units,
 		const uint8_t smooth_mult) {
 		//std::printf("starting demand query\n");
-		for (size_t i = 0; i < NUM_WORKERS; i++) {
-			workers[i].signal_round_start(active_prices, &work_units, smooth_mult);
+		query_prices.set(active_prices, num_assets);
+		for (size_t i = 0; i < num_active_workers; i++) {
+			workers[i].signal_round_start(&query_prices, &work_units, smooth_mult);
 		}
 		//std::printf("signaled round start\n");
 
 		//coro_oracle.get_supply_demand(active_prices, supplies, demands, work_units, smooth_mult);
 		for (size_t i = main_thread_start_idx; i < main_thread_end_idx; i++) {
-			work_units[i].calculate_demands_and_supplies(active_prices, demands, supplies, smooth_mult);
+			work_units[i].calculate_demands_and_supplies(query_prices, demands, supplies, smooth_mult);
 		}
 		//std::printf("starting wait for compute done\n");
-		for (size_t i = 0; i < NUM_WORKERS; i++) {
+		for (size_t i = 0; i < num_active_workers; i++) {
 			workers[i].wait_for_compute_done_and_get_results(demands, supplies);
 		}
 		//std::printf("done demand query\n");
 	}
 
 	void activate_oracle() {
-		for (size_t i = 0; i < NUM_WORKERS; i++) {
+		oracle_active = true;
+		for (size_t i = 0; i < num_active_workers; i++) {
 			workers[i].activate_worker();
 		}
 	}
 
 	void deactivate_oracle() {
-		for (size_t i = 0; i < NUM_WORKERS; i++) {
+		oracle_active = false;
+		for (size_t i = 0; i < num_active_workers; i++) {
 			workers[i].deactivate_worker();
 		}
 	}
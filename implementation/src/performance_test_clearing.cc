@@ -0,0 +1,114 @@
+#include "merkle_work_unit.h"
+#include "memory_database.h"
+#include "account_modification_log.h"
+#include "price_utils.h"
+#include "utils.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "xdr/types.h"
+
+using namespace edce;
+
+/*
+Clearing on a skewed orderbook: one trading pair (work unit) holds every offer,
+and every offer clears.  Compares the serial clearing loop against
+the parallel, prefetching clearing used for large work units.
+*/
+
+using TrieT = MerkleWorkUnit::MerkleTrieT;
+
+OfferCategory make_category() {
+	OfferCategory category;
+	category.sellAsset = 0;
+	category.buyAsset = 1;
+	category.type = OfferType::SELL;
+	return category;
+}
+
+void make_skewed_book(TrieT& trie, uint64_t num_offers, uint64_t num_accounts, Price max_min_price) {
+	std::minstd_rand gen(0);
+	std::uniform_int_distribution<uint64_t> owner_dist(0, num_accounts - 1);
+	std::uniform_int_distribution<Price> price_dist(1, max_min_price);
+
+	Offer offer;
+	offer.category = make_category();
+
+	TrieT::prefix_t key_buf;
+
+	for (uint64_t i = 0; i < num_offers; i++) {
+		offer.owner = owner_dist(gen);
+		offer.offerId = i;
+		offer.amount = 100;
+		offer.minPrice = price_dist(gen);
+		MerkleWorkUnit::generate_key(offer, key_buf);
+		trie.insert(key_buf, MerkleWorkUnit::TrieValueT(offer));
+	}
+}
+
+void clearing_time(uint64_t num_offers, uint64_t num_accounts, int num_trials) {
+	MemoryDatabase db;
+	for (uint64_t i = 0; i < num_accounts; i++) {
+		db.add_account_to_db(i);
+	}
+	db.commit(0);
+
+	Price price = PriceUtils::from_double(1.0);
+
+	TrieT trie;
+	make_skewed_book(trie, num_offers, num_accounts, price);
+	std::printf("made book of %lu offers over %lu accounts\n", trie.size(), num_accounts);
+
+	for (int trial = 0; trial < num_trials; trial++) {
+		{
+			AccountModificationLog log;
+			SerialAccountModificationLog serial_log(log);
+
+			CompleteClearingFunc func(make_category(), price, price, 10, db, serial_log);
+
+			auto timestamp = init_time_measurement();
+			trie.apply(func);
+			double res = measure_time(timestamp);
+			log.merge_in_log_batch();
+			double merge_res = measure_time(timestamp);
+			std::printf("serial clearing: %lf (log merge %lf)\n", res, merge_res);
+		}
+		{
+			AccountModificationLog log;
+
+			ParallelCompleteClearingFunc func(make_category(), price, price, 10, db, log);
+
+			auto timestamp = init_time_measurement();
+			trie.parallel_apply_threadlocal_acc(func);
+			double res = measure_time(timestamp);
+			log.merge_in_log_batch();
+			double merge_res = measure_time(timestamp);
+			if (func.failed()) {
+				throw std::runtime_error("parallel clearing failed");
+			}
+			std::printf("parallel clearing: %lf (log merge %lf)\n", res, merge_res);
+		}
+	}
+}
+
+int main(int argc, char const *argv[])
+{
+	if (argc != 3 && argc != 1) {
+		std::printf("usage: ./perftest_clearing <num_offers> <num_accounts>\n");
+		return -1;
+	}
+
+	uint64_t num_offers = 1'000'000;
+	uint64_t num_accounts = 10'000'000;
+
+	if (argc == 3) {
+		num_offers = std::atol(argv[1]);
+		num_accounts = std::atol(argv[2]);
+	}
+
+	clearing_time(num_offers, num_accounts, 5);
+	return 0;
+}
@@ -3,9 +3,15 @@
 #include "utils.h"
 #include "account_modification_log.h"
 #include "account_merkle_trie.h"
+#include "merkle_work_unit.h"
 
 
+#include <atomic>
 #include <cstdint>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "xdr/types.h"
 
@@ -237,9 +243,240 @@ void apply_time(uint64_t num_insertions) {
 	}
 }
 
+struct ScanLambda {
+	uint64_t amount = 0;
+
+	template<typename prefix_t>
+	void operator() (const prefix_t& key, const Offer& offer) {
+		amount += offer.amount;
+	}
+};
+
+struct ParallelScanLambda {
+	std::atomic<uint64_t> amount = 0;
+
+	template<typename prefix_t>
+	void operator() (const prefix_t& key, const Offer& offer) {
+		amount.fetch_add(offer.amount, std::memory_order_relaxed);
+	}
+};
+
+struct SumLambda {
+	uint64_t amount = 0;
+
+	void operator() (const Offer& offer) {
+		amount += offer.amount;
+	}
+};
+
+void iterate_time(uint64_t num_insertions) {
+	using MT = MerkleTrie<8, InsertValueT, CombinedMetadata<SizeMixin>>;
+	using prefix_t = typename MT::prefix_t;
+
+	prefix_t key;
+
+	MT trie;
+
+	for (uint64_t i = 0; i < num_insertions; i++) {
+		//spread keys across the whole key space
+		PriceUtils::write_unsigned_big_endian(key, i * 0x9E3779B97F4A7C15);
+		InsertValueT offer;
+		offer.amount = 1;
+		trie.insert(key, offer);
+	}
+
+	std::printf("made test trie\n");
+
+	prefix_t lo, hi, mid;
+	hi.set_max();
+	PriceUtils::write_unsigned_big_endian(mid, UINT64_MAX / 2);
+
+	while(true) {
+		auto timestamp = init_time_measurement();
+
+		uint64_t iter_amount = 0;
+		for (auto iter = trie.begin(); !iter.at_end(); ++iter) {
+			iter_amount += (*iter).second.get().amount;
+		}
+		float iter_time = measure_time(timestamp);
+
+		SumLambda apply_lambda;
+		trie.apply(apply_lambda);
+		float apply_time = measure_time(timestamp);
+
+		ScanLambda scan_lambda;
+		trie.range_scan(scan_lambda, lo, hi);
+		float scan_time = measure_time(timestamp);
+
+		ScanLambda half_scan_lambda;
+		trie.range_scan(half_scan_lambda, lo, mid);
+		float half_scan_time = measure_time(timestamp);
+
+		ParallelScanLambda parallel_scan_lambda;
+		trie.parallel_range_scan(parallel_scan_lambda, lo, hi);
+		float parallel_scan_time = measure_time(timestamp);
+
+		if (iter_amount != num_insertions
+			|| apply_lambda.amount != num_insertions
+			|| scan_lambda.amount != num_insertions
+			|| parallel_scan_lambda.amount != num_insertions) {
+			throw std::runtime_error("scan missed keys!");
+		}
+
+		std::printf("iterator %lf apply %lf range_scan %lf (half range %lf) parallel_range_scan %lf\n",
+			iter_time, apply_time, scan_time, half_scan_time, parallel_scan_time);
+	}
+}
+
+template<typename MT>
+void offer_memory_usage(uint64_t num_offers) {
+	using prefix_t = typename MT::prefix_t;
+
+	std::minstd_rand gen(0);
+
+	prefix_t key;
+
+	MT trie;
+
+	for (uint64_t i = 0; i < num_offers; i++) {
+		Offer offer;
+		offer.offerId = i;
+		offer.owner = gen() % 1'000'000;
+		offer.amount = 100;
+		offer.minPrice = PriceUtils::from_double(0.5 + ((double) (gen() % 1000)) / 1000);
+		MerkleWorkUnit::generate_key(offer, key);
+		trie.insert(key, typename MT::value_t(offer));
+	}
+
+	auto usage = trie.memory_usage();
+
+	std::printf("offers %lu nodes %lu heap children maps %lu\n", 
+		usage.num_leaves, usage.num_nodes, usage.num_heap_children_maps);
+	std::printf("node size %lu bytes, total %lu bytes, %lf bytes per offer\n",
+		sizeof(typename MT::TrieT), usage.bytes, usage.bytes_per_leaf());
+}
+
+void offer_memory_report(uint64_t num_offers) {
+	std::printf("work unit offer trie (amount-only leaves):\n");
+	offer_memory_usage<MerkleWorkUnit::MerkleTrieT>(num_offers);
+
+	std::printf("full Offer leaves:\n");
+	offer_memory_usage<MerkleTrie<MerkleWorkUnit::WORKUNIT_KEY_LEN, OfferWrapper, MerkleWorkUnit::TrieMetadataT, false>>(num_offers);
+}
+
+/*
+Fills a trie from num_threads threads, either by parallel_insert directly into the trie,
+or by inserting into threadlocal tries and merging those in afterwards
+(with merge_in, as work units do, and with batch_merge_in, if the trie has node locks).
+make_kv(i, key) writes the i'th key and returns its value.
+*/
+template<typename MT, bool BATCH_MERGE, typename MakeKVFn>
+void concurrent_insert_time(uint64_t num_insertions, unsigned int num_threads, MakeKVFn make_kv) {
+	using prefix_t = typename MT::prefix_t;
+
+	auto run_threads = [num_insertions, num_threads, &make_kv] (auto insert_fn) {
+		std::vector<std::thread> threads;
+		for (unsigned int t = 0; t < num_threads; t++) {
+			threads.emplace_back([=, &make_kv] () {
+				prefix_t key;
+				for (uint64_t i = num_insertions * t / num_threads; i < num_insertions * (t + 1) / num_threads; i++) {
+					auto value = make_kv(i, key);
+					insert_fn(t, key, value);
+				}
+			});
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+	};
+
+	for (int round = 0; round < 5; round++) {
+		MT parallel_trie;
+		auto timestamp = init_time_measurement();
+		run_threads([&parallel_trie] (unsigned int, const prefix_t& key, const auto& value) {
+			parallel_trie.parallel_insert(key, value);
+		});
+		float parallel_time = measure_time(timestamp);
+
+		MT merge_trie;
+		std::vector<MT> local_tries(num_threads);
+		timestamp = init_time_measurement();
+		run_threads([&local_tries] (unsigned int t, const prefix_t& key, const auto& value) {
+			local_tries[t].insert(key, value);
+		});
+		for (auto& local_trie : local_tries) {
+			merge_trie.merge_in(std::move(local_trie));
+		}
+		float merge_time = measure_time(timestamp);
+
+		float batch_merge_time = 0;
+		if constexpr (BATCH_MERGE) {
+			MT batch_trie;
+			std::vector<MT> batch_local_tries(num_threads);
+			timestamp = init_time_measurement();
+			run_threads([&batch_local_tries] (unsigned int t, const prefix_t& key, const auto& value) {
+				batch_local_tries[t].insert(key, value);
+			});
+			std::vector<std::unique_ptr<typename MT::TrieT>> roots;
+			for (auto& local_trie : batch_local_tries) {
+				roots.push_back(local_trie.extract_root());
+			}
+			batch_trie.batch_merge_in(std::move(roots));
+			batch_merge_time = measure_time(timestamp);
+			if (batch_trie.size() != num_insertions) {
+				throw std::runtime_error("size error!");
+			}
+		}
+
+		if (parallel_trie.size() != num_insertions || merge_trie.size() != num_insertions) {
+			throw std::runtime_error("size error!");
+		}
+
+		std::printf("%u threads: parallel_insert %lf threadlocal+merge_in %lf", num_threads, parallel_time, merge_time);
+		if (BATCH_MERGE) {
+			std::printf(" threadlocal+batch_merge_in %lf", batch_merge_time);
+		}
+		std::printf("\n");
+	}
+}
+
+void concurrent_insert_report(uint64_t num_insertions, unsigned int num_threads) {
+	std::printf("generic trie (node locks):\n");
+	concurrent_insert_time<MerkleTrie<8, InsertValueT, CombinedMetadata<SizeMixin>>, true>(
+		num_insertions, num_threads, 
+		[] (uint64_t i, auto& key) {
+			PriceUtils::write_unsigned_big_endian(key, i * 0x9E3779B97F4A7C15);
+			return InsertValueT{};
+		});
+
+	std::printf("offer trie (no node locks):\n");
+	concurrent_insert_time<MerkleWorkUnit::MerkleTrieT, false>(
+		num_insertions, num_threads,
+		[] (uint64_t i, auto& key) {
+			Offer offer;
+			offer.offerId = i;
+			offer.owner = (i * 0x9E3779B97F4A7C15) % 1'000'000;
+			offer.amount = 100;
+			offer.minPrice = PriceUtils::from_double(0.5 + ((double) ((i * 7919) % 1000)) / 1000);
+			MerkleWorkUnit::generate_key(offer, key);
+			return MerkleWorkUnit::TrieValueT(offer);
+		});
+}
 
 int main(int argc, char const *argv[])
 {
+	if ((argc == 2 || argc == 3) && std::string(argv[1]) == "concurrent_insert") {
+		unsigned int num_threads = (argc == 3) ? std::stoi(argv[2]) : std::thread::hardware_concurrency();
+		concurrent_insert_report(2'000'000, num_threads);
+		return 0;
+	}
+	if (argc == 2 && std::string(argv[1]) == "iterate") {
+		iterate_time(2'000'000);
+	}
+	if (argc == 2 && std::string(argv[1]) == "memory") {
+		offer_memory_report(10'000'000);
+		return 0;
+	}
 //	accumulate_values_time(20'000'000);
 	//auto timestamp = init_time_measurement();
 	insert_time(1'000'000);
@@ -0,0 +1,175 @@
+#include "price_trace.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <xdrpp/marshal.h>
+
+namespace edce {
+
+PriceTraceRecorder::PriceTraceRecorder(const std::string& filename)
+	: f(std::fopen(filename.c_str(), "a"))
+	, current() {
+	if (f == nullptr) {
+		std::printf("errno was %d %s opening %s\n", errno, strerror(errno), filename.c_str());
+		throw std::runtime_error("could not open price trace file");
+	}
+}
+
+PriceTraceRecorder::~PriceTraceRecorder() {
+	wait_for_index_copy();
+	std::fclose(f);
+}
+
+void
+PriceTraceRecorder::wait_for_index_copy() {
+	if (index_copy_thread.joinable()) {
+		index_copy_thread.join();
+	}
+}
+
+void
+PriceTraceRecorder::copy_indices(MerkleWorkUnitManager& work_unit_manager) {
+	auto& work_units = work_unit_manager.get_work_units();
+
+	for (size_t i = 0; i < work_units.size(); i++) {
+		auto& index = work_units[i].get_indexed_metadata();
+		auto& out = current.workUnits[i].index;
+		out.reserve(index.size());
+		for (auto& entry : index) {
+			PriceTraceIndexEntry recorded;
+			recorded.key = entry.key;
+			recorded.endow = entry.metadata.endow;
+			recorded.endowTimesPriceHigh = static_cast<int64_t>(entry.metadata.endow_times_price >> 64);
+			recorded.endowTimesPriceLow = static_cast<uint64_t>(entry.metadata.endow_times_price);
+			out.push_back(recorded);
+		}
+	}
+}
+
+void
+PriceTraceRecorder::begin_block(
+	uint64_t block_number,
+	MerkleWorkUnitManager& work_unit_manager,
+	const Price* starting_prices,
+	const ApproximationParameters approx_params,
+	const uint16_t* volume_relativizers) {
+
+	//a block that was abandoned before finish_block
+	wait_for_index_copy();
+
+	auto num_assets = work_unit_manager.get_num_assets();
+	auto& work_units = work_unit_manager.get_work_units();
+
+	current = PriceComputationTrace();
+	current.blockNumber = block_number;
+	current.numAssets = num_assets;
+	current.taxRate = approx_params.tax_rate;
+	current.smoothMult = approx_params.smooth_mult;
+
+	current.startingPrices.insert(current.startingPrices.end(), starting_prices, starting_prices + num_assets);
+	if (volume_relativizers != nullptr) {
+		current.volumeRelativizers.insert(current.volumeRelativizers.end(), volume_relativizers, volume_relativizers + num_assets);
+	}
+
+	current.workUnits.resize(work_units.size());
+	index_copy_thread = std::thread(
+		[this, &work_unit_manager] () {
+			copy_indices(work_unit_manager);
+		});
+	block_in_progress = true;
+}
+
+void
+PriceTraceRecorder::finish_block(
+	const Price* computed_prices,
+	const TatonnementMeasurements& tatonnement_results,
+	const BlockCreationMeasurements& stats) {
+
+	if (!block_in_progress) {
+		throw std::runtime_error("finish_block without begin_block");
+	}
+	block_in_progress = false;
+
+	wait_for_index_copy();
+
+	current.computedPrices.insert(current.computedPrices.end(), computed_prices, computed_prices + current.numAssets);
+	current.tatonnement = tatonnement_results;
+	current.lpTime = stats.lp_time;
+	current.achievedFeeRate = stats.achieved_feerate;
+	current.achievedSmoothMult = stats.achieved_smooth_mult;
+	current.timeoutHappened = stats.tat_timeout_happened;
+
+	auto buf = xdr::xdr_to_opaque(current);
+
+	unsigned char header[4];
+	uint32_t len = buf.size();
+	for (size_t i = 0; i < 4; i++) {
+		header[i] = (len >> (8 * (3 - i))) & 0xFF;
+	}
+
+	if (std::fwrite(header, 1, 4, f) != 4 || std::fwrite(buf.data(), 1, buf.size(), f) != buf.size()) {
+		throw std::runtime_error("error writing price trace");
+	}
+	std::fflush(f);
+}
+
+PriceTraceReader::PriceTraceReader(const std::string& filename)
+	: f(std::fopen(filename.c_str(), "r")) {
+	if (f == nullptr) {
+		std::printf("errno was %d %s opening %s\n", errno, strerror(errno), filename.c_str());
+		throw std::runtime_error("could not open price trace file");
+	}
+}
+
+PriceTraceReader::~PriceTraceReader() {
+	std::fclose(f);
+}
+
+bool
+PriceTraceReader::next(PriceComputationTrace& out) {
+	unsigned char header[4];
+	auto header_read = std::fread(header, 1, 4, f);
+	if (header_read == 0) {
+		return false;
+	}
+	if (header_read != 4) {
+		throw std::runtime_error("truncated price trace header");
+	}
+	uint32_t len = 0;
+	for (size_t i = 0; i < 4; i++) {
+		len = (len << 8) + header[i];
+	}
+
+	std::vector<unsigned char> buf;
+	buf.resize(len);
+	if (std::fread(buf.data(), 1, len, f) != len) {
+		throw std::runtime_error("truncated price trace record");
+	}
+	xdr::xdr_from_opaque(buf, out);
+	return true;
+}
+
+void load_price_trace_indices(const PriceComputationTrace& trace, MerkleWorkUnitManager& work_unit_manager) {
+	auto& work_units = work_unit_manager.get_work_units();
+
+	if (trace.numAssets != work_unit_manager.get_num_assets() || trace.workUnits.size() != work_units.size()) {
+		throw std::runtime_error("price trace does not match work unit manager");
+	}
+
+	for (size_t i = 0; i < work_units.size(); i++) {
+		std::vector<MerkleWorkUnit::IndexType> index;
+		index.reserve(trace.workUnits[i].index.size());
+		for (auto& entry : trace.workUnits[i].index) {
+			EndowAccumulator metadata;
+			metadata.endow = entry.endow;
+			metadata.endow_times_price = (static_cast<int128_t>(entry.endowTimesPriceHigh) << 64)
+				+ static_cast<int128_t>(entry.endowTimesPriceLow);
+			index.emplace_back(entry.key, metadata);
+		}
+		work_units[i].set_indexed_metadata_for_replay(std::move(index));
+	}
+}
+
+} /* edce */
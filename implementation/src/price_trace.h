@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include "approximation_parameters.h"
+#include "merkle_work_unit_manager.h"
+
+#include "xdr/block.h"
+#include "xdr/experiments.h"
+
+namespace edce {
+
+/*
+Trace of the price computations of produced blocks.
+
+For each block, the recorder captures everything Tatonnement and the LPSolver read
+(the work units' metadata indices, the starting prices, the volume relativizers
+and the approximation parameters) and what came out of them.
+price_trace_replay reruns both on the recorded inputs, so changes to the oracle
+can be measured on real orderbooks instead of synthetic ones.
+
+Only the indices are recorded, not the offers, so a record is roughly
+(number of distinct offer prices) * 32 bytes.
+
+The indices are copied on a background thread, alongside price computation
+(which only reads them), so the copy is not on the block production path.
+The indices are not rebuilt until the next block's commit_for_production,
+after finish_block has waited for the copy.
+*/
+class PriceTraceRecorder {
+
+	std::FILE* f;
+	PriceComputationTrace current;
+	bool block_in_progress = false;
+
+	std::thread index_copy_thread;
+
+	void copy_indices(MerkleWorkUnitManager& work_unit_manager);
+	void wait_for_index_copy();
+
+public:
+
+	//Appends to filename.
+	PriceTraceRecorder(const std::string& filename);
+
+	PriceTraceRecorder(const PriceTraceRecorder&) = delete;
+	PriceTraceRecorder& operator=(const PriceTraceRecorder&) = delete;
+
+	~PriceTraceRecorder();
+
+	//Called just before price computation.  volume_relativizers can be nullptr.
+	//The work unit indices must not change until finish_block.
+	void begin_block(
+		uint64_t block_number,
+		MerkleWorkUnitManager& work_unit_manager,
+		const Price* starting_prices,
+		const ApproximationParameters approx_params,
+		const uint16_t* volume_relativizers);
+
+	//Called once the block's clearing parameters are known.  Writes out the record.
+	void finish_block(
+		const Price* computed_prices,
+		const TatonnementMeasurements& tatonnement_results,
+		const BlockCreationMeasurements& stats);
+};
+
+class PriceTraceReader {
+
+	std::FILE* f;
+
+public:
+
+	PriceTraceReader(const std::string& filename);
+
+	PriceTraceReader(const PriceTraceReader&) = delete;
+	PriceTraceReader& operator=(const PriceTraceReader&) = delete;
+
+	~PriceTraceReader();
+
+	//Returns false at the end of the trace.  Throws on a truncated record.
+	bool next(PriceComputationTrace& out);
+};
+
+//Replaces the metadata indices of the manager's work units with the recorded ones.
+//The manager must trade trace.numAssets assets.
+void load_price_trace_indices(const PriceComputationTrace& trace, MerkleWorkUnitManager& work_unit_manager);
+
+} /* edce */
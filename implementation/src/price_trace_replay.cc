@@ -0,0 +1,173 @@
+#include "lp_solver.h"
+#include "merkle_work_unit_manager.h"
+#include "price_trace.h"
+#include "tatonnement_oracle.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+/*
+Reruns Tatonnement and the LPSolver on the price computations recorded by PriceTraceRecorder
+(see /edce-node/price_trace_file), and compares against what was recorded.
+
+The inputs of every rerun are exactly the recorded ones, and the LP check on the recorded prices
+is deterministic.
+
+By default, Tatonnement runs a single fixed strategy, so every trial that does not time out
+computes the same prices in the same number of rounds (the tool checks this), and only the runtime
+varies.  With portfolio=1, the full strategy portfolio and the convex solver race as they do on a
+block producer; which one wins (and so the prices, rounds and runtime) can then vary between trials.
+*/
+
+using namespace edce;
+
+struct ReplayStructures {
+	MerkleWorkUnitManager work_unit_manager;
+	LPSolver solver;
+	TatonnementOracle oracle;
+
+	ReplayStructures(uint16_t num_assets, bool portfolio)
+		: work_unit_manager(num_assets)
+		, solver(work_unit_manager)
+		, oracle(work_unit_manager, solver, 0, portfolio, !portfolio) {}
+};
+
+static double median(std::vector<double> samples) {
+	if (samples.size() == 0) {
+		return 0;
+	}
+	std::sort(samples.begin(), samples.end());
+	return samples[samples.size() / 2];
+}
+
+int main(int argc, char const *argv[])
+{
+	if (argc < 2 || argc > 5) {
+		std::printf("usage: ./price_trace_replay <trace_file> <num_trials=3> <timeout_ms=2000> <portfolio=0>\n");
+		return 1;
+	}
+
+	std::string trace_file = argv[1];
+	size_t num_trials = (argc > 2) ? std::stoi(argv[2]) : 3;
+	uint32_t timeout_ms = (argc > 3) ? std::stoi(argv[3]) : 2000;
+	bool portfolio = (argc > 4) ? std::stoi(argv[4]) : false;
+
+	PriceTraceReader reader(trace_file);
+
+	std::unique_ptr<ReplayStructures> structures;
+
+	PriceComputationTrace trace;
+
+	size_t num_blocks = 0;
+	size_t lp_mismatches = 0;
+	double total_recorded_time = 0, total_replay_time = 0;
+	size_t replay_timeouts = 0;
+	//blocks where single strategy trials disagreed
+	size_t nondeterministic_blocks = 0;
+
+	std::printf("block\tnnz\trecorded tat (s)\trounds\ttimeout\treplay tat median (s)\tmax (s)\ttimeouts\tfee rate (rec/replay)\n");
+
+	while (reader.next(trace)) {
+		if (!structures || structures->work_unit_manager.get_num_assets() != trace.numAssets) {
+			structures.reset();
+			structures = std::make_unique<ReplayStructures>(trace.numAssets, portfolio);
+		}
+
+		auto& manager = structures->work_unit_manager;
+		load_price_trace_indices(trace, manager);
+
+		ApproximationParameters approx_params {
+			.tax_rate = static_cast<uint8_t>(trace.taxRate),
+			.smooth_mult = static_cast<uint8_t>(trace.smoothMult)
+		};
+
+		std::vector<uint16_t> relativizers;
+		for (auto v : trace.volumeRelativizers) {
+			relativizers.push_back(v);
+		}
+		const uint16_t* relativizers_ptr = relativizers.size() ? relativizers.data() : nullptr;
+
+		//the recorded prices should reproduce the recorded fee rate
+		std::vector<Price> recorded_prices(trace.computedPrices.begin(), trace.computedPrices.end());
+		auto recorded_lp = structures->solver.solve(recorded_prices.data(), approx_params, trace.timeoutHappened == 0);
+		if (recorded_lp.tax_rate != trace.achievedFeeRate) {
+			lp_mismatches++;
+		}
+
+		std::vector<double> runtimes;
+		size_t timeouts = 0;
+		uint8_t replay_fee_rate = 0;
+
+		std::optional<std::vector<Price>> first_prices;
+		uint32_t first_rounds = 0;
+		bool trials_agree = true;
+
+		for (size_t trial = 0; trial < num_trials; trial++) {
+			std::vector<Price> prices(trace.startingPrices.begin(), trace.startingPrices.end());
+
+			std::atomic<bool> timeout_flag = false;
+			std::atomic<bool> cancel_timeout = false;
+			auto timeout_th = structures->oracle.launch_timeout_thread(timeout_ms, timeout_flag, cancel_timeout);
+
+			auto timestamp = init_time_measurement();
+			auto tat_res = structures->oracle.compute_prices_grid_search(prices.data(), approx_params, relativizers_ptr);
+			runtimes.push_back(measure_time(timestamp));
+			cancel_timeout = true;
+
+			auto lp_res = structures->solver.solve(prices.data(), approx_params, !timeout_flag);
+			replay_fee_rate = lp_res.tax_rate;
+
+			timeout_th.join();
+			structures->oracle.wait_for_all_tatonnement_threads();
+
+			if (timeout_flag) {
+				timeouts++;
+			} else if (!first_prices) {
+				first_prices = prices;
+				first_rounds = tat_res.num_rounds;
+			} else if (*first_prices != prices || first_rounds != tat_res.num_rounds) {
+				trials_agree = false;
+			}
+		}
+		if (!portfolio && !trials_agree) {
+			nondeterministic_blocks++;
+		}
+
+		total_recorded_time += trace.tatonnement.runtime;
+		total_replay_time += median(runtimes);
+		replay_timeouts += timeouts;
+		num_blocks++;
+
+		std::printf("%lu\t%lu\t%lf\t%u\t%u\t%lf\t%lf\t%lu/%lu\t%u/%u\n",
+			trace.blockNumber,
+			manager.get_total_nnz(),
+			trace.tatonnement.runtime,
+			trace.tatonnement.num_rounds,
+			trace.timeoutHappened,
+			median(runtimes),
+			runtimes.size() ? *std::max_element(runtimes.begin(), runtimes.end()) : 0.0,
+			timeouts,
+			num_trials,
+			trace.achievedFeeRate,
+			replay_fee_rate);
+	}
+
+	std::printf("%lu blocks: recorded tatonnement %lf s, replayed (median per block) %lf s, %lu replay timeouts\n",
+		num_blocks, total_recorded_time, total_replay_time, replay_timeouts);
+
+	if (nondeterministic_blocks > 0) {
+		std::printf("single strategy trials computed different prices in %lu blocks\n", nondeterministic_blocks);
+	}
+
+	if (lp_mismatches > 0) {
+		std::printf("LP on recorded prices did not reproduce the recorded fee rate in %lu blocks\n", lp_mismatches);
+		return 1;
+	}
+	return 0;
+}
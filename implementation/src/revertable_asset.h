@@ -7,6 +7,8 @@
 
 #include <memory>
 
+#include "contention_counters.h"
+
 #include "xdr/types.h"
 #include "xdr/database_commitments.h"
 
@@ -182,6 +184,7 @@ public:
 			if (result) {
 				return true;
 			}
+			record_cas_retry();
 			__builtin_ia32_pause();
 		}	
 	}
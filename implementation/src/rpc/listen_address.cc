@@ -0,0 +1,39 @@
+#include "rpc/listen_address.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <string>
+#include <system_error>
+
+#include <sys/socket.h>
+
+namespace edce {
+
+xdr::unique_sock 
+tcp_listen_on_node_address(const char* port) {
+	const char* address = std::getenv(LISTEN_ADDRESS_ENV);
+	if (address == nullptr || address[0] == '\0') {
+		return xdr::tcp_listen(port, AF_INET);
+	}
+
+	xdr::unique_addrinfo ai = xdr::get_addrinfo(address, SOCK_STREAM, port, AF_INET);
+
+	xdr::unique_sock s(xdr::sock_t(socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)));
+	if (!s) {
+		throw std::system_error(errno, std::system_category(), "socket");
+	}
+
+	//nodes restart on the same address between runs
+	int reuse = 1;
+	setsockopt(s.get().fd(), SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+	if (bind(s.get().fd(), ai->ai_addr, ai->ai_addrlen) == -1) {
+		throw std::system_error(errno, std::system_category(), std::string("bind to ") + address + ":" + port);
+	}
+	if (listen(s.get().fd(), 5) == -1) {
+		throw std::system_error(errno, std::system_category(), "listen");
+	}
+	return s;
+}
+
+} /* edce */
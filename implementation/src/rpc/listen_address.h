@@ -0,0 +1,16 @@
+#pragma once
+
+#include <xdrpp/socket.h>
+
+namespace edce {
+
+//Environment variable holding the address that a process's rpc servers listen on.
+//Unset (the default), servers listen on every interface.  Setting it to a distinct
+//loopback address per process (127.0.0.1, 127.0.0.2, ...) lets several nodes run on one host
+//with the usual ports (see run_local_cluster.sh).
+constexpr static const char* LISTEN_ADDRESS_ENV = "EDCE_LISTEN_ADDRESS";
+
+//Drop-in for xdr::tcp_listen(port, AF_INET).  Throws std::system_error if the socket can't be bound.
+xdr::unique_sock tcp_listen_on_node_address(const char* port);
+
+} /* edce */
@@ -0,0 +1,43 @@
+#include "rpc/metrics_api.h"
+#include "metrics.h"
+#include "span_tracer.h"
+
+namespace edce {
+
+//Only plain file names, so a client can't write outside the results directory.
+static bool
+is_plain_filename(const std::string& filename) {
+  if (filename.empty() || filename == "." || filename == "..") {
+    return false;
+  }
+  return filename.find_first_of(std::string("/\0", 2)) == std::string::npos;
+}
+
+std::unique_ptr<MetricsSnapshot>
+MetricsV1_server::get_metrics()
+{
+  return std::make_unique<MetricsSnapshot>(MetricsRegistry::global().snapshot());
+}
+
+std::unique_ptr<SpanTraceDumpResult>
+MetricsV1_server::dump_span_trace(const SpanTraceDumpRequest &arg)
+{
+  auto res = std::make_unique<SpanTraceDumpResult>(-1);
+
+  auto& tracer = SpanTracer::global();
+  if (!tracer.is_enabled()) {
+    return res;
+  }
+  if (!is_plain_filename(arg.filename)) {
+    std::printf("rejected span trace filename %s\n", arg.filename.c_str());
+    return res;
+  }
+  try {
+    *res = tracer.write_chrome_trace(results_dir + arg.filename, arg.num_blocks);
+  } catch (std::exception& e) {
+    std::printf("failed to dump span trace: %s\n", e.what());
+  }
+  return res;
+}
+
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+
+#include <xdrpp/srpc.h>
+
+#include "xdr/metrics_api.h"
+
+namespace edce {
+
+class MetricsV1_server {
+
+  //span traces are only ever written here
+  const std::string results_dir;
+
+public:
+  using rpc_interface_type = MetricsV1;
+
+  //results_dir includes the trailing '/'
+  MetricsV1_server(const std::string& results_dir) : results_dir(results_dir) {};
+
+  std::unique_ptr<MetricsSnapshot> get_metrics();
+  std::unique_ptr<SpanTraceDumpResult> dump_span_trace(const SpanTraceDumpRequest &arg);
+};
+
+}
@@ -8,3 +8,4 @@
 #define SIGNATURE_CHECK_PORT "9017"
 #define SIGNATURE_SHARD_PORT "9018"
 #define HELLOWORLD_PORT "9019"
+#define METRICS_PORT "9020"
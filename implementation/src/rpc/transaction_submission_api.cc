@@ -3,19 +3,75 @@
 
 #include "rpc/transaction_submission_api.h"
 #include <xdrpp/marshal.h>
+
+#include "simple_debug.h"
+
 namespace edce {
 
 void
-SubmitTransactionV1_server::submit_transaction(const SignedTransaction &arg)
+SubmitTransactionV1_server::insert_into_buffer(const SignedTransaction& tx)
 {
   if (!current_buffer) {
     current_buffer = buffer_manager.get_empty_buffer();
   }
-  bool full = current_buffer->insert(arg);
+  bool full = current_buffer->insert(tx);
   if (full) {
     buffer_manager.return_full_buffer(std::move(current_buffer));
     current_buffer = buffer_manager.get_empty_buffer();
   }  
 }
 
+void
+SubmitTransactionV1_server::submit_transaction(const SignedTransaction &arg)
+{
+  insert_into_buffer(arg);
+}
+
+std::unique_ptr<TransactionBatchSubmissionResults>
+SubmitTransactionV1_server::submit_transaction_batch(const SerializedBlock &arg)
+{
+  auto results = std::make_unique<TransactionBatchSubmissionResults>();
+
+  SignedTransactionList txs;
+  try {
+    xdr::xdr_from_opaque(arg, txs);
+  } catch (xdr::xdr_runtime_error& e) {
+    MEMPOOL_INFO("rejecting malformed tx batch: %s", e.what());
+    return results;
+  }
+
+  for (auto& tx : txs) {
+    insert_into_buffer(tx);
+  }
+  results->num_accepted = txs.size();
+  results->results.assign(txs.size(), TransactionProcessingStatus::SUCCESS);
+  return results;
+}
+
+std::unique_ptr<SubmissionStatus>
+SubmitTransactionV1_server::get_submission_status(const SubmissionStatusQuery &arg)
+{
+  auto status = std::make_unique<SubmissionStatus>();
+  status->committed_sequence_numbers.assign(arg.size(), 0);
+  return status;
+}
+
+void
+MempoolSubmitTransactionV1_server::submit_transaction(const SignedTransaction &arg)
+{
+  main_node.submit_transaction(arg);
+}
+
+std::unique_ptr<TransactionBatchSubmissionResults>
+MempoolSubmitTransactionV1_server::submit_transaction_batch(const SerializedBlock &arg)
+{
+  return std::make_unique<TransactionBatchSubmissionResults>(main_node.submit_transaction_batch(arg));
+}
+
+std::unique_ptr<SubmissionStatus>
+MempoolSubmitTransactionV1_server::get_submission_status(const SubmissionStatusQuery &arg)
+{
+  return std::make_unique<SubmissionStatus>(main_node.get_submission_status(arg));
+}
+
 } /* edce */
@@ -12,6 +12,7 @@
 #include "merkle_work_unit_manager.h"
 #include "transaction_buffer_manager.h"
 #include "signature_check.h"
+#include "edce_node.h"
 
 namespace edce {
 
@@ -21,6 +22,8 @@ class SubmitTransactionV1_server {
 
 	TransactionBufferManager::buffer_ptr current_buffer;
 
+	void insert_into_buffer(const SignedTransaction& tx);
+
 public:
   using rpc_interface_type = SubmitTransactionV1;
 
@@ -28,7 +31,29 @@ public:
   	: buffer_manager(buffer_manager), current_buffer() {}
 
   void submit_transaction(const SignedTransaction &arg);
+
+  std::unique_ptr<TransactionBatchSubmissionResults> submit_transaction_batch(const SerializedBlock &arg);
+
+  //does not track blocks; reports nothing as committed.
+  std::unique_ptr<SubmissionStatus> get_submission_status(const SubmissionStatusQuery &arg);
 };
 
-}
+//Feeds submitted txs directly into a block producer's mempool.
+class MempoolSubmitTransactionV1_server {
+
+	EdceNode& main_node;
+
+public:
+  using rpc_interface_type = SubmitTransactionV1;
 
+  MempoolSubmitTransactionV1_server(EdceNode& main_node)
+  	: main_node(main_node) {}
+
+  void submit_transaction(const SignedTransaction &arg);
+
+  std::unique_ptr<TransactionBatchSubmissionResults> submit_transaction_batch(const SerializedBlock &arg);
+
+  std::unique_ptr<SubmissionStatus> get_submission_status(const SubmissionStatusQuery &arg);
+};
+
+}
@@ -0,0 +1,96 @@
+#!/bin/bash
+
+#Runs a producer and num_validators validators on this host, each pinned to its own
+#threads_per_node cores and listening on its own loopback address (producer 127.0.0.1, validator i 127.0.0.(i+2)),
+#and drives them with e2e_load_harness, pinned to the cores after those.
+#Experiment data (params and accounts) come from experiment_data/<experiment_name>, i.e. from workload_gen or synthetic_data_gen.
+#Each node runs in its own directory under local_cluster/, so that their databases are separate.
+
+if [ "$#" -ne 8 ]; then
+	echo "usage: ./whatever experiment_name num_validators num_clients accounts_per_client measure_seconds threads_per_node num_assets name_suffix";
+	exit 1;
+fi
+
+experiment_name=$1
+num_validators=$2
+num_clients=$3
+accounts_per_client=$4
+measure_seconds=$5
+threads_per_node=$6
+assets=$7
+name_suffix=$8
+
+warmup_seconds=5
+#time for the last blocks to be produced and confirmed once the clients stop submitting
+drain_seconds=5
+
+set -ex
+
+make edce_producer_experiment -j
+make edce_validator_experiment -j
+make generate_zeroblock -j
+make e2e_load_harness -j
+
+SRC_DIR=$(pwd)
+EXPERIMENT_DATA_FILE=${SRC_DIR}/experiment_data/${experiment_name}
+RESULTS_DIR=${SRC_DIR}/experiment_results/${name_suffix}
+CLUSTER_DIR=${SRC_DIR}/local_cluster
+
+DEFAULT_AMOUNT=10000000000
+
+num_nodes=$(( num_validators + 1 ))
+client_first_core=$(( num_nodes * threads_per_node ))
+client_last_core=$(( client_first_core + num_clients - 1 ))
+
+if [ ${client_last_core} -ge $(nproc) ]; then
+	echo "need $(( client_last_core + 1 )) cores, have $(nproc)";
+	exit 1;
+fi
+
+mkdir -p ${RESULTS_DIR}
+lscpu > ${RESULTS_DIR}/cpuconfig
+
+node_cores () {
+	echo $(( $1 * threads_per_node ))-$(( ($1 + 1) * threads_per_node - 1 ))
+}
+
+pids=()
+
+for (( i=0; i<num_nodes; i++ ))
+do
+	node_dir=${CLUSTER_DIR}/node_${i}
+	rm -rf ${node_dir}
+	mkdir -p ${node_dir}/databases ${node_dir}/results
+	cp clean_offer_lmdbs.sh ${node_dir}/
+
+	pushd ${node_dir}
+	set +e
+	${SRC_DIR}/clean_persisted_data.sh ${assets}
+	set -e
+	${SRC_DIR}/generate_zeroblock ${EXPERIMENT_DATA_FILE} ${DEFAULT_AMOUNT}
+
+	address=127.0.0.$(( i + 1 ))
+
+	if [ ${i} -eq 0 ]; then
+		EDCE_LISTEN_ADDRESS=${address} taskset -c $(node_cores ${i}) \
+			${SRC_DIR}/edce_producer_experiment ${EXPERIMENT_DATA_FILE} results ${threads_per_node} \
+			$(( warmup_seconds + measure_seconds + drain_seconds )) > ${RESULTS_DIR}/node_${i}.log 2>&1 &
+	else
+		EDCE_LISTEN_ADDRESS=${address} taskset -c $(node_cores ${i}) \
+			${SRC_DIR}/edce_validator_experiment ${EXPERIMENT_DATA_FILE} results 127.0.0.1 ${address} ${threads_per_node} \
+			> ${RESULTS_DIR}/node_${i}.log 2>&1 &
+	fi
+	pids+=($!)
+	popd
+done
+
+taskset -c ${client_first_core}-${client_last_core} \
+	./e2e_load_harness ${EXPERIMENT_DATA_FILE} ${RESULTS_DIR} ${num_validators} ${num_clients} ${accounts_per_client} ${measure_seconds} ${warmup_seconds} \
+	| tee ${RESULTS_DIR}/harness.log
+
+for pid in "${pids[@]}"
+do
+	wait ${pid}
+done
+
+echo "results in ${RESULTS_DIR}/e2e_results.json"
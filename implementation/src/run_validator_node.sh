@@ -1,8 +1,10 @@
-if [ "$#" -ne 7 ]; then
-	echo "usage: ./whatever experiment_name num_threads name_suffix experiment_yaml parent_hostname self_hostname num_assets";
+if [ "$#" -ne 7 ] && [ "$#" -ne 8 ]; then
+	echo "usage: ./whatever experiment_name num_threads name_suffix experiment_yaml parent_hostname self_hostname num_assets <optional: validation_mode (ranges|partitioned)>";
 	exit 1;
 fi
 
+validation_mode=${8:-ranges}
+
 
 assets=$7
 
@@ -41,5 +43,5 @@ echo ${num_threads}
 echo ${num_cores}
 
 #cgexec -g cpuset:cpu${num_cores}core 
-./edce_validator_experiment ${EXPERIMENT_DATA_FILE} experiment_results/${output_folder} $5 $6 ${num_threads}
+./edce_validator_experiment ${EXPERIMENT_DATA_FILE} experiment_results/${output_folder} $5 $6 ${num_threads} ${validation_mode}
 
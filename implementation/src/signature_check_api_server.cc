@@ -5,7 +5,7 @@ namespace edce {
 
 SignatureCheckApiServer::SignatureCheckApiServer(std::string shard_ip)
     : ps()
-    , signature_check_listener(ps, xdr::tcp_listen(SIGNATURE_CHECK_PORT, AF_INET), false, xdr::session_allocator<void>())
+    , signature_check_listener(ps, tcp_listen_on_node_address(SIGNATURE_CHECK_PORT), false, xdr::session_allocator<void>())
     , ip_of_shard(shard_ip) {
         signature_check_listener.register_service(signature_check_server);
         init_checker(ip_of_shard);
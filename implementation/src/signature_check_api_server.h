@@ -2,6 +2,7 @@
 
 #include "edce_node.h"
 #include "rpc/rpcconfig.h"
+#include "rpc/listen_address.h"
 #include "rpc/signature_check_api.h"
 #include "xdr/signature_check_api.h"
 
@@ -4,7 +4,7 @@ namespace edce {
 
 SignatureShardApiServer::SignatureShardApiServer()
     : ps()
-    , signature_shard_listener(ps, xdr::tcp_listen(SIGNATURE_SHARD_PORT, AF_INET), false, xdr::session_allocator<rpcsockptr>()) {
+    , signature_shard_listener(ps, tcp_listen_on_node_address(SIGNATURE_SHARD_PORT), false, xdr::session_allocator<rpcsockptr>()) {
         signature_shard_listener.register_service(signature_shard_server);
 
         ps.run();
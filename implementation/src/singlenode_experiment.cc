@@ -267,6 +267,10 @@ bool run_experiment_using_block0(const ExperimentParameters& params, std::string
 	tbb::global_control control(
 		tbb::global_control::max_allowed_parallelism, thread_count);
 
+	if (options.multiset_state_commitment) {
+		management_structures.enable_multiset_state_commitment();
+	}
+
 	init_management_structures_from_lmdb(management_structures);
 
 	//init_management_structures_no_lmdb(management_structures, params.num_accounts, params.num_assets, 10000000000);
@@ -281,6 +285,9 @@ bool run_experiment_using_block0(const ExperimentParameters& params, std::string
 
 
 	TatonnementManagementStructures tatonnement_structs(management_structures);
+	if (!options.price_trace_file.empty()) {
+		tatonnement_structs.enable_price_trace(options.price_trace_file);
+	}
 
 	//LPSolver solver(manager);
 	//TatonnementOracle oracle(manager, solver, 0);
@@ -53,6 +53,10 @@ bool run_experiment(const ExperimentParameters& params, std::string experiment_r
 	}*/
 
 
+	if (options.multiset_state_commitment) {
+		management_structures.enable_multiset_state_commitment();
+	}
+
 	uint64_t starting_block = init_management_structures_from_lmdb(management_structures);
 //	init_management_structures_no_lmdb(management_structures, params.num_accounts, params.num_assets, 10000000000);
 
@@ -143,7 +147,7 @@ bool run_experiment(const ExperimentParameters& params, std::string experiment_r
 		
 		auto persistence_start = init_time_measurement();
 
-		edce_persist_critical_round_data(management_structures, header_block, results.block_results.at(block-1).data_persistence_measurements, 1000000);
+		edce_persist_critical_round_data(management_structures, header_block, results.block_results.at(block-1).data_persistence_measurements, false, 1000000);
 
 		prev_block = header_block;
 
@@ -0,0 +1,146 @@
+#include "span_tracer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace edce {
+
+SpanTracer::ThreadBuffer::ThreadBuffer(uint32_t thread_id)
+	: slots()
+	, head(0)
+	, thread_name(nullptr)
+	, in_use(true)
+	, thread_id(thread_id) {}
+
+void
+SpanTracer::ThreadBuffer::collect(std::vector<SpanTraceEvent>& out, uint64_t min_block_number) const {
+	uint64_t end = head.load(std::memory_order_acquire);
+	uint64_t start = (end > BUFFER_CAPACITY) ? end - BUFFER_CAPACITY : 0;
+
+	for (uint64_t i = start; i < end; i++) {
+		auto& slot = slots[i % BUFFER_CAPACITY];
+
+		uint64_t seq = slot.seq.load(std::memory_order_acquire);
+		if (seq != i + 1) {
+			//already overwritten by the owner, who lapped us
+			continue;
+		}
+		SpanTraceEvent event;
+		event.name = slot.name.load(std::memory_order_relaxed);
+		event.start_ns = slot.start_ns.load(std::memory_order_relaxed);
+		event.duration_ns = slot.duration_ns.load(std::memory_order_relaxed);
+		event.block_number = slot.block_number.load(std::memory_order_relaxed);
+		event.thread_id = thread_id;
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.seq.load(std::memory_order_relaxed) != seq) {
+			//overwritten while we read it
+			continue;
+		}
+		if (event.block_number >= min_block_number) {
+			out.push_back(event);
+		}
+	}
+}
+
+SpanTracer::ThreadBuffer*
+SpanTracer::acquire_buffer() {
+	std::lock_guard lock(buffers_mtx);
+
+	ThreadBuffer* out = nullptr;
+	for (auto& buffer : buffers) {
+		if (!buffer->in_use.load(std::memory_order_acquire)) {
+			buffer->in_use.store(true, std::memory_order_relaxed);
+			out = buffer.get();
+			break;
+		}
+	}
+	if (out == nullptr) {
+		buffers.push_back(std::make_unique<ThreadBuffer>(buffers.size()));
+		out = buffers.back().get();
+	}
+	out->thread_name.store(local_thread_name(), std::memory_order_relaxed);
+	return out;
+}
+
+void
+SpanTracer::set_thread_name(const char* name) {
+	local_thread_name() = name;
+	if (is_enabled()) {
+		local_buffer().thread_name.store(name, std::memory_order_relaxed);
+	}
+}
+
+std::vector<SpanTraceEvent>
+SpanTracer::collect(uint32_t num_blocks) const {
+	uint64_t latest_block = get_current_block();
+	uint64_t min_block_number = (num_blocks == 0 || latest_block < num_blocks) ? 0 : latest_block - num_blocks + 1;
+
+	std::vector<SpanTraceEvent> out;
+	{
+		std::lock_guard lock(buffers_mtx);
+		for (auto& buffer : buffers) {
+			buffer->collect(out, min_block_number);
+		}
+	}
+	std::sort(out.begin(), out.end(), [] (const SpanTraceEvent& a, const SpanTraceEvent& b) {
+		return a.start_ns < b.start_ns;
+	});
+	return out;
+}
+
+size_t
+SpanTracer::write_chrome_trace(std::FILE* out, uint32_t num_blocks) const {
+	auto events = collect(num_blocks);
+
+	std::fprintf(out, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+
+	bool first = true;
+	{
+		std::lock_guard lock(buffers_mtx);
+		for (auto& buffer : buffers) {
+			const char* thread_name = buffer->thread_name.load(std::memory_order_relaxed);
+			std::fprintf(out, "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"%s\"}}",
+				first ? "" : ",",
+				buffer->thread_id,
+				thread_name ? thread_name : "unnamed");
+			first = false;
+		}
+	}
+
+	//timestamps are in microseconds
+	for (auto& event : events) {
+		std::fprintf(out, "%s\n{\"name\": \"%s\", \"cat\": \"edce\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %lu.%03lu, \"dur\": %lu.%03lu, \"args\": {\"block\": %lu}}",
+			first ? "" : ",",
+			event.name,
+			event.thread_id,
+			event.start_ns / 1000, event.start_ns % 1000,
+			event.duration_ns / 1000, event.duration_ns % 1000,
+			event.block_number);
+		first = false;
+	}
+	std::fprintf(out, "\n]}\n");
+	return events.size();
+}
+
+size_t
+SpanTracer::write_chrome_trace(const std::string& filename, uint32_t num_blocks) const {
+	std::string tmp_filename = filename + ".tmp";
+	std::FILE* f = std::fopen(tmp_filename.c_str(), "w");
+	if (f == nullptr) {
+		std::printf("errno was %d %s\n", errno, strerror(errno));
+		throw std::runtime_error("could not open span trace file " + tmp_filename);
+	}
+	size_t num_events = write_chrome_trace(f, num_blocks);
+	std::fclose(f);
+
+	if (std::rename(tmp_filename.c_str(), filename.c_str())) {
+		std::printf("errno was %d %s\n", errno, strerror(errno));
+		throw std::runtime_error("could not rename span trace file");
+	}
+	return num_events;
+}
+
+} /* edce */
@@ -0,0 +1,241 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace edce {
+
+/*
+Span tracer for the block pipeline.
+
+Spans (name, start, duration, block number) are written to per-thread ring buffers,
+so recording takes no locks: a clock read at either end and a few relaxed stores.
+When tracing is disabled (the default), a span is one relaxed load and a branch.
+
+Each span is tagged with a block number: either given explicitly (i.e. for async persistence,
+which runs behind the block pipeline), or the block the pipeline is currently working on
+(set_current_block(), called at the start of produce_block / validate_block).
+
+write_chrome_trace() dumps the spans of the last N blocks as Chrome trace event json,
+which chrome://tracing and ui.perfetto.dev both load.  Each ring holds the last
+BUFFER_CAPACITY spans of its thread, so threads with many small spans (i.e. demand oracle workers)
+may have lost their spans for the oldest of those blocks.
+
+Names must be string literals (or otherwise outlive the tracer).
+*/
+
+struct SpanTraceEvent {
+	const char* name;
+	uint64_t start_ns;
+	uint64_t duration_ns;
+	uint64_t block_number;
+	uint32_t thread_id;
+};
+
+class SpanTracer {
+
+	//A seqlock: seq is 0 while the slot is being written, and i + 1 once it holds span i.
+	struct Slot {
+		std::atomic<uint64_t> seq;
+		std::atomic<const char*> name;
+		std::atomic<uint64_t> start_ns;
+		std::atomic<uint64_t> duration_ns;
+		std::atomic<uint64_t> block_number;
+	};
+
+public:
+	constexpr static size_t BUFFER_CAPACITY = 1 << 15;
+
+private:
+
+	//Single writer (the owning thread).  A buffer outlives its thread and is handed to the next new thread,
+	//so spans of exited threads stay visible.
+	struct alignas(64) ThreadBuffer {
+		std::array<Slot, BUFFER_CAPACITY> slots;
+		//number of spans ever written.  Span i lives in slots[i % BUFFER_CAPACITY].
+		std::atomic<uint64_t> head;
+		std::atomic<const char*> thread_name;
+		std::atomic<bool> in_use;
+		const uint32_t thread_id;
+
+		ThreadBuffer(uint32_t thread_id);
+
+		void push(const char* name, uint64_t start_ns, uint64_t duration_ns, uint64_t block_number) {
+			uint64_t idx = head.load(std::memory_order_relaxed);
+			auto& slot = slots[idx % BUFFER_CAPACITY];
+			slot.seq.store(0, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			slot.name.store(name, std::memory_order_relaxed);
+			slot.start_ns.store(start_ns, std::memory_order_relaxed);
+			slot.duration_ns.store(duration_ns, std::memory_order_relaxed);
+			slot.block_number.store(block_number, std::memory_order_relaxed);
+			slot.seq.store(idx + 1, std::memory_order_release);
+			head.store(idx + 1, std::memory_order_release);
+		}
+
+		void collect(std::vector<SpanTraceEvent>& out, uint64_t min_block_number) const;
+	};
+
+	struct BufferHandle {
+		ThreadBuffer* buffer;
+		BufferHandle(SpanTracer& tracer) : buffer(tracer.acquire_buffer()) {}
+		~BufferHandle() {
+			buffer->in_use.store(false, std::memory_order_release);
+		}
+	};
+
+	std::atomic<bool> enabled;
+	std::atomic<uint64_t> current_block;
+
+	mutable std::mutex buffers_mtx;
+	std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+	const std::chrono::steady_clock::time_point start_time;
+
+	ThreadBuffer* acquire_buffer();
+
+	ThreadBuffer& local_buffer() {
+		static thread_local BufferHandle handle(*this);
+		return *handle.buffer;
+	}
+
+	static const char*& local_thread_name() {
+		static thread_local const char* name = nullptr;
+		return name;
+	}
+
+	SpanTracer()
+		: enabled(false)
+		, current_block(0)
+		, buffers_mtx()
+		, buffers()
+		, start_time(std::chrono::steady_clock::now()) {}
+
+public:
+
+	static SpanTracer& global() {
+		static SpanTracer tracer;
+		return tracer;
+	}
+
+	//ns since the tracer was created
+	uint64_t now_ns() const {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time).count();
+	}
+
+	bool is_enabled() const {
+		return enabled.load(std::memory_order_relaxed);
+	}
+
+	void enable(bool enable_tracing = true) {
+		enabled.store(enable_tracing, std::memory_order_relaxed);
+	}
+
+	void set_current_block(uint64_t block_number) {
+		current_block.store(block_number, std::memory_order_relaxed);
+	}
+
+	uint64_t get_current_block() const {
+		return current_block.load(std::memory_order_relaxed);
+	}
+
+	//Labels the calling thread's spans in the trace.  Cheap, and fine to call while disabled.
+	void set_thread_name(const char* name);
+
+	void record(const char* name, uint64_t start_ns, uint64_t end_ns, uint64_t block_number) {
+		local_buffer().push(name, start_ns, end_ns - start_ns, block_number);
+	}
+
+	//Spans of the last num_blocks blocks (up to and including the current block), sorted by start time.
+	//num_blocks = 0 collects every retained span.
+	std::vector<SpanTraceEvent> collect(uint32_t num_blocks) const;
+
+	//Returns the number of spans written.
+	size_t write_chrome_trace(std::FILE* out, uint32_t num_blocks) const;
+
+	//Throws if the file can't be written.  Writes to a temporary file and renames it over filename.
+	size_t write_chrome_trace(const std::string& filename, uint32_t num_blocks) const;
+};
+
+//Records a span from construction to destruction, if tracing was enabled at construction.
+class TraceSpan {
+	const char* name;
+	uint64_t block_number;
+	uint64_t start_ns;
+	bool active;
+
+public:
+
+	//tagged with the current block
+	TraceSpan(const char* name)
+		: name(name)
+		, block_number(0)
+		, start_ns(0)
+		, active(SpanTracer::global().is_enabled()) {
+			if (active) {
+				block_number = SpanTracer::global().get_current_block();
+				start_ns = SpanTracer::global().now_ns();
+			}
+		}
+
+	TraceSpan(const char* name, uint64_t block_number)
+		: name(name)
+		, block_number(block_number)
+		, start_ns(0)
+		, active(SpanTracer::global().is_enabled()) {
+			if (active) {
+				start_ns = SpanTracer::global().now_ns();
+			}
+		}
+
+	TraceSpan(const TraceSpan&) = delete;
+	TraceSpan& operator=(const TraceSpan&) = delete;
+
+	~TraceSpan() {
+		if (active) {
+			auto& tracer = SpanTracer::global();
+			tracer.record(name, start_ns, tracer.now_ns(), block_number);
+		}
+	}
+};
+
+//Consecutive phases, in the style of measure_time(): each end_phase() records a span
+//from the previous end_phase() (or construction) until now.
+class TracePhases {
+	uint64_t block_number;
+	uint64_t phase_start_ns;
+	bool active;
+
+public:
+
+	TracePhases(uint64_t block_number)
+		: block_number(block_number)
+		, phase_start_ns(0)
+		, active(SpanTracer::global().is_enabled()) {
+			if (active) {
+				phase_start_ns = SpanTracer::global().now_ns();
+			}
+		}
+
+	void end_phase(const char* name) {
+		if (active) {
+			auto& tracer = SpanTracer::global();
+			uint64_t now = tracer.now_ns();
+			tracer.record(name, phase_start_ns, now, block_number);
+			phase_start_ns = now;
+		}
+	}
+};
+
+static inline void span_tracer_set_thread_name(const char* name) {
+	SpanTracer::global().set_thread_name(name);
+}
+
+} /* edce */
@@ -0,0 +1,358 @@
+#include "speculative_tx_processor.h"
+
+#include <algorithm>
+
+#include <tbb/parallel_for.h>
+
+#include "simple_debug.h"
+#include "utils.h"
+
+namespace edce {
+
+SpeculativeBalanceOverlay::AssetEntry&
+SpeculativeBalanceOverlay::get_asset_entry(AccountEntry& account, account_db_idx idx, AssetID asset) {
+	auto iter = account.assets.find(asset);
+	if (iter == account.assets.end()) {
+		AssetEntry entry;
+		entry.base = db.peek_available_balance(idx, asset);
+		iter = account.assets.emplace(asset, entry).first;
+	}
+	return iter->second;
+}
+
+bool
+SpeculativeBalanceOverlay::check_debit(account_db_idx idx, AssetID asset, int64_t amount) {
+	auto& shard = get_shard(idx);
+	std::lock_guard lock(shard.mtx);
+	auto& entry = get_asset_entry(shard.accounts[idx], idx, asset);
+	return entry.base >= amount;
+}
+
+void
+SpeculativeBalanceOverlay::add_credit(account_db_idx idx, AssetID asset, int64_t amount) {
+	auto& shard = get_shard(idx);
+	std::lock_guard lock(shard.mtx);
+	auto& entry = get_asset_entry(shard.accounts[idx], idx, asset);
+	entry.max_credits += amount;
+}
+
+void
+SpeculativeBalanceOverlay::mark_unknown_credits(account_db_idx idx) {
+	auto& shard = get_shard(idx);
+	std::lock_guard lock(shard.mtx);
+	shard.accounts[idx].unknown_credits = true;
+}
+
+uint64_t
+SpeculativeBalanceOverlay::validate() {
+	std::atomic<uint64_t> num_conflicts = 0;
+	tbb::parallel_for(
+		tbb::blocked_range<size_t>(0, NUM_SHARDS),
+		[this, &num_conflicts] (auto r) {
+			for (auto i = r.begin(); i < r.end(); i++) {
+				std::lock_guard lock(shards[i].mtx);
+				uint64_t local_conflicts = 0;
+				for (auto& [idx, account] : shards[i].accounts) {
+					for (auto& [asset, entry] : account.assets) {
+						if (db.peek_available_balance(idx, asset) != entry.base) {
+							account.conflicted = true;
+							local_conflicts++;
+							break;
+						}
+					}
+				}
+				num_conflicts.fetch_add(local_conflicts, std::memory_order_relaxed);
+			}
+		});
+	return num_conflicts.load(std::memory_order_relaxed);
+}
+
+bool
+SpeculativeBalanceOverlay::debit_likely_to_fail(account_db_idx idx, AssetID asset, int64_t amount) {
+	auto& shard = get_shard(idx);
+	std::lock_guard lock(shard.mtx);
+	auto account_iter = shard.accounts.find(idx);
+	if (account_iter == shard.accounts.end()) {
+		return false;
+	}
+	auto& account = account_iter->second;
+	if (account.conflicted || account.unknown_credits) {
+		return false;
+	}
+	auto asset_iter = account.assets.find(asset);
+	if (asset_iter == account.assets.end()) {
+		return false;
+	}
+	return asset_iter->second.base + asset_iter->second.max_credits < amount;
+}
+
+void
+SpeculativeBalanceOverlay::clear() {
+	for (auto& shard : shards) {
+		std::lock_guard lock(shard.mtx);
+		shard.accounts.clear();
+	}
+}
+
+//Mirrors the balance effects of SerialTransactionProcessor::process_transaction,
+//without modifying anything.
+SpeculativeTxProcessor::SpeculativeTxRecord
+SpeculativeTxProcessor::speculate_transaction(const SignedTransaction& signed_tx) {
+	auto& tx = signed_tx.transaction;
+
+	SpeculativeTxRecord record;
+
+	auto static_status = static_checker.check_static_parameters(tx);
+	if (static_status != TransactionProcessingStatus::SUCCESS) {
+		record.predicted_status = static_status;
+		return record;
+	}
+
+	account_db_idx source_idx;
+	if (!db.lookup_user_id(tx.metadata.sourceAccount, &source_idx)) {
+		//might be created by another tx in the next block.  Can't speculate,
+		//but its payments could still credit existing accounts.
+		for (auto& op : tx.operations) {
+			if (op.body.type() == PAYMENT && op.body.paymentOp().amount > 0) {
+				account_db_idx target_idx;
+				if (db.lookup_user_id(op.body.paymentOp().receiver, &target_idx)) {
+					overlay.add_credit(target_idx, op.body.paymentOp().asset, op.body.paymentOp().amount);
+				}
+			}
+		}
+		return record;
+	}
+
+	auto last_committed_seq_num = db.get_last_committed_seq_num(tx.metadata.sourceAccount);
+	if (last_committed_seq_num && tx.metadata.sequenceNumber <= *last_committed_seq_num) {
+		record.predicted_status = TransactionProcessingStatus::SEQ_NUM_TOO_LOW;
+		return record;
+	}
+
+	auto debit = [this, &record] (account_db_idx idx, AssetID asset, int64_t amount) {
+		if (amount <= 0) {
+			overlay.add_credit(idx, asset, -amount);
+			return;
+		}
+		if ((!overlay.check_debit(idx, asset, amount))
+			&& record.predicted_status == TransactionProcessingStatus::SUCCESS) {
+			record.predicted_status = TransactionProcessingStatus::INSUFFICIENT_BALANCE;
+			record.account = idx;
+			record.asset = asset;
+			record.amount = amount;
+		}
+	};
+
+	auto credit = [this] (account_db_idx idx, AssetID asset, int64_t amount) {
+		if (amount >= 0) {
+			overlay.add_credit(idx, asset, amount);
+		}
+		//negative credits are debits that can only make other txs fail, so ignore them.
+	};
+
+	//All credits are recorded, even from txs predicted to fail,
+	//so that max_credits bounds what any ordering could make available.
+	for (auto& op : tx.operations) {
+		switch(op.body.type()) {
+			case CREATE_ACCOUNT:
+				debit(source_idx, MemoryDatabase::NATIVE_ASSET, op.body.createAccountOp().startingBalance);
+				break;
+			case CREATE_SELL_OFFER:
+				debit(source_idx, op.body.createSellOfferOp().category.sellAsset, op.body.createSellOfferOp().amount);
+				break;
+			case CANCEL_SELL_OFFER:
+				overlay.mark_unknown_credits(source_idx);
+				break;
+			case PAYMENT:
+			{
+				auto& payment = op.body.paymentOp();
+				account_db_idx target_idx;
+				if (db.lookup_user_id(payment.receiver, &target_idx)) {
+					if (payment.amount >= 0) {
+						debit(source_idx, payment.asset, payment.amount);
+						credit(target_idx, payment.asset, payment.amount);
+					} else {
+						debit(target_idx, payment.asset, -payment.amount);
+						credit(source_idx, payment.asset, -payment.amount);
+					}
+				}
+				break;
+			}
+			case MONEY_PRINTER:
+				credit(source_idx, op.body.moneyPrinterOp().asset, op.body.moneyPrinterOp().amount);
+				break;
+		}
+	}
+	return record;
+}
+
+void
+SpeculativeTxProcessor::speculate(size_t max_txs) {
+	size_t num_chunks = mempool.num_chunks();
+
+	records.resize(num_chunks);
+	speculated_chunk_sizes.resize(num_chunks, 0);
+
+	std::atomic<int64_t> remaining_txs = max_txs;
+
+	tbb::parallel_for(
+		tbb::blocked_range<size_t>(0, num_chunks),
+		[this, &remaining_txs] (auto r) {
+			for (auto i = r.begin(); i < r.end(); i++) {
+				if (stop_flag.load(std::memory_order_relaxed)) {
+					return;
+				}
+
+				auto& chunk = mempool[i];
+				int64_t chunk_sz = chunk.size();
+
+				if (remaining_txs.fetch_sub(chunk_sz, std::memory_order_relaxed) <= 0) {
+					return;
+				}
+
+				auto& chunk_records = records[i];
+				chunk_records.resize(chunk_sz);
+				for (int64_t j = 0; j < chunk_sz; j++) {
+					chunk_records[j] = speculate_transaction(chunk[j]);
+				}
+
+				num_speculated_txs.fetch_add(chunk_sz, std::memory_order_relaxed);
+				speculated_chunk_sizes[i] = chunk_sz;
+			}
+		});
+}
+
+void
+SpeculativeTxProcessor::validate_and_decide(SpeculationMeasurements& measurements) {
+	auto timestamp = init_time_measurement();
+
+	measurements.num_conflicted_accounts = overlay.validate();
+
+	size_t num_chunks = records.size();
+	decisions.resize(num_chunks);
+
+	std::atomic<uint64_t> num_drops = 0, num_defers = 0, num_replays_from_conflicts = 0;
+
+	tbb::parallel_for(
+		tbb::blocked_range<size_t>(0, num_chunks),
+		[this, &num_drops, &num_defers, &num_replays_from_conflicts] (auto r) {
+			for (auto i = r.begin(); i < r.end(); i++) {
+				auto& chunk_records = records[i];
+				auto& chunk_decisions = decisions[i];
+				chunk_decisions.assign(chunk_records.size(), SPECULATION_REPLAY);
+
+				uint64_t local_drops = 0, local_defers = 0, local_replays = 0;
+
+				for (size_t j = 0; j < chunk_records.size(); j++) {
+					auto& record = chunk_records[j];
+					switch(record.predicted_status) {
+						case SUCCESS:
+							break;
+						case INSUFFICIENT_BALANCE:
+							if (overlay.debit_likely_to_fail(record.account, record.asset, record.amount)) {
+								chunk_decisions[j] = SPECULATION_DEFER;
+								local_defers++;
+							} else {
+								local_replays++;
+							}
+							break;
+						default:
+							//static parameter failures and SEQ_NUM_TOO_LOW never become valid.
+							chunk_decisions[j] = SPECULATION_DROP;
+							local_drops++;
+					}
+				}
+				num_drops.fetch_add(local_drops, std::memory_order_relaxed);
+				num_defers.fetch_add(local_defers, std::memory_order_relaxed);
+				num_replays_from_conflicts.fetch_add(local_replays, std::memory_order_relaxed);
+			}
+		});
+
+	measurements.num_speculated_txs = num_speculated_txs.load(std::memory_order_relaxed);
+	measurements.num_predicted_drops = num_drops.load(std::memory_order_relaxed);
+	measurements.num_predicted_deferrals = num_defers.load(std::memory_order_relaxed);
+	measurements.num_replayed_failures = num_replays_from_conflicts.load(std::memory_order_relaxed);
+	measurements.validation_time = measure_time(timestamp);
+
+	num_deferrals = measurements.num_predicted_deferrals;
+
+	BLOCK_INFO("speculation: %u txs, %u conflicted accounts, %u drops, %u deferrals, %u failures replayed",
+		measurements.num_speculated_txs, measurements.num_conflicted_accounts,
+		measurements.num_predicted_drops, measurements.num_predicted_deferrals, measurements.num_replayed_failures);
+}
+
+const std::vector<uint8_t>*
+SpeculativeTxProcessor::get_decisions(size_t chunk_idx, size_t chunk_size) const {
+	if (chunk_idx >= decisions.size()) {
+		return nullptr;
+	}
+	if (speculated_chunk_sizes[chunk_idx] != chunk_size || decisions[chunk_idx].size() != chunk_size) {
+		return nullptr;
+	}
+	return &decisions[chunk_idx];
+}
+
+void
+SpeculativeTxProcessor::clear() {
+	overlay.clear();
+	records.clear();
+	decisions.clear();
+	speculated_chunk_sizes.clear();
+	stop_flag = false;
+	num_speculated_txs = 0;
+	num_deferrals = 0;
+}
+
+void
+SpeculationWorker::run() {
+	std::unique_lock lock(mtx);
+	while(true) {
+		if ((!done_flag) && (!exists_work_to_do())) {
+			cv.wait(lock, [this] () { return done_flag || exists_work_to_do();});
+		}
+		if (done_flag) return;
+		if (start_speculation) {
+			auto timestamp = init_time_measurement();
+
+			mempool_worker.wait_for_mempool_cleaning_done();
+			{
+				auto mempool_lock = mempool.lock_mempool();
+				processor.speculate(max_txs.load(std::memory_order_relaxed));
+			}
+			speculation_time = measure_time(timestamp);
+
+			start_speculation = false;
+		}
+		cv.notify_all();
+	}
+}
+
+void
+SpeculationWorker::start_speculation_window() {
+	wait_for_async_task();
+	processor.clear();
+
+	std::lock_guard lock(mtx);
+	speculation_time = 0;
+	window_time = 0;
+	window_start = init_time_measurement();
+	start_speculation = true;
+	cv.notify_all();
+}
+
+void
+SpeculationWorker::end_speculation_window() {
+	processor.request_stop();
+	wait_for_async_task();
+	window_time = measure_time_from_basept(window_start);
+}
+
+void
+SpeculationWorker::finish_speculation(SpeculationMeasurements& measurements) {
+	processor.validate_and_decide(measurements);
+	measurements.speculation_time = speculation_time;
+	measurements.speculation_window_time = window_time;
+	measurements.screening_window_fraction = (window_time > 0) ? std::min(1.0f, speculation_time / window_time) : 0;
+}
+
+} /* edce */
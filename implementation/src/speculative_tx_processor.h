@@ -0,0 +1,244 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "async_worker.h"
+#include "database_types.h"
+#include "memory_database.h"
+#include "mempool.h"
+#include "mempool_admission.h"
+#include "utils.h"
+
+#include "xdr/block.h"
+#include "xdr/transaction.h"
+
+namespace edce {
+
+/*
+Speculative screening of the next block's transactions, run while the current block's
+Tatonnement, LP solve, and offer clearing are in progress (cores are otherwise idle on the tx side).
+Enabled by EdceOptions::speculative_tx_screening (off by default).
+
+This is a screening pass, not buffered execution: no speculative result is ever
+applied to the db, and every tx that is not dropped is processed in full by the next build_block().
+The pass only labels txs REPLAY, DROP, or DEFER.
+
+The db has only one copy of uncommitted state, and the current block's clearing is
+concurrently writing to it, so speculation never writes to the db.  Instead, txs are checked
+against a SpeculativeBalanceOverlay, which records, per (account, asset),
+the balance observed when speculation first read it (the read set) and the sum of all
+credits that speculated txs could make to it.
+
+Once clearing finishes, the read set is re-validated against the db.
+Any account whose balance moved (i.e. was touched by offer clearing) is a conflict,
+and every tx whose speculative result depended on it is replayed through the
+normal block production path.
+
+Speculative results are used by the next build_block() in two ways.
+Txs that fail no matter what else the next block contains (static parameter errors, SEQ_NUM_TOO_LOW)
+are dropped without being processed.  MempoolAdmissionChecker already rejects static parameter errors
+on admission, so in practice these are txs whose sequence number was consumed by a tx committed
+after they were admitted.
+Txs whose debits exceed (validated base balance + every credit any speculated tx could provide)
+are likely, but not guaranteed, to fail: txs that were not speculated (speculation stopped early,
+or hit the block size cutoff, or the txs reached the mempool afterwards) might still credit the account.
+These are deprioritized, not dropped: build_block() processes them after every other tx it considers,
+so that any such credits land first.  This reorders txs within the block, which is why screening
+is opt-in.
+*/
+
+//per-tx outcome, consumed by BlockProducer::build_block
+enum SpeculativeDecision : uint8_t {
+	SPECULATION_REPLAY = 0,
+	SPECULATION_DROP = 1,
+	SPECULATION_DEFER = 2
+};
+
+class SpeculativeBalanceOverlay {
+
+	struct AssetEntry {
+		int64_t base;
+		int64_t max_credits = 0;
+	};
+
+	struct AccountEntry {
+		std::unordered_map<AssetID, AssetEntry> assets;
+		//set if a speculated tx might credit this account by an amount we can't know
+		//(i.e. cancelling an offer refunds its escrow).
+		bool unknown_credits = false;
+		//set in validation if any asset balance changed since it was read.
+		bool conflicted = false;
+	};
+
+	constexpr static size_t NUM_SHARDS = 64;
+
+	struct Shard {
+		std::mutex mtx;
+		std::unordered_map<account_db_idx, AccountEntry> accounts;
+	};
+
+	std::array<Shard, NUM_SHARDS> shards;
+
+	MemoryDatabase& db;
+
+	Shard& get_shard(account_db_idx idx) {
+		return shards[idx % NUM_SHARDS];
+	}
+
+	AssetEntry& get_asset_entry(AccountEntry& account, account_db_idx idx, AssetID asset);
+
+public:
+
+	SpeculativeBalanceOverlay(MemoryDatabase& db) : db(db) {}
+
+	//returns true if amount is covered by the balance observed at first read.
+	bool check_debit(account_db_idx idx, AssetID asset, int64_t amount);
+
+	void add_credit(account_db_idx idx, AssetID asset, int64_t amount);
+
+	void mark_unknown_credits(account_db_idx idx);
+
+	//must not run concurrently with speculation, or with db commits/rollbacks.
+	//returns number of conflicted accounts.
+	uint64_t validate();
+
+	//after validate().  True iff the debit fails in any ordering of the speculated txs
+	//(txs that were not speculated might still cover it).
+	bool debit_likely_to_fail(account_db_idx idx, AssetID asset, int64_t amount);
+
+	void clear();
+};
+
+class SpeculativeTxProcessor {
+
+	struct SpeculativeTxRecord {
+		TransactionProcessingStatus predicted_status = TransactionProcessingStatus::SUCCESS;
+		//for INSUFFICIENT_BALANCE, the debit that could not be covered.
+		account_db_idx account = 0;
+		AssetID asset = 0;
+		int64_t amount = 0;
+	};
+
+	Mempool& mempool;
+	MemoryDatabase& db;
+	MempoolAdmissionChecker& static_checker;
+
+	SpeculativeBalanceOverlay overlay;
+
+	//indexed by mempool chunk
+	std::vector<std::vector<SpeculativeTxRecord>> records;
+	std::vector<std::vector<uint8_t>> decisions;
+	//chunk sizes when speculated; decisions for a chunk are ignored if it changed since.
+	std::vector<size_t> speculated_chunk_sizes;
+
+	std::atomic<bool> stop_flag = false;
+	std::atomic<uint64_t> num_speculated_txs = 0;
+	uint64_t num_deferrals = 0;
+
+	SpeculativeTxRecord speculate_transaction(const SignedTransaction& tx);
+
+public:
+
+	SpeculativeTxProcessor(Mempool& mempool, MemoryDatabase& db, MempoolAdmissionChecker& static_checker)
+		: mempool(mempool)
+		, db(db)
+		, static_checker(static_checker)
+		, overlay(db) {}
+
+	//Caller must hold the mempool lock, and keep the mempool's chunk structure
+	//unchanged until the decisions are consumed.
+	//Returns early (leaving remaining chunks unspeculated) if request_stop() is called.
+	void speculate(size_t max_txs);
+
+	void request_stop() {
+		stop_flag.store(true, std::memory_order_relaxed);
+	}
+
+	//run after the current block's clearing has finished
+	void validate_and_decide(SpeculationMeasurements& measurements);
+
+	//nullptr if no (valid) speculative decisions for this chunk.
+	const std::vector<uint8_t>* get_decisions(size_t chunk_idx, size_t chunk_size) const;
+
+	//true if any decision is SPECULATION_DEFER
+	bool has_deferrals() const {
+		return num_deferrals > 0;
+	}
+
+	void clear();
+};
+
+/*
+Runs the speculative pass in the background.
+Speculation starts only once the mempool cleaning from the current block has finished,
+so that chunk indices are stable until the next block's build_block().
+
+The window is the span of block creation during which speculation is allowed to run
+(after the initial db/offer commits, until offer clearing finishes).
+*/
+class SpeculationWorker : public AsyncWorker {
+	using AsyncWorker::mtx;
+	using AsyncWorker::cv;
+
+	SpeculativeTxProcessor processor;
+	Mempool& mempool;
+	MempoolWorker& mempool_worker;
+	std::atomic<size_t> max_txs;
+
+	bool start_speculation = false;
+
+	float speculation_time = 0;
+	float window_time = 0;
+	time_point window_start;
+
+	bool exists_work_to_do() override final {
+		return start_speculation;
+	}
+
+	void run();
+
+public:
+	SpeculationWorker(
+		Mempool& mempool,
+		MempoolWorker& mempool_worker,
+		MemoryDatabase& db,
+		MempoolAdmissionChecker& static_checker,
+		size_t max_txs)
+		: AsyncWorker()
+		, processor(mempool, db, static_checker)
+		, mempool(mempool)
+		, mempool_worker(mempool_worker)
+		, max_txs(max_txs) {
+			start_async_thread([this] () {run();});
+		}
+
+	~SpeculationWorker() {
+		end_speculation_window();
+		end_async_thread();
+	}
+
+	//Must be called after the previous block's decisions have been consumed.
+	void start_speculation_window();
+
+	//blocks until the speculative pass has stopped.
+	void end_speculation_window();
+
+	//after the current block's clearing.  Computes decisions for the next build_block().
+	void finish_speculation(SpeculationMeasurements& measurements);
+
+	const SpeculativeTxProcessor& get_processor() const {
+		return processor;
+	}
+
+	//the block size that speculation targets, from the next speculation window on
+	void set_max_txs(size_t new_max_txs) {
+		max_txs.store(new_max_txs, std::memory_order_relaxed);
+	}
+};
+
+} /* edce */
@@ -14,6 +14,21 @@ GeneratorState<random_generator>::gen_new_accounts(uint64_t num_new_accounts) {
 	}
 }
 
+template<typename random_generator>
+void 
+GeneratorState<random_generator>::init_workload_accounts() {
+	if (options.workload.zipf_accounts) {
+		zipf_account_dist.emplace(num_active_accounts, options.workload.zipf_exponent);
+	}
+	//Market makers come from the least active accounts (the top ranks already send at most
+	//MAX_TXS_PER_ACCOUNT_PER_BLOCK txs per block), so their offers are not lost to the per-account cap.
+	for (size_t i = 0; i < options.workload.num_market_makers && i < num_active_accounts; i++) {
+		AccountID market_maker = existing_accounts_map.at(num_active_accounts - 1 - i);
+		market_makers.insert(market_maker);
+		market_maker_list.push_back(market_maker);
+	}
+}
+
 template<typename random_generator>
 void
 GeneratorState<random_generator>::dump_account_list() {
@@ -141,12 +156,44 @@ GeneratorState<random_generator>::gen_endowment(double price) {
 template<typename random_generator>
 AccountID 
 GeneratorState<random_generator>::gen_account() {
+	if (zipf_account_dist) {
+		//accounts created after startup are never drawn
+		return existing_accounts_map.at((*zipf_account_dist)(gen));
+	}
+
 	std::exponential_distribution<> account_dist(options.account_dist_param);
 
 	uint64_t account_idx = static_cast<uint64_t>(std::floor(account_dist(gen))) % num_active_accounts;
 	return existing_accounts_map.at(account_idx);
 }
 
+template<typename random_generator>
+AccountID
+GeneratorState<random_generator>::gen_source_account() {
+	for (unsigned int i = 0; i < MAX_SOURCE_ACCOUNT_DRAWS; i++) {
+		AccountID account = gen_account();
+		if (has_buffer_space(account)) {
+			block_state.buffered_tx_counts[account]++;
+			return account;
+		}
+	}
+	throw std::runtime_error("every active account is at its tx cap: too few accounts for the block size");
+}
+
+template<typename random_generator>
+AccountID 
+GeneratorState<random_generator>::gen_offer_account() {
+	if (market_maker_list.size() > 0 && zero_one_dist(gen) < options.workload.market_maker_offer_fraction) {
+		std::uniform_int_distribution<size_t> mm_dist(0, market_maker_list.size() - 1);
+		AccountID market_maker = market_maker_list[mm_dist(gen)];
+		if (has_buffer_space(market_maker)) {
+			block_state.buffered_tx_counts[market_maker]++;
+			return market_maker;
+		}
+	}
+	return gen_source_account();
+}
+
 template<typename random_generator>
 OperationType
 GeneratorState<random_generator>::gen_new_op_type() {
@@ -225,7 +272,7 @@ GeneratorState<random_generator>::gen_good_tx_cycle(const std::vector<AssetID>&
 
 		prev_endows.emplace_back(min_price, endow);
 
-		tx.transaction.metadata.sourceAccount = gen_account();
+		tx.transaction.metadata.sourceAccount = gen_offer_account();
 		output.push_back(tx);
 		//if (endow >= 20000000) {
 		//	std::printf("invalid amount! %lu %lf\n", endow, min_price);
@@ -319,7 +366,7 @@ GeneratorState<random_generator>::gen_bad_tx(const std::vector<double>& prices)
 
 	SignedTransaction tx;
 	tx.transaction.operations.push_back(make_sell_offer(gen_endowment(prices[category.sellAsset]), bad_price, category));
-	tx.transaction.metadata.sourceAccount = gen_account();
+	tx.transaction.metadata.sourceAccount = gen_offer_account();
 	return tx;
 }
 
@@ -333,7 +380,7 @@ GeneratorState<random_generator>::gen_account_creation_tx() {
 	//state.num_active_accounts++;
 
 	SignedTransaction tx;
-	tx.transaction.metadata.sourceAccount = gen_account();
+	tx.transaction.metadata.sourceAccount = gen_source_account();
 
 	CreateAccountOp create_op;
 
@@ -361,7 +408,7 @@ GeneratorState<random_generator>::gen_account_creation_tx() {
 template<typename random_generator>
 SignedTransaction 
 GeneratorState<random_generator>::gen_payment_tx() {
-	AccountID sender = gen_account();
+	AccountID sender = gen_source_account();
 	AccountID receiver = gen_account();
 	AssetID asset = gen_asset();
 	int64_t amount = gen_endowment(1);
@@ -393,6 +440,19 @@ GeneratorState<random_generator>::gen_cancel_tx(const SignedTransaction& creatio
 	return tx_out;
 }
 
+//same offer, re-quoted at the current prices
+template<typename random_generator>
+SignedTransaction
+GeneratorState<random_generator>::gen_replacement_offer_tx(const SignedTransaction& creation_tx, const std::vector<double>& prices) {
+	const CreateSellOfferOp& creation_op = creation_tx.transaction.operations.at(0).body.createSellOfferOp();
+
+	SignedTransaction tx_out;
+	tx_out.transaction.metadata.sourceAccount = creation_tx.transaction.metadata.sourceAccount;
+	tx_out.transaction.operations.push_back(
+		make_sell_offer(creation_op.amount, gen_good_price(get_exact_price(prices, creation_op.category)), creation_op.category));
+	return tx_out;
+}
+
 template<typename random_generator>
 bool 
 GeneratorState<random_generator>::bad_offer_cancel() {
@@ -414,6 +474,20 @@ bool is_cancellable(const SignedTransaction& tx) {
 	return false;
 }
 
+template<typename random_generator>
+bool 
+GeneratorState<random_generator>::is_market_maker_offer(const SignedTransaction& tx) const {
+	return market_makers.size() > 0 
+		&& is_cancellable(tx) 
+		&& market_makers.find(tx.transaction.metadata.sourceAccount) != market_makers.end();
+}
+
+template<typename random_generator>
+bool 
+GeneratorState<random_generator>::market_maker_replace() {
+	return zero_one_dist(gen) < options.workload.market_maker_replace_chance;
+}
+
 template<typename random_generator>
 std::pair<
 		std::vector<SignedTransaction>,
@@ -478,53 +552,92 @@ GeneratorState<random_generator>::gen_transactions(size_t num_txs, const std::ve
 }
 
 template<typename random_generator>
-void GeneratorState<random_generator>::make_block(const std::vector<double>& prices) {
+void
+GeneratorState<random_generator>::cap_txs_per_account(size_t block_size, const std::vector<double>& prices) {
+	auto& txs = block_state.tx_buffer;
+	auto& cancellation_flags = block_state.cancel_flags;
+
+	std::unordered_map<AccountID, uint32_t> block_tx_counts;
+
+	auto is_full = [&block_tx_counts] (const SignedTransaction& tx) {
+		auto it = block_tx_counts.find(tx.transaction.metadata.sourceAccount);
+		return it != block_tx_counts.end() && it->second >= MAX_TXS_PER_ACCOUNT_PER_BLOCK;
+	};
+
+	size_t next_spare = block_size;
+
+	for (size_t i = 0; i < block_size; i++) {
+		while (is_full(txs[i])) {
+			while (next_spare < txs.size() && is_full(txs[next_spare])) {
+				next_spare++;
+			}
+			if (next_spare == txs.size()) {
+				//gen_source_account throws once every account's buffer is full, so this terminates
+				auto [new_txs, new_cancellation_flags] = gen_transactions(block_size, prices);
+				txs.insert(txs.end(), new_txs.begin(), new_txs.end());
+				cancellation_flags.insert(cancellation_flags.end(), new_cancellation_flags.begin(), new_cancellation_flags.end());
+				continue;
+			}
+			std::swap(txs[i], txs[next_spare]);
+			std::swap(cancellation_flags[i], cancellation_flags[next_spare]);
+			next_spare++;
+		}
+		block_tx_counts[txs[i].transaction.metadata.sourceAccount]++;
+	}
+}
+
+template<typename random_generator>
+ExperimentBlock 
+GeneratorState<random_generator>::build_block(const std::vector<double>& prices, size_t block_size) {
 	normalize_asset_probabilities();
 
-	if (2 * options.block_size < block_state.tx_buffer.size()) {
+	if (block_size == 0) {
+		return ExperimentBlock();
+	}
+
+	if (2 * block_size < block_state.tx_buffer.size()) {
 		std::printf("previous round overfilled block buffer.\n");
 
 	} else {
-		size_t new_txs_count = 2 * options.block_size - block_state.tx_buffer.size();
+		size_t new_txs_count = 2 * block_size - block_state.tx_buffer.size();
 
 		auto [new_txs, new_cancellation_flags] = gen_transactions(new_txs_count, prices);
 		block_state.tx_buffer.insert(block_state.tx_buffer.end(), new_txs.begin(), new_txs.end());
 		block_state.cancel_flags.insert(block_state.cancel_flags.end(), new_cancellation_flags.begin(), new_cancellation_flags.end());
 	}
 		
-	std::uniform_int_distribution<> idx_dist (0, options.block_size - 1);
+	std::uniform_int_distribution<> idx_dist (0, block_size - 1);
 
-	int num_swaps = options.block_size * options.block_boundary_crossing_fraction;
+	int num_swaps = block_size * options.block_boundary_crossing_fraction;
 
 	for (int swap_cnt = 0; swap_cnt < num_swaps; swap_cnt++) {
 		int idx_1 = idx_dist(gen);
-		int idx_2 = idx_dist(gen) + options.block_size;
+		int idx_2 = idx_dist(gen) + block_size;
 
 		std::swap(block_state.tx_buffer[idx_1], block_state.tx_buffer[idx_2]);
 		std::swap(block_state.cancel_flags[idx_1], block_state.cancel_flags[idx_2]);
 	}
 
+	cap_txs_per_account(block_size, prices);
+
 	auto& txs = block_state.tx_buffer;
 	auto& cancellation_flags = block_state.cancel_flags;
 
-	for (unsigned int i = 0; i < options.block_size; i++) {
+	for (unsigned int i = 0; i < block_size; i++) {
 		uint64_t prev_seq_num = block_state.sequence_num_map[txs[i].transaction.metadata.sourceAccount];
 		txs[i].transaction.metadata.sequenceNumber = (prev_seq_num + 1) << 8;
 		block_state.sequence_num_map[txs.at(i).transaction.metadata.sourceAccount] ++;
 
-		if (cancellation_flags.at(i)) {
+		if (is_market_maker_offer(txs.at(i)) && market_maker_replace()) {
+			replace_txs.push_back(gen_cancel_tx(txs.at(i)));
+			replace_txs.push_back(gen_replacement_offer_tx(txs.at(i), prices));
+		} else if (cancellation_flags.at(i)) {
 			add_cancel_tx(gen_cancel_tx(txs.at(i)));
 		}
 	}
 
 	ExperimentBlock output;
-	output.insert(output.end(), txs.begin(), txs.begin() + options.block_size);
-	
-	std::printf("writing block %lu\n", block_state.block_number);
-
-	std::string filename = output_directory + std::to_string(block_state.block_number) + ".txs";
-	block_state.block_number ++;
-
+	output.insert(output.end(), txs.begin(), txs.begin() + block_size);
 
 	if (options.do_shuffle) {
 		std::shuffle(output.begin(), output.end(), gen);
@@ -532,19 +645,45 @@ void GeneratorState<random_generator>::make_block(const std::vector<double>& pri
 
 	signer.sign_block(output);
 
-	if (save_xdr_to_file(output, filename.c_str())) {
-		throw std::runtime_error("was not able to save file!");
+	for (size_t i = 0; i < block_size; i++) {
+		remove_buffered_tx(txs[i]);
 	}
-
-
-	txs.erase(txs.begin(), txs.begin() + options.block_size);
-	cancellation_flags.erase(cancellation_flags.begin(), cancellation_flags.begin() + options.block_size);
+	txs.erase(txs.begin(), txs.begin() + block_size);
+	cancellation_flags.erase(cancellation_flags.begin(), cancellation_flags.begin() + block_size);
 
 	auto cancel_txs = dump_current_round_cancel_txs();
 	//auto cancel_txs_sz = cancel_txs.size();
 
 	txs.insert(txs.end(), cancel_txs.begin(), cancel_txs.end());
+
+	//re-quotes go first, so that they land in the next block
+	txs.insert(txs.begin(), replace_txs.begin(), replace_txs.end());
+
+	for (auto& tx : cancel_txs) {
+		add_buffered_tx(tx);
+	}
+	for (auto& tx : replace_txs) {
+		add_buffered_tx(tx);
+	}
+	cancellation_flags.insert(cancellation_flags.begin(), replace_txs.size(), false);
+	replace_txs.clear();
+
 	cancellation_flags.resize(txs.size(), false);
+	return output;
+}
+
+template<typename random_generator>
+void GeneratorState<random_generator>::make_block(const std::vector<double>& prices) {
+	auto output = build_block(prices, options.block_size);
+
+	std::printf("writing block %lu\n", block_state.block_number);
+
+	std::string filename = output_directory + std::to_string(block_state.block_number) + ".txs";
+	block_state.block_number ++;
+
+	if (save_xdr_to_file(output, filename.c_str())) {
+		throw std::runtime_error("was not able to save file!");
+	}
 }
 
 template<typename random_generator>
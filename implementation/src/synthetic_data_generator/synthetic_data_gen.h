@@ -5,13 +5,16 @@
 #include "tx_type_utils.h"
 
 #include "synthetic_data_gen_options.h"
+#include "workload_distributions.h"
 
 #include "edce_options.h"
 
 #include <cstdint>
 
 #include <random>
+#include <optional>
 #include <unordered_map>
+#include <unordered_set>
 #include <algorithm>
 
 #include <xdrpp/marshal.h>
@@ -92,6 +95,8 @@ public:
 
 struct BlockState {
 	std::unordered_map<AccountID, uint64_t> sequence_num_map;
+	//txs in tx_buffer, by source account
+	std::unordered_map<AccountID, uint32_t> buffered_tx_counts;
 
 	std::vector<SignedTransaction> tx_buffer;
 	std::vector<bool> cancel_flags;
@@ -131,6 +136,11 @@ struct GeneratorState {
 
 	std::string output_directory;
 
+	//Generators can split the accounts (see ParallelWorkloadGenerator): this one only makes
+	//account ids equal to shard_idx mod num_shards, so generators never share an account or its sequence numbers.
+	const uint32_t shard_idx = 0;
+	const uint32_t num_shards = 1;
+
 	std::vector<AccountID> existing_accounts_map; // map from index [0, num_accounts) to accountID
 
 	//std::unordered_map<uint64_t, AccountID> existing_accounts_map;
@@ -144,8 +154,11 @@ struct GeneratorState {
 
 	void add_account_mapping(uint64_t new_idx) {
 		std::uniform_int_distribution<uint64_t> account_gen_dist(0, UINT64_MAX);
+		std::uniform_int_distribution<uint64_t> shard_account_gen_dist(0, UINT64_MAX / num_shards - 1);
 		while(true) {
-			AccountID new_acct = account_gen_dist(gen);
+			AccountID new_acct = (num_shards == 1) 
+				? account_gen_dist(gen) 
+				: shard_account_gen_dist(gen) * num_shards + shard_idx;
 			if (existing_accounts_set.find(new_acct) != existing_accounts_set.end()) {
 				continue;
 			}
@@ -175,6 +188,40 @@ struct GeneratorState {
 
 	std::vector<std::vector<SignedTransaction>> cancel_txs;
 
+	//market maker cancels and re-quotes, sent at the start of the next block
+	std::vector<SignedTransaction> replace_txs;
+
+	//set if options.workload.zipf_accounts, over the initial accounts
+	std::optional<ZipfDistribution> zipf_account_dist;
+
+	std::unordered_set<AccountID> market_makers;
+	std::vector<AccountID> market_maker_list;
+
+	//UserAccount::reserve_sequence_number only accepts sequence numbers this far past the last committed one,
+	//so no account may send more txs than this in one block.
+	constexpr static uint32_t MAX_TXS_PER_ACCOUNT_PER_BLOCK = 64;
+	//tx_buffer holds about two blocks of txs
+	constexpr static uint32_t MAX_BUFFERED_TXS_PER_ACCOUNT = 2 * MAX_TXS_PER_ACCOUNT_PER_BLOCK;
+	constexpr static unsigned int MAX_SOURCE_ACCOUNT_DRAWS = 10'000;
+
+	bool has_buffer_space(AccountID account) const {
+		auto it = block_state.buffered_tx_counts.find(account);
+		return it == block_state.buffered_tx_counts.end() || it->second < MAX_BUFFERED_TXS_PER_ACCOUNT;
+	}
+	void add_buffered_tx(const SignedTransaction& tx) {
+		block_state.buffered_tx_counts[tx.transaction.metadata.sourceAccount]++;
+	}
+	void remove_buffered_tx(const SignedTransaction& tx) {
+		auto it = block_state.buffered_tx_counts.find(tx.transaction.metadata.sourceAccount);
+		if (--(it->second) == 0) {
+			block_state.buffered_tx_counts.erase(it);
+		}
+	}
+
+	//Keeps hot accounts within the sequence number window: if a block would have more than
+	//MAX_TXS_PER_ACCOUNT_PER_BLOCK txs from one account, the extras swap with txs from after the block.
+	void cap_txs_per_account(size_t block_size, const std::vector<double>& prices);
+
 	void add_cancel_tx(SignedTransaction tx) {
 		auto delay_dist = std::uniform_int_distribution<>(options.cancel_delay_rounds_min, options.cancel_delay_rounds_max);
 
@@ -204,6 +251,11 @@ struct GeneratorState {
 	std::vector<AssetID> gen_asset_cycle();
 	int64_t gen_endowment(double price);
 	AccountID gen_account();
+	//Like gen_account, but redraws accounts that already have MAX_BUFFERED_TXS_PER_ACCOUNT txs waiting in tx_buffer.
+	//Every tx a source account is drawn for must go into tx_buffer.
+	AccountID gen_source_account();
+	//the source of a new offer: a market maker, with options.workload.market_maker_offer_fraction
+	AccountID gen_offer_account();
 	double gen_tolerance();
 	double get_exact_price(const std::vector<double>& prices, const OfferCategory& category);
 	double gen_good_price(double exact_price);
@@ -218,9 +270,12 @@ struct GeneratorState {
 	SignedTransaction gen_account_creation_tx();
 	SignedTransaction gen_payment_tx();
 	SignedTransaction gen_cancel_tx(const SignedTransaction& creation_tx);
+	SignedTransaction gen_replacement_offer_tx(const SignedTransaction& creation_tx, const std::vector<double>& prices);
 
 	bool good_offer_cancel();
 	bool bad_offer_cancel();
+	bool is_market_maker_offer(const SignedTransaction& tx) const;
+	bool market_maker_replace();
 
 	std::pair<
 		std::vector<SignedTransaction>,
@@ -229,6 +284,7 @@ struct GeneratorState {
 	gen_transactions(size_t num_txs, const std::vector<double>& prices);
 
 	void gen_new_accounts(uint64_t num_new_accounts);
+	void init_workload_accounts();
 	void dump_account_list();
 
 public:
@@ -241,10 +297,26 @@ public:
 		, signer()
 		, output_directory(output_directory) {
 			gen_new_accounts(options.num_accounts);
+			init_workload_accounts();
 			dump_account_list();
 		}
 
+	//One of num_shards generators, which splits the accounts with the others.  Does not write an account list.
+	GeneratorState(random_generator& gen, const GenerationOptions& options, uint32_t shard_idx, uint32_t num_shards) 
+		: type_dist(0.0, 1.0) 
+		, num_active_accounts(0)
+		, gen(gen)
+		, options(options) 
+		, signer()
+		, output_directory()
+		, shard_idx(shard_idx)
+		, num_shards(num_shards) {
+			gen_new_accounts(options.num_accounts / num_shards + ((shard_idx < options.num_accounts % num_shards) ? 1 : 0));
+			init_workload_accounts();
+		}
 
+	//Generates, sequences and signs the next block_size txs.
+	ExperimentBlock build_block(const std::vector<double>& prices, size_t block_size);
 
 	void make_block(const std::vector<double>& prices);
 
@@ -92,6 +92,53 @@ bool PriceOptions::parse(struct fy_document* fyd) {
 	return count == 6;
 }
 
+bool WorkloadOptions::parse(struct fy_document* fyd) {
+	//every key is optional
+	char account_dist_buf[16];
+	if (fy_document_scanf(fyd, "/experiment/workload/account_dist %15s", account_dist_buf) == 1) {
+		std::string account_dist(account_dist_buf);
+		if (account_dist == "zipf") {
+			zipf_accounts = true;
+		} else if (account_dist != "exponential") {
+			std::printf("unknown account_dist %s\n", account_dist_buf);
+			return false;
+		}
+	}
+
+	fy_document_scanf(fyd, "/experiment/workload/seed %lu", &seed);
+	fy_document_scanf(fyd, "/experiment/workload/num_generator_threads %u", &num_generator_threads);
+	fy_document_scanf(fyd, "/experiment/workload/zipf_exponent %lf", &zipf_exponent);
+	fy_document_scanf(fyd, "/experiment/workload/num_market_makers %u", &num_market_makers);
+	fy_document_scanf(fyd, "/experiment/workload/market_maker_offer_fraction %lf", &market_maker_offer_fraction);
+	fy_document_scanf(fyd, "/experiment/workload/market_maker_replace_chance %lf", &market_maker_replace_chance);
+	fy_document_scanf(fyd, "/experiment/workload/burst_start_chance %lf", &burst_start_chance);
+	fy_document_scanf(fyd, "/experiment/workload/burst_end_chance %lf", &burst_end_chance);
+	fy_document_scanf(fyd, "/experiment/workload/burst_multiplier %lf", &burst_multiplier);
+	fy_document_scanf(fyd, "/experiment/workload/submission_batch_size %u", &submission_batch_size);
+	fy_document_scanf(fyd, "/experiment/workload/block_interval_ms %u", &block_interval_ms);
+
+	auto is_chance = [] (double p) {return p >= 0 && p <= 1;};
+
+	if (num_generator_threads == 0 || submission_batch_size == 0) {
+		std::printf("need at least one generator thread and a positive submission batch size\n");
+		return false;
+	}
+	if (zipf_exponent <= 0 || burst_multiplier <= 0) {
+		std::printf("zipf_exponent and burst_multiplier must be positive\n");
+		return false;
+	}
+	if (!(is_chance(market_maker_offer_fraction) && is_chance(market_maker_replace_chance) 
+		&& is_chance(burst_start_chance) && is_chance(burst_end_chance))) {
+		std::printf("workload chances must be in [0,1]\n");
+		return false;
+	}
+	if (market_maker_offer_fraction > 0 && num_market_makers == 0) {
+		std::printf("market_maker_offer_fraction needs num_market_makers > 0\n");
+		return false;
+	}
+	return true;
+}
+
 bool GenerationOptions::parse(const char* filename) {
 
 	struct fy_document* fyd = fy_document_build_from_file(NULL, filename);
@@ -174,6 +221,22 @@ bool GenerationOptions::parse(const char* filename) {
 
 	do_shuffle = (shuffle > 0);
 
+	status = workload.parse(fyd);
+	if (!status) {
+		std::printf("workload problem\n");
+		return false;
+	}
+
+	if (workload.num_generator_threads > num_accounts) {
+		std::printf("more generator threads than accounts\n");
+		return false;
+	}
+
+	if (workload.num_market_makers * workload.num_generator_threads > num_accounts) {
+		std::printf("more market makers than accounts\n");
+		return false;
+	}
+
 	return true;
 }
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <libfyaml.h>
+#include <cstdint>
 #include <vector>
 
 #include <string>
@@ -28,6 +29,37 @@ struct PriceOptions {
 	bool parse(struct fy_document* fyd);
 };
 
+//Optional (/experiment/workload/...), used by ParallelWorkloadGenerator (workload_generator.h).
+//The defaults leave account activity and arrivals as in GeneratorState.
+struct WorkloadOptions {
+	uint64_t seed = 0;
+	//accounts are split across this many independent generators, which build each block in parallel
+	unsigned int num_generator_threads = 1;
+
+	//exponential (over account index, with account_dist_param) or zipf (P(rank k) ~ 1/(k+1)^zipf_exponent)
+	bool zipf_accounts = false;
+	double zipf_exponent = 1.0;
+
+	//The num_market_makers least active accounts (of each generator) are market makers.  They send this fraction of offers,
+	//and each of their offers is replaced (cancelled, and re-quoted at the current price) in the next block
+	//with market_maker_replace_chance.
+	unsigned int num_market_makers = 0;
+	double market_maker_offer_fraction = 0.0;
+	double market_maker_replace_chance = 0.0;
+
+	//Bursty arrivals: per block, a burst starts with burst_start_chance and ends with burst_end_chance.
+	//A block during a burst has burst_multiplier * block_size txs.
+	double burst_start_chance = 0.0;
+	double burst_end_chance = 1.0;
+	double burst_multiplier = 1.0;
+
+	//when streaming to a node's submission api: txs per rpc, and the time over which each block's txs are sent (0 = no pacing)
+	unsigned int submission_batch_size = 1000;
+	unsigned int block_interval_ms = 0;
+
+	bool parse(struct fy_document* fyd);
+};
+
 struct GenerationOptions {
 	unsigned int num_assets;
 	double asset_bias = 0.0;
@@ -62,6 +94,7 @@ struct GenerationOptions {
 
 	bool do_shuffle;
 
+	WorkloadOptions workload;
 
 	bool parse(const char* filename);
 };
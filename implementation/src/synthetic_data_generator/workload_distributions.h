@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace edce {
+
+//P(rank k) proportional to 1/(k+1)^exponent, over ranks [0, n).
+//Sampling is a binary search over the precomputed cdf.
+class ZipfDistribution {
+	std::vector<double> cdf;
+
+public:
+
+	ZipfDistribution(size_t n, double exponent) {
+		if (n == 0) {
+			throw std::runtime_error("zipf distribution over no ranks");
+		}
+		cdf.reserve(n);
+		double sum = 0;
+		for (size_t k = 0; k < n; k++) {
+			sum += 1.0 / std::pow(static_cast<double>(k + 1), exponent);
+			cdf.push_back(sum);
+		}
+		for (auto& c : cdf) {
+			c /= sum;
+		}
+		cdf.back() = 1.0;
+	}
+
+	size_t size() const {
+		return cdf.size();
+	}
+
+	double probability(size_t rank) const {
+		return (rank == 0) ? cdf[0] : cdf[rank] - cdf[rank - 1];
+	}
+
+	template<typename random_generator>
+	size_t operator()(random_generator& gen) const {
+		std::uniform_real_distribution<> dist(0, 1);
+		double u = dist(gen);
+		return std::min<size_t>(std::upper_bound(cdf.begin(), cdf.end(), u) - cdf.begin(), cdf.size() - 1);
+	}
+};
+
+//Two state (calm/burst) Markov chain over blocks, giving each block's size.
+class BurstSchedule {
+	const size_t base_block_size;
+	const double start_chance;
+	const double end_chance;
+	const double multiplier;
+
+	bool bursting = false;
+
+public:
+
+	BurstSchedule(size_t base_block_size, double start_chance, double end_chance, double multiplier)
+		: base_block_size(base_block_size)
+		, start_chance(start_chance)
+		, end_chance(end_chance)
+		, multiplier(multiplier) {}
+
+	bool is_bursting() const {
+		return bursting;
+	}
+
+	template<typename random_generator>
+	size_t next_block_size(random_generator& gen) {
+		std::uniform_real_distribution<> dist(0, 1);
+		double u = dist(gen);
+		bursting = bursting ? (u >= end_chance) : (u < start_chance);
+		return bursting ? static_cast<size_t>(base_block_size * multiplier) : base_block_size;
+	}
+};
+
+} /* edce */
@@ -0,0 +1,80 @@
+#include "synthetic_data_generator/workload_generator.h"
+
+#include <cstddef>
+
+#include "synthetic_data_generator/synthetic_data_gen_options.h"
+
+#include "edce_options.h"
+#include "utils.h"
+
+#include "xdr/experiments.h"
+
+using namespace edce;
+
+int main(int argc, char const *argv[])
+{
+	if (!(argc == 4 || argc == 5)) {
+		std::printf("usage: ./workload_gen <edce_options> <experiment_yaml> <experiment_name> [hostname]\n");
+		std::printf("writes blocks to <output_prefix><experiment_name>/, or if hostname is given,\n");
+		std::printf("streams them to that node's submission api\n");
+		return 1;
+	}
+
+	GenerationOptions options;
+	auto parsed = options.parse(argv[2]);
+	if (!parsed) {
+		std::printf("yaml parse error\n");
+		return 1;
+	}
+
+	ExperimentParameters params;
+	params.num_assets = options.num_assets;
+	params.num_accounts = options.num_accounts;
+
+	EdceOptions edce_options;
+	edce_options.parse_options(argv[1]);
+	params.tax_rate = edce_options.tax_rate;
+	params.smooth_mult = edce_options.smooth_mult;
+	params.num_threads = 0; // SET LATER
+	params.persistence_frequency = edce_options.persistence_frequency;
+	params.num_blocks = options.num_blocks;
+
+	if (params.num_assets != edce_options.num_assets) {
+		throw std::runtime_error("mismatch in number of assets.  Are you sure?");
+	}
+
+	std::string output_root = options.output_prefix + std::string(argv[3]) + std::string("/");
+
+	if (mkdir_safe(options.output_prefix.c_str())) {
+		std::printf("directory %s already exists, continuing\n", options.output_prefix.c_str());
+	}
+	if (mkdir_safe(output_root.c_str())) {
+		std::printf("directory %s already exists, continuing\n", output_root.c_str());
+	}
+
+	auto params_file = output_root + std::string("params");
+	if (save_xdr_to_file(params, params_file.c_str())) {
+		throw std::runtime_error("failed to save params file");
+	}
+
+	auto start_time = init_time_measurement();
+
+	ParallelWorkloadGenerator generator(options);
+
+	//a node fed from the submission api must be started from this account list
+	generator.dump_account_list(output_root);
+
+	std::printf("made %u accounts in %lf s\n", options.num_accounts, measure_time_from_basept(start_time));
+
+	if (argc == 4) {
+		FileWorkloadSink sink(output_root);
+		generator.make_blocks(sink);
+		std::printf("made experiment in %lf s, output to %s\n", measure_time_from_basept(start_time), output_root.c_str());
+	} else {
+		SubmissionApiWorkloadSink sink(argv[4], options.workload.submission_batch_size, options.workload.block_interval_ms);
+		generator.make_blocks(sink);
+		double total_time = measure_time_from_basept(start_time);
+		std::printf("submitted %lu txs (%lu accepted) in %lf s: %lf submissions/s\n",
+			sink.get_num_submitted(), sink.get_num_accepted(), total_time, sink.get_num_submitted() / total_time);
+	}
+}
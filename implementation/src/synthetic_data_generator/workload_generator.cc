@@ -0,0 +1,166 @@
+#include "synthetic_data_generator/workload_generator.h"
+
+#include "rpc/rpcconfig.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+#include <tbb/parallel_for.h>
+
+#include <xdrpp/marshal.h>
+
+namespace edce {
+
+void
+FileWorkloadSink::write_block(uint64_t block_number, ExperimentBlock& block) {
+	std::printf("writing block %lu\n", block_number);
+
+	std::string filename = output_directory + std::to_string(block_number) + ".txs";
+	if (save_xdr_to_file(block, filename.c_str())) {
+		throw std::runtime_error("was not able to save file!");
+	}
+}
+
+SubmissionApiWorkloadSink::SubmissionApiWorkloadSink(const std::string& hostname, size_t batch_size, unsigned int block_interval_ms)
+	: socket(xdr::tcp_connect(hostname.c_str(), TRANSACTION_SUBMISSION_PORT))
+	, client(std::make_unique<client_t>(socket.get()))
+	, batch_size(batch_size)
+	, block_interval_ms(block_interval_ms) {
+		if (batch_size == 0) {
+			throw std::runtime_error("batch size must be nonzero");
+		}
+	}
+
+void
+SubmissionApiWorkloadSink::write_block(uint64_t block_number, ExperimentBlock& block) {
+	auto block_start = std::chrono::steady_clock::now();
+	size_t num_batches = (block.size() + batch_size - 1) / batch_size;
+
+	uint64_t block_accepted = 0;
+
+	for (size_t i = 0; i < num_batches; i++) {
+		SignedTransactionList batch;
+		batch.insert(
+			batch.end(),
+			block.begin() + i * batch_size,
+			block.begin() + std::min(block.size(), (i + 1) * batch_size));
+
+		if (block_interval_ms > 0) {
+			std::this_thread::sleep_until(block_start + std::chrono::milliseconds((block_interval_ms * i) / num_batches));
+		}
+
+		auto res = client->submit_transaction_batch(xdr::xdr_to_opaque(batch));
+		block_accepted += res->num_accepted;
+	}
+
+	num_submitted += block.size();
+	num_accepted += block_accepted;
+
+	std::printf("submitted block %lu: %lu txs (%lu accepted)\n", block_number, block.size(), block_accepted);
+
+	if (block_interval_ms > 0) {
+		std::this_thread::sleep_until(block_start + std::chrono::milliseconds(block_interval_ms));
+	}
+}
+
+ParallelWorkloadGenerator::ParallelWorkloadGenerator(const GenerationOptions& options)
+	: options(options)
+	, gens()
+	, generators()
+	, master_gen(options.workload.seed)
+	, burst_schedule(
+		options.block_size,
+		options.workload.burst_start_chance,
+		options.workload.burst_end_chance,
+		options.workload.burst_multiplier) {
+
+		uint32_t num_shards = options.workload.num_generator_threads;
+		for (uint32_t i = 0; i < num_shards; i++) {
+			std::seed_seq seed{options.workload.seed, static_cast<uint64_t>(i + 1)};
+			gens.push_back(std::make_unique<random_generator>(seed));
+			generators.push_back(nullptr);
+		}
+
+		tbb::parallel_for(
+			tbb::blocked_range<uint32_t>(0, num_shards),
+			[this, num_shards] (auto r) {
+				for (auto i = r.begin(); i < r.end(); i++) {
+					generators[i] = std::make_unique<generator_t>(*gens[i], this->options, i, num_shards);
+				}
+			});
+	}
+
+void
+ParallelWorkloadGenerator::dump_account_list(const std::string& output_directory) const {
+	AccountIDList list;
+	for (auto& generator : generators) {
+		list.insert(list.end(), generator->existing_accounts_map.begin(), generator->existing_accounts_map.end());
+	}
+
+	std::string accounts_filename = output_directory + "accounts";
+	if (save_xdr_to_file(list, accounts_filename.c_str())) {
+		throw std::runtime_error("could not save accounts list!");
+	}
+}
+
+std::vector<size_t>
+ParallelWorkloadGenerator::split_block_size(size_t block_size) const {
+	size_t num_shards = generators.size();
+	std::vector<size_t> out;
+	for (size_t i = 0; i < num_shards; i++) {
+		out.push_back(block_size / num_shards + ((i < block_size % num_shards) ? 1 : 0));
+	}
+	return out;
+}
+
+ExperimentBlock
+ParallelWorkloadGenerator::make_block(const std::vector<double>& prices) {
+	size_t block_size = burst_schedule.next_block_size(master_gen);
+	auto shard_sizes = split_block_size(block_size);
+
+	std::vector<ExperimentBlock> shard_blocks(generators.size());
+
+	tbb::parallel_for(
+		tbb::blocked_range<size_t>(0, generators.size()),
+		[this, &prices, &shard_sizes, &shard_blocks] (auto r) {
+			for (auto i = r.begin(); i < r.end(); i++) {
+				shard_blocks[i] = generators[i]->build_block(prices, shard_sizes[i]);
+			}
+		});
+
+	ExperimentBlock output;
+	output.reserve(block_size);
+	for (auto& shard_block : shard_blocks) {
+		output.insert(output.end(), shard_block.begin(), shard_block.end());
+	}
+
+	if (options.do_shuffle) {
+		std::shuffle(output.begin(), output.end(), master_gen);
+	}
+
+	if (burst_schedule.is_bursting()) {
+		std::printf("block %lu is a burst (%lu txs)\n", block_number, output.size());
+	}
+	return output;
+}
+
+void
+ParallelWorkloadGenerator::make_blocks(WorkloadSink& sink) {
+	//prices are shared, and evolve with the first generator's rng
+	auto& price_generator = *generators.at(0);
+	std::vector<double> prices = price_generator.gen_prices();
+
+	for (size_t i = 0; i < options.num_blocks; i++) {
+		auto block = make_block(prices);
+		sink.write_block(block_number, block);
+		block_number++;
+
+		price_generator.modify_prices(prices);
+		price_generator.print_prices(prices);
+	}
+}
+
+} /* edce */
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "synthetic_data_generator/synthetic_data_gen.h"
+#include "synthetic_data_generator/synthetic_data_gen_options.h"
+
+#include "xdr/experiments.h"
+#include "xdr/transaction_submission_api.h"
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <xdrpp/srpc.h>
+
+namespace edce {
+
+/*
+Workload generation for load tests.
+
+ParallelWorkloadGenerator splits the accounts across options.workload.num_generator_threads
+GeneratorStates, each with its own rng (seeded from options.workload.seed and its index), and builds
+each block by having every generator make its share of the block in parallel.  Output is deterministic
+for a given seed and thread count.
+
+Generators never share accounts, so payments only go between accounts of one generator.
+
+Blocks go to a WorkloadSink: either files (<n>.txs, as synthetic_data_gen writes them) or
+a node's transaction submission api.
+*/
+
+class WorkloadSink {
+public:
+	virtual void write_block(uint64_t block_number, ExperimentBlock& block) = 0;
+	virtual ~WorkloadSink() = default;
+};
+
+class FileWorkloadSink : public WorkloadSink {
+	const std::string output_directory;
+
+public:
+	FileWorkloadSink(std::string output_directory)
+		: output_directory(output_directory) {}
+
+	void write_block(uint64_t block_number, ExperimentBlock& block) override final;
+};
+
+//Streams each block to a node's submission api, in batches of batch_size txs.
+//If block_interval_ms > 0, the batches of a block are spread over block_interval_ms.
+class SubmissionApiWorkloadSink : public WorkloadSink {
+	using client_t = xdr::srpc_client<SubmitTransactionV1>;
+
+	xdr::unique_sock socket;
+	std::unique_ptr<client_t> client;
+
+	const size_t batch_size;
+	const unsigned int block_interval_ms;
+
+	uint64_t num_submitted = 0;
+	uint64_t num_accepted = 0;
+
+public:
+	SubmissionApiWorkloadSink(const std::string& hostname, size_t batch_size, unsigned int block_interval_ms);
+
+	void write_block(uint64_t block_number, ExperimentBlock& block) override final;
+
+	uint64_t get_num_submitted() const {
+		return num_submitted;
+	}
+	uint64_t get_num_accepted() const {
+		return num_accepted;
+	}
+};
+
+class ParallelWorkloadGenerator {
+	using random_generator = std::minstd_rand;
+	using generator_t = GeneratorState<random_generator>;
+
+	const GenerationOptions& options;
+
+	//generators hold references to their rngs
+	std::vector<std::unique_ptr<random_generator>> gens;
+	std::vector<std::unique_ptr<generator_t>> generators;
+
+	//block sizes, and shuffling the merged block
+	random_generator master_gen;
+	BurstSchedule burst_schedule;
+
+	uint64_t block_number = 1;
+
+	std::vector<size_t> split_block_size(size_t block_size) const;
+
+public:
+
+	ParallelWorkloadGenerator(const GenerationOptions& options);
+
+	//Writes <output_directory>accounts, the union of every generator's initial accounts.
+	void dump_account_list(const std::string& output_directory) const;
+
+	ExperimentBlock make_block(const std::vector<double>& prices);
+
+	//Writes options.num_blocks blocks to sink.
+	void make_blocks(WorkloadSink& sink);
+};
+
+} /* edce */
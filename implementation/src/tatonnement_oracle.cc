@@ -351,25 +351,12 @@ TatonnementOracle::compute_prices(Price* prices_workspace, const ApproximationPa
 	}
 }
 
-void TatonnementOracle::run_tatonnement_thread(TatonnementControlParameters* control_params_ptr_) {
+template<typename QueryFn>
+void TatonnementOracle::run_worker_thread(QueryFn&& query, const bool use_in_case_of_timeout) {
 
 	std::vector<Price> local_price_workspace;
 	local_price_workspace.resize(num_assets);
 
-	if (control_params_ptr_ == nullptr) {
-		throw std::runtime_error("nonsense!");
-	}
-
-	std::unique_ptr<TatonnementControlParameters> control_params_ptr(control_params_ptr_);
-
-	if (!control_params_ptr) {
-		throw std::runtime_error("nonsense!!");
-	}
-
-	auto& control_params = *control_params_ptr;
-
-	std::unique_ptr<LPInstance> instance = solver.make_instance();
-
 	while(true) {
 		std::unique_lock lock(mtx);
 		start_cv.wait(lock, [this] {
@@ -386,18 +373,15 @@ void TatonnementOracle::run_tatonnement_thread(TatonnementControlParameters* con
 //		num_active_threads.fetch_add(1);
 		lock.unlock();
 
-		auto success = grid_search_tatonnement_query(control_params, local_price_workspace.data(), instance);
+		auto success = query(local_price_workspace.data());
 
 		lock.lock();
 		num_active_threads --;
 
 		//std::printf("num active threads: %u\n", num_active_threads);
-		if (success || (timeout_happened && control_params.use_in_case_of_timeout)) {
+		if (success || (timeout_happened && use_in_case_of_timeout)) {
 		//	lock.lock();
 			//std::unique_lock lock(mtx);
-			if (success) {
-				TAT_INFO("success with step_radix %lu diff_reduction %lu", control_params.step_radix, control_params.diff_reduction);
-			}
 			for(size_t i = 0; i < num_assets; i++) {
 				internal_shared_price_workspace[i] = local_price_workspace[i];
 			}
@@ -410,6 +394,46 @@ void TatonnementOracle::run_tatonnement_thread(TatonnementControlParameters* con
 	}
 }
 
+void TatonnementOracle::run_tatonnement_thread(TatonnementControlParameters* control_params_ptr_) {
+
+	if (control_params_ptr_ == nullptr) {
+		throw std::runtime_error("nonsense!");
+	}
+
+	std::unique_ptr<TatonnementControlParameters> control_params_ptr(control_params_ptr_);
+
+	if (!control_params_ptr) {
+		throw std::runtime_error("nonsense!!");
+	}
+
+	auto& control_params = *control_params_ptr;
+
+	std::unique_ptr<LPInstance> instance = solver.make_instance();
+
+	run_worker_thread(
+		[this, &control_params, &instance] (Price* prices_workspace) {
+			auto success = grid_search_tatonnement_query(control_params, prices_workspace, instance);
+			if (success) {
+				TAT_INFO("success with strategy %u step_radix %lu diff_reduction %lu", control_params.strategy_idx, control_params.step_radix, control_params.diff_reduction);
+			}
+			return success;
+		}, 
+		control_params.use_in_case_of_timeout);
+}
+
+void TatonnementOracle::run_convex_solver_thread() {
+
+	ConvexPriceSolver convex_solver(work_unit_manager);
+
+	std::unique_ptr<LPInstance> instance = solver.make_instance();
+
+	run_worker_thread(
+		[this, &convex_solver, &instance] (Price* prices_workspace) {
+			return convex_solver_query(convex_solver, prices_workspace, instance);
+		},
+		false);
+}
+
 void TatonnementOracle::start_tatonnement_threads() {
 	size_t num_work_units = WorkUnitManagerUtils::get_num_work_units_by_asset_count(num_assets);
 
@@ -418,6 +442,7 @@ void TatonnementOracle::start_tatonnement_threads() {
 
 
 	bool first = true;
+	num_strategies = 0;
 
 	for (size_t i = 0; i < 3 ; i++) { // was i=4
 
@@ -433,11 +458,16 @@ void TatonnementOracle::start_tatonnement_threads() {
 		params->diff_reduction = 0;//5*(3-i);
 		params->use_in_case_of_timeout = first; // only one thread should be set to true.
 		first = false;
+		params->strategy_idx = num_strategies++;
 		
 		worker_threads.emplace_back(std::thread(
 			[this] (TatonnementControlParameters* params) {
 				run_tatonnement_thread(params);
 			}, params));
+
+		if (single_strategy) {
+			return;
+		}
 	}
 	for (size_t i = 0; i < 3; i++) {
 		auto params = new TatonnementControlParameters(num_assets, num_work_units);
@@ -450,6 +480,38 @@ void TatonnementOracle::start_tatonnement_threads() {
 		params->use_in_case_of_timeout = false;
 
 		params->use_volume_relativizer = true;
+		params->strategy_idx = num_strategies++;
+
+		worker_threads.emplace_back(std::thread(
+			[this, params] {
+				run_tatonnement_thread(params);
+			}));
+	}
+
+	//aggressive step schedule: large steps early, quick backoff
+	{
+		auto params = new TatonnementControlParameters(num_assets, num_work_units);
+		params->min_step = ((uint64_t)1)<<7;
+		params->step_adjust_radix = 5;
+		params->step_radix = 84;
+		params->step_up_factor = 2.0;
+		params->step_down_factor = 0.5;
+		params->strategy_idx = num_strategies++;
+
+		worker_threads.emplace_back(std::thread(
+			[this, params] {
+				run_tatonnement_thread(params);
+			}));
+	}
+	//different starting point
+	{
+		auto params = new TatonnementControlParameters(num_assets, num_work_units);
+		params->min_step = ((uint64_t)1)<<7;
+		params->step_adjust_radix = 5;
+		params->step_radix = 73;
+		params->start_perturbation_radix = 4;
+		params->use_volume_relativizer = true;
+		params->strategy_idx = num_strategies++;
 
 		worker_threads.emplace_back(std::thread(
 			[this, params] {
@@ -457,6 +519,12 @@ void TatonnementOracle::start_tatonnement_threads() {
 			}));
 	}
 
+	if (race_convex_solver) {
+		worker_threads.emplace_back(std::thread(
+			[this] {
+				run_convex_solver_thread();
+			}));
+	}
 }
 
 void TatonnementOracle::end_tatonnement_threads() {
@@ -476,6 +544,7 @@ void TatonnementOracle::start_tatonnement_query() {
 	done_tatonnement_flag = false;
 	results_ready = false;
 	timeout_happened = false;
+	portfolio.reset(num_strategies);
 	start_cv.notify_all();
 }
 
@@ -525,6 +594,8 @@ TatonnementOracle::compute_prices_grid_search(Price* prices_workspace, const App
 
 	//update_approximation_parameters();
 	active_approx_params = approx_params;
+	//a timeout leaves this unset
+	internal_measurements.convex_solver_won = 0;
 
 	for (size_t i = 0; i < num_assets; i++) {
 		internal_shared_price_workspace[i] = prices_workspace[i];
@@ -546,6 +617,8 @@ TatonnementOracle::compute_prices_grid_search(Price* prices_workspace, const App
 	}
 	internal_measurements.runtime = measure_time(timestamp);
 
+	TAT_INFO("pruned %u of %u tatonnement strategies", portfolio.get_num_pruned(), num_strategies);
+
 	return internal_measurements;
 }
 
@@ -599,6 +672,74 @@ TatonnementOracle::normalize_prices(
 	return 0;
 }
 
+void
+TatonnementOracle::perturb_starting_prices(
+	Price* prices_workspace,
+	const TatonnementControlParameters& control_params) {
+
+	//deterministic, so that a strategy starts from the same place given the same prices
+	for (size_t i = 0; i < num_assets; i++) {
+		uint64_t hash = (i + 1) * 0x9E3779B97F4A7C15ull + control_params.strategy_idx;
+		hash ^= hash >> 31;
+		Price delta = prices_workspace[i] >> control_params.start_perturbation_radix;
+		if (hash & 1) {
+			prices_workspace[i] = PriceUtils::impose_bounds(prices_workspace[i] + delta);
+		} else {
+			prices_workspace[i] = PriceUtils::impose_bounds(prices_workspace[i] - delta);
+		}
+	}
+}
+
+bool
+TatonnementOracle::portfolio_check(
+	TatonnementControlParameters& control_params,
+	const MultifuncTatonnementObjective& objective,
+	uint64_t round_number,
+	unsigned int& lagging_checks) {
+
+	auto& demand_oracle = *(control_params.oracle);
+	size_t num_active_workers = demand_oracle.get_num_active_workers();
+
+	if (portfolio.publish(control_params.strategy_idx, objective.relative_l2norm)) {
+		lagging_checks = 0;
+		auto claimed = portfolio.claim_workers(TatonnementControlParameters::MAX_DEMAND_WORKERS - num_active_workers);
+		if (claimed > 0) {
+			TAT_INFO("strategy %u leads, taking %u more demand workers", control_params.strategy_idx, claimed);
+			demand_oracle.set_num_active_workers(num_active_workers + claimed);
+		}
+		return true;
+	}
+
+	//give back anything taken while leading
+	const size_t base_workers = control_params.base_demand_workers;
+	if (num_active_workers > base_workers) {
+		demand_oracle.set_num_active_workers(base_workers);
+		portfolio.release_workers(num_active_workers - base_workers);
+		num_active_workers = base_workers;
+	}
+
+	//the timeout strategy has to keep going, in case no one clears
+	if (control_params.use_in_case_of_timeout
+		|| round_number < TatonnementPortfolio::PRUNE_MIN_ROUNDS
+		|| !portfolio.lags(objective.relative_l2norm)) {
+		lagging_checks = 0;
+		return true;
+	}
+
+	lagging_checks++;
+	if (lagging_checks < TatonnementPortfolio::PRUNE_PATIENCE) {
+		return true;
+	}
+
+	//the demand workers plus this thread
+	if (portfolio.try_prune(num_active_workers + 1)) {
+		TAT_INFO("pruning strategy %u at round %lu, objective %lf best %lf",
+			control_params.strategy_idx, round_number, objective.relative_l2norm, portfolio.get_best_objective());
+		return false;
+	}
+	return true;
+}
+
 bool
 TatonnementOracle::grid_search_tatonnement_query(
 	TatonnementControlParameters& control_params,
@@ -618,8 +759,8 @@ TatonnementOracle::grid_search_tatonnement_query(
 	//TAT_INFO("step up:%f", (1.2 * ((double) (((uint16_t)1) << step_adjust_radix))));
 	//was: up 1.4, down 0.8
 	
-	const uint16_t step_up = (uint16_t) (1.4 * ((double) (((uint16_t)1) << step_adjust_radix)));
-	const uint16_t step_down = (uint16_t) (0.8 * ((double) (((uint16_t)1) << step_adjust_radix)));
+	const uint16_t step_up = (uint16_t) (control_params.step_up_factor * ((double) (((uint16_t)1) << step_adjust_radix)));
+	const uint16_t step_down = (uint16_t) (control_params.step_down_factor * ((double) (((uint16_t)1) << step_adjust_radix)));
 
 	uint128_t* supplies_workspace = new uint128_t[num_assets];
 	uint128_t* demands_workspace = new uint128_t[num_assets];
@@ -639,7 +780,14 @@ TatonnementOracle::grid_search_tatonnement_query(
 
 	clear_supply_demand_workspaces(supplies_search, demands_search);
 
+	if (control_params.start_perturbation_radix > 0) {
+		perturb_starting_prices(prices_workspace, control_params);
+	}
+
 	auto& demand_oracle = *(control_params.oracle);
+	//undo any workers taken from pruned strategies in the last query
+	control_params.base_demand_workers = num_demand_workers.load(std::memory_order_relaxed);
+	demand_oracle.set_num_active_workers(control_params.base_demand_workers);
 	demand_oracle.activate_oracle();
 
 
@@ -658,6 +806,8 @@ TatonnementOracle::grid_search_tatonnement_query(
 
 	int force_step_rounds = 0;
 
+	unsigned int lagging_checks = 0;
+
 	while (true) {
 
 		if (round_number % LP_CHECK_FREQ == LP_CHECK_FREQ - 1) {
@@ -700,6 +850,7 @@ TatonnementOracle::grid_search_tatonnement_query(
 				}
 				internal_measurements.num_rounds = round_number;
 				internal_measurements.step_radix = step_radix;
+				internal_measurements.convex_solver_won = 0;
 			}
 			delete[] trial_prices;
 			delete[] supplies_workspace;
@@ -832,8 +983,91 @@ TatonnementOracle::grid_search_tatonnement_query(
 			//prev_objective = get_objective(supplies_workspace, demands_workspace, prices_workspace, function_inputs);
 		}
 
+		if (round_number % PORTFOLIO_CHECK_FREQ == 0) {
+			if (!portfolio_check(control_params, prev_objective, round_number, lagging_checks)) {
+				delete[] trial_prices;
+				delete[] supplies_workspace;
+				delete[] demands_workspace;
+				delete[] supplies_search;
+				delete[] demands_search;
+
+				demand_oracle.deactivate_oracle();
+				return false;
+			}
+		}
+
 	}
 }
 
 
+bool
+TatonnementOracle::convex_solver_query(
+	ConvexPriceSolver& convex_solver,
+	Price* prices_workspace,
+	std::unique_ptr<LPInstance>& lp_instance) {
+
+	std::vector<Price> trial_prices;
+	trial_prices.resize(num_assets);
+
+	uint128_t* supplies_workspace = new uint128_t[num_assets];
+	uint128_t* demands_workspace = new uint128_t[num_assets];
+
+	auto& work_units = work_unit_manager.get_work_units();
+
+	convex_solver.reset(prices_workspace, active_approx_params.smooth_mult);
+
+	size_t iteration = 0;
+	bool progress = true;
+	bool clearing = false;
+
+	while (true) {
+		if (done_tatonnement_flag.load(std::memory_order_acquire)) {
+			TAT_INFO("convex solver ending, num iterations was %lu", iteration);
+			break;
+		}
+
+		convex_solver.get_prices(trial_prices.data());
+
+		//the same (exact) check as the grid search threads
+		clear_supply_demand_workspaces(supplies_workspace, demands_workspace);
+		for (auto& work_unit : work_units) {
+			work_unit.calculate_demands_and_supplies(trial_prices.data(), demands_workspace, supplies_workspace, active_approx_params.smooth_mult);
+		}
+		clearing = check_clearing(demands_workspace, supplies_workspace, active_approx_params.tax_rate, num_assets);
+
+		if (!clearing && ((!progress) || (iteration % CONVEX_LP_CHECK_FREQ == CONVEX_LP_CHECK_FREQ - 1))) {
+			clearing = solver.check_feasibility(trial_prices.data(), lp_instance, active_approx_params);
+		}
+
+		if (clearing || (!progress) || iteration >= MAX_CONVEX_ITERATIONS) {
+			break;
+		}
+
+		progress = convex_solver.step(active_approx_params.smooth_mult);
+		iteration++;
+	}
+
+	delete[] supplies_workspace;
+	delete[] demands_workspace;
+
+	if (!clearing) {
+		//stalled or lost the race; the grid search threads will still finish.
+		TAT_INFO("convex solver stopped without clearing after %lu iterations, relative residual %lf", iteration, convex_solver.get_relative_residual());
+		return false;
+	}
+
+	auto not_first_clear = done_tatonnement_flag.exchange(true, std::memory_order_acq_rel);
+
+	if (!not_first_clear) {
+		TAT_INFO("CLEARING (convex solver) after %lu iterations, relative residual %lf", iteration, convex_solver.get_relative_residual());
+		for (size_t i = 0; i < num_assets; i++) {
+			prices_workspace[i] = trial_prices[i];
+		}
+		internal_measurements.num_rounds = iteration;
+		internal_measurements.step_radix = 0;
+		internal_measurements.convex_solver_won = 1;
+	}
+	return !not_first_clear;
+}
+
 } /* namespace edce */
@@ -6,9 +6,12 @@
 #include "utils.h"
 #include "lp_solver.h"
 #include "approximation_parameters.h"
+#include "convex_price_solver.h"
+#include "tatonnement_portfolio.h"
 
 #include <cstdint>
 
+#include <algorithm>
 #include <atomic>
 #include <mutex>
 #include <condition_variable>
@@ -24,29 +27,44 @@ typedef unsigned __int128 uint128_t;
 struct TatonnementControlParameters {
 
 	constexpr static size_t NUM_DEMAND_WORKERS = 5;
+	//the leading strategy can take over the workers of pruned strategies, up to this many
+	constexpr static size_t MAX_DEMAND_WORKERS = 2 * NUM_DEMAND_WORKERS;
 
+	//position in the TatonnementPortfolio
+	uint32_t strategy_idx = 0;
 	uint8_t step_radix = 55; // 50 //33
 	uint64_t min_step = ((uint64_t)1)<<7;
 	uint8_t step_adjust_radix = 5;
 	uint8_t diff_reduction = 0;
+	//step size multipliers after an accepted/rejected round
+	double step_up_factor = 1.4;
+	double step_down_factor = 0.8;
+	//if nonzero, each starting price is moved up or down by price >> start_perturbation_radix
+	uint8_t start_perturbation_radix = 0;
 	bool use_in_case_of_timeout = false;
 	bool use_volume_relativizer = false;
-	std::optional<ParallelDemandOracle<NUM_DEMAND_WORKERS>> oracle;
+	//demand workers used while not leading; the oracle's num_demand_workers at the start of the current query
+	size_t base_demand_workers = NUM_DEMAND_WORKERS;
+	std::optional<ParallelDemandOracle<MAX_DEMAND_WORKERS>> oracle;
 
 	TatonnementControlParameters() : oracle(std::nullopt) {}
 
 	TatonnementControlParameters(size_t num_assets, size_t num_work_units)
-		: oracle(std::make_optional<ParallelDemandOracle<NUM_DEMAND_WORKERS>>(num_work_units, num_assets)) {}
+		: oracle(std::make_optional<ParallelDemandOracle<MAX_DEMAND_WORKERS>>(num_work_units, num_assets, NUM_DEMAND_WORKERS)) {}
 };
 
 struct MultifuncTatonnementObjective {
 	double l2norm_sq = 0;
 	double l8norm = 0;
+	//l2 norm over the total value supplied, comparable across price scales
+	double relative_l2norm = 0;
 
 	void eval(const uint128_t* supplies, const uint128_t* demands, const Price* prices, size_t num_assets) {
 		double acc_l2 = 0;
 		double acc_l8 = 0;
+		double acc_volume = 0;
 		for (size_t i = 0; i < num_assets; i++) {
+			acc_volume += PriceUtils::amount_to_double(supplies[i], PriceUtils::PRICE_RADIX) * PriceUtils::to_double(prices[i]);
 			double diff = PriceUtils::amount_to_double(supplies[i], PriceUtils::PRICE_RADIX) - PriceUtils::amount_to_double(demands[i], PriceUtils::PRICE_RADIX);//(double) supplies[i] - (double) demands[i];
 			diff *= PriceUtils::to_double(prices[i]);
 			double diff_sq = diff * diff;
@@ -55,6 +73,7 @@ struct MultifuncTatonnementObjective {
 		}
 		l2norm_sq = acc_l2;
 		l8norm = std::pow(acc_l8, 1.0/8.0);
+		relative_l2norm = (acc_volume > 0) ? std::sqrt(acc_l2) / acc_volume : std::sqrt(acc_l2);
 	}
 
 	bool is_better_than(const MultifuncTatonnementObjective& reference_objective) {
@@ -68,6 +87,11 @@ class TatonnementOracle {
 	LPSolver& solver;
 	size_t num_assets;
 	int num_worker_threads;
+	//also race a ConvexPriceSolver thread against the grid search threads
+	bool race_convex_solver;
+	//run only the first grid search strategy (and no convex solver), so that the computed
+	//prices do not depend on which thread wins a race (unless there is a timeout)
+	bool single_strategy;
 	ApproximationParameters active_approx_params;
 	//uint8_t tax_rate;
 	//uint8_t smooth_mult;
@@ -92,10 +116,22 @@ class TatonnementOracle {
 
 	TatonnementMeasurements internal_measurements;
 
+	TatonnementPortfolio portfolio;
+	uint32_t num_strategies = 0;
+
+	//demand oracle workers per strategy, at most TatonnementControlParameters::MAX_DEMAND_WORKERS
+	std::atomic<uint32_t> num_demand_workers = TatonnementControlParameters::NUM_DEMAND_WORKERS;
+
 	constexpr static size_t LP_CHECK_FREQ = 1000;
 
 	static_assert(LP_CHECK_FREQ >= 2, "too small, can't check lp on round 0 (trial_prices unset)");
 
+	constexpr static size_t PORTFOLIO_CHECK_FREQ = 1000;
+
+	//Newton steps are much more expensive than tatonnement rounds, so check the lp more often.
+	constexpr static size_t CONVEX_LP_CHECK_FREQ = 20;
+	constexpr static size_t MAX_CONVEX_ITERATIONS = 5000;
+
 	long double get_objective(
 		const uint128_t* supplies,
 		const uint128_t* demands,
@@ -128,10 +164,27 @@ class TatonnementOracle {
 		const uint8_t smooth_mult,
 		ObjectiveFunctionInputs& inputs);
 
+	void perturb_starting_prices(
+		Price* prices_workspace,
+		const TatonnementControlParameters& control_params);
+
+	//Publishes the strategy's objective and moves demand oracle workers to the leader.
+	//Returns false if the strategy has been pruned.
+	bool portfolio_check(
+		TatonnementControlParameters& control_params,
+		const MultifuncTatonnementObjective& objective,
+		uint64_t round_number,
+		unsigned int& lagging_checks);
+
 	void start_tatonnement_threads();
 	void end_tatonnement_threads();
 
+	//query(prices) runs one price computation in place, returning true iff it was the first to find an equilibrium
+	template<typename QueryFn>
+	void run_worker_thread(QueryFn&& query, const bool use_in_case_of_timeout);
+
 	void run_tatonnement_thread(TatonnementControlParameters* control_params); //owns the input control_params
+	void run_convex_solver_thread();
 
 	void start_tatonnement_query();
 	void finish_tatonnement_query();
@@ -142,6 +195,12 @@ class TatonnementOracle {
 		Price* prices_workspace, 
 		std::unique_ptr<LPInstance>& lp_instance);
 
+	//return true if this thread is the first to find successful equilibrium
+	bool convex_solver_query(
+		ConvexPriceSolver& convex_solver,
+		Price* prices_workspace,
+		std::unique_ptr<LPInstance>& lp_instance);
+
 	//void update_approximation_parameters() {
 	//	smooth_mult = work_unit_manager.get_smooth_mult();
 	//	tax_rate = work_unit_manager.get_tax_rate();
@@ -151,11 +210,15 @@ public:
 	TatonnementOracle(
 		MerkleWorkUnitManager& work_unit_manager,
 		LPSolver& solver,
-		int num_worker_threads)
+		int num_worker_threads,
+		bool race_convex_solver = true,
+		bool single_strategy = false)
 	: work_unit_manager(work_unit_manager)
 	, solver(solver)
 	, num_assets(work_unit_manager.get_num_assets())
 	, num_worker_threads(num_worker_threads)
+	, race_convex_solver(race_convex_solver && !single_strategy)
+	, single_strategy(single_strategy)
 	//, tax_rate(work_unit_manager.get_tax_rate())
 	//, smooth_mult(work_unit_manager.get_smooth_mult())
 	{
@@ -183,5 +246,15 @@ public:
 	TatonnementMeasurements
 	compute_prices(Price* prices_workspace, const ApproximationParameters approx_params);
 
+	//takes effect at the start of the next query
+	void set_num_demand_workers(uint32_t num_workers) {
+		num_workers = std::clamp<uint32_t>(num_workers, 1, TatonnementControlParameters::MAX_DEMAND_WORKERS);
+		num_demand_workers.store(num_workers, std::memory_order_relaxed);
+	}
+
+	uint32_t get_num_demand_workers() const {
+		return num_demand_workers.load(std::memory_order_relaxed);
+	}
+
 };
 }
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+namespace edce {
+
+/*
+Shared state of the Tatonnement strategies racing in one price computation.
+
+Every few rounds, each strategy publishes its objective (relative to the volume traded,
+so strategies at different price scales are comparable).  The best objective and the
+strategy that reported it are kept in atomics, so the Tatonnement threads never take a lock.
+
+A strategy whose objective is more than PRUNE_RATIO times the best for PRUNE_PATIENCE
+consecutive checks stops, and its cores (its demand oracle workers and its own thread)
+go into a spare pool.  The leading strategy draws extra demand oracle workers from that pool.
+
+Objectives are nonnegative doubles, and the bit patterns of nonnegative doubles order
+the same way as their values, so the best is tracked with an integer CAS.
+*/
+class TatonnementPortfolio {
+
+public:
+	constexpr static double PRUNE_RATIO = 4.0;
+	constexpr static unsigned int PRUNE_PATIENCE = 3;
+	//a strategy runs at least this many rounds before it can be pruned
+	constexpr static uint64_t PRUNE_MIN_ROUNDS = 5000;
+
+	constexpr static uint32_t NO_LEADER = UINT32_MAX;
+
+private:
+
+	std::atomic<uint64_t> best_objective_bits;
+	std::atomic<uint32_t> leader;
+	std::atomic<uint32_t> num_running;
+	std::atomic<uint32_t> spare_workers;
+	std::atomic<uint32_t> num_pruned;
+
+	static uint64_t to_bits(double objective) {
+		uint64_t out;
+		std::memcpy(&out, &objective, sizeof(out));
+		return out;
+	}
+
+	static double from_bits(uint64_t bits) {
+		double out;
+		std::memcpy(&out, &bits, sizeof(out));
+		return out;
+	}
+
+public:
+
+	TatonnementPortfolio() {
+		reset(0);
+	}
+
+	//Called before any strategy starts on a query.
+	void reset(uint32_t num_strategies) {
+		best_objective_bits.store(to_bits(std::numeric_limits<double>::infinity()), std::memory_order_relaxed);
+		leader.store(NO_LEADER, std::memory_order_relaxed);
+		num_running.store(num_strategies, std::memory_order_relaxed);
+		spare_workers.store(0, std::memory_order_relaxed);
+		num_pruned.store(0, std::memory_order_relaxed);
+	}
+
+	//Returns true iff the strategy is (now) the leader.
+	bool publish(uint32_t strategy, double objective) {
+		if (!(objective >= 0)) {
+			//nan
+			return false;
+		}
+		uint64_t bits = to_bits(objective);
+		uint64_t current = best_objective_bits.load(std::memory_order_relaxed);
+		while (bits < current) {
+			if (best_objective_bits.compare_exchange_weak(current, bits, std::memory_order_relaxed)) {
+				leader.store(strategy, std::memory_order_relaxed);
+				return true;
+			}
+		}
+		return leader.load(std::memory_order_relaxed) == strategy;
+	}
+
+	double get_best_objective() const {
+		return from_bits(best_objective_bits.load(std::memory_order_relaxed));
+	}
+
+	bool lags(double objective) const {
+		return objective > PRUNE_RATIO * get_best_objective();
+	}
+
+	//Takes a strategy out of the race, unless it's the last one still running.
+	bool try_prune(uint32_t num_released_cores) {
+		uint32_t running = num_running.load(std::memory_order_relaxed);
+		while (running > 1) {
+			if (num_running.compare_exchange_weak(running, running - 1, std::memory_order_relaxed)) {
+				spare_workers.fetch_add(num_released_cores, std::memory_order_relaxed);
+				num_pruned.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void release_workers(uint32_t num_workers) {
+		spare_workers.fetch_add(num_workers, std::memory_order_relaxed);
+	}
+
+	uint32_t claim_workers(uint32_t max_claim) {
+		uint32_t spare = spare_workers.load(std::memory_order_relaxed);
+		while (spare > 0 && max_claim > 0) {
+			uint32_t claim = std::min(spare, max_claim);
+			if (spare_workers.compare_exchange_weak(spare, spare - claim, std::memory_order_relaxed)) {
+				return claim;
+			}
+		}
+		return 0;
+	}
+
+	uint32_t get_num_pruned() const {
+		return num_pruned.load(std::memory_order_relaxed);
+	}
+};
+
+} /* edce */
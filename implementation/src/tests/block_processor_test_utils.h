@@ -40,5 +40,17 @@ struct BlockProcessorTestUtils {
 		metadata.sequenceNumber = tx_number<<8;
 		return metadata;
 	}
+
+	static SignedTransaction make_payment_tx(AccountID source, uint64_t tx_number, AccountID receiver, AssetID asset = 0, int64_t amount = 10) {
+		SignedTransaction tx;
+		tx.transaction.metadata = make_metadata(source, tx_number);
+		Operation op;
+		op.body.type(PAYMENT);
+		op.body.paymentOp().receiver = receiver;
+		op.body.paymentOp().asset = asset;
+		op.body.paymentOp().amount = amount;
+		tx.transaction.operations.push_back(op);
+		return tx;
+	}
 }; 
 }
\ No newline at end of file
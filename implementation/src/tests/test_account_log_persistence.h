@@ -0,0 +1,127 @@
+#include <cxxtest/TestSuite.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include <fcntl.h>
+
+#include "account_modification_log.h"
+#include "file_prealloc_worker.h"
+#include "io_uring_file_writer.h"
+#include "simple_debug.h"
+#include "utils.h"
+
+#include "xdr/database_commitments.h"
+
+#include <xdrpp/marshal.h>
+
+using namespace edce;
+
+class AccountLogPersistenceTestSuite : public CxxTest::TestSuite {
+
+	const std::string async_filename = "test_account_log_persistence_async.block";
+	const std::string in_place_filename = "test_account_log_persistence_in_place.block";
+
+	//far past any block an experiment in the same directory would write
+	constexpr static uint64_t TEST_BLOCK_NUMBER = 999'999'999;
+
+	using ValueT = XdrTypeWrapper<AccountModificationTxList>;
+
+	static void fill_trie(AccountTrie<ValueT>& trie, uint64_t num_accounts) {
+		auto serial_trie = trie.open_serial_subsidiary();
+		for (uint64_t i = 0; i < num_accounts; i++) {
+			AccountModificationTxList value;
+			value.owner = 7 * i;
+			for (uint64_t j = 0; j < i % 9; j++) {
+				value.identifiers_self.push_back(j);
+			}
+			serial_trie.insert(7 * i, ValueT(value));
+		}
+		trie.merge_in(serial_trie);
+	}
+
+	static AccountModificationBlock load_block(const std::string& filename) {
+		AccountModificationBlock out;
+		if (load_xdr_from_file(out, filename.c_str())) {
+			throw std::runtime_error("failed to load " + filename);
+		}
+		return out;
+	}
+
+public:
+
+	void tearDown() {
+		std::remove(async_filename.c_str());
+		std::remove(in_place_filename.c_str());
+		std::remove(tx_block_name(TEST_BLOCK_NUMBER).c_str());
+	}
+
+	void test_in_place_write_matches_write_async() {
+		TEST_START();
+
+		AccountTrie<ValueT> trie;
+		//several chunks, more than there are buffers
+		fill_trie(trie, 5000);
+
+		auto block = trie.template accumulate_values_parallel<AccountModificationBlock>();
+
+		IoUringFileWriter writer(4 * 4096, 2);
+
+		writer.write_async(block, preallocate_file(async_filename.c_str()));
+
+		trie.template serialize_values_parallel<AccountModificationTxList>(
+			[&] (size_t list_bytes) {
+				return writer.begin_in_place(preallocate_file(in_place_filename.c_str()), block.size(), list_bytes);
+			});
+		writer.submit_in_place();
+		writer.wait();
+
+		auto expect = xdr::xdr_to_opaque(block);
+		TS_ASSERT(xdr::xdr_to_opaque(load_block(async_filename)) == expect);
+		TS_ASSERT(xdr::xdr_to_opaque(load_block(in_place_filename)) == expect);
+	}
+
+	void test_in_place_write_empty() {
+		TEST_START();
+
+		AccountTrie<ValueT> trie;
+
+		IoUringFileWriter writer(4 * 4096, 2);
+
+		trie.template serialize_values_parallel<AccountModificationTxList>(
+			[&] (size_t list_bytes) {
+				TS_ASSERT_EQUALS(list_bytes, 0);
+				return writer.begin_in_place(preallocate_file(in_place_filename.c_str()), 0, list_bytes);
+			});
+		writer.submit_in_place();
+		writer.wait();
+
+		TS_ASSERT_EQUALS(load_block(in_place_filename).size(), 0);
+	}
+
+	void test_persist_block_streaming() {
+		TEST_START();
+
+		AccountModificationLog log;
+		{
+			SerialAccountModificationLog serial_log(log);
+			for (AccountID i = 0; i < 3000; i++) {
+				for (uint64_t j = 0; j < i % 5 + 1; j++) {
+					serial_log.log_self_modification(3 * i, j);
+				}
+			}
+		}
+		log.merge_in_log_batch();
+
+		auto expect = log.parallel_accumulate_values<AccountModificationBlock>();
+
+		log.prepare_block_fd(TEST_BLOCK_NUMBER);
+		//nobody wants the block back, so it is serialized straight from the log
+		auto out = log.persist_block(TEST_BLOCK_NUMBER, false);
+		TS_ASSERT(!out);
+		log.wait_for_persisted_block();
+
+		TS_ASSERT(xdr::xdr_to_opaque(load_block(tx_block_name(TEST_BLOCK_NUMBER))) == xdr::xdr_to_opaque(expect));
+	}
+};
@@ -5,7 +5,9 @@
 #include <cstring>
 
 #include "account_merkle_trie.h"
+#include "merkle_trie_utils.h"
 
+#include "xdr/database_commitments.h"
 #include "xdr/transaction.h"
 
 #include "simple_debug.h"
@@ -259,4 +261,35 @@ public:
 		check_equality(trie, expect);
 	}
 
+	void test_serialize_values_parallel() {
+		TEST_START();
+		using ValueT = XdrTypeWrapper<AccountModificationTxList>;
+
+		AccountTrie<ValueT> trie;
+		auto serial_trie = trie.open_serial_subsidiary();
+
+		for (uint64_t i = 0; i < 10000; i += 3) {
+			AccountModificationTxList value;
+			value.owner = i;
+			for (uint64_t j = 0; j < i % 5; j++) {
+				value.identifiers_self.push_back(j);
+			}
+			serial_trie.insert(i, ValueT(value));
+		}
+		trie.merge_in(serial_trie);
+
+		auto expect = xdr::xdr_to_opaque(trie.template accumulate_values_parallel<AccountModificationBlock>());
+
+		//everything but the length prefix
+		std::vector<unsigned char> serialized(expect.begin(), expect.begin() + 4);
+		trie.template serialize_values_parallel<AccountModificationTxList>(
+			[&serialized] (size_t list_bytes) {
+				serialized.resize(4 + list_bytes);
+				return serialized.data() + 4;
+			});
+
+		TS_ASSERT_EQUALS(expect.size(), serialized.size());
+		TS_ASSERT(std::vector<unsigned char>(expect.begin(), expect.end()) == serialized);
+	}
+
 };
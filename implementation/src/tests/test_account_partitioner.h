@@ -0,0 +1,121 @@
+#include <cxxtest/TestSuite.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+#include "account_partitioner.h"
+#include "memory_database.h"
+#include "simple_debug.h"
+
+using namespace edce;
+
+class AccountPartitionerTestSuite : public CxxTest::TestSuite {
+
+	//each unit is a payment (source, receiver)
+	struct PaymentList {
+		std::vector<std::pair<AccountID, AccountID>> payments;
+
+		template<typename F>
+		void for_each_written_account(size_t i, F&& func) const {
+			func(payments[i].first);
+			func(payments[i].second);
+		}
+
+		size_t size() const {
+			return payments.size();
+		}
+	};
+
+public:
+	void test_components() {
+		TEST_START();
+
+		MemoryDatabase db;
+		for (AccountID i = 1; i <= 6; i++) {
+			db.add_account_to_db(i);
+		}
+		db.commit(0);
+
+		PaymentList txs;
+		txs.payments = {{1, 2}, {3, 4}, {2, 5}, {6, 6}, {7, 1}};
+
+		AccountPartitioner partitioner(db);
+		AccountPartitionedBlock out;
+		partitioner.partition(txs, 100, out);
+
+		TS_ASSERT_EQUALS(3, out.num_components);
+		TS_ASSERT_EQUALS(2, out.largest_component);
+		//account 7 is not in the committed db
+		TS_ASSERT_EQUALS(1, out.num_residue_units);
+
+		std::vector<uint32_t> expected_units = {0, 2, 1, 3, 4};
+		TS_ASSERT_EQUALS(expected_units, out.units);
+
+		std::vector<size_t> expected_starts = {0, 2, 3, 4, 5};
+		TS_ASSERT_EQUALS(expected_starts, out.partition_starts);
+	}
+
+	void test_components_not_split() {
+		TEST_START();
+
+		MemoryDatabase db;
+		for (AccountID i = 1; i <= 6; i++) {
+			db.add_account_to_db(i);
+		}
+		db.commit(0);
+
+		PaymentList txs;
+		txs.payments = {{1, 2}, {3, 4}, {2, 5}, {6, 6}, {5, 1}, {4, 3}};
+
+		AccountPartitioner partitioner(db);
+		AccountPartitionedBlock out;
+		partitioner.partition(txs, 2, out);
+
+		TS_ASSERT_EQUALS(2, out.num_partitions());
+
+		std::vector<uint32_t> expected_units = {0, 2, 4, 1, 5, 3};
+		TS_ASSERT_EQUALS(expected_units, out.units);
+
+		std::vector<size_t> expected_starts = {0, 3, 6};
+		TS_ASSERT_EQUALS(expected_starts, out.partition_starts);
+	}
+
+	void test_reuse_across_blocks() {
+		TEST_START();
+
+		MemoryDatabase db;
+		for (AccountID i = 1; i <= 6; i++) {
+			db.add_account_to_db(i);
+		}
+		db.commit(0);
+
+		AccountPartitioner partitioner(db);
+		AccountPartitionedBlock out;
+
+		PaymentList txs;
+		txs.payments = {{1, 2}, {3, 4}, {5, 6}};
+		partitioner.partition(txs, 100, out);
+		TS_ASSERT_EQUALS(3, out.num_components);
+
+		//none of the previous block's unions carry over
+		txs.payments = {{2, 3}, {4, 5}, {6, 1}};
+		partitioner.partition(txs, 100, out);
+		TS_ASSERT_EQUALS(3, out.num_components);
+		TS_ASSERT_EQUALS(1, out.largest_component);
+
+		//accounts added since the last block are covered
+		db.add_account_to_db(7);
+		db.commit(0);
+
+		txs.payments = {{7, 1}, {2, 3}, {1, 6}};
+		partitioner.partition(txs, 100, out);
+		TS_ASSERT_EQUALS(2, out.num_components);
+		TS_ASSERT_EQUALS(2, out.largest_component);
+		TS_ASSERT_EQUALS(0, out.num_residue_units);
+
+		std::vector<uint32_t> expected_units = {0, 2, 1};
+		TS_ASSERT_EQUALS(expected_units, out.units);
+	}
+};
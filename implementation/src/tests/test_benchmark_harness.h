@@ -0,0 +1,125 @@
+#include <cxxtest/TestSuite.h>
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "benchmark_harness.h"
+#include "simple_debug.h"
+
+using namespace edce;
+
+class BenchmarkHarnessTestSuite : public CxxTest::TestSuite {
+
+	const std::string filename = "test_benchmark_harness.json";
+
+	struct CountingBenchmark : public BenchmarkCase {
+		int& setup_count;
+		int& run_count;
+
+		CountingBenchmark(int& setup_count, int& run_count)
+			: setup_count(setup_count)
+			, run_count(run_count) {}
+
+		void setup() override {
+			setup_count++;
+		}
+
+		void run(BenchmarkTimer& timer) override {
+			run_count++;
+			//only the (empty) timed section counts
+			volatile uint64_t sum = 0;
+			for (uint64_t i = 0; i < 1'000'000; i++) {
+				sum = sum + i;
+			}
+			timer.start();
+			timer.stop();
+		}
+	};
+
+	static BenchmarkResult make_result(const std::string& name, std::vector<double> samples) {
+		BenchmarkResult result;
+		result.name = name;
+		result.samples = samples;
+		return result;
+	}
+
+public:
+
+	void tearDown() {
+		std::remove(filename.c_str());
+	}
+
+	void test_percentiles() {
+		TEST_START();
+
+		auto result = make_result("case", {5, 1, 4, 2, 3, 9, 8, 7, 6, 10});
+
+		TS_ASSERT_EQUALS(result.min(), 1);
+		TS_ASSERT_EQUALS(result.max(), 10);
+		TS_ASSERT_EQUALS(result.percentile(0.5), 6);
+		TS_ASSERT_EQUALS(result.percentile(0.9), 10);
+		TS_ASSERT_DELTA(result.mean(), 5.5, 1e-9);
+
+		TS_ASSERT_EQUALS(make_result("empty", {}).percentile(0.5), 0);
+	}
+
+	void test_registry() {
+		TEST_START();
+
+		int setup_count = 0, run_count = 0;
+
+		BenchmarkRegistry registry;
+		auto factory = [&] () {return std::make_unique<CountingBenchmark>(setup_count, run_count);};
+		registry.add("trie_insert", "", factory);
+		registry.add("trie_merge", "", factory);
+		registry.add("demand_query", "", factory);
+
+		TS_ASSERT_THROWS_ANYTHING(registry.add("trie_insert", "", factory));
+		TS_ASSERT_THROWS_ANYTHING(registry.add("Bad Name", "", factory));
+		TS_ASSERT_THROWS_ANYTHING(registry.add("a/b", "", factory));
+
+		TS_ASSERT_EQUALS(registry.select("trie").size(), 2);
+		TS_ASSERT_EQUALS(registry.select("all").size(), 3);
+		TS_ASSERT_EQUALS(registry.select("signature").size(), 0);
+
+		auto result = registry.run("trie_merge", 2, 5);
+		TS_ASSERT_EQUALS(setup_count, 1);
+		TS_ASSERT_EQUALS(run_count, 7);
+		TS_ASSERT_EQUALS(result.samples.size(), 5);
+		//the untimed loop is excluded
+		TS_ASSERT_LESS_THAN(result.max(), 1e-3);
+
+		TS_ASSERT_THROWS_ANYTHING(registry.run("missing", 0, 1));
+	}
+
+	void test_compare() {
+		TEST_START();
+
+		std::vector<BenchmarkResult> baseline;
+		baseline.push_back(make_result("fast_case", {1.0, 1.0, 1.0}));
+		baseline.push_back(make_result("slow_case", {2.0, 2.0, 2.0}));
+		TS_ASSERT(write_benchmark_json(baseline, filename));
+
+		TS_ASSERT_DELTA(*load_baseline_p50(filename, "slow_case"), 2.0, 1e-9);
+		TS_ASSERT(!load_baseline_p50(filename, "new_case"));
+
+		std::vector<BenchmarkResult> current;
+		current.push_back(make_result("fast_case", {1.05, 1.05, 1.05}));
+		current.push_back(make_result("slow_case", {2.5, 2.5, 2.5}));
+		current.push_back(make_result("new_case", {100, 100, 100}));
+
+		std::vector<BenchmarkComparison> comparisons;
+		TS_ASSERT_EQUALS(compare_benchmarks(current, filename, 0.1, comparisons), 1);
+
+		TS_ASSERT_EQUALS(comparisons.size(), 3);
+		TS_ASSERT(!comparisons[0].is_regression(0.1));
+		TS_ASSERT(comparisons[1].is_regression(0.1));
+		TS_ASSERT_DELTA(comparisons[1].ratio(), 1.25, 1e-9);
+		TS_ASSERT(!comparisons[2].baseline_p50);
+
+		comparisons.clear();
+		TS_ASSERT_EQUALS(compare_benchmarks(current, filename, 0.3, comparisons), 0);
+	}
+};
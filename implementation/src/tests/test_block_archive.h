@@ -0,0 +1,83 @@
+#include <cxxtest/TestSuite.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "block_archive.h"
+#include "simple_debug.h"
+
+#include "xdr/database_commitments.h"
+
+#include <xdrpp/marshal.h>
+
+using namespace edce;
+
+class BlockArchiveTestSuite : public CxxTest::TestSuite {
+
+	const std::string filename = "test_block_archive.archive";
+
+	static AccountModificationBlock make_block(uint64_t block_number, size_t num_accounts) {
+		AccountModificationBlock block;
+		for (uint64_t i = 0; i < num_accounts; i++) {
+			AccountModificationTxList entry;
+			entry.owner = 3 * i + 1;
+			for (uint64_t j = 0; j < (i + block_number) % 4; j++) {
+				entry.identifiers_self.push_back(block_number * 100 + j);
+			}
+			block.push_back(entry);
+		}
+		return block;
+	}
+
+public:
+
+	void tearDown() {
+		std::remove(filename.c_str());
+	}
+
+	void test_round_trip() {
+		TEST_START();
+
+		std::vector<AccountModificationBlock> blocks;
+		blocks.push_back(make_block(10, 100));
+		//empty blocks have no frames
+		blocks.push_back(make_block(11, 0));
+		blocks.push_back(make_block(12, 37));
+
+		BlockArchiveWriter writer(16);
+		writer.write_segment(filename, 10, blocks);
+
+		BlockArchiveReader reader(filename);
+		TS_ASSERT_EQUALS(10, reader.get_first_block());
+		TS_ASSERT_EQUALS(3, reader.get_num_blocks());
+		TS_ASSERT(!reader.contains(9));
+		TS_ASSERT(!reader.contains(13));
+
+		for (size_t i = 0; i < blocks.size(); i++) {
+			AccountModificationBlock loaded;
+			reader.load_block(10 + i, loaded);
+			TS_ASSERT(xdr::xdr_to_opaque(loaded) == xdr::xdr_to_opaque(blocks[i]));
+		}
+	}
+
+	void test_find_account() {
+		TEST_START();
+
+		std::vector<AccountModificationBlock> blocks;
+		blocks.push_back(make_block(1, 100));
+
+		BlockArchiveWriter writer(16);
+		writer.write_segment(filename, 1, blocks);
+
+		BlockArchiveReader reader(filename);
+
+		auto found = reader.find_account(1, 3 * 50 + 1);
+		TS_ASSERT(found.has_value());
+		TS_ASSERT(xdr::xdr_to_opaque(*found) == xdr::xdr_to_opaque(blocks[0][50]));
+
+		TS_ASSERT(!reader.find_account(1, 3 * 50).has_value());
+		TS_ASSERT(!reader.find_account(1, 1000).has_value());
+	}
+};
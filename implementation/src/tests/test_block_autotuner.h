@@ -0,0 +1,193 @@
+#include <cxxtest/TestSuite.h>
+
+#include "block_autotuner.h"
+#include "simple_debug.h"
+
+using namespace edce;
+
+class BlockAutotunerTestSuite : public CxxTest::TestSuite {
+
+	EdceOptions make_options() {
+		EdceOptions options;
+		options.target_block_size = 100'000;
+		options.mempool_chunk_size = 10'000;
+		options.persist_batch = 5;
+		options.num_demand_workers = 4;
+		options.autotune = true;
+		options.autotune_target_latency = 1.0;
+		options.autotune_window_blocks = 10;
+		return options;
+	}
+
+	BlockPhaseTimings make_timings(double total_time, size_t num_txs, double tatonnement_time = 0, double persist_wait_time = 0) {
+		BlockPhaseTimings timings;
+		timings.total_time = total_time;
+		timings.num_txs = num_txs;
+		timings.tatonnement_time = tatonnement_time;
+		timings.persist_wait_time = persist_wait_time;
+		return timings;
+	}
+
+	//returns the last record_block result
+	bool run_window(BlockAutotuner& autotuner, const BlockPhaseTimings& timings) {
+		bool changed = false;
+		for (size_t i = 0; i < 10; i++) {
+			changed = autotuner.record_block(timings);
+			if (i + 1 < 10) {
+				TS_ASSERT(!changed);
+			}
+		}
+		return changed;
+	}
+
+public:
+
+	void test_block_size_tracks_latency() {
+		TEST_START();
+
+		auto options = make_options();
+		BlockAutotuner autotuner(options, 1'000'000, 10);
+
+		//full blocks, well under the target
+		TS_ASSERT(run_window(autotuner, make_timings(0.5, 100'000)));
+		TS_ASSERT_EQUALS(autotuner.get_parameters().target_block_size, 110'000);
+		//a full block still spans 10 chunks
+		TS_ASSERT_EQUALS(autotuner.get_parameters().mempool_chunk_size, 11'000);
+
+		//blocks not full: growing would not help
+		run_window(autotuner, make_timings(0.5, 50'000));
+		TS_ASSERT_EQUALS(autotuner.get_parameters().target_block_size, 110'000);
+
+		//over the target: cut proportionally
+		run_window(autotuner, make_timings(1.25, 110'000));
+		TS_ASSERT_EQUALS(autotuner.get_parameters().target_block_size, 88'000);
+
+		//cuts are at most by half
+		run_window(autotuner, make_timings(10.0, 88'000));
+		TS_ASSERT_EQUALS(autotuner.get_parameters().target_block_size, 44'000);
+		TS_ASSERT_EQUALS(autotuner.get_parameters().mempool_chunk_size, 4'400);
+
+		//between the growth headroom and the target, nothing changes
+		TS_ASSERT(!run_window(autotuner, make_timings(0.9, 44'000)));
+	}
+
+	void test_block_size_bounds() {
+		TEST_START();
+
+		auto options = make_options();
+		BlockAutotuner autotuner(options, 105'000, 10);
+
+		run_window(autotuner, make_timings(0.1, 100'000));
+		TS_ASSERT_EQUALS(autotuner.get_parameters().target_block_size, 105'000);
+
+		for (size_t i = 0; i < 20; i++) {
+			run_window(autotuner, make_timings(100.0, 100'000));
+		}
+		TS_ASSERT_EQUALS(autotuner.get_parameters().target_block_size, BlockAutotuner::MIN_BLOCK_SIZE);
+	}
+
+	void test_floor_above_exhausted_mempool() {
+		TEST_START();
+
+		auto options = make_options();
+		BlockAutotuner autotuner(options, 1'000'000, 10);
+
+		for (size_t i = 0; i < 20; i++) {
+			run_window(autotuner, make_timings(100.0, 100'000));
+		}
+		size_t floor = autotuner.get_parameters().target_block_size;
+		TS_ASSERT_EQUALS(floor, BlockAutotuner::MIN_BLOCK_SIZE);
+
+		//blocks that count as full at the floor must not read as a drained mempool,
+		//or the producer experiment stops as soon as the target bottoms out
+		TS_ASSERT(static_cast<size_t>(BlockAutotuner::FULL_BLOCK_FRACTION * floor) > BlockAutotuner::EXHAUSTED_MEMPOOL_BLOCK_SIZE);
+
+		//and the autotuner can climb back out
+		TS_ASSERT(run_window(autotuner, make_timings(0.1, floor)));
+		TS_ASSERT(autotuner.get_parameters().target_block_size > floor);
+	}
+
+	void test_demand_worker_hill_climb() {
+		TEST_START();
+
+		auto options = make_options();
+		BlockAutotuner autotuner(options, 1'000'000, 10);
+
+		//not full, under the target, so only the worker count moves
+		run_window(autotuner, make_timings(0.9, 1'000, 0.4));
+		TS_ASSERT_EQUALS(autotuner.get_parameters().num_demand_workers, 5);
+
+		//improved: keep it, and keep going
+		run_window(autotuner, make_timings(0.9, 1'000, 0.3));
+		TS_ASSERT_EQUALS(autotuner.get_parameters().num_demand_workers, 5);
+		run_window(autotuner, make_timings(0.9, 1'000, 0.3));
+		TS_ASSERT_EQUALS(autotuner.get_parameters().num_demand_workers, 6);
+
+		//no better: undo, then try the other direction
+		run_window(autotuner, make_timings(0.9, 1'000, 0.3));
+		TS_ASSERT_EQUALS(autotuner.get_parameters().num_demand_workers, 5);
+		run_window(autotuner, make_timings(0.9, 1'000, 0.3));
+		TS_ASSERT_EQUALS(autotuner.get_parameters().num_demand_workers, 4);
+
+		//no better either: undo, then hold
+		run_window(autotuner, make_timings(0.9, 1'000, 0.3));
+		TS_ASSERT_EQUALS(autotuner.get_parameters().num_demand_workers, 5);
+		for (unsigned int i = 0; i < BlockAutotuner::WORKER_HOLD_WINDOWS; i++) {
+			TS_ASSERT(!run_window(autotuner, make_timings(0.9, 1'000, 0.3)));
+		}
+		run_window(autotuner, make_timings(0.9, 1'000, 0.3));
+		TS_ASSERT_DIFFERS(autotuner.get_parameters().num_demand_workers, 5);
+	}
+
+	void test_one_knob_per_window() {
+		TEST_START();
+
+		auto options = make_options();
+		BlockAutotuner autotuner(options, 1'000'000, 10);
+
+		//full blocks well under the target: the block size grows, and the worker count waits
+		TS_ASSERT(run_window(autotuner, make_timings(0.5, 100'000, 0.4)));
+		TS_ASSERT_EQUALS(autotuner.get_parameters().target_block_size, 110'000);
+		TS_ASSERT_EQUALS(autotuner.get_parameters().num_demand_workers, 4);
+
+		//block size settled, so the worker count steps
+		run_window(autotuner, make_timings(0.5, 50'000, 0.4));
+		TS_ASSERT_EQUALS(autotuner.get_parameters().target_block_size, 110'000);
+		TS_ASSERT_EQUALS(autotuner.get_parameters().num_demand_workers, 5);
+
+		//the window after a step only judges it (kept), even though latency is over the target
+		run_window(autotuner, make_timings(1.25, 110'000, 0.3));
+		TS_ASSERT_EQUALS(autotuner.get_parameters().target_block_size, 110'000);
+		TS_ASSERT_EQUALS(autotuner.get_parameters().num_demand_workers, 5);
+
+		//then the block size is cut, and the worker count waits again
+		run_window(autotuner, make_timings(1.25, 110'000, 0.3));
+		TS_ASSERT_EQUALS(autotuner.get_parameters().target_block_size, 88'000);
+		TS_ASSERT_EQUALS(autotuner.get_parameters().num_demand_workers, 5);
+
+		//persist_batch also takes a window of its own
+		run_window(autotuner, make_timings(0.9, 1'000, 0.3, 0.1));
+		TS_ASSERT_EQUALS(autotuner.get_parameters().persist_batch, 10);
+		TS_ASSERT_EQUALS(autotuner.get_parameters().num_demand_workers, 5);
+	}
+
+	void test_persist_batch() {
+		TEST_START();
+
+		auto options = make_options();
+		BlockAutotuner autotuner(options, 1'000'000, 1);
+
+		run_window(autotuner, make_timings(0.9, 1'000, 0, 0.1));
+		TS_ASSERT_EQUALS(autotuner.get_parameters().persist_batch, 10);
+		for (size_t i = 0; i < 10; i++) {
+			run_window(autotuner, make_timings(0.9, 1'000, 0, 0.1));
+		}
+		TS_ASSERT_EQUALS(autotuner.get_parameters().persist_batch, BlockAutotuner::MAX_PERSIST_BATCH);
+
+		//never below the configured batch
+		for (size_t i = 0; i < 100; i++) {
+			run_window(autotuner, make_timings(0.9, 1'000));
+		}
+		TS_ASSERT_EQUALS(autotuner.get_parameters().persist_batch, 5);
+	}
+};
@@ -0,0 +1,141 @@
+#include <cxxtest/TestSuite.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "edce.h"
+#include "edce_management_structures.h"
+#include "price_utils.h"
+#include "simple_debug.h"
+#include "tx_type_utils.h"
+
+#include "xdr/block.h"
+#include "xdr/database_commitments.h"
+
+#include "tests/block_processor_test_utils.h"
+
+using namespace edce;
+
+//No lmdb is opened, so replay only touches the in-memory structures
+//(persisting just advances the persisted round numbers).
+class CatchupReplayTestSuite : public CxxTest::TestSuite {
+
+	constexpr static uint16_t NUM_ASSETS = 2;
+	constexpr static AccountID NUM_ACCOUNTS = 20;
+	constexpr static uint64_t NUM_ROUNDS = 7;
+
+	static void init_accounts(EdceManagementStructures& management_structures) {
+		auto& db = management_structures.db;
+		std::vector<account_db_idx> idxs;
+		for (AccountID i = 1; i <= NUM_ACCOUNTS; i++) {
+			idxs.push_back(db.add_account_to_db(i));
+		}
+		db.commit(0);
+		for (auto idx : idxs) {
+			db.transfer_available(idx, 0, 10000);
+			db.transfer_available(idx, 1, 10000);
+		}
+		db.commit(0);
+	}
+
+	//every account pays its neighbor, and even accounts also offer to sell asset 0
+	static AccountModificationBlock make_tx_block(uint64_t round) {
+		AccountModificationBlock block;
+		for (AccountID i = 1; i <= NUM_ACCOUNTS; i++) {
+			AccountModificationTxList entry;
+			entry.owner = i;
+
+			auto tx = BlockProcessorTestUtils::make_payment_tx(i, round, (i % NUM_ACCOUNTS) + 1, round % NUM_ASSETS, round);
+			if (i % 2 == 0) {
+				CreateSellOfferOp op;
+				op.category = TxTypeUtils::make_category(0, 1, OfferType::SELL);
+				op.amount = 10 * round;
+				op.minPrice = PriceUtils::from_double(0.5 + 0.01 * i);
+				tx.transaction.operations.push_back(TxTypeUtils::make_operation(op));
+			}
+			entry.new_transactions_self.push_back(tx);
+			block.push_back(entry);
+		}
+		return block;
+	}
+
+	//Zeroed clearing details clear every open offer at the round's prices.
+	static HashedBlock make_header(uint64_t round, size_t num_work_units) {
+		HashedBlock header;
+		header.block.blockNumber = round;
+		for (uint16_t i = 0; i < NUM_ASSETS; i++) {
+			header.block.prices.push_back(PriceUtils::from_double(1.0 + 0.1 * ((round + i) % 3)));
+		}
+		header.block.feeRate = 0;
+		header.block.internalHashes.clearingDetails.resize(num_work_units);
+		header.hash[0] = static_cast<unsigned char>(round);
+		return header;
+	}
+
+	struct StateHashes {
+		Hash db_hash;
+		WorkUnitStateCommitment clearing_details;
+		Hash header_map_hash;
+	};
+
+	static StateHashes hash_state(EdceManagementStructures& management_structures) {
+		StateHashes out;
+		management_structures.db.commit_values();
+		management_structures.db.produce_state_commitment(out.db_hash);
+		out.clearing_details.resize(management_structures.work_unit_manager.get_num_work_units());
+		management_structures.work_unit_manager.freeze_and_hash(out.clearing_details);
+		management_structures.block_header_hash_map.freeze_and_hash(out.header_map_hash);
+		return out;
+	}
+
+public:
+
+	void test_batched_matches_per_round() {
+		TEST_START();
+
+		EdceManagementStructures per_round(NUM_ASSETS, ApproximationParameters{1, 1});
+		EdceManagementStructures batched(NUM_ASSETS, ApproximationParameters{1, 1});
+		init_accounts(per_round);
+		init_accounts(batched);
+
+		auto num_work_units = per_round.work_unit_manager.get_num_work_units();
+
+		for (uint64_t round = 1; round <= NUM_ROUNDS; round++) {
+			edce_replay_trusted_round(per_round, round, make_tx_block(round), make_header(round, num_work_units));
+			per_round.account_modification_log.detached_clear();
+		}
+
+		uint64_t num_loads = 0;
+		auto block_source = [&num_loads, num_work_units] (uint64_t round, AccountModificationBlock& tx_block, HashedBlock& header) {
+			tx_block = make_tx_block(round);
+			header = make_header(round, num_work_units);
+			num_loads++;
+		};
+
+		//the last batch is partial
+		auto stats = edce_catchup_replay(batched, NUM_ROUNDS, 3, 0, block_source);
+
+		TS_ASSERT_EQUALS(NUM_ROUNDS, stats.num_blocks);
+		TS_ASSERT_EQUALS(3, stats.num_batches);
+		TS_ASSERT_EQUALS(NUM_ROUNDS, num_loads);
+		TS_ASSERT_EQUALS(NUM_ROUNDS, batched.db.get_persisted_round_number());
+
+		auto expect = hash_state(per_round);
+		auto actual = hash_state(batched);
+
+		TS_ASSERT(expect.db_hash == actual.db_hash);
+		TS_ASSERT(expect.header_map_hash == actual.header_map_hash);
+		TS_ASSERT_EQUALS(expect.clearing_details.size(), actual.clearing_details.size());
+		for (size_t i = 0; i < expect.clearing_details.size(); i++) {
+			TS_ASSERT(expect.clearing_details[i].rootHash == actual.clearing_details[i].rootHash);
+		}
+
+		//the replayed payments and trades moved balances away from the initial endowment
+		account_db_idx idx;
+		TS_ASSERT(batched.db.lookup_user_id(2, &idx));
+		TS_ASSERT_EQUALS(per_round.db.lookup_available_balance(idx, 0), batched.db.lookup_available_balance(idx, 0));
+		TS_ASSERT_EQUALS(per_round.db.lookup_available_balance(idx, 1), batched.db.lookup_available_balance(idx, 1));
+		TS_ASSERT(batched.db.lookup_available_balance(idx, 1) != 10000);
+	}
+};
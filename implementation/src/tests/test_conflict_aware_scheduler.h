@@ -0,0 +1,219 @@
+#include <cxxtest/TestSuite.h>
+
+#include <cstdint>
+#include <cstdio>
+
+#include "block_producer.h"
+#include "conflict_aware_scheduler.h"
+#include "edce_management_structures.h"
+#include "mempool.h"
+#include "simple_debug.h"
+
+#include "xdr/transaction.h"
+
+#include "tests/block_processor_test_utils.h"
+
+using namespace edce;
+
+class ConflictAwareSchedulerTestSuite : public CxxTest::TestSuite {
+
+	//account 1 pays 40 others, 40 others pay account 2, plus some unrelated traffic.
+	static void fill_mempool(Mempool& mempool) {
+		std::vector<SignedTransaction> chunk;
+		for (uint64_t i = 0; i < 40; i++) {
+			chunk.push_back(BlockProcessorTestUtils::make_payment_tx(1, i + 1, 100 + i));
+		}
+		mempool.add_to_mempool_buffer(std::move(chunk));
+
+		chunk.clear();
+		for (uint64_t i = 0; i < 40; i++) {
+			chunk.push_back(BlockProcessorTestUtils::make_payment_tx(200 + i, 1, 2));
+		}
+		mempool.add_to_mempool_buffer(std::move(chunk));
+
+		chunk.clear();
+		for (uint64_t i = 0; i < 10; i++) {
+			chunk.push_back(BlockProcessorTestUtils::make_payment_tx(300 + i, 1, 400 + i));
+		}
+		//touches both hot accounts
+		chunk.push_back(BlockProcessorTestUtils::make_payment_tx(1, 41, 2));
+		mempool.add_to_mempool_buffer(std::move(chunk));
+
+		mempool.push_mempool_buffer_to_mempool();
+	}
+
+	constexpr static AccountID HOT_ACCOUNT = 10001;
+	constexpr static uint64_t NUM_LANE_TEST_SOURCES = 400;
+
+	//Sources 1000.. each send one tx: the even ones pay the hot account, the odd ones pay the source before them.
+	static void fill_lane_test(EdceManagementStructures& management_structures, Mempool& mempool) {
+		auto& db = management_structures.db;
+		BlockProcessorTestUtils::init_simple(db);
+
+		std::vector<account_db_idx> idxs;
+		for (uint64_t k = 0; k < NUM_LANE_TEST_SOURCES; k++) {
+			idxs.push_back(db.add_account_to_db(1000 + k));
+		}
+		db.commit(0);
+		for (auto idx : idxs) {
+			db.transfer_available(idx, 0, 100);
+		}
+		db.commit(0);
+
+		for (uint64_t chunk_start = 0; chunk_start < NUM_LANE_TEST_SOURCES; chunk_start += 50) {
+			std::vector<SignedTransaction> chunk;
+			for (uint64_t k = chunk_start; k < chunk_start + 50; k++) {
+				chunk.push_back(BlockProcessorTestUtils::make_payment_tx(1000 + k, 1, (k % 2 == 0) ? HOT_ACCOUNT : 1000 + k - 1));
+			}
+			mempool.add_to_mempool_buffer(std::move(chunk));
+		}
+		mempool.push_mempool_buffer_to_mempool();
+	}
+
+public:
+	void test_hot_accounts_get_own_lanes() {
+		TEST_START();
+
+		Mempool mempool(100);
+		fill_mempool(mempool);
+
+		ConflictAwareScheduler scheduler(1, 0.1);
+
+		auto lock = mempool.lock_mempool();
+		scheduler.schedule(mempool, 1000, 2);
+
+		TS_ASSERT_EQUALS(2, scheduler.get_num_hot_accounts());
+		TS_ASSERT(scheduler.is_hot(1));
+		TS_ASSERT(scheduler.is_hot(2));
+		TS_ASSERT(!scheduler.is_hot(100));
+
+		TS_ASSERT_EQUALS(2, scheduler.get_num_lanes());
+		TS_ASSERT_EQUALS(81, scheduler.get_num_hot_txs());
+
+		//ties broken by account id, so account 1 has lane 0
+		TS_ASSERT_EQUALS(0, scheduler.get_tx_lane(0, 5));
+		TS_ASSERT_EQUALS(1, scheduler.get_tx_lane(1, 5));
+		TS_ASSERT_EQUALS(ConflictAwareScheduler::NO_LANE, scheduler.get_tx_lane(2, 0));
+		//routed by source account
+		TS_ASSERT_EQUALS(0, scheduler.get_tx_lane(2, 10));
+
+		auto& lane = scheduler.get_lane(0);
+		TS_ASSERT_EQUALS(41, lane.size());
+		for (size_t i = 0; i < 40; i++) {
+			TS_ASSERT_EQUALS(0, lane[i].chunk_idx);
+			TS_ASSERT_EQUALS(i, lane[i].tx_idx);
+		}
+		TS_ASSERT_EQUALS(2, lane[40].chunk_idx);
+		TS_ASSERT_EQUALS(10, lane[40].tx_idx);
+	}
+
+	void test_no_hot_accounts() {
+		TEST_START();
+
+		Mempool mempool(100);
+		fill_mempool(mempool);
+
+		//threshold above any account's count
+		ConflictAwareScheduler scheduler(1, 0.9);
+
+		auto lock = mempool.lock_mempool();
+		scheduler.schedule(mempool, 1000, 2);
+
+		TS_ASSERT(!scheduler.has_hot_txs());
+		TS_ASSERT_EQUALS(0, scheduler.get_num_lanes());
+		TS_ASSERT_EQUALS(ConflictAwareScheduler::NO_LANE, scheduler.get_tx_lane(0, 0));
+	}
+
+	void test_self_payments_counted_once() {
+		TEST_START();
+
+		Mempool mempool(100);
+		std::vector<SignedTransaction> chunk;
+		//12 samples of account 1, which would be 24 if its self-payments counted twice
+		for (uint64_t i = 0; i < 12; i++) {
+			chunk.push_back(BlockProcessorTestUtils::make_payment_tx(1, i + 1, 1));
+		}
+		for (uint64_t i = 0; i < 28; i++) {
+			chunk.push_back(BlockProcessorTestUtils::make_payment_tx(100 + i, 1, 200 + i));
+		}
+		mempool.add_to_mempool_buffer(std::move(chunk));
+		mempool.push_mempool_buffer_to_mempool();
+
+		ConflictAwareScheduler scheduler(1, 0.1);
+
+		auto lock = mempool.lock_mempool();
+		scheduler.schedule(mempool, 1000, 2);
+
+		TS_ASSERT(!scheduler.is_hot(1));
+		TS_ASSERT(!scheduler.has_hot_txs());
+	}
+
+	void test_lanes_in_block() {
+		TEST_START();
+
+		EdceManagementStructures management_structures(10, ApproximationParameters{1, 1});
+		Mempool mempool(50);
+		fill_lane_test(management_structures, mempool);
+
+		BlockProducer producer(management_structures, true);
+		BlockCreationMeasurements measurements;
+		BlockStateUpdateStatsWrapper stats;
+
+		auto block_size = producer.build_block(mempool, 1000, measurements, stats);
+
+		TS_ASSERT_EQUALS(NUM_LANE_TEST_SOURCES, block_size);
+		//every payment to the hot account went through its lane
+		TS_ASSERT_EQUALS(NUM_LANE_TEST_SOURCES / 2, stats.hot_account_tx_count);
+
+		auto& db = management_structures.db;
+		account_db_idx idx;
+		TS_ASSERT(db.lookup_user_id(HOT_ACCOUNT, &idx));
+		TS_ASSERT_EQUALS(1000 + 10 * NUM_LANE_TEST_SOURCES / 2, db.lookup_available_balance(idx, 0));
+
+		//confirmed txs (hot or not) leave the mempool
+		mempool.remove_confirmed_txs();
+		TS_ASSERT_EQUALS(0, mempool.size());
+	}
+
+	void test_lanes_share_block_space() {
+		TEST_START();
+
+		EdceManagementStructures management_structures(10, ApproximationParameters{1, 1});
+		Mempool mempool(50);
+		fill_lane_test(management_structures, mempool);
+
+		BlockProducer producer(management_structures, true);
+		BlockCreationMeasurements measurements;
+		BlockStateUpdateStatsWrapper stats;
+
+		//lanes and chunks reserve block space concurrently, and together fill exactly the block
+		auto block_size = producer.build_block(mempool, 150, measurements, stats);
+		TS_ASSERT_EQUALS(150, block_size);
+
+		mempool.remove_confirmed_txs();
+		TS_ASSERT_EQUALS(NUM_LANE_TEST_SOURCES - 150, mempool.size());
+	}
+
+	void test_scheduling_disabled() {
+		TEST_START();
+
+		EdceManagementStructures management_structures(10, ApproximationParameters{1, 1});
+		Mempool mempool(50);
+		fill_lane_test(management_structures, mempool);
+
+		BlockProducer producer(management_structures, false);
+		BlockCreationMeasurements measurements;
+		BlockStateUpdateStatsWrapper stats;
+
+		//same block as with lanes, but no tx goes through a lane
+		auto block_size = producer.build_block(mempool, 1000, measurements, stats);
+
+		TS_ASSERT_EQUALS(NUM_LANE_TEST_SOURCES, block_size);
+		TS_ASSERT_EQUALS(0, stats.hot_account_tx_count);
+
+		auto& db = management_structures.db;
+		account_db_idx idx;
+		TS_ASSERT(db.lookup_user_id(HOT_ACCOUNT, &idx));
+		TS_ASSERT_EQUALS(1000 + 10 * NUM_LANE_TEST_SOURCES / 2, db.lookup_available_balance(idx, 0));
+	}
+};
@@ -0,0 +1,101 @@
+#include <cxxtest/TestSuite.h>
+
+#include <cmath>
+#include <cstdint>
+
+#include "merkle_work_unit_manager.h"
+#include "database.h"
+
+#include "xdr/transaction.h"
+
+#include "simple_debug.h"
+
+#include "price_utils.h"
+#include "tx_type_utils.h"
+
+#include "convex_price_solver.h"
+
+using namespace edce;
+
+class ConvexPriceSolverTestSuite : public CxxTest::TestSuite {
+
+	void add_offer(ProcessingSerialManager& serial_manager, MerkleWorkUnitManager& manager, AssetID sell, AssetID buy, uint64_t offer_id, int64_t amount, double min_price) {
+		int x = 0;
+		Offer offer;
+		offer.category = TxTypeUtils::make_category(sell, buy, OfferType::SELL);
+		offer.offerId = offer_id;
+		offer.owner = 1;
+		offer.amount = amount;
+		offer.minPrice = PriceUtils::from_double(min_price);
+
+		auto offer_idx = manager.look_up_idx(offer.category);
+		serial_manager.add_offer(offer_idx, offer, x, x);
+	}
+
+public:
+
+	void test_twoasset_converges() {
+		TEST_START();
+
+		const uint8_t smooth_mult = 4;
+
+		MerkleWorkUnitManager manager(2);
+
+		ProcessingSerialManager serial_manager(manager);
+
+		for (uint64_t i = 0; i < 10; i++) {
+			add_offer(serial_manager, manager, 0, 1, 1000 + i, 100, 0.5 + 0.05 * i);
+			add_offer(serial_manager, manager, 1, 0, 2000 + i, 100, 0.5 + 0.05 * i);
+		}
+
+		serial_manager.finish_merge();
+		manager.commit_for_production(1);
+
+		ConvexPriceSolver solver(manager);
+
+		Price prices[2];
+		prices[0] = PriceUtils::from_double(4);
+		prices[1] = PriceUtils::from_double(1);
+
+		solver.reset(prices, smooth_mult);
+
+		double starting_residual = solver.get_relative_residual();
+
+		for (int i = 0; i < 200; i++) {
+			if (!solver.step(smooth_mult)) {
+				break;
+			}
+		}
+
+		TS_ASSERT_LESS_THAN(solver.get_relative_residual(), starting_residual);
+		TS_ASSERT_LESS_THAN(solver.get_relative_residual(), 0.001);
+
+		solver.get_prices(prices);
+
+		//symmetric market, so the exchange rate should end up near 1
+		double rate = PriceUtils::to_double(prices[0]) / PriceUtils::to_double(prices[1]);
+		TS_ASSERT_DELTA(std::log2(rate), 0, 1);
+	}
+
+	void test_empty_market_stalls() {
+		TEST_START();
+
+		MerkleWorkUnitManager manager(3);
+
+		ConvexPriceSolver solver(manager);
+
+		Price prices[3];
+		for (int i = 0; i < 3; i++) {
+			prices[i] = PriceUtils::from_double(1);
+		}
+
+		solver.reset(prices, 10);
+		TS_ASSERT(!solver.step(10));
+
+		Price out[3];
+		solver.get_prices(out);
+		for (int i = 0; i < 3; i++) {
+			TS_ASSERT_EQUALS(out[i], prices[i]);
+		}
+	}
+};
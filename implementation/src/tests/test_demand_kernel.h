@@ -0,0 +1,116 @@
+#include <cxxtest/TestSuite.h>
+
+#include <cstdint>
+#include <random>
+
+#include "merkle_work_unit_manager.h"
+#include "database.h"
+
+#include "xdr/transaction.h"
+
+#include "simple_debug.h"
+
+#include "price_utils.h"
+#include "tx_type_utils.h"
+
+#include "demand_kernel.h"
+
+using namespace edce;
+
+class DemandKernelTestSuite : public CxxTest::TestSuite {
+
+	void add_offer(ProcessingSerialManager& serial_manager, MerkleWorkUnitManager& manager, AssetID sell, AssetID buy, uint64_t offer_id, int64_t amount, double min_price) {
+		int x = 0;
+		Offer offer;
+		offer.category = TxTypeUtils::make_category(sell, buy, OfferType::SELL);
+		offer.offerId = offer_id;
+		offer.owner = 1;
+		offer.amount = amount;
+		offer.minPrice = PriceUtils::from_double(min_price);
+
+		auto offer_idx = manager.look_up_idx(offer.category);
+		serial_manager.add_offer(offer_idx, offer, x, x);
+	}
+
+public:
+
+	void test_reciprocal_division_exact() {
+		TEST_START();
+
+		std::mt19937_64 gen(0);
+
+		std::vector<uint64_t> divisors = {1, 2, 3, 7, UINT64_MAX, ((uint64_t)1) << 63, (((uint64_t)1) << 63) + 1, PriceUtils::PRICE_MAX};
+		for (size_t i = 0; i < 200; i++) {
+			divisors.push_back(gen() >> (gen() % 64) | 1);
+		}
+
+		for (auto divisor : divisors) {
+			DivisorReciprocal reciprocal(divisor);
+			TS_ASSERT_EQUALS(reciprocal.get_divisor(), divisor);
+
+			for (size_t i = 0; i < 200; i++) {
+				uint128_t value = ((((uint128_t) gen()) << 64) | gen()) >> (gen() % 128);
+				uint64_t remainder;
+				auto quotient = reciprocal.divide(value, remainder);
+				TS_ASSERT(quotient == value / divisor);
+				TS_ASSERT_EQUALS(remainder, (uint64_t) (value % divisor));
+			}
+			uint64_t remainder;
+			TS_ASSERT(reciprocal.divide(~((uint128_t) 0), remainder) == ~((uint128_t) 0) / divisor);
+			TS_ASSERT(reciprocal.divide(0, remainder) == 0);
+		}
+	}
+
+	void test_kernel_matches_generic() {
+		TEST_START();
+
+		const size_t num_assets = 4;
+
+		MerkleWorkUnitManager manager(num_assets);
+
+		ProcessingSerialManager serial_manager(manager);
+
+		std::mt19937 gen(1);
+		std::uniform_real_distribution<> price_dist(0.1, 10);
+		uint64_t offer_id = 0;
+		for (size_t sell = 0; sell < num_assets; sell++) {
+			for (size_t buy = 0; buy < num_assets; buy++) {
+				if (sell == buy) {
+					continue;
+				}
+				for (size_t i = 0; i < 50; i++) {
+					add_offer(serial_manager, manager, sell, buy, offer_id++, 1 + gen() % 100000, price_dist(gen));
+				}
+			}
+		}
+		serial_manager.finish_merge();
+		manager.commit_for_production(1);
+
+		auto& work_units = manager.get_work_units();
+
+		DemandQueryPrices query_prices;
+
+		//including smooth_mults with no specialized kernel
+		for (uint8_t smooth_mult : {0, 1, 5, 10, 20, 31, 32, 40}) {
+			for (size_t trial = 0; trial < 20; trial++) {
+				Price prices[num_assets];
+				for (size_t i = 0; i < num_assets; i++) {
+					prices[i] = PriceUtils::from_double(price_dist(gen));
+				}
+				query_prices.set(prices, num_assets);
+
+				uint128_t demands[num_assets] = {0}, supplies[num_assets] = {0};
+				uint128_t kernel_demands[num_assets] = {0}, kernel_supplies[num_assets] = {0};
+
+				for (auto& work_unit : work_units) {
+					work_unit.calculate_demands_and_supplies(prices, demands, supplies, smooth_mult);
+					work_unit.calculate_demands_and_supplies(query_prices, kernel_demands, kernel_supplies, smooth_mult);
+				}
+				for (size_t i = 0; i < num_assets; i++) {
+					TS_ASSERT(demands[i] == kernel_demands[i]);
+					TS_ASSERT(supplies[i] == kernel_supplies[i]);
+				}
+			}
+		}
+	}
+};
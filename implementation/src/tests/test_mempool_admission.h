@@ -0,0 +1,272 @@
+#include <cxxtest/TestSuite.h>
+
+#include <cstdint>
+#include <cstdio>
+
+#include <sodium.h>
+#include <xdrpp/marshal.h>
+
+#include "crypto_utils.h"
+#include "memory_database.h"
+#include "mempool.h"
+#include "mempool_admission.h"
+#include "price_utils.h"
+#include "verified_transaction_cache.h"
+
+#include "xdr/transaction.h"
+
+#include "simple_debug.h"
+
+using namespace edce;
+
+class MempoolAdmissionTestSuite : public CxxTest::TestSuite {
+
+	constexpr static uint16_t NUM_ASSETS = 4;
+
+	SignedTransaction make_offer_tx(AccountID source, uint64_t seq_num, const DeterministicKeyGenerator::SecretKey& sk) {
+		SignedTransaction tx;
+		tx.transaction.metadata.sourceAccount = source;
+		tx.transaction.metadata.sequenceNumber = seq_num;
+
+		Operation op;
+		op.body.type(CREATE_SELL_OFFER);
+		op.body.createSellOfferOp().category.sellAsset = 0;
+		op.body.createSellOfferOp().category.buyAsset = 1;
+		op.body.createSellOfferOp().amount = 100;
+		op.body.createSellOfferOp().minPrice = PriceUtils::from_double(1.0);
+		tx.transaction.operations.push_back(op);
+
+		auto msg = xdr::xdr_to_opaque(tx.transaction);
+		crypto_sign_detached(tx.signature.data(), nullptr, msg.data(), msg.size(), sk.data());
+		return tx;
+	}
+
+public:
+	void test_static_checks() {
+		TEST_START();
+
+		DeterministicKeyGenerator key_gen;
+		auto [sk, pk] = key_gen.deterministic_key_gen(1);
+
+		MemoryDatabase db;
+		db.add_account_to_db(1, pk);
+		db.commit(0);
+
+		VerifiedTransactionCache cache;
+		MempoolAdmissionChecker checker(db, cache, NUM_ASSETS);
+
+		TS_ASSERT_EQUALS(TransactionProcessingStatus::SUCCESS, checker.check_transaction(make_offer_tx(1, 1<<8, sk)));
+
+		TS_ASSERT_EQUALS(TransactionProcessingStatus::INVALID_TX_FORMAT, checker.check_transaction(make_offer_tx(1, (1<<8) + 1, sk)));
+		TS_ASSERT_EQUALS(TransactionProcessingStatus::SEQ_NUM_TOO_LOW, checker.check_transaction(make_offer_tx(1, 0, sk)));
+
+		auto bad_category = make_offer_tx(1, 2<<8, sk);
+		bad_category.transaction.operations[0].body.createSellOfferOp().category.buyAsset = NUM_ASSETS;
+		TS_ASSERT_EQUALS(TransactionProcessingStatus::INVALID_OFFER_CATEGORY, checker.check_transaction(bad_category));
+
+		auto bad_price = make_offer_tx(1, 2<<8, sk);
+		bad_price.transaction.operations[0].body.createSellOfferOp().minPrice = 0;
+		TS_ASSERT_EQUALS(TransactionProcessingStatus::INVALID_PRICE, checker.check_transaction(bad_price));
+
+		//account not yet committed: can't be verified.
+		TS_ASSERT_EQUALS(TransactionProcessingStatus::SOURCE_ACCOUNT_NEXIST, checker.check_transaction(make_offer_tx(2, 1<<8, sk)));
+	}
+
+	void test_held_until_account_exists() {
+		TEST_START();
+
+		DeterministicKeyGenerator key_gen;
+		auto [sk, pk] = key_gen.deterministic_key_gen(2);
+		auto [other_sk, other_pk] = key_gen.deterministic_key_gen(3);
+
+		MemoryDatabase db;
+		VerifiedTransactionCache cache;
+		MempoolAdmissionChecker checker(db, cache, NUM_ASSETS);
+
+		std::vector<SignedTransaction> txs;
+		txs.push_back(make_offer_tx(2, 1<<8, sk));
+		//signed with the wrong key
+		txs.push_back(make_offer_tx(3, 1<<8, sk));
+
+		std::vector<TransactionProcessingStatus> statuses(txs.size());
+		TS_ASSERT_EQUALS(2, checker.filter_transactions(txs, statuses.data()));
+
+		//neither reaches the mempool unverified
+		TS_ASSERT_EQUALS(0, txs.size());
+		TS_ASSERT_EQUALS(TransactionProcessingStatus::SUCCESS, statuses[0]);
+		TS_ASSERT_EQUALS(TransactionProcessingStatus::SUCCESS, statuses[1]);
+		TS_ASSERT_EQUALS(2, checker.num_unverified.load());
+		TS_ASSERT_EQUALS(2, checker.num_held_txs());
+
+		TS_ASSERT_EQUALS(0, checker.release_held_txs().size());
+		TS_ASSERT_EQUALS(2, checker.num_held_txs());
+
+		db.add_account_to_db(2, pk);
+		db.add_account_to_db(3, other_pk);
+		db.commit(0);
+
+		auto released = checker.release_held_txs();
+		TS_ASSERT_EQUALS(1, released.size());
+		TS_ASSERT_EQUALS(2, released[0].transaction.metadata.sourceAccount);
+		TS_ASSERT_EQUALS(0, checker.num_held_txs());
+		TS_ASSERT_EQUALS(1, checker.num_held_dropped.load());
+
+		Hash tx_hash;
+		VerifiedTransactionCache::hash_tx(released[0], tx_hash);
+		TS_ASSERT(cache.contains(tx_hash));
+	}
+
+	void test_signature_cache() {
+		TEST_START();
+
+		DeterministicKeyGenerator key_gen;
+		auto [sk, pk] = key_gen.deterministic_key_gen(1);
+		auto [wrong_sk, wrong_pk] = key_gen.deterministic_key_gen(2);
+
+		MemoryDatabase db;
+		db.add_account_to_db(1, pk);
+		db.commit(0);
+
+		VerifiedTransactionCache cache;
+		MempoolAdmissionChecker checker(db, cache, NUM_ASSETS);
+
+		auto tx = make_offer_tx(1, 1<<8, sk);
+		Hash tx_hash;
+		VerifiedTransactionCache::hash_tx(tx, tx_hash);
+
+		TS_ASSERT(!cache.contains(tx_hash));
+		TS_ASSERT_EQUALS(TransactionProcessingStatus::SUCCESS, checker.check_transaction(tx));
+		TS_ASSERT(cache.contains(tx_hash));
+		TS_ASSERT_EQUALS(0, checker.num_sig_cache_hits.load());
+
+		TS_ASSERT_EQUALS(TransactionProcessingStatus::SUCCESS, checker.check_transaction(tx));
+		TS_ASSERT_EQUALS(1, checker.num_sig_cache_hits.load());
+
+		auto forged = make_offer_tx(1, 1<<8, wrong_sk);
+		TS_ASSERT_EQUALS(TransactionProcessingStatus::INVALID_SIGNATURE, checker.check_transaction(forged));
+		VerifiedTransactionCache::hash_tx(forged, tx_hash);
+		TS_ASSERT(!cache.contains(tx_hash));
+	}
+
+	void test_filter_preserves_order() {
+		TEST_START();
+
+		DeterministicKeyGenerator key_gen;
+		auto [sk, pk] = key_gen.deterministic_key_gen(1);
+
+		MemoryDatabase db;
+		db.add_account_to_db(1, pk);
+		db.commit(0);
+
+		VerifiedTransactionCache cache;
+		MempoolAdmissionChecker checker(db, cache, NUM_ASSETS);
+
+		std::vector<SignedTransaction> txs;
+		for (uint64_t i = 1; i <= 10; i++) {
+			//odd txs have malformed seq nums
+			txs.push_back(make_offer_tx(1, (i<<8) + (i % 2), sk));
+		}
+
+		std::vector<TransactionProcessingStatus> statuses(txs.size());
+		TS_ASSERT_EQUALS(5, checker.filter_transactions(txs, statuses.data()));
+		TS_ASSERT_EQUALS(5, txs.size());
+
+		for (size_t i = 0; i < statuses.size(); i++) {
+			auto expect = (i % 2 == 0) ? TransactionProcessingStatus::INVALID_TX_FORMAT : TransactionProcessingStatus::SUCCESS;
+			TS_ASSERT_EQUALS(expect, statuses[i]);
+		}
+		for (size_t i = 0; i < txs.size(); i++) {
+			TS_ASSERT_EQUALS((2 * (i+1)) << 8, txs[i].transaction.metadata.sequenceNumber);
+		}
+	}
+
+	void test_serialized_batch() {
+		TEST_START();
+
+		DeterministicKeyGenerator key_gen;
+		auto [sk, pk] = key_gen.deterministic_key_gen(1);
+
+		MemoryDatabase db;
+		db.add_account_to_db(1, pk);
+		db.commit(0);
+
+		VerifiedTransactionCache cache;
+		MempoolAdmissionChecker checker(db, cache, NUM_ASSETS);
+
+		SignedTransactionList txs;
+		for (uint64_t i = 1; i <= 5; i++) {
+			//odd txs have malformed seq nums
+			txs.push_back(make_offer_tx(1, (i<<8) + (i % 2), sk));
+		}
+		SerializedBlock serialized = xdr::xdr_to_opaque(txs);
+
+		//chunks of 2, so statuses from each chunk's admission land at the right offset
+		Mempool mempool(2);
+		TransactionBatchSubmissionResults results;
+		TS_ASSERT_EQUALS(2, mempool.add_serialized_to_mempool_buffer(serialized, results, &checker));
+		TS_ASSERT_EQUALS(2, results.num_accepted);
+		TS_ASSERT_EQUALS(5, results.results.size());
+		for (size_t i = 0; i < results.results.size(); i++) {
+			auto expect = (i % 2 == 0) ? TransactionProcessingStatus::INVALID_TX_FORMAT : TransactionProcessingStatus::SUCCESS;
+			TS_ASSERT_EQUALS(expect, results.results[i]);
+		}
+		mempool.push_mempool_buffer_to_mempool();
+		TS_ASSERT_EQUALS(2, mempool.size());
+	}
+
+	void test_serialized_batch_framing() {
+		TEST_START();
+
+		DeterministicKeyGenerator key_gen;
+		auto [sk, pk] = key_gen.deterministic_key_gen(1);
+
+		SignedTransactionList txs;
+		for (uint64_t i = 1; i <= 3; i++) {
+			txs.push_back(make_offer_tx(1, i<<8, sk));
+		}
+		const SerializedBlock serialized = xdr::xdr_to_opaque(txs);
+
+		Mempool mempool(100);
+		TransactionBatchSubmissionResults results;
+
+		auto expect_all_rejected = [&] (size_t num_results) {
+			TS_ASSERT_EQUALS(0, results.num_accepted);
+			TS_ASSERT_EQUALS(num_results, results.results.size());
+			for (auto status : results.results) {
+				TS_ASSERT_EQUALS(TransactionProcessingStatus::INVALID_TX_FORMAT, status);
+			}
+		};
+
+		//bytes past the last declared tx
+		auto trailing = serialized;
+		trailing.insert(trailing.end(), 4, 0);
+		TS_ASSERT_EQUALS(0, mempool.add_serialized_to_mempool_buffer(trailing, results));
+		expect_all_rejected(3);
+
+		//not a whole number of xdr words
+		auto unaligned = serialized;
+		unaligned.push_back(0);
+		TS_ASSERT_EQUALS(0, mempool.add_serialized_to_mempool_buffer(unaligned, results));
+		expect_all_rejected(3);
+
+		//declares more txs than a batch may hold
+		auto oversized = serialized;
+		oversized[0] = 0xFF;
+		TS_ASSERT_EQUALS(0, mempool.add_serialized_to_mempool_buffer(oversized, results));
+		expect_all_rejected(MAX_TRANSACTIONS_PER_BLOCK);
+
+		mempool.push_mempool_buffer_to_mempool();
+		TS_ASSERT_EQUALS(0, mempool.size());
+
+		//declares more txs than it has: the ones present are still admitted
+		auto truncated = serialized;
+		truncated[3] = 5;
+		TS_ASSERT_EQUALS(3, mempool.add_serialized_to_mempool_buffer(truncated, results));
+		TS_ASSERT_EQUALS(5, results.results.size());
+		TS_ASSERT_EQUALS(TransactionProcessingStatus::SUCCESS, results.results[2]);
+		TS_ASSERT_EQUALS(TransactionProcessingStatus::INVALID_TX_FORMAT, results.results[3]);
+
+		mempool.push_mempool_buffer_to_mempool();
+		TS_ASSERT_EQUALS(3, mempool.size());
+	}
+};
@@ -1,8 +1,12 @@
 #include <cxxtest/TestSuite.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
+#include <thread>
+#include <vector>
 
 #include "merkle_trie.h"
 #include "merkle_work_unit.h"
@@ -401,6 +405,54 @@ public:
 		TS_ASSERT(trie.partial_metadata_integrity_check());
 	}
 
+	void test_split_deep() {
+		TEST_START();
+		using TrieT = MerkleTrie<8, OfferWrapper, MerkleWorkUnit::TrieMetadataT>;
+
+		TrieT trie;
+		TrieT::prefix_t key_buf;
+
+		//(key, amount), sorted by key
+		std::vector<std::pair<uint64_t, int64_t>> offers;
+
+		for (uint64_t i = 0; i < 2000; i++) {
+			Offer offer;
+			offer.amount = 1 + (i % 7);
+			offer.minPrice = 1;
+			uint64_t key = i * 0x9E3779B97F4A7C15;
+			PriceUtils::write_unsigned_big_endian(key_buf, key);
+			trie.insert(key_buf, OfferWrapper(offer));
+			offers.emplace_back(key, offer.amount);
+		}
+		std::sort(offers.begin(), offers.end());
+
+		size_t consumed = 0;
+		//split exactly at an offer boundary, then in the middle of an offer
+		for (size_t num_split : {1u, 17u, 300u, 1000u}) {
+			int64_t endow = 0;
+			for (size_t i = consumed; i < consumed + num_split; i++) {
+				endow += offers[i].second;
+			}
+
+			auto split = trie.endow_split(endow);
+			TS_ASSERT_EQUALS(split.size(), num_split);
+			TS_ASSERT_EQUALS(split.get_root_metadata().endow, endow);
+			consumed += num_split;
+			TS_ASSERT_EQUALS(trie.size(), offers.size() - consumed);
+
+			auto partial = trie.endow_split(offers[consumed].second - 1);
+			TS_ASSERT_EQUALS(partial.size(), 0u);
+
+			TS_ASSERT(split.metadata_integrity_check());
+			TS_ASSERT(trie.metadata_integrity_check());
+			TS_ASSERT_EQUALS(trie.uncached_size(), offers.size() - consumed);
+		}
+		auto lowest = trie.get_lowest_key();
+		TS_ASSERT(lowest);
+		PriceUtils::write_unsigned_big_endian(key_buf, offers[consumed].first);
+		TS_ASSERT(*lowest == key_buf);
+	}
+
 	void test_endow_below_threshold() {
 		TEST_START();
 		using ValueT = XdrTypeWrapper<Offer>;
@@ -447,4 +499,219 @@ public:
 
 	}
 
+	struct RangeScanFn {
+		std::atomic<uint64_t> count = 0;
+		std::atomic<uint64_t> key_sum = 0;
+
+		template<typename prefix_t>
+		void operator()(const prefix_t& key, const EmptyValue&) {
+			uint64_t key_int = 0;
+			for (size_t i = 0; i < 8; i++) {
+				key_int = (key_int << 8) + key[i];
+			}
+			count++;
+			key_sum += key_int;
+		}
+	};
+
+	void test_stack_iterator_and_range_scan() {
+		TEST_START();
+		using TrieT = MerkleTrie<8, EmptyValue, CombinedMetadata<SizeMixin>>;
+
+		TrieT trie;
+		TrieT::prefix_t buf;
+
+		TS_ASSERT(trie.begin().at_end());
+
+		std::vector<uint64_t> keys;
+		for (uint64_t i = 0; i < 10000; i++) {
+			keys.push_back((i * 0x9E3779B97F4A7C15) >> 16);
+			PriceUtils::write_unsigned_big_endian(buf, keys.back());
+			trie.insert(buf);
+		}
+		std::sort(keys.begin(), keys.end());
+
+		size_t idx = 0;
+		for (auto iter = trie.begin(); !iter.at_end(); ++iter) {
+			PriceUtils::write_unsigned_big_endian(buf, keys.at(idx));
+			TS_ASSERT((*iter).first == buf);
+			idx++;
+		}
+		TS_ASSERT_EQUALS(idx, keys.size());
+
+		auto check_range = [&] (uint64_t lo, uint64_t hi) {
+			uint64_t count = 0, key_sum = 0;
+			for (auto key : keys) {
+				if (key >= lo && key < hi) {
+					count++;
+					key_sum += key;
+				}
+			}
+			TrieT::prefix_t lo_buf, hi_buf;
+			PriceUtils::write_unsigned_big_endian(lo_buf, lo);
+			PriceUtils::write_unsigned_big_endian(hi_buf, hi);
+
+			RangeScanFn serial, parallel;
+			trie.range_scan(serial, lo_buf, hi_buf);
+			trie.parallel_range_scan(parallel, lo_buf, hi_buf);
+
+			TS_ASSERT_EQUALS(serial.count, count);
+			TS_ASSERT_EQUALS(serial.key_sum, key_sum);
+			TS_ASSERT_EQUALS(parallel.count, count);
+			TS_ASSERT_EQUALS(parallel.key_sum, key_sum);
+		};
+
+		check_range(0, UINT64_MAX);
+		check_range(keys[100], keys[5000]);
+		check_range(keys[100] + 1, keys[5000] + 1);
+		check_range(keys[7000], keys[7000]);
+		check_range(keys[7000], keys[7001]);
+		check_range(0x1234'5678'9ABC, 0x0000'F000'0000'0000);
+		check_range(keys.back() + 1, UINT64_MAX);
+	}
+
+	void test_children_map_spill() {
+		TEST_START();
+		using TrieT = MerkleTrie<1>;
+		TrieT trie;
+		TrieT::prefix_t key_buf;
+
+		//root children move to a heap map past INLINE_CHILDREN, and back
+		for (uint8_t i = 0; i < 16; i++) {
+			PriceUtils::write_unsigned_big_endian(key_buf, (uint8_t)(i << 4));
+			trie.insert(key_buf);
+
+			auto usage = trie.memory_usage();
+			TS_ASSERT_EQUALS(usage.num_leaves, i + 1u);
+			TS_ASSERT_EQUALS(usage.num_heap_children_maps, (i + 1u > TrieT::TrieT::children_map_t::INLINE_CHILDREN) ? 1u : 0u);
+		}
+
+		for (uint8_t i = 0; i < 14; i++) {
+			//delete from the middle, to shift the inline map
+			PriceUtils::write_unsigned_big_endian(key_buf, (uint8_t)((i + 1) << 4));
+			trie.perform_deletion(key_buf);
+
+			TS_ASSERT_EQUALS(trie.uncached_size(), 15u - i);
+			uint8_t prev = 0;
+			bool first = true;
+			for (auto iter = trie.begin(); !iter.at_end(); ++iter) {
+				auto key = (*iter).first[0];
+				TS_ASSERT(first || key > prev);
+				TS_ASSERT(key == 0 || key > ((i + 1) << 4));
+				prev = key;
+				first = false;
+			}
+			TS_ASSERT_EQUALS(trie.memory_usage().num_heap_children_maps, (15u - i > TrieT::TrieT::children_map_t::INLINE_CHILDREN) ? 1u : 0u);
+		}
+	}
+
+	void test_parallel_insert() {
+		TEST_START();
+		//no node locks, as in work units
+		using TrieT = MerkleTrie<8, EmptyValue, CombinedMetadata<SizeMixin>, false>;
+
+		constexpr int NUM_THREADS = 8;
+		constexpr uint64_t NUM_KEYS = 20000;
+
+		//threads' key sets overlap, and share prefixes at every length
+		auto make_key = [] (int thread, uint64_t i, TrieT::prefix_t& buf) {
+			uint64_t key = (i * 0x9E3779B97F4A7C15) >> ((thread + i) % 48);
+			PriceUtils::write_unsigned_big_endian(buf, key);
+		};
+
+		TrieT parallel_trie, serial_trie;
+
+		std::vector<std::thread> threads;
+		for (int t = 0; t < NUM_THREADS; t++) {
+			threads.emplace_back([&parallel_trie, &make_key, t] () {
+				TrieT::prefix_t buf;
+				for (uint64_t i = 0; i < NUM_KEYS; i++) {
+					make_key(t, i, buf);
+					parallel_trie.parallel_insert(buf);
+				}
+			});
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+
+		TrieT::prefix_t buf;
+		for (int t = 0; t < NUM_THREADS; t++) {
+			for (uint64_t i = 0; i < NUM_KEYS; i++) {
+				make_key(t, i, buf);
+				serial_trie.insert(buf);
+			}
+		}
+
+		TS_ASSERT(parallel_trie.metadata_integrity_check());
+		TS_ASSERT_EQUALS(parallel_trie.size(), serial_trie.size());
+		TS_ASSERT_EQUALS(parallel_trie.uncached_size(), serial_trie.size());
+
+		Hash parallel_hash, serial_hash;
+		parallel_trie.freeze_and_hash(parallel_hash);
+		serial_trie.freeze_and_hash(serial_hash);
+		TS_ASSERT_EQUALS(0, memcmp(parallel_hash.data(), serial_hash.data(), 32));
+	}
+
+	void test_compact_offer_leaf() {
+		TEST_START();
+		using CompactTrieT = MerkleWorkUnit::MerkleTrieT;
+		using FullTrieT = MerkleTrie<MerkleWorkUnit::WORKUNIT_KEY_LEN, OfferWrapper, MerkleWorkUnit::TrieMetadataT, false>;
+
+		OfferCategory category;
+		category.sellAsset = 3;
+		category.buyAsset = 1;
+		category.type = OfferType::SELL;
+
+		CompactTrieT compact;
+		FullTrieT full;
+		CompactTrieT::prefix_t key_buf;
+
+		std::vector<Offer> offers;
+		for (uint64_t i = 0; i < 500; i++) {
+			Offer offer;
+			offer.category = category;
+			offer.offerId = i * 0x9E3779B97F4A7C15;
+			offer.owner = (i * 7919) % 100;
+			offer.amount = 1 + (i % 13);
+			offer.minPrice = PriceUtils::from_double(0.5 + ((double) (i % 37)) / 37);
+			MerkleWorkUnit::generate_key(offer, key_buf);
+			compact.insert(key_buf, MerkleWorkUnit::TrieValueT(offer));
+			full.insert(key_buf, OfferWrapper(offer));
+			offers.push_back(offer);
+		}
+
+		//leaves hash as the full Offer
+		Hash compact_hash, full_hash;
+		compact.freeze_and_hash(compact_hash, category);
+		full.freeze_and_hash(full_hash);
+		TS_ASSERT(compact_hash == full_hash);
+
+		TS_ASSERT_EQUALS(compact.get_root_metadata().endow, full.get_root_metadata().endow);
+
+		//apply passes keys along, so every offer is rebuilt exactly
+		std::vector<Offer> rebuilt;
+		auto accumulate = [&rebuilt, &category] (const CompactTrieT::prefix_t& key, const MerkleWorkUnit::TrieValueT& leaf) {
+			rebuilt.push_back(leaf.to_offer(key, category));
+		};
+		compact.apply(accumulate);
+		auto full_offers = full.accumulate_values<std::vector<Offer>>();
+		TS_ASSERT_EQUALS(rebuilt.size(), full_offers.size());
+		for (size_t i = 0; i < rebuilt.size(); i++) {
+			TS_ASSERT(xdr::xdr_to_opaque(rebuilt[i]) == xdr::xdr_to_opaque(full_offers[i]));
+		}
+
+		for (size_t i = 0; i < offers.size(); i += 3) {
+			MerkleWorkUnit::generate_key(offers[i], key_buf);
+			auto deleted = compact.perform_deletion(key_buf);
+			TS_ASSERT(deleted);
+			TS_ASSERT(full.perform_deletion(key_buf));
+			TS_ASSERT(xdr::xdr_to_opaque(deleted->to_offer(key_buf, category)) == xdr::xdr_to_opaque(offers[i]));
+		}
+
+		compact.freeze_and_hash(compact_hash, category);
+		full.freeze_and_hash(full_hash);
+		TS_ASSERT(compact_hash == full_hash);
+	}
+
 };
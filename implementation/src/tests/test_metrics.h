@@ -0,0 +1,158 @@
+#include <cxxtest/TestSuite.h>
+
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "metrics.h"
+#include "simple_debug.h"
+
+using namespace edce;
+
+class MetricsTestSuite : public CxxTest::TestSuite {
+
+	const std::string filename = "test_metrics_snapshot.json";
+
+	//the registry is process-wide, so tests compare against a snapshot taken at the start
+	static uint64_t counter_value(const MetricsSnapshot& snapshot, MetricsCounter counter) {
+		return snapshot.counters.at(static_cast<size_t>(counter)).value;
+	}
+
+	static const MetricsHistogramSummary& histogram(const MetricsSnapshot& snapshot, MetricsHistogram hist) {
+		return snapshot.histograms.at(static_cast<size_t>(hist));
+	}
+
+public:
+
+	void tearDown() {
+		std::remove(filename.c_str());
+	}
+
+	void test_buckets() {
+		TEST_START();
+
+		size_t prev_bucket = 0;
+		for (uint64_t value = 0; value < 100'000; value++) {
+			size_t bucket = LatencyBuckets::bucket(value);
+			TS_ASSERT(bucket >= prev_bucket);
+			TS_ASSERT(LatencyBuckets::lower_bound(bucket) <= value);
+			TS_ASSERT(LatencyBuckets::upper_bound(bucket) >= value);
+			prev_bucket = bucket;
+		}
+
+		for (uint64_t value = 16; value < (((uint64_t)1) << 39); value = value * 3 + 7) {
+			size_t bucket = LatencyBuckets::bucket(value);
+			uint64_t width = LatencyBuckets::upper_bound(bucket) - LatencyBuckets::lower_bound(bucket) + 1;
+			TS_ASSERT(width * LatencyBuckets::SUB_BUCKETS <= value);
+		}
+
+		TS_ASSERT_EQUALS(LatencyBuckets::bucket(UINT64_MAX), LatencyBuckets::NUM_BUCKETS - 1);
+	}
+
+	void test_histogram_percentiles() {
+		TEST_START();
+
+		auto before = MetricsRegistry::global().snapshot();
+
+		//1ms .. 1s
+		for (uint64_t i = 1; i <= 1000; i++) {
+			metrics_record(MetricsHistogram::LP_SOLVE, i / 1000.0);
+		}
+
+		auto after = MetricsRegistry::global().snapshot();
+		auto& hist = histogram(after, MetricsHistogram::LP_SOLVE);
+
+		TS_ASSERT_EQUALS(hist.count - histogram(before, MetricsHistogram::LP_SOLVE).count, 1000);
+
+		if (histogram(before, MetricsHistogram::LP_SOLVE).count == 0) {
+			//within one bucket width
+			TS_ASSERT_DELTA((double) hist.p50_ns, 500e6, 500e6 / LatencyBuckets::SUB_BUCKETS);
+			TS_ASSERT_DELTA((double) hist.p99_ns, 990e6, 990e6 / LatencyBuckets::SUB_BUCKETS);
+			TS_ASSERT_DELTA((double) hist.max_ns, 1e9, 1000);
+			TS_ASSERT(hist.p999_ns <= hist.max_ns);
+		}
+	}
+
+	void test_counters_multithreaded() {
+		TEST_START();
+
+		auto before = MetricsRegistry::global().snapshot();
+
+		const size_t num_threads = 8;
+		const uint64_t num_adds = 100'000;
+
+		std::vector<std::thread> threads;
+		for (size_t i = 0; i < num_threads; i++) {
+			threads.emplace_back([num_adds] {
+				for (uint64_t j = 0; j < num_adds; j++) {
+					metrics_add(MetricsCounter::MEMPOOL_TXS_ADDED, 2);
+					metrics_record(MetricsHistogram::MEMPOOL_PUSH, 0.001);
+				}
+			});
+		}
+		for (auto& th : threads) {
+			th.join();
+		}
+
+		auto after = MetricsRegistry::global().snapshot();
+
+		TS_ASSERT_EQUALS(
+			counter_value(after, MetricsCounter::MEMPOOL_TXS_ADDED) - counter_value(before, MetricsCounter::MEMPOOL_TXS_ADDED),
+			2 * num_threads * num_adds);
+		TS_ASSERT_EQUALS(
+			histogram(after, MetricsHistogram::MEMPOOL_PUSH).count - histogram(before, MetricsHistogram::MEMPOOL_PUSH).count,
+			num_threads * num_adds);
+
+		//shards of exited threads are reused, and their values are kept
+		std::thread th([] {metrics_add(MetricsCounter::MEMPOOL_TXS_ADDED, 1);});
+		th.join();
+		auto last = MetricsRegistry::global().snapshot();
+		TS_ASSERT_EQUALS(
+			counter_value(last, MetricsCounter::MEMPOOL_TXS_ADDED) - counter_value(after, MetricsCounter::MEMPOOL_TXS_ADDED),
+			1);
+	}
+
+	void test_disabled() {
+		TEST_START();
+
+		auto before = MetricsRegistry::global().snapshot();
+
+		MetricsRegistry::global().enable(false);
+		metrics_add(MetricsCounter::BLOCKS_VALIDATED, 5);
+		metrics_record(MetricsHistogram::BLOCK_VALIDATION, 0.01);
+		MetricsRegistry::global().enable();
+
+		auto after = MetricsRegistry::global().snapshot();
+		TS_ASSERT_EQUALS(counter_value(after, MetricsCounter::BLOCKS_VALIDATED), counter_value(before, MetricsCounter::BLOCKS_VALIDATED));
+		TS_ASSERT_EQUALS(histogram(after, MetricsHistogram::BLOCK_VALIDATION).count, histogram(before, MetricsHistogram::BLOCK_VALIDATION).count);
+
+		metrics_add(MetricsCounter::BLOCKS_VALIDATED, 5);
+		auto reenabled = MetricsRegistry::global().snapshot();
+		TS_ASSERT_EQUALS(counter_value(reenabled, MetricsCounter::BLOCKS_VALIDATED) - counter_value(before, MetricsCounter::BLOCKS_VALIDATED), 5);
+	}
+
+	void test_snapshot_file() {
+		TEST_START();
+
+		metrics_add(MetricsCounter::BLOCKS_PRODUCED);
+
+		write_metrics_snapshot_file(MetricsRegistry::global().snapshot(), filename);
+
+		std::FILE* f = std::fopen(filename.c_str(), "r");
+		TS_ASSERT(f != nullptr);
+		std::fclose(f);
+
+		f = std::fopen((filename + ".tmp").c_str(), "r");
+		TS_ASSERT(f == nullptr);
+
+		{
+			//writes once more on shutdown
+			MetricsSnapshotWriter writer(filename, 10);
+			std::this_thread::sleep_for(std::chrono::milliseconds(30));
+		}
+		f = std::fopen(filename.c_str(), "r");
+		TS_ASSERT(f != nullptr);
+		std::fclose(f);
+	}
+};
@@ -0,0 +1,178 @@
+#include <cxxtest/TestSuite.h>
+
+#include <cstdint>
+#include <cstdio>
+
+#include "account_modification_log.h"
+#include "memory_database.h"
+#include "merkle_work_unit_manager.h"
+#include "multiset_hash.h"
+#include "price_utils.h"
+#include "tx_type_utils.h"
+
+#include "xdr/types.h"
+
+#include "simple_debug.h"
+
+using namespace edce;
+
+class MultisetHashTestSuite : public CxxTest::TestSuite {
+
+	static Offer make_offer(AccountID owner, uint64_t offer_id) {
+		Offer offer;
+		offer.owner = owner;
+		offer.offerId = offer_id;
+		offer.amount = 100;
+		offer.minPrice = 1000;
+		return offer;
+	}
+
+	static Offer make_work_unit_offer(uint64_t offer_id) {
+		Offer offer = make_offer(1, offer_id);
+		offer.category = TxTypeUtils::make_category(0, 1, OfferType::SELL);
+		offer.minPrice = PriceUtils::from_double(offer_id);
+		return offer;
+	}
+
+	//adds offers [start, end) to the work unit, as block validation does (rollbackable)
+	static void add_validation_offers(MerkleWorkUnitManager& manager, uint64_t start, uint64_t end) {
+		MerkleWorkUnit::MerkleTrieT trie;
+		MerkleWorkUnit::MerkleTrieT::prefix_t key;
+		for (uint64_t i = start; i < end; i++) {
+			auto offer = make_work_unit_offer(i);
+			MerkleWorkUnit::generate_key(offer, key);
+			trie.insert<RollbackInsertFn>(key, MerkleWorkUnit::TrieValueT(offer));
+		}
+		manager.add_offers(manager.look_up_idx(make_work_unit_offer(0).category), std::move(trie));
+	}
+
+public:
+	void test_order_independence() {
+		TEST_START();
+
+		MultisetHash h1, h2;
+		for (uint64_t i = 0; i < 20; i++) {
+			h1.insert_xdr(make_offer(i, i));
+		}
+		for (uint64_t i = 20; i > 0; i--) {
+			h2.insert_xdr(make_offer(i - 1, i - 1));
+		}
+		TS_ASSERT(h1 == h2);
+
+		//two accumulators combine to the same result
+		MultisetHash a, b;
+		for (uint64_t i = 0; i < 20; i++) {
+			if (i % 3 == 0) {
+				a.insert_xdr(make_offer(i, i));
+			} else {
+				b.insert_xdr(make_offer(i, i));
+			}
+		}
+		a += b;
+		TS_ASSERT(a == h1);
+
+		Hash d1, d2;
+		h1.digest(d1);
+		a.digest(d2);
+		TS_ASSERT(d1 == d2);
+	}
+
+	void test_remove() {
+		TEST_START();
+
+		MultisetHash empty, h;
+		h.insert_xdr(make_offer(1, 1));
+		h.insert_xdr(make_offer(2, 1));
+		TS_ASSERT(h != empty);
+
+		h.remove_xdr(make_offer(1, 1));
+		h.remove_xdr(make_offer(2, 1));
+		TS_ASSERT(h == empty);
+
+		//multiplicity matters
+		h.insert_xdr(make_offer(1, 1));
+		h.insert_xdr(make_offer(1, 1));
+		h.remove_xdr(make_offer(1, 1));
+		TS_ASSERT(h != empty);
+	}
+
+	void test_db_incremental_matches_rebuild() {
+		TEST_START();
+
+		MemoryDatabase db;
+		db.enable_multiset_commitment();
+
+		for (AccountID i = 0; i < 100; i++) {
+			db.add_account_to_db(i);
+		}
+		db.commit_new_accounts(0);
+
+		Hash initial;
+		db.produce_multiset_commitment(initial);
+
+		AccountModificationLog log;
+		{
+			SerialAccountModificationLog serial_log(log);
+			for (AccountID i = 0; i < 100; i += 7) {
+				account_db_idx idx;
+				TS_ASSERT(db.lookup_user_id(i, &idx));
+				db.transfer_available(idx, 1, 100 + i);
+				serial_log.log_self_modification(i, 1);
+			}
+		}
+		log.merge_in_log_batch();
+		db.commit_values();
+
+		Hash merkle_hash;
+		db.produce_state_commitment(merkle_hash, log);
+
+		Hash incremental;
+		db.produce_multiset_commitment(incremental);
+		TS_ASSERT(incremental != initial);
+
+		//rehashes every account from scratch
+		db.produce_state_commitment(merkle_hash);
+
+		Hash rebuilt;
+		db.produce_multiset_commitment(rebuilt);
+		TS_ASSERT(incremental == rebuilt);
+	}
+
+	void test_offer_multiset_after_rollback() {
+		TEST_START();
+
+		MerkleWorkUnitManager manager(2);
+		manager.enable_multiset_commitment();
+
+		add_validation_offers(manager, 1, 11);
+		manager.tentative_commit_for_validation(1);
+		manager.finalize_validation();
+
+		//block 2 is rejected
+		add_validation_offers(manager, 11, 16);
+		manager.tentative_commit_for_validation(2);
+		Hash rejected;
+		manager.produce_multiset_commitment(rejected);
+		manager.rollback_validation();
+
+		//a different block 2 is accepted
+		add_validation_offers(manager, 16, 21);
+		manager.tentative_commit_for_validation(2);
+		manager.finalize_validation();
+
+		Hash incremental;
+		manager.produce_multiset_commitment(incremental);
+		TS_ASSERT(incremental != rejected);
+
+		MerkleWorkUnitManager fresh(2);
+		add_validation_offers(fresh, 1, 11);
+		add_validation_offers(fresh, 16, 21);
+		fresh.commit_for_production(1);
+		//hashes every offer from scratch
+		fresh.enable_multiset_commitment();
+
+		Hash rebuilt;
+		fresh.produce_multiset_commitment(rebuilt);
+		TS_ASSERT(incremental == rebuilt);
+	}
+};
@@ -0,0 +1,114 @@
+#include <cxxtest/TestSuite.h>
+
+#include <cstdint>
+#include <cstdio>
+
+#include "merkle_work_unit_manager.h"
+#include "database.h"
+
+#include "xdr/transaction.h"
+
+#include "simple_debug.h"
+
+#include "price_utils.h"
+#include "tx_type_utils.h"
+
+#include "price_trace.h"
+
+using namespace edce;
+
+class PriceTraceTestSuite : public CxxTest::TestSuite {
+
+	void add_offer(ProcessingSerialManager& serial_manager, MerkleWorkUnitManager& manager, AssetID sell, AssetID buy, uint64_t offer_id, int64_t amount, double min_price) {
+		int x = 0;
+		Offer offer;
+		offer.category = TxTypeUtils::make_category(sell, buy, OfferType::SELL);
+		offer.offerId = offer_id;
+		offer.owner = 1;
+		offer.amount = amount;
+		offer.minPrice = PriceUtils::from_double(min_price);
+
+		auto offer_idx = manager.look_up_idx(offer.category);
+		serial_manager.add_offer(offer_idx, offer, x, x);
+	}
+
+public:
+
+	void test_replayed_index_gives_same_demands() {
+		TEST_START();
+
+		const char* filename = "price_trace_test";
+		std::remove(filename);
+
+		const uint8_t smooth_mult = 5;
+
+		MerkleWorkUnitManager manager(3);
+
+		ProcessingSerialManager serial_manager(manager);
+		for (uint64_t i = 0; i < 20; i++) {
+			add_offer(serial_manager, manager, 0, 1, 1000 + i, 100 + i, 0.5 + 0.1 * i);
+			add_offer(serial_manager, manager, 1, 2, 2000 + i, 300, 1.0 + 0.01 * i);
+			add_offer(serial_manager, manager, 2, 0, 3000 + i, 50, 0.2 + 0.3 * i);
+		}
+		serial_manager.finish_merge();
+		manager.commit_for_production(1);
+
+		Price prices[3] = {PriceUtils::from_double(1), PriceUtils::from_double(1.5), PriceUtils::from_double(0.7)};
+		uint16_t relativizers[3] = {1, 2, 3};
+
+		TatonnementMeasurements tat_res;
+		tat_res.num_rounds = 17;
+		BlockCreationMeasurements stats;
+		stats.achieved_feerate = 12;
+
+		{
+			PriceTraceRecorder recorder(filename);
+			recorder.begin_block(1, manager, prices, ApproximationParameters{.tax_rate = 10, .smooth_mult = smooth_mult}, relativizers);
+			recorder.finish_block(prices, tat_res, stats);
+			recorder.begin_block(2, manager, prices, ApproximationParameters{.tax_rate = 10, .smooth_mult = smooth_mult}, nullptr);
+			recorder.finish_block(prices, tat_res, stats);
+		}
+
+		PriceTraceReader reader(filename);
+		PriceComputationTrace trace;
+
+		TS_ASSERT(reader.next(trace));
+		TS_ASSERT_EQUALS(trace.blockNumber, 1u);
+		TS_ASSERT_EQUALS(trace.numAssets, 3u);
+		TS_ASSERT_EQUALS(trace.smoothMult, smooth_mult);
+		TS_ASSERT_EQUALS(trace.volumeRelativizers.size(), 3u);
+		TS_ASSERT_EQUALS(trace.tatonnement.num_rounds, 17u);
+		TS_ASSERT_EQUALS(trace.achievedFeeRate, 12u);
+
+		MerkleWorkUnitManager replay_manager(3);
+		load_price_trace_indices(trace, replay_manager);
+
+		TS_ASSERT_EQUALS(replay_manager.get_total_nnz(), manager.get_total_nnz());
+
+		for (double scale : {0.3, 1.0, 4.0}) {
+			Price query[3] = {PriceUtils::from_double(scale), PriceUtils::from_double(1), PriceUtils::from_double(2)};
+
+			uint128_t demands[3] = {0, 0, 0}, supplies[3] = {0, 0, 0};
+			uint128_t replay_demands[3] = {0, 0, 0}, replay_supplies[3] = {0, 0, 0};
+
+			for (auto& work_unit : manager.get_work_units()) {
+				work_unit.calculate_demands_and_supplies(query, demands, supplies, smooth_mult);
+			}
+			for (auto& work_unit : replay_manager.get_work_units()) {
+				work_unit.calculate_demands_and_supplies(query, replay_demands, replay_supplies, smooth_mult);
+			}
+			for (size_t i = 0; i < 3; i++) {
+				TS_ASSERT(demands[i] == replay_demands[i]);
+				TS_ASSERT(supplies[i] == replay_supplies[i]);
+			}
+		}
+
+		TS_ASSERT(reader.next(trace));
+		TS_ASSERT_EQUALS(trace.blockNumber, 2u);
+		TS_ASSERT_EQUALS(trace.volumeRelativizers.size(), 0u);
+
+		TS_ASSERT(!reader.next(trace));
+
+		std::remove(filename);
+	}
+};
@@ -0,0 +1,172 @@
+#include <cxxtest/TestSuite.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "span_tracer.h"
+#include "simple_debug.h"
+
+#include "rpc/metrics_api.h"
+
+using namespace edce;
+
+class SpanTracerTestSuite : public CxxTest::TestSuite {
+
+	const std::string filename = "test_span_trace.json";
+
+	static size_t count_named(const std::vector<SpanTraceEvent>& events, const char* name) {
+		size_t count = 0;
+		for (auto& event : events) {
+			if (std::strcmp(event.name, name) == 0) {
+				count++;
+			}
+		}
+		return count;
+	}
+
+public:
+
+	void tearDown() {
+		SpanTracer::global().enable(false);
+		std::remove(filename.c_str());
+	}
+
+	void test_disabled() {
+		TEST_START();
+
+		auto& tracer = SpanTracer::global();
+		tracer.enable(false);
+		tracer.set_current_block(1);
+		{
+			TraceSpan span("test_disabled_span");
+		}
+		TS_ASSERT_EQUALS(count_named(tracer.collect(0), "test_disabled_span"), 0);
+	}
+
+	void test_last_blocks() {
+		TEST_START();
+
+		auto& tracer = SpanTracer::global();
+		tracer.enable();
+
+		for (uint64_t block = 100; block < 110; block++) {
+			tracer.set_current_block(block);
+			TraceSpan outer("test_block");
+			TracePhases phases(block);
+			{
+				TraceSpan inner("test_inner");
+			}
+			phases.end_phase("test_phase_1");
+			phases.end_phase("test_phase_2");
+		}
+
+		auto events = tracer.collect(3);
+		TS_ASSERT_EQUALS(count_named(events, "test_block"), 3);
+		TS_ASSERT_EQUALS(count_named(events, "test_phase_2"), 3);
+		for (auto& event : events) {
+			TS_ASSERT(event.block_number >= 107);
+		}
+		for (size_t i = 1; i < events.size(); i++) {
+			TS_ASSERT(events[i-1].start_ns <= events[i].start_ns);
+		}
+
+		TS_ASSERT_EQUALS(count_named(tracer.collect(0), "test_block"), 10);
+	}
+
+	void test_threads_and_wraparound() {
+		TEST_START();
+
+		auto& tracer = SpanTracer::global();
+		tracer.enable();
+		tracer.set_current_block(200);
+
+		const size_t num_spans = SpanTracer::BUFFER_CAPACITY + 100;
+		const size_t num_threads = 4;
+
+		//every thread takes its buffer (set_thread_name does, while enabled) before any exits,
+		//so that no buffer is handed from one to another
+		std::atomic<size_t> num_started = 0;
+
+		std::vector<std::thread> threads;
+		for (size_t i = 0; i < num_threads; i++) {
+			threads.emplace_back([&num_started, num_spans, num_threads] {
+				span_tracer_set_thread_name("test_thread");
+				num_started++;
+				while (num_started.load() < num_threads) {
+					std::this_thread::yield();
+				}
+				for (size_t j = 0; j < num_spans; j++) {
+					TraceSpan span("test_thread_span");
+				}
+			});
+		}
+		//concurrent reads see only complete spans
+		for (size_t i = 0; i < 10; i++) {
+			auto events = tracer.collect(1);
+			for (auto& event : events) {
+				TS_ASSERT(event.name != nullptr);
+				TS_ASSERT_EQUALS(event.block_number, 200);
+			}
+		}
+		for (auto& th : threads) {
+			th.join();
+		}
+
+		//each ring keeps only its last BUFFER_CAPACITY spans
+		TS_ASSERT_EQUALS(count_named(tracer.collect(1), "test_thread_span"), num_threads * SpanTracer::BUFFER_CAPACITY);
+	}
+
+	void test_chrome_trace_file() {
+		TEST_START();
+
+		auto& tracer = SpanTracer::global();
+		tracer.enable();
+		tracer.set_current_block(300);
+		{
+			TraceSpan span("test_file_span", 300);
+		}
+
+		size_t num_written = tracer.write_chrome_trace(filename, 1);
+		TS_ASSERT_EQUALS(num_written, 1);
+
+		std::FILE* f = std::fopen(filename.c_str(), "r");
+		TS_ASSERT(f != nullptr);
+		char buf[64];
+		TS_ASSERT(std::fgets(buf, sizeof(buf), f) != nullptr);
+		TS_ASSERT(std::strncmp(buf, "{\"displayTimeUnit\"", 18) == 0);
+		std::fclose(f);
+	}
+
+	void test_rpc_dump_stays_in_results_dir() {
+		TEST_START();
+
+		auto& tracer = SpanTracer::global();
+		tracer.enable();
+		tracer.set_current_block(400);
+		{
+			TraceSpan span("test_rpc_span", 400);
+		}
+
+		MetricsV1_server server("./");
+
+		for (std::string bad_name : {"", ".", "..", "../test_span_trace.json", "/tmp/test_span_trace.json", "sub/test_span_trace.json"}) {
+			SpanTraceDumpRequest request;
+			request.filename = bad_name;
+			request.num_blocks = 1;
+			TS_ASSERT_EQUALS(*server.dump_span_trace(request), -1);
+		}
+
+		SpanTraceDumpRequest request;
+		request.filename = filename;
+		request.num_blocks = 1;
+		TS_ASSERT_EQUALS(*server.dump_span_trace(request), 1);
+
+		std::FILE* f = std::fopen(filename.c_str(), "r");
+		TS_ASSERT(f != nullptr);
+		std::fclose(f);
+	}
+};
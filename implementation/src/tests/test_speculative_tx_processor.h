@@ -0,0 +1,171 @@
+#include <cxxtest/TestSuite.h>
+
+#include <cstdint>
+#include <cstdio>
+
+#include "block_producer.h"
+#include "edce_management_structures.h"
+#include "memory_database.h"
+#include "mempool.h"
+#include "mempool_admission.h"
+#include "speculative_tx_processor.h"
+#include "verified_transaction_cache.h"
+#include "simple_debug.h"
+
+#include "xdr/transaction.h"
+
+#include "tests/block_processor_test_utils.h"
+
+using namespace edce;
+
+class SpeculativeTxProcessorTestSuite : public CxxTest::TestSuite {
+
+	//10001 has 1000 of asset 0, 20002 has 1000 of asset 1
+	static void fill_mempool(Mempool& mempool) {
+		std::vector<SignedTransaction> txs;
+		txs.push_back(BlockProcessorTestUtils::make_payment_tx(10001, 1, 20002, 0, 500));
+		//more than 10001 could ever have
+		txs.push_back(BlockProcessorTestUtils::make_payment_tx(10001, 2, 20002, 0, 5000));
+		//20002 has none of asset 0, but could be paid some by 10001 first
+		txs.push_back(BlockProcessorTestUtils::make_payment_tx(20002, 1, 10001, 0, 600));
+		txs.push_back(BlockProcessorTestUtils::make_payment_tx(20002, 0, 10001, 1, 10));
+		mempool.add_to_mempool_buffer(std::move(txs));
+		mempool.push_mempool_buffer_to_mempool();
+	}
+
+public:
+	void test_predicted_failures() {
+		TEST_START();
+
+		MemoryDatabase db;
+		BlockProcessorTestUtils::init_simple(db);
+
+		Mempool mempool(100);
+		fill_mempool(mempool);
+
+		VerifiedTransactionCache cache;
+		MempoolAdmissionChecker checker(db, cache, 2, false);
+		SpeculativeTxProcessor speculation(mempool, db, checker);
+
+		{
+			auto lock = mempool.lock_mempool();
+			speculation.speculate(1000);
+		}
+
+		SpeculationMeasurements measurements;
+		speculation.validate_and_decide(measurements);
+
+		TS_ASSERT_EQUALS(4, measurements.num_speculated_txs);
+		TS_ASSERT_EQUALS(0, measurements.num_conflicted_accounts);
+		TS_ASSERT_EQUALS(1, measurements.num_predicted_drops);
+		TS_ASSERT_EQUALS(1, measurements.num_predicted_deferrals);
+		TS_ASSERT(speculation.has_deferrals());
+
+		auto* decisions = speculation.get_decisions(0, 4);
+		TS_ASSERT(decisions != nullptr);
+
+		TS_ASSERT_EQUALS(SPECULATION_REPLAY, (*decisions)[0]);
+		//a tx that was not speculated could still pay 10001
+		TS_ASSERT_EQUALS(SPECULATION_DEFER, (*decisions)[1]);
+		TS_ASSERT_EQUALS(SPECULATION_REPLAY, (*decisions)[2]);
+		TS_ASSERT_EQUALS(SPECULATION_DROP, (*decisions)[3]); // seq num too low
+
+		//chunk changed since speculation
+		TS_ASSERT(speculation.get_decisions(0, 5) == nullptr);
+	}
+
+	void test_conflict_forces_replay() {
+		TEST_START();
+
+		MemoryDatabase db;
+		BlockProcessorTestUtils::init_simple(db);
+
+		Mempool mempool(100);
+		fill_mempool(mempool);
+
+		VerifiedTransactionCache cache;
+		MempoolAdmissionChecker checker(db, cache, 2, false);
+		SpeculativeTxProcessor speculation(mempool, db, checker);
+
+		{
+			auto lock = mempool.lock_mempool();
+			speculation.speculate(1000);
+		}
+
+		//as if offer clearing paid out to 10001 after speculation read its balance
+		account_db_idx idx;
+		TS_ASSERT(db.lookup_user_id(10001, &idx));
+		db.transfer_available(idx, 0, 10000);
+
+		SpeculationMeasurements measurements;
+		speculation.validate_and_decide(measurements);
+
+		TS_ASSERT_EQUALS(1, measurements.num_conflicted_accounts);
+		//tx 1 from the conflict, tx 2 as before
+		TS_ASSERT_EQUALS(2, measurements.num_replayed_failures);
+
+		auto* decisions = speculation.get_decisions(0, 4);
+		TS_ASSERT(decisions != nullptr);
+		TS_ASSERT_EQUALS(SPECULATION_REPLAY, (*decisions)[1]);
+		TS_ASSERT_EQUALS(SPECULATION_DROP, (*decisions)[3]);
+	}
+
+	void test_unspeculated_credits_rescue_deferred_tx() {
+		TEST_START();
+
+		EdceManagementStructures management_structures(10, ApproximationParameters{1, 1});
+		auto& db = management_structures.db;
+		BlockProcessorTestUtils::init_simple(db);
+
+		auto third_idx = db.add_account_to_db(30003);
+		db.commit(0);
+		db.transfer_available(third_idx, 1, 1000);
+		db.commit(0);
+
+		Mempool mempool(100);
+		{
+			std::vector<SignedTransaction> txs;
+			//20002 only has 1000 of asset 1
+			txs.push_back(BlockProcessorTestUtils::make_payment_tx(20002, 1, 10001, 1, 1500));
+			mempool.add_to_mempool_buffer(std::move(txs));
+			mempool.push_mempool_buffer_to_mempool();
+		}
+
+		VerifiedTransactionCache cache;
+		MempoolAdmissionChecker checker(db, cache, 2, false);
+		SpeculativeTxProcessor speculation(mempool, db, checker);
+
+		{
+			auto lock = mempool.lock_mempool();
+			speculation.speculate(1000);
+		}
+
+		SpeculationMeasurements measurements;
+		speculation.validate_and_decide(measurements);
+		TS_ASSERT_EQUALS(1, measurements.num_predicted_deferrals);
+
+		//arrives after speculation, and covers the payment above
+		{
+			std::vector<SignedTransaction> txs;
+			txs.push_back(BlockProcessorTestUtils::make_payment_tx(30003, 1, 20002, 1, 1000));
+			mempool.add_to_mempool_buffer(std::move(txs));
+			mempool.push_mempool_buffer_to_mempool();
+		}
+
+		BlockProducer producer(management_structures, true);
+		BlockCreationMeasurements creation_measurements;
+		BlockStateUpdateStatsWrapper state_update_stats;
+		uint32_t num_drops = 0;
+
+		auto block_size = producer.build_block(mempool, 100, creation_measurements, state_update_stats, &speculation, &num_drops);
+
+		TS_ASSERT_EQUALS(2, block_size);
+		TS_ASSERT_EQUALS(0, num_drops);
+
+		account_db_idx idx;
+		TS_ASSERT(db.lookup_user_id(20002, &idx));
+		TS_ASSERT_EQUALS(500, db.lookup_available_balance(idx, 1));
+		TS_ASSERT(db.lookup_user_id(10001, &idx));
+		TS_ASSERT_EQUALS(1500, db.lookup_available_balance(idx, 1));
+	}
+};
@@ -0,0 +1,86 @@
+#include <cxxtest/TestSuite.h>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "synthetic_data_generator/workload_distributions.h"
+#include "simple_debug.h"
+
+using namespace edce;
+
+class WorkloadDistributionsTestSuite : public CxxTest::TestSuite {
+
+public:
+
+	void test_zipf_probabilities() {
+		TEST_START();
+
+		ZipfDistribution dist(1000, 1.2);
+		TS_ASSERT_EQUALS(dist.size(), 1000);
+
+		double sum = 0;
+		for (size_t k = 0; k < dist.size(); k++) {
+			sum += dist.probability(k);
+			if (k > 0) {
+				TS_ASSERT(dist.probability(k) <= dist.probability(k - 1));
+			}
+		}
+		TS_ASSERT_DELTA(sum, 1.0, 1e-9);
+
+		//P(k) / P(0) = 1/(k+1)^exponent
+		TS_ASSERT_DELTA(dist.probability(1) / dist.probability(0), std::pow(2.0, -1.2), 1e-9);
+	}
+
+	void test_zipf_sampling() {
+		TEST_START();
+
+		ZipfDistribution dist(100, 1.0);
+		std::minstd_rand gen(1);
+
+		const size_t num_samples = 200'000;
+		std::vector<size_t> counts(dist.size(), 0);
+		for (size_t i = 0; i < num_samples; i++) {
+			size_t rank = dist(gen);
+			TS_ASSERT(rank < dist.size());
+			counts[rank]++;
+		}
+		TS_ASSERT_DELTA(((double) counts[0]) / num_samples, dist.probability(0), 0.01);
+		TS_ASSERT_DELTA(((double) counts[9]) / num_samples, dist.probability(9), 0.005);
+
+		std::minstd_rand gen1(7), gen2(7);
+		for (size_t i = 0; i < 1000; i++) {
+			TS_ASSERT_EQUALS(dist(gen1), dist(gen2));
+		}
+	}
+
+	void test_burst_schedule() {
+		TEST_START();
+
+		std::minstd_rand gen(3);
+		BurstSchedule calm(1000, 0.0, 1.0, 4.0);
+		for (size_t i = 0; i < 100; i++) {
+			TS_ASSERT_EQUALS(calm.next_block_size(gen), 1000);
+		}
+
+		BurstSchedule always(1000, 1.0, 0.0, 4.0);
+		for (size_t i = 0; i < 100; i++) {
+			TS_ASSERT_EQUALS(always.next_block_size(gen), 4000);
+			TS_ASSERT(always.is_bursting());
+		}
+
+		BurstSchedule schedule1(1000, 0.1, 0.5, 2.5), schedule2(1000, 0.1, 0.5, 2.5);
+		std::minstd_rand gen1(5), gen2(5);
+		size_t num_bursts = 0;
+		for (size_t i = 0; i < 10'000; i++) {
+			size_t size = schedule1.next_block_size(gen1);
+			TS_ASSERT_EQUALS(size, schedule2.next_block_size(gen2));
+			TS_ASSERT(size == 1000 || size == 2500);
+			if (size == 2500) {
+				num_bursts++;
+			}
+		}
+		//stationary burst fraction is 0.1 / (0.1 + 0.5)
+		TS_ASSERT_DELTA(((double) num_bursts) / 10'000, 1.0 / 6, 0.03);
+	}
+};
@@ -0,0 +1,163 @@
+#include <cxxtest/TestSuite.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "synthetic_data_generator/workload_generator.h"
+#include "simple_debug.h"
+
+#include <xdrpp/marshal.h>
+
+using namespace edce;
+
+class WorkloadGeneratorTestSuite : public CxxTest::TestSuite {
+
+	const std::string params_filename = "test_workload_generator_params.yaml";
+
+	constexpr static uint32_t NUM_SHARDS = 3;
+	constexpr static size_t NUM_BLOCKS = 4;
+
+	using generator_t = GeneratorState<std::minstd_rand>;
+
+	//hot enough that the top accounts would send far more than the sequence number window per block
+	GenerationOptions make_options() {
+		std::ofstream params(params_filename);
+		params << "experiment:\n"
+			"  output_prefix: \"unused/\"\n"
+			"  num_assets: 5\n"
+			"  num_accounts: 900\n"
+			"  account_dist_param: 0.01\n"
+			"  block_size: 3000\n"
+			"  num_blocks: 4\n"
+			"  bad_tx_fraction: 0.1\n"
+			"  prices:\n"
+			"    price_tolerance_min: 0.00\n"
+			"    price_tolerance_max: 0.02\n"
+			"    price_min: 1\n"
+			"    price_max: 100\n"
+			"    exp_param: 0.0\n"
+			"    per_block_delta: 0.05\n"
+			"  cycle_size_dist:\n"
+			"    dist_max: 3\n"
+			"    2: 1\n"
+			"    3: 0.5\n"
+			"  block_boundary_crossing_fraction: 0.01\n"
+			"  initial_endow_min: 1000\n"
+			"  initial_endow_max: 10000\n"
+			"  payment_rate: 1.0\n"
+			"  create_offer_rate: 1.0\n"
+			"  account_creation_rate: 0.01\n"
+			"  new_account_balance: 100000000\n"
+			"  cancel_delay_rounds_min: 1\n"
+			"  cancel_delay_rounds_max: 2\n"
+			"  bad_offer_cancel_chance: 0.8\n"
+			"  good_offer_cancel_chance: 0.1\n"
+			"  do_shuffle: 1\n"
+			"  workload:\n"
+			"    seed: 17\n"
+			"    num_generator_threads: 3\n"
+			"    account_dist: zipf\n"
+			"    zipf_exponent: 2.0\n"
+			"    num_market_makers: 2\n"
+			"    market_maker_offer_fraction: 0.3\n"
+			"    market_maker_replace_chance: 0.5\n"
+			"    burst_start_chance: 0.5\n"
+			"    burst_end_chance: 0.5\n"
+			"    burst_multiplier: 2.0\n";
+		params.close();
+
+		GenerationOptions options;
+		TS_ASSERT(options.parse(params_filename.c_str()));
+		return options;
+	}
+
+	std::vector<ExperimentBlock> make_blocks(const GenerationOptions& options) {
+		ParallelWorkloadGenerator generator(options);
+		std::vector<double> prices = {1, 2, 3, 4, 5};
+
+		std::vector<ExperimentBlock> out;
+		for (size_t i = 0; i < NUM_BLOCKS; i++) {
+			out.push_back(generator.make_block(prices));
+		}
+		return out;
+	}
+
+public:
+
+	void tearDown() {
+		std::remove(params_filename.c_str());
+	}
+
+	void test_deterministic_for_seed() {
+		TEST_START();
+
+		auto options = make_options();
+
+		auto blocks = make_blocks(options);
+		auto again = make_blocks(options);
+
+		TS_ASSERT_EQUALS(blocks.size(), again.size());
+		for (size_t i = 0; i < blocks.size(); i++) {
+			TS_ASSERT(blocks[i].size() > 0);
+			TS_ASSERT(xdr::xdr_to_opaque(blocks[i]) == xdr::xdr_to_opaque(again[i]));
+		}
+
+		options.workload.seed++;
+		auto other_seed = make_blocks(options);
+		TS_ASSERT(xdr::xdr_to_opaque(blocks[0]) != xdr::xdr_to_opaque(other_seed[0]));
+	}
+
+	void test_shards_disjoint() {
+		TEST_START();
+
+		auto options = make_options();
+
+		//shard i only makes account ids equal to i mod NUM_SHARDS
+		for (auto& block : make_blocks(options)) {
+			for (auto& tx : block) {
+				AccountID source = tx.transaction.metadata.sourceAccount;
+				for (auto& op : tx.transaction.operations) {
+					if (op.body.type() == PAYMENT) {
+						TS_ASSERT_EQUALS(op.body.paymentOp().receiver % NUM_SHARDS, source % NUM_SHARDS);
+					} else if (op.body.type() == CREATE_ACCOUNT) {
+						TS_ASSERT_EQUALS(op.body.createAccountOp().newAccountId % NUM_SHARDS, source % NUM_SHARDS);
+					}
+				}
+			}
+		}
+	}
+
+	void test_txs_per_account_within_sequence_window() {
+		TEST_START();
+
+		auto options = make_options();
+
+		std::unordered_map<AccountID, uint64_t> last_seq_nums;
+
+		uint32_t max_count = 0;
+		for (auto& block : make_blocks(options)) {
+			std::unordered_map<AccountID, uint32_t> counts;
+			std::unordered_map<AccountID, uint64_t> max_seq_nums;
+			for (auto& tx : block) {
+				AccountID source = tx.transaction.metadata.sourceAccount;
+				uint32_t count = ++counts[source];
+				max_count = std::max(max_count, count);
+
+				//every sequence number fits in the window past the last block's
+				uint64_t seq_num = tx.transaction.metadata.sequenceNumber >> 8;
+				TS_ASSERT(seq_num > last_seq_nums[source]);
+				TS_ASSERT(seq_num <= last_seq_nums[source] + generator_t::MAX_TXS_PER_ACCOUNT_PER_BLOCK);
+				max_seq_nums[source] = std::max(max_seq_nums[source], seq_num);
+			}
+			for (auto& [account, seq_num] : max_seq_nums) {
+				last_seq_nums[account] = seq_num;
+			}
+		}
+		//the hottest accounts hit the cap
+		TS_ASSERT_EQUALS(max_count, generator_t::MAX_TXS_PER_ACCOUNT_PER_BLOCK);
+	}
+};
@@ -5,7 +5,7 @@ namespace edce {
 TransactionBufferManager::buffer_ptr TransactionBufferManager::get_empty_buffer() {
 	std::lock_guard lock(modify_mtx);
 	if (empty_buffers.empty()) {
-		return std::make_unique<buffer_type>(); 
+		return std::make_unique<buffer_type>(buf_size);
 	}
 	auto output = std::move(empty_buffers.back());
 	empty_buffers.pop_back();
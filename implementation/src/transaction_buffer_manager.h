@@ -2,28 +2,28 @@
 
 #include "xdr/transaction.h"
 
-#include <array>
 #include <atomic>
 #include <cstdint>
+#include <memory>
 #include <mutex>
 #include <condition_variable>
+#include <vector>
 
 namespace edce {
 
-template<unsigned int buf_size>
 class TransactionBuffer {
-	using buffer_type = std::array<SignedTransaction, buf_size>;
+	using buffer_type = std::vector<SignedTransaction>;
 
 	buffer_type transactions;
 	unsigned int idx;
 public:
-	TransactionBuffer() : transactions(), idx(0) {}
+	TransactionBuffer(size_t buf_size) : transactions(buf_size), idx(0) {}
 
 	//returns true if this call to insert filled buffer
 	bool insert(const SignedTransaction& tx) {
 		transactions[idx] = tx;
 		idx++;
-		return idx >= buf_size;
+		return idx >= transactions.size();
 	}
 
 	//empty is true if this call empties buffer
@@ -42,10 +42,12 @@ class TransactionBufferManager {
 	constexpr static int MAX_NUM_BUFFERS = 20;
 
 public:
-	constexpr static int BUF_SIZE = 10000;
-	using buffer_type = TransactionBuffer<BUF_SIZE>;
+	constexpr static size_t DEFAULT_BUF_SIZE = 10000;
+	using buffer_type = TransactionBuffer;
 	using buffer_ptr = std::unique_ptr<buffer_type>;
 private:
+	const size_t buf_size;
+
 	std::mutex modify_mtx, full_buffer_return_wait_mtx, full_buffer_get_wait_mtx;
 	std::condition_variable cv_wait_full_return, cv_wait_full_get;
 
@@ -54,6 +56,13 @@ private:
 
 public:
 
+	TransactionBufferManager(size_t buf_size = DEFAULT_BUF_SIZE)
+		: buf_size(buf_size) {}
+
+	size_t get_buf_size() const {
+		return buf_size;
+	}
+
 	buffer_ptr get_empty_buffer();
 	void return_empty_buffer(buffer_ptr ptr);
 	
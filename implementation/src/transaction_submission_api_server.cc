@@ -0,0 +1,15 @@
+#include "transaction_submission_api_server.h"
+
+namespace edce {
+
+TransactionSubmissionApiServer::TransactionSubmissionApiServer(EdceNode& main_node)
+	: submit_server(main_node)
+	, ps()
+	, submit_listener(ps, tcp_listen_on_node_address(TRANSACTION_SUBMISSION_PORT), false, xdr::session_allocator<void>()) {
+		submit_listener.register_service(submit_server);
+
+		std::thread th([this] {ps.run();});
+		th.detach();
+	}
+
+} /* edce */
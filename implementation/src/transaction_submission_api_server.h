@@ -0,0 +1,31 @@
+#pragma once
+
+#include "edce_node.h"
+#include "rpc/rpcconfig.h"
+#include "rpc/listen_address.h"
+#include "rpc/transaction_submission_api.h"
+#include "xdr/transaction_submission_api.h"
+
+#include <xdrpp/srpc.h>
+#include <xdrpp/pollset.h>
+
+namespace edce {
+
+//Accepts tx submissions (single or batched) on TRANSACTION_SUBMISSION_PORT
+//and forwards them into a block producer's mempool.
+class TransactionSubmissionApiServer {
+
+	using SubmitTransaction = MempoolSubmitTransactionV1_server;
+
+	SubmitTransaction submit_server;
+
+	xdr::pollset ps;
+
+	xdr::srpc_tcp_listener<> submit_listener;
+
+public:
+
+	TransactionSubmissionApiServer(EdceNode& main_node);
+};
+
+} /* edce */
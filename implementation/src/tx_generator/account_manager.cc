@@ -1,5 +1,7 @@
 #include "account_manager.h"
 
+#include <xdrpp/marshal.h>
+
 namespace txgen {
 
 void AccountManager::generate_transactions_underlying_prices(int num_txs) {
@@ -10,18 +12,38 @@ void AccountManager::create_accounts(int num_new_accounts, edce::AccountID start
 
 	auto& local_root = accounts.at(local_root_account);
 
+	edce::SignedTransactionList batch;
+
 	for (int i = 0; i < num_new_accounts; i++) {
 		edce::PublicKey pk;
 		edce::SigningKey sk;
 
 		crypto_sign_keypair(sk.data(), pk.data());
 
-		auto tx = builder.create_new_account_tx(local_root.sk, local_root_account, local_root.seq_num, pk, starting_id + i, NEW_ACCOUNT_WITHDRAW_AMT, num_assets);
-
-		client.submit_transaction(tx);
+		batch.push_back(builder.create_new_account_tx(local_root.sk, local_root_account, local_root.seq_num, pk, starting_id + i, NEW_ACCOUNT_WITHDRAW_AMT, num_assets));
 
 		accounts.insert({starting_id + i, CachedAccount(num_assets, sk, NEW_ACCOUNT_WITHDRAW_AMT)});
+
+		if (batch.size() >= SUBMISSION_BATCH_SIZE) {
+			submit_batch(batch, client);
+		}
+	}
+	submit_batch(batch, client);
+}
+
+void AccountManager::submit_batch(edce::SignedTransactionList& batch, xdr::srpc_client<edce::SubmitTransactionV1>& client) {
+	if (batch.size() == 0) {
+		return;
+	}
+
+	edce::SerializedBlock serialized_batch = xdr::xdr_to_opaque(batch);
+
+	auto res = client.submit_transaction_batch(serialized_batch);
+
+	if (res->num_accepted != batch.size()) {
+		std::printf("only %u of %lu submitted txs accepted\n", res->num_accepted, batch.size());
 	}
+	batch.clear();
 }
 
 void AccountManager::init(xdr::srpc_client<edce::SubmitTransactionV1>& client, uint64_t& global_root_seqnum) {
@@ -36,9 +58,12 @@ void AccountManager::init(xdr::srpc_client<edce::SubmitTransactionV1>& client, u
 
 	accounts.insert({local_root_account, CachedAccount(num_assets, sk, LOCAL_ROOT_WITHDRAW_AMT)});
 
+	edce::SignedTransactionList batch;
+
 	for (int i = 1; i < 10000; i++) {
-		client.submit_transaction(builder.empty_transaction(global_root_sk, 0, global_root_seqnum));
+		batch.push_back(builder.empty_transaction(global_root_sk, 0, global_root_seqnum));
 	}
+	submit_batch(batch, client);
 }
 
 
@@ -6,6 +6,7 @@
 
 #include "../xdr/types.h"
 #include "../xdr/transaction.h"
+#include "../xdr/block.h"
 
 #include "../xdr/transaction_submission_api.h"
 #include "../xdr/server_control_api.h"
@@ -42,11 +43,15 @@ class AccountManager {
 
 	int num_assets;
 
+	//submits and then clears batch
+	void submit_batch(edce::SignedTransactionList& batch, xdr::srpc_client<edce::SubmitTransactionV1>& client);
+
 
 public:
 
 	static constexpr int64_t NEW_ACCOUNT_WITHDRAW_AMT = 1000000;
 	static constexpr int64_t LOCAL_ROOT_WITHDRAW_AMT = NEW_ACCOUNT_WITHDRAW_AMT * 1000000;
+	static constexpr size_t SUBMISSION_BATCH_SIZE = 10000;
 
 	AccountManager(
 		edce::SigningKey& root_sk, 
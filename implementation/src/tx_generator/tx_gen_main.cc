@@ -1,20 +1,94 @@
 #include "account_manager.h"
 
 #include <xdrpp/srpc.h>
+#include <xdrpp/marshal.h>
 #include "../xdr/server_control_api.h"
 #include "../xdr/transaction_submission_api.h"
+#include "../xdr/experiments.h"
 #include "../rpc/rpcconfig.h"
 
 #include "../edce_options.h"
+#include "../utils.h"
+
+#include <algorithm>
 
 using namespace txgen;
 
+//Replays experiment tx files (<data_directory>/<n>.txs) into a producer's
+//submission api in pre-serialized batches, and reports sustained submissions/sec.
+int run_load_generator(std::string experiment_data_root, size_t batch_size, size_t num_blocks, const char* hostname) {
+
+	std::vector<edce::SerializedBlock> batches;
+	size_t total_txs = 0;
+
+	for (size_t block_number = 1; block_number <= num_blocks; block_number++) {
+		auto filename = experiment_data_root + std::to_string(block_number) + ".txs";
+
+		edce::ExperimentBlock data;
+		if (edce::load_xdr_from_file(data, filename.c_str())) {
+			std::printf("could not load %s, stopping at %lu blocks\n", filename.c_str(), block_number - 1);
+			break;
+		}
+
+		for (size_t i = 0; i < data.size(); i += batch_size) {
+			edce::SignedTransactionList batch;
+			batch.insert(
+				batch.end(), 
+				data.begin() + i, 
+				data.begin() + std::min(data.size(), i + batch_size));
+			batches.push_back(xdr::xdr_to_opaque(batch));
+			total_txs += batch.size();
+		}
+	}
+
+	if (batches.size() == 0) {
+		std::printf("no txs to submit\n");
+		return -1;
+	}
+
+	auto submit_fd = xdr::tcp_connect(hostname, TRANSACTION_SUBMISSION_PORT);
+	xdr::srpc_client<edce::SubmitTransactionV1> submit_c{submit_fd.get()};
+
+	std::vector<double> latencies;
+	size_t num_accepted = 0;
+
+	auto start_time = edce::init_time_measurement();
+
+	for (auto& batch : batches) {
+		auto batch_ts = edce::init_time_measurement();
+		auto res = submit_c.submit_transaction_batch(batch);
+		latencies.push_back(edce::measure_time(batch_ts));
+		num_accepted += res->num_accepted;
+	}
+
+	double total_time = edce::measure_time_from_basept(start_time);
+
+	std::sort(latencies.begin(), latencies.end());
+
+	std::printf("submitted %lu txs (%lu accepted) in %lu batches of <= %lu in %lf s\n", 
+		total_txs, num_accepted, batches.size(), batch_size, total_time);
+	std::printf("sustained rate: %lf submissions/s (%lf accepted/s)\n", 
+		total_txs / total_time, num_accepted / total_time);
+	std::printf("batch latency: p50 %lf p99 %lf max %lf\n", 
+		latencies[latencies.size() / 2], 
+		latencies[(latencies.size() * 99) / 100], 
+		latencies.back());
+	return 0;
+}
+
 int main(int argc, char const *argv[])
 {
 
+	if (argc >= 5 && std::string(argv[1]) == "load") {
+		const char* hostname = (argc >= 6) ? argv[5] : "localhost";
+		return run_load_generator(std::string(argv[2]) + "/", std::stoi(argv[3]), std::stoi(argv[4]), hostname);
+	}
+
 	edce::EdceOptions options;
 
 	if (argc != 2) {
+		std::printf("usage: ./tx_gen <options yaml>\n");
+		std::printf("       ./tx_gen load <data_directory> <batch_size> <num_blocks> [hostname]\n");
 		throw std::runtime_error("need options yaml");
 	}
 
@@ -46,4 +120,4 @@ int main(int argc, char const *argv[])
 
 
 	return 0;
-}
\ No newline at end of file
+}
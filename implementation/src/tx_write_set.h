@@ -0,0 +1,25 @@
+#pragma once
+
+#include "xdr/transaction.h"
+#include "xdr/types.h"
+
+namespace edce {
+
+/*
+Calls func on every account whose balances a tx can modify:
+its source account, and the receiver of each of its payments.
+(New accounts get their starting balance from the source account, and
+offers only escrow from the source; the orderbooks are handled separately.)
+Accounts may be visited more than once.
+*/
+template<typename F>
+static inline void for_each_written_account(const Transaction& tx, F&& func) {
+	func(tx.metadata.sourceAccount);
+	for (auto& op : tx.operations) {
+		if (op.body.type() == PAYMENT) {
+			func(op.body.paymentOp().receiver);
+		}
+	}
+}
+
+} /* edce */
@@ -8,6 +8,7 @@
 #include <unordered_map>
 #include <atomic>
 
+#include "contention_counters.h"
 #include "revertable_asset.h"
 
 #include "xdr/types.h"
@@ -59,7 +60,7 @@ class UserAccount {
 		return_type (*func)(RevertableAsset&, const amount_t&)) {
 		unsigned int owned_assets_size = owned_assets.size();
 		if (asset >= owned_assets_size) {
-			std::lock_guard<std::mutex> lock(uncommitted_assets_mtx);
+			auto lock = lock_counting_contention(uncommitted_assets_mtx);
 			while (asset >= owned_assets_size + uncommitted_assets.size()) {
 				uncommitted_assets.emplace_back();
 			}
@@ -71,7 +72,7 @@ class UserAccount {
 	void operate_on_asset(unsigned int asset, amount_t amount, void (*func)(RevertableAsset&, const amount_t&)) {
 		unsigned int owned_assets_size = owned_assets.size();
 		if (asset >= owned_assets_size) {
-			std::lock_guard lock(uncommitted_assets_mtx);
+			auto lock = lock_counting_contention(uncommitted_assets_mtx);
 			while (asset >= owned_assets_size + uncommitted_assets.size()) {
 				uncommitted_assets.emplace_back();
 			}
@@ -174,6 +175,11 @@ public:
 		return owner;
 	}
 
+	//only changes in commit(), which the db runs under an exclusive lock.
+	uint64_t get_last_committed_seq_num() const {
+		return last_committed_id;
+	}
+
 	void stringify() const {
 		for (auto& asset : owned_assets) {
 			asset.stringify();		}
@@ -205,6 +211,20 @@ public:
 		return operate_on_asset<amount_t>(asset, unused, [] (RevertableAsset& asset, [[maybe_unused]] const amount_t& amount) {return asset.lookup_available_balance();});
 	}
 
+	//unlike lookup_available_balance, never creates an (uncommitted) entry for an asset the account lacks,
+	//so reading does not change the account's commitment.
+	amount_t peek_available_balance(unsigned int asset) {
+		unsigned int owned_assets_size = owned_assets.size();
+		if (asset >= owned_assets_size) {
+			std::lock_guard lock(uncommitted_assets_mtx);
+			if (asset >= owned_assets_size + uncommitted_assets.size()) {
+				return 0;
+			}
+			return uncommitted_assets[asset - owned_assets_size].lookup_available_balance();
+		}
+		return owned_assets[asset].lookup_available_balance();
+	}
+
 	//not threadsafe with rollback/commit
 	TransactionProcessingStatus reserve_sequence_number(
 		uint64_t sequence_number);
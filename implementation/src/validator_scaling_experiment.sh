@@ -0,0 +1,17 @@
+if [ "$#" -ne 6 ]; then
+	echo "usage: ./whatever experiment_name name_suffix experiment_yaml parent_hostname self_hostname num_assets";
+	exit 1;
+fi
+
+# Runs the validator node at each thread count, once validating tx ranges (the default)
+# and once with account-partitioned replay.  The upstream producer must be restarted
+# for each run (i.e. by the experiment controller).
+# Results go to experiment_results/<name_suffix>/<mode>_<num_threads>.
+
+set -ex
+
+for num_threads in 8 16 32 64; do
+	for mode in ranges partitioned; do
+		./run_validator_node.sh $1 ${num_threads} $2/${mode}_${num_threads} $3 $4 $5 $6 ${mode}
+	done
+done
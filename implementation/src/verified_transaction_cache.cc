@@ -0,0 +1,50 @@
+#include "verified_transaction_cache.h"
+
+#include "utils.h"
+
+namespace edce {
+
+void
+VerifiedTransactionCache::hash_tx(const SignedTransaction& tx, Hash& hash_out) {
+	hash_xdr(tx, hash_out);
+}
+
+void
+VerifiedTransactionCache::insert(const Hash& hash) {
+	auto& shard = get_shard(hash);
+	std::lock_guard lock(shard.mtx);
+	if (shard.current.size() >= MAX_CACHED_PER_SHARD) {
+		shard.prev = std::move(shard.current);
+		shard.current.clear();
+	}
+	shard.current.insert(hash);
+}
+
+bool
+VerifiedTransactionCache::contains(const Hash& hash) {
+	auto& shard = get_shard(hash);
+	std::lock_guard lock(shard.mtx);
+	return (shard.current.find(hash) != shard.current.end())
+		|| (shard.prev.find(hash) != shard.prev.end());
+}
+
+void
+VerifiedTransactionCache::clear() {
+	for (auto& shard : shards) {
+		std::lock_guard lock(shard.mtx);
+		shard.current.clear();
+		shard.prev.clear();
+	}
+}
+
+size_t
+VerifiedTransactionCache::size() {
+	size_t out = 0;
+	for (auto& shard : shards) {
+		std::lock_guard lock(shard.mtx);
+		out += shard.current.size() + shard.prev.size();
+	}
+	return out;
+}
+
+} /* edce */
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <unordered_set>
+
+#include "xdr/types.h"
+#include "xdr/transaction.h"
+
+namespace edce {
+
+/*
+Records the hashes of signed transactions whose signatures have already been verified
+at mempool admission, so that a resubmitted tx (e.g. a client retrying a batch)
+skips re-running crypto_sign_verify_detached.
+Only admission reads or fills the cache.  The block producer relies on admission having
+checked every tx, and a validator never admitted a received block's txs,
+so BlockSignatureChecker checks every signature.
+
+A hash is sha256(xdr(SignedTransaction)), so it commits to both the tx body and the signature.
+Public keys never change after account creation, so a hit remains valid indefinitely.
+
+Sharded by the low bits of the hash, one mutex per shard.
+Each shard keeps two generations; when the current generation fills,
+the older one is dropped.  This bounds memory to roughly 2 * MAX_CACHED_PER_SHARD * NUM_SHARDS entries.
+A miss just means the signature gets checked again.
+*/
+class VerifiedTransactionCache {
+
+	constexpr static size_t NUM_SHARDS = 64;
+	constexpr static size_t MAX_CACHED_PER_SHARD = 50'000;
+
+	struct HashHasher {
+		size_t operator() (const Hash& hash) const {
+			size_t out;
+			memcpy(&out, hash.data(), sizeof(size_t));
+			return out;
+		}
+	};
+
+	using hash_set_t = std::unordered_set<Hash, HashHasher>;
+
+	struct Shard {
+		std::mutex mtx;
+		hash_set_t current;
+		hash_set_t prev;
+	};
+
+	std::array<Shard, NUM_SHARDS> shards;
+
+	Shard& get_shard(const Hash& hash) {
+		return shards[hash[31] % NUM_SHARDS];
+	}
+
+public:
+
+	static void hash_tx(const SignedTransaction& tx, Hash& hash_out);
+
+	//threadsafe
+	void insert(const Hash& hash);
+
+	//threadsafe
+	bool contains(const Hash& hash);
+
+	//threadsafe
+	void clear();
+
+	//approximate, threadsafe
+	size_t size();
+};
+
+} /* edce */
@@ -3,6 +3,7 @@
 
 #include "xdr/types.h"
 #include "merkle_trie_utils.h"
+#include "compact_offer_wrapper.h"
 
 namespace edce {
 
@@ -15,6 +16,7 @@ struct WorkUnitMetadata {
 	int64_t endow;
 
 	WorkUnitMetadata(const Offer& offer) : endow(offer.amount) {}
+	WorkUnitMetadata(const CompactOfferWrapper& offer) : endow(offer.amount) {}
 
 	WorkUnitMetadata() : endow(0) {}
 
@@ -52,6 +54,7 @@ struct AtomicWorkUnitMetadata {
 	std::atomic_int64_t endow;
 
 	AtomicWorkUnitMetadata(const Offer& offer) : endow(offer.amount) {}
+	AtomicWorkUnitMetadata(const CompactOfferWrapper& offer) : endow(offer.amount) {}
 
 	AtomicWorkUnitMetadata() : endow(0) {}
 
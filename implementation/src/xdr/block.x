@@ -102,6 +102,10 @@ struct InternalHashes {
 	WorkUnitStateCommitment clearingDetails;
 	Hash modificationLogHash;
 	Hash blockMapHash;
+	// multiset hashes of all account commitments and of all open offers.
+	// All zeros unless the multiset state commitment is enabled.
+	Hash dbMultisetHash;
+	Hash offerMultisetHash;
 };
 
 //typedef opaque PriceBuffer[6];
@@ -126,6 +130,7 @@ struct TatonnementMeasurements {
 	uint32 num_rounds;
 	uint32 achieved_fee_rate;
 	uint32 achieved_smooth_mult;
+	uint32 convex_solver_won; // 1 if the convex solver found the prices, 0 if tatonnement did
 };
 
 struct BlockStateUpdateStats {
@@ -135,6 +140,9 @@ struct BlockStateUpdateStats {
 	uint32 partial_clear_offer_count;
 	uint32 payment_count;
 	uint32 new_account_count;
+	uint32 hot_account_tx_count;
+	uint32 cas_retry_count;
+	uint32 mutex_wait_count;
 };
 
 struct BlockCreationMeasurements {
@@ -154,6 +162,7 @@ struct BlockCreationMeasurements {
 	uint32 achieved_feerate;
 	uint32 achieved_smooth_mult;
 	uint32 tat_timeout_happened; // 1 if yes, 0 if no
+	uint32 convex_solver_won; // 1 if yes, 0 if no
 	uint32 num_open_offers;
 	float offer_merge_time;
 	float reserved_space8;
@@ -161,6 +170,21 @@ struct BlockCreationMeasurements {
 	float reserved_space0;
 };
 
+//Speculation runs during block N's creation, on the txs that block N+1 will see.
+//num_speculative_drops_applied is from block N's build, using block N-1's speculation.
+struct SpeculationMeasurements {
+	uint32 num_speculated_txs;
+	uint32 num_conflicted_accounts;
+	uint32 num_predicted_drops;
+	uint32 num_predicted_deferrals; // likely failures, processed last in the next block
+	uint32 num_replayed_failures; // predicted failures that conflicts (or unknown credits) sent back to replay
+	uint32 num_speculative_drops_applied;
+	float speculation_time;
+	float speculation_window_time; // tatonnement + lp + clearing
+	float screening_window_fraction; // speculation_time / speculation_window_time, capped at 1; not time saved on the block path
+	float validation_time;
+};
+
 struct BlockDataPersistenceMeasurements {
 	float header_write_time;
 	float account_db_checkpoint_time;
@@ -216,8 +240,8 @@ struct BlockValidationMeasurements {
 	float account_log_finalization_time;
 	float header_map_finalization_time;
 
-	float reserved_space1;
-	float reserved_space2;
+	float tx_partition_time;
+	float multiset_check_time;
 	float reserved_space3;
 	float reserved_space4;
 	float reserved_space5;
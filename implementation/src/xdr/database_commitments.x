@@ -49,5 +49,31 @@ struct AccountModificationTxList {
 
 typedef AccountModificationTxList AccountModificationBlock<>;
 
+// Archived account modification blocks.
+// Each block is split into frames of consecutive accounts, compressed independently.
+
+enum BlockArchiveCompression {
+	ARCHIVE_UNCOMPRESSED = 0,
+	ARCHIVE_ZSTD = 1
+};
+
+struct BlockArchiveFrame {
+	uint64 blockNumber;
+	AccountID firstAccount;
+	AccountID lastAccount;
+	uint32 numEntries;
+	uint32 uncompressedSize;
+	uint64 offset; // from the start of the segment's data section
+	uint32 compressedSize;
+};
+
+struct BlockArchiveSegmentIndex {
+	uint64 firstBlock;
+	uint64 numBlocks;
+	BlockArchiveCompression compression;
+	opaque dictionary<>;
+	BlockArchiveFrame frames<>; // sorted by block, then account
+};
+
 
 }
\ No newline at end of file
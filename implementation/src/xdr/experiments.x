@@ -79,6 +79,7 @@ struct ExperimentBlockResults {
 	float total_block_send_time;
 	float total_self_confirm_time;
 	float total_critical_persist_time;
+	SpeculationMeasurements speculation_measurements;
 };
 
 struct ExperimentResults {
@@ -145,4 +146,35 @@ struct ExperimentConfig {
 
 typedef ExperimentConfig ExperimentConfigList<>;
 
+// One entry of a work unit's metadata index (MerkleWorkUnit::IndexType).
+struct PriceTraceIndexEntry {
+	Price key;
+	int64 endow;
+	int64 endowTimesPriceHigh;
+	uint64 endowTimesPriceLow;
+};
+
+struct PriceTraceWorkUnit {
+	PriceTraceIndexEntry index<>;
+};
+
+// Everything a price computation reads, and what it produced, for one block.
+// A trace file is a sequence of these, each preceded by its length (4 bytes, big endian).
+struct PriceComputationTrace {
+	uint64 blockNumber;
+	uint32 numAssets;
+	uint32 taxRate;
+	uint32 smoothMult;
+	Price startingPrices<>;
+	uint32 volumeRelativizers<>;
+	PriceTraceWorkUnit workUnits<>;
+
+	Price computedPrices<>;
+	TatonnementMeasurements tatonnement;
+	float lpTime;
+	uint32 achievedFeeRate;
+	uint32 achievedSmoothMult;
+	uint32 timeoutHappened;
+};
+
 }
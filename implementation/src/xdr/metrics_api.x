@@ -0,0 +1,43 @@
+namespace edce {
+
+struct MetricsCounterValue {
+	string name<64>;
+	uint64 value;
+};
+
+//latencies in nanoseconds.  Percentiles are bucket upper bounds (within 1/16 of the true value).
+struct MetricsHistogramSummary {
+	string name<64>;
+	uint64 count;
+	uint64 sum_ns;
+	uint64 p50_ns;
+	uint64 p90_ns;
+	uint64 p99_ns;
+	uint64 p999_ns;
+	uint64 max_ns;
+};
+
+struct MetricsSnapshot {
+	uint64 uptime_ns;
+	MetricsCounterValue counters<>;
+	MetricsHistogramSummary histograms<>;
+};
+
+//Written on the server, in its results directory.  filename must be a plain file name
+//(no directories).  num_blocks = 0 dumps every retained span.
+struct SpanTraceDumpRequest {
+	string filename<256>;
+	uint32 num_blocks;
+};
+
+//number of spans written, or -1 if tracing is disabled, the filename is rejected, or the file couldn't be written
+typedef int64 SpanTraceDumpResult;
+
+program Metrics {
+	version MetricsV1 {
+		MetricsSnapshot get_metrics(void) = 1;
+		SpanTraceDumpResult dump_span_trace(SpanTraceDumpRequest) = 2;
+	} = 1;
+} = 0x11111118;
+
+}
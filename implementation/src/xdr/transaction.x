@@ -34,7 +34,8 @@ enum TransactionProcessingStatus {
 	CANCEL_OFFER_TARGET_NEXIST = 13,
 	RECIPIENT_ACCOUNT_NEXIST = 14,
 	INVALID_PRINT_MONEY_AMOUNT = 15,
-	INVALID_AMOUNT = 16
+	INVALID_AMOUNT = 16,
+	INVALID_SIGNATURE = 17
 };
 
 enum OperationType
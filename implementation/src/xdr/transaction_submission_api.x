@@ -1,11 +1,33 @@
-
 %#include "xdr/transaction.h"
+%#include "xdr/block.h"
 
 namespace edce {
 
+//one status per submitted transaction, in submission order.
+//SUCCESS means the tx was admitted to the mempool, not that it will succeed in a block.
+struct TransactionBatchSubmissionResults {
+	uint32 num_accepted;
+	TransactionProcessingStatus results<MAX_TRANSACTIONS_PER_BLOCK>;
+};
+
+typedef AccountID SubmissionStatusQuery<MAX_TRANSACTIONS_PER_BLOCK>;
+
+//for closed-loop load generators (e2e_load_harness).
+//highest_produced_block is read before the sequence numbers, so a tx whose sequence number shows as committed
+//is in a block at most highest_produced_block + 1.
+struct SubmissionStatus {
+	uint64 highest_produced_block;
+	uint64 highest_confirmed_block;
+	//last committed sequence number of each queried account (0 if unknown), in query order
+	uint64 committed_sequence_numbers<MAX_TRANSACTIONS_PER_BLOCK>;
+};
+
 program SubmitTransaction {
 	version SubmitTransactionV1 {
 		void submit_transaction(SignedTransaction) = 1;
+		//payload is SignedTransactionList
+		TransactionBatchSubmissionResults submit_transaction_batch(SerializedBlock) = 2;
+		SubmissionStatus get_submission_status(SubmissionStatusQuery) = 3;
 	} = 1;
 } = 0x10734299;
 
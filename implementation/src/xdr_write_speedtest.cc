@@ -1,38 +1,111 @@
-
 #include "xdr/block.h"
 
 #include "xdr/experiments.h"
 
+#include "io_uring_file_writer.h"
 #include "utils.h"
 
+#include <algorithm>
+#include <string>
+#include <vector>
 
 using namespace edce;
 
+static double percentile(std::vector<double> samples, double p) {
+	if (samples.size() == 0) {
+		return 0;
+	}
+	std::sort(samples.begin(), samples.end());
+	size_t idx = std::min<size_t>(samples.size() - 1, p * samples.size());
+	return samples[idx];
+}
+
+static void print_latencies(const char* name, const std::vector<double>& samples) {
+	std::printf("%s: n=%lu p50=%lf p90=%lf p99=%lf max=%lf\n",
+		name,
+		samples.size(),
+		percentile(samples, 0.5),
+		percentile(samples, 0.9),
+		percentile(samples, 0.99),
+		percentile(samples, 1.0));
+}
+
 int main(int argc, char const *argv[])
 {
 
 
-	if (argc != 3) {
-		std::printf("usage: <infile (Experiment)> <outfile>\n");
+	if (argc != 3 && argc != 4) {
+		std::printf("usage: <infile (Experiment)> <outfile> <num_reps=5>\n");
 		return 0;
 	}
 
+	size_t num_reps = 5;
+	if (argc == 4) {
+		num_reps = std::stoi(argv[3]);
+	}
+
 	ExperimentBlock exp;
 
 	load_xdr_from_file(exp, argv[1]);
 
-	save_xdr_to_file(exp, "comparison");
+	if (save_xdr_to_file(exp, "comparison")) {
+		throw std::runtime_error("could not save comparison file");
+	}
+
+	size_t file_size = xdr::xdr_argpack_size(exp);
+	std::printf("file size: %lu bytes\n", file_size);
+
+	std::string outfile = argv[2];
 
-	auto timestamp = init_time_measurement();
+	std::vector<double> fast_totals;
 
-	save_xdr_to_file_fast(exp, argv[2]);
+	constexpr static unsigned int BUF_SIZE = 5*1677716;
+	unsigned char* write_buffer = new unsigned char[BUF_SIZE];
 
-	float diff = measure_time(timestamp);
+	for (size_t i = 0; i < num_reps; i++) {
+		auto fd = preallocate_file(outfile.c_str(), file_size);
 
-	std::printf("duration: %f\n", diff);
+		auto timestamp = init_time_measurement();
 
-	xdr::xvector<Transaction> txs;
+		save_xdr_to_file_fast(exp, fd, write_buffer, BUF_SIZE);
 
-	load_xdr_from_file(txs, argv[2]);
-	
+		fast_totals.push_back(measure_time(timestamp));
+	}
+	delete[] write_buffer;
+
+	std::vector<double> uring_returns, uring_totals;
+
+	IoUringFileWriter writer;
+
+	for (size_t i = 0; i < num_reps; i++) {
+		auto fd = preallocate_file(outfile.c_str(), file_size);
+
+		auto timestamp = init_time_measurement();
+
+		writer.write_async(exp, std::move(fd));
+		//time until the caller gets control back (i.e. what the block pipeline waits for)
+		uring_returns.push_back(measure_time_from_basept(timestamp));
+
+		writer.wait();
+		uring_totals.push_back(measure_time(timestamp));
+	}
+
+	std::printf("save_xdr_to_file_fast:\n");
+	print_latencies("\ttotal (s)", fast_totals);
+	std::printf("\tthroughput: %lf MB/s\n", file_size / percentile(fast_totals, 0.5) / 1000000);
+
+	std::printf("IoUringFileWriter (liburing = %d):\n", HAVE_LIBURING);
+	print_latencies("\treturn from write_async (s)", uring_returns);
+	print_latencies("\ttotal (s)", uring_totals);
+	print_latencies("\tper chunk (s)", writer.get_chunk_latencies());
+	std::printf("\tthroughput: %lf MB/s\n", file_size / percentile(uring_totals, 0.5) / 1000000);
+
+	ExperimentBlock reloaded;
+	if (load_xdr_from_file(reloaded, argv[2])) {
+		throw std::runtime_error("could not reload output");
+	}
+	if (xdr::xdr_to_opaque(reloaded) != xdr::xdr_to_opaque(exp)) {
+		throw std::runtime_error("IoUringFileWriter output does not match input");
+	}
+	std::printf("output matches input\n");
 }